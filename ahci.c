@@ -5,13 +5,26 @@
 #include "kernel.h"
 #include "memory.h"
 #include "mmu.h"
+#include "softirq.h"
+#include "spinlock.h"
 #include "string.h"
 #include "terminal.h"
 // Global AHCI controller
 ahci_controller_t ahci_controller = {0};
 // Timeout values
 #define AHCI_TIMEOUT_MS 5000
+#define AHCI_TIMEOUT_TICKS (AHCI_TIMEOUT_MS / 10)
 #define AHCI_SPIN_TIMEOUT 1000000
+
+// Causas de PxIS que detienen el puerto
+#define AHCI_PORT_IS_ERRORS                                                    \
+  (AHCI_PORT_IS_TFES | AHCI_PORT_IS_HBFS | AHCI_PORT_IS_HBDS |                 \
+   AHCI_PORT_IS_IFS)
+
+static void ahci_softirq(void);
+static void ahci_setup_irq(void);
+static void ahci_port_poll(ahci_port_t *port);
+static void ahci_port_recover_work(void *arg);
 // ========================================================================
 // INICIALIZACIÓN
 // ========================================================================
@@ -64,6 +77,9 @@ bool ahci_init(void) {
   }
 
   ahci_controller.initialized = true;
+  // Las causas de interrupción se atienden en el bottom half
+  open_softirq(SOFTIRQ_BLOCK, ahci_softirq);
+  ahci_setup_irq();
 
   terminal_printf(&main_terminal,
                   "AHCI initialization complete: %u ports initialized\r\n",
@@ -473,6 +489,12 @@ bool ahci_initialize_port(uint8_t port_num) {
   memset(port, 0, sizeof(ahci_port_t));
 
   port->port_num = port_num;
+  spinlock_init(&port->lock, "ahci_port");
+  wait_queue_init(&port->wq, "ahci_port");
+  work_init(&port->recover_work, ahci_port_recover_work, port);
+  port->slot_mask = ahci_controller.command_slots >= AHCI_MAX_CMDS
+                        ? 0xFFFFFFFFu
+                        : (1u << ahci_controller.command_slots) - 1;
   port->port_regs =
       (hba_port_t *)((uint8_t *)ahci_controller.abar + AHCI_PORT_BASE +
                      (port_num * AHCI_PORT_SIZE));
@@ -666,9 +688,9 @@ bool ahci_initialize_port(uint8_t port_num) {
 
   // 9. Initialize command tables
   for (int i = 0; i < AHCI_MAX_CMDS; i++) {
-    // Usar tamaño de buffer mayor para ICH9
+    // Cabecera de 128 bytes + AHCI_PRDT_ENTRIES entradas PRD
     port->cmd_table_buffers[i] =
-        dma_alloc_buffer(sizeof(hba_cmd_tbl_t) * 2, 128);
+        dma_alloc_buffer(sizeof(hba_cmd_tbl_t), 128);
     if (!port->cmd_table_buffers[i]) {
       terminal_printf(
           &main_terminal,
@@ -696,9 +718,6 @@ bool ahci_initialize_port(uint8_t port_num) {
       port->cmd_list[i].ctbau =
           (port->cmd_table_buffers[i]->physical_address >> 32) & 0xFFFFFFFF;
     }
-
-    // Inicializar slot como libre
-    port->command_slots[i] = false;
   }
 
   // =================================================================
@@ -927,9 +946,10 @@ bool ahci_stop_port(uint8_t port_num) {
 // FUNCIONES DE COMANDO
 // ========================================================================
 int ahci_find_cmdslot(ahci_port_t *port) {
-  uint32_t slots = (port->port_regs->sact | port->port_regs->ci);
+  uint32_t slots = port->port_regs->sact | port->port_regs->ci |
+                   port->slots_busy | ~port->slot_mask;
   for (int i = 0; i < AHCI_MAX_CMDS; i++) {
-    if ((slots & (1 << i)) == 0 && !port->command_slots[i]) {
+    if ((slots & (1u << i)) == 0) {
       return i;
     }
   }
@@ -978,6 +998,86 @@ bool ahci_spin_up_device(uint8_t port_num) {
   terminal_puts(&main_terminal, "AHCI: Failed to spin up device\r\n");
   return false;
 }
+// ========================================================================
+// TABLA PRD
+// ========================================================================
+
+// Recorre 'buffer' página a página y une las físicamente contiguas en una
+// entrada (hasta AHCI_PRD_MAX_BYTES). Devuelve los bytes cubiertos: menos
+// de 'size' si se acaban las AHCI_PRDT_ENTRIES entradas o una página no
+// está mapeada. Con table == NULL solo cuenta.
+static uint32_t ahci_fill_prdt(hba_cmd_tbl_t *table, const void *buffer,
+                               uint32_t size, uint16_t *entries_out) {
+  uint32_t virt = (uint32_t)buffer;
+  uint32_t done = 0;
+  uint32_t entries = 0;
+  uint32_t run_end = 0;
+  uint32_t run_bytes = 0;
+
+  while (done < size) {
+    uint32_t phys = mmu_virtual_to_physical(virt + done);
+    if (phys == 0)
+      break;
+    uint32_t chunk = 0x1000 - ((virt + done) & 0xFFF);
+    if (chunk > size - done)
+      chunk = size - done;
+
+    if (entries && phys == run_end &&
+        run_bytes + chunk <= AHCI_PRD_MAX_BYTES) {
+      run_bytes += chunk;
+    } else {
+      if (entries == AHCI_PRDT_ENTRIES)
+        break;
+      entries++;
+      run_bytes = chunk;
+      if (table) {
+        hba_prdt_entry_t *prd = &table->prdt_entry[entries - 1];
+        prd->dba = phys;
+        prd->dbau = 0;
+        prd->rsv0 = 0;
+        prd->i = 0;
+      }
+    }
+    if (table)
+      table->prdt_entry[entries - 1].dbc = run_bytes - 1; // Size - 1
+    run_end = phys + chunk;
+    done += chunk;
+  }
+
+  // Interrupt on completion en la última
+  if (table && entries)
+    table->prdt_entry[entries - 1].i = 1;
+  if (entries_out)
+    *entries_out = (uint16_t)entries;
+  return done;
+}
+
+// ========================================================================
+// COMANDOS SÍNCRONOS
+// ========================================================================
+
+// Los comandos sin cola (IDENTIFY, IDLE...) no se pueden mezclar con los
+// NCQ: se cierra el paso a nuevas peticiones y se espera a que terminen
+// las que están en vuelo
+static void ahci_port_quiesce(ahci_port_t *port) {
+  uint32_t flags = spin_lock_irqsave(&port->lock);
+  port->exclusive++;
+  while (port->slots_busy) {
+    wait_queue_sleep(&port->wq, &port->lock, 1);
+    spin_unlock_irqrestore(&port->lock, flags);
+    ahci_port_poll(port);
+    flags = spin_lock_irqsave(&port->lock);
+  }
+  spin_unlock_irqrestore(&port->lock, flags);
+}
+
+static void ahci_port_release(ahci_port_t *port) {
+  uint32_t flags = spin_lock_irqsave(&port->lock);
+  port->exclusive--;
+  wait_queue_wake_all(&port->wq);
+  spin_unlock_irqrestore(&port->lock, flags);
+}
+
 bool ahci_send_command(uint8_t port_num, uint8_t slot, uint8_t *fis,
                        void *buffer, uint32_t buffer_size, bool write) {
   if (port_num >= ahci_controller.port_count ||
@@ -985,55 +1085,64 @@ bool ahci_send_command(uint8_t port_num, uint8_t slot, uint8_t *fis,
     return false;
   }
   ahci_port_t *port = &ahci_controller.ports[port_num];
+  ahci_port_quiesce(port);
   hba_cmd_header_t *cmd_header = &port->cmd_list[slot];
   hba_cmd_tbl_t *cmd_table = port->cmd_tables[slot];
+  // Configurar PRDT si hay buffer
+  uint16_t prdt_entries = 0;
+  if (buffer && buffer_size > 0 &&
+      ahci_fill_prdt(cmd_table, buffer, buffer_size, &prdt_entries) !=
+          buffer_size) {
+    terminal_printf(&main_terminal,
+                    "AHCI: Failed to get physical address for buffer\r\n");
+    ahci_port_release(port);
+    return false;
+  }
   // Configurar command header
   cmd_header->cfl = sizeof(fis_reg_h2d_t) / sizeof(uint32_t); // FIS length
   cmd_header->w = write ? 1 : 0;
-  cmd_header->prdtl = buffer ? 1 : 0; // Number of PRDT entries
+  cmd_header->prdtl = prdt_entries; // Number of PRDT entries
+  cmd_header->prdbc = 0;
   // Copiar FIS al command table
   memcpy(cmd_table->cfis, fis, sizeof(fis_reg_h2d_t));
-  // Configurar PRDT si hay buffer
-  if (buffer && buffer_size > 0) {
-    uint32_t phys_addr = mmu_virtual_to_physical((uint32_t)buffer);
-    if (phys_addr == 0) {
-      terminal_printf(&main_terminal,
-                      "AHCI: Failed to get physical address for buffer\r\n");
-      return false;
-    }
-    cmd_table->prdt_entry[0].dba = phys_addr;
-    cmd_table->prdt_entry[0].dbau = 0;
-    cmd_table->prdt_entry[0].dbc = buffer_size - 1; // Size - 1
-    cmd_table->prdt_entry[0].i = 1;                 // Interrupt on completion
-  }
   // Marcar slot como usado
-  port->command_slots[slot] = true;
+  uint32_t flags = spin_lock_irqsave(&port->lock);
+  port->slots_busy |= 1u << slot;
+  port->error_pending = false;
+  spin_unlock_irqrestore(&port->lock, flags);
   // Emitir comando
   port->port_regs->ci = 1 << slot;
-  // Esperar completación
+  // Esperar completación. El top half puede reconocer PxIS antes que
+  // nosotros: el error queda entonces en error_pending.
+  bool ok = true;
   uint32_t timeout = AHCI_TIMEOUT_MS * 1000; // Convert to microseconds
   while ((port->port_regs->ci & (1 << slot)) && timeout--) {
     // Check for errors
-    if (port->port_regs->is & AHCI_PORT_IS_TFES) {
+    if ((port->port_regs->is & AHCI_PORT_IS_TFES) || port->error_pending) {
       terminal_printf(&main_terminal, "AHCI: Task file error on port %u\r\n",
                       port_num);
-      port->command_slots[slot] = false;
-      return false;
+      ok = false;
+      break;
     }
     // Small delay
     for (volatile int i = 0; i < 10; i++)
       ;
   }
-  port->command_slots[slot] = false;
-  if (port->port_regs->ci & (1 << slot)) {
+  if (ok && (port->port_regs->ci & (1 << slot))) {
     terminal_printf(&main_terminal,
                     "AHCI: Command timeout on port %u slot %u\r\n", port_num,
                     slot);
-    return false;
+    ok = false;
   }
   // Clear interrupts
-  port->port_regs->is = 0xFFFFFFFF;
-  return true;
+  if (ok)
+    port->port_regs->is = 0xFFFFFFFF;
+  flags = spin_lock_irqsave(&port->lock);
+  port->slots_busy &= ~(1u << slot);
+  port->error_pending = false;
+  spin_unlock_irqrestore(&port->lock, flags);
+  ahci_port_release(port);
+  return ok;
 }
 bool ahci_identify_device(uint8_t port_num, void *buffer) {
   if (!buffer)
@@ -1050,110 +1159,509 @@ bool ahci_identify_device(uint8_t port_num, void *buffer) {
       (port->device_type == 2) ? ATA_CMD_IDENTIFY_PACKET : ATA_CMD_IDENTIFY;
   return ahci_send_command(port_num, slot, (uint8_t *)&fis, buffer, 512, false);
 }
-bool ahci_read_sectors(uint8_t port_num, uint64_t lba, uint32_t count,
-                       void *buffer) {
-  if (!buffer || count == 0)
-    return false;
+
+// ========================================================================
+// COMANDOS ASÍNCRONOS
+// ========================================================================
+
+void ahci_enable_ncq(uint8_t port_num, uint32_t depth) {
+  if (port_num >= AHCI_MAX_PORTS || !ahci_controller.supports_ncq)
+    return;
   ahci_port_t *port = &ahci_controller.ports[port_num];
-  if (port->device_type != 1)
-    return false; // Solo SATA
-  int slot = ahci_find_cmdslot(port);
-  if (slot == -1)
-    return false;
-  // Preparar FIS
-  fis_reg_h2d_t fis = {0};
-  fis.fis_type = FIS_TYPE_REG_H2D;
-  fis.c = 1; // Command bit
-  if (lba > 0xFFFFFFF) {
+  if (!port->initialized || port->device_type != 1)
+    return;
+
+  if (depth > ahci_controller.command_slots)
+    depth = ahci_controller.command_slots;
+  if (depth > AHCI_MAX_CMDS)
+    depth = AHCI_MAX_CMDS;
+  if (depth < 2)
+    return; // Con un tag no gana nada frente a READ/WRITE DMA
+
+  uint32_t flags = spin_lock_irqsave(&port->lock);
+  port->ncq_enabled = true;
+  port->ncq_depth = (uint8_t)depth;
+  port->slot_mask = depth >= AHCI_MAX_CMDS ? 0xFFFFFFFFu : (1u << depth) - 1;
+  spin_unlock_irqrestore(&port->lock, flags);
+
+  terminal_printf(&main_terminal, "AHCI: Port %u NCQ enabled, depth %u\r\n",
+                  port_num, depth);
+}
+
+void ahci_set_lba48(uint8_t port_num, bool supported) {
+  if (port_num < AHCI_MAX_PORTS)
+    ahci_controller.ports[port_num].lba48 = supported;
+}
+
+uint32_t ahci_max_sectors(uint8_t port_num) {
+  if (port_num >= AHCI_MAX_PORTS)
+    return 0;
+  ahci_port_t *port = &ahci_controller.ports[port_num];
+  return (port->lba48 || port->ncq_enabled) ? AHCI_MAX_SECTORS_LBA48
+                                            : AHCI_MAX_SECTORS_LBA28;
+}
+
+static void ahci_build_rw_fis(const ahci_port_t *port, fis_reg_h2d_t *fis,
+                              uint64_t lba, uint32_t count, bool write,
+                              uint8_t tag) {
+  memset(fis, 0, sizeof(*fis));
+  fis->fis_type = FIS_TYPE_REG_H2D;
+  fis->c = 1; // Command bit
+
+  if (port->ncq_enabled) {
+    // FPDMA QUEUED: el número de sectores va en FEATURES y el tag en
+    // COUNT(7:3). Siempre con LBA48.
+    fis->command =
+        write ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED;
+    fis->featurel = count & 0xFF;
+    fis->featureh = (count >> 8) & 0xFF;
+    fis->countl = tag << 3;
+    fis->lba0 = lba & 0xFF;
+    fis->lba1 = (lba >> 8) & 0xFF;
+    fis->lba2 = (lba >> 16) & 0xFF;
+    fis->lba3 = (lba >> 24) & 0xFF;
+    fis->lba4 = (lba >> 32) & 0xFF;
+    fis->lba5 = (lba >> 40) & 0xFF;
+    fis->device = 1 << 6; // LBA mode
+  } else if (lba + count > 0xFFFFFFF || count > AHCI_MAX_SECTORS_LBA28) {
     // LBA48
-    fis.command = ATA_CMD_READ_DMA_EXT;
-    fis.lba0 = lba & 0xFF;
-    fis.lba1 = (lba >> 8) & 0xFF;
-    fis.lba2 = (lba >> 16) & 0xFF;
-    fis.lba3 = (lba >> 24) & 0xFF;
-    fis.lba4 = (lba >> 32) & 0xFF;
-    fis.lba5 = (lba >> 40) & 0xFF;
-    fis.device = 1 << 6; // LBA mode
-    fis.countl = count & 0xFF;
-    fis.counth = (count >> 8) & 0xFF;
+    fis->command = write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+    fis->lba0 = lba & 0xFF;
+    fis->lba1 = (lba >> 8) & 0xFF;
+    fis->lba2 = (lba >> 16) & 0xFF;
+    fis->lba3 = (lba >> 24) & 0xFF;
+    fis->lba4 = (lba >> 32) & 0xFF;
+    fis->lba5 = (lba >> 40) & 0xFF;
+    fis->device = 1 << 6; // LBA mode
+    fis->countl = count & 0xFF;
+    fis->counth = (count >> 8) & 0xFF;
   } else {
     // LBA28
-    fis.command = ATA_CMD_READ_DMA;
-    fis.lba0 = lba & 0xFF;
-    fis.lba1 = (lba >> 8) & 0xFF;
-    fis.lba2 = (lba >> 16) & 0xFF;
-    fis.device = (1 << 6) | ((lba >> 24) & 0x0F); // LBA mode + upper 4 bits
-    fis.countl = count & 0xFF;
-  }
-  return ahci_send_command(port_num, slot, (uint8_t *)&fis, buffer, count * 512,
-                           false);
+    fis->command = write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA;
+    fis->lba0 = lba & 0xFF;
+    fis->lba1 = (lba >> 8) & 0xFF;
+    fis->lba2 = (lba >> 16) & 0xFF;
+    fis->device = (1 << 6) | ((lba >> 24) & 0x0F); // LBA mode + upper 4 bits
+    fis->countl = count & 0xFF;
+  }
 }
 
-bool ahci_write_sectors(uint8_t port_num, uint64_t lba, uint32_t count,
-                        const void *buffer) {
-  if (!buffer || count == 0) {
-    terminal_printf(&main_terminal, "AHCI: Invalid write parameters\n");
+bool ahci_submit(uint8_t port_num, ahci_request_t *req) {
+  if (port_num >= AHCI_MAX_PORTS || !req || !req->buffer || req->count == 0 ||
+      req->count > ahci_max_sectors(port_num))
     return false;
-  }
-
   ahci_port_t *port = &ahci_controller.ports[port_num];
-  if (!port->initialized || port->device_type != 1) {
+  if (!port->initialized || port->device_type != 1)
+    return false; // Solo SATA
+
+  // Las entradas PRD tienen que empezar en dirección par
+  uint32_t size = req->count * 512;
+  if ((uint32_t)req->buffer & 1) {
     terminal_printf(&main_terminal,
-                    "AHCI: Port %u not initialized or not SATA\n", port_num);
+                    "AHCI: Buffer not usable for DMA on port %u\r\n",
+                    port_num);
     return false;
   }
 
-  // terminal_printf(
-  //     &main_terminal,
-  //     "AHCI: Write sectors - port=%u, lba=%llu, count=%u, buffer=%p\n",
-  //     port_num, lba, count, buffer);
-
-  // Verificar que hay slots disponibles
-  int slot = ahci_find_cmdslot(port);
-  if (slot == -1) {
-    terminal_printf(&main_terminal, "AHCI: No free command slots on port %u\n",
+  req->error = false;
+
+  // Esperar a un slot libre (y a que no haya un comando síncrono pendiente)
+  uint32_t flags = spin_lock_irqsave(&port->lock);
+  uint32_t free;
+  while (port->exclusive || port->recovering ||
+         !(free = port->slot_mask & ~port->slots_busy)) {
+    port->stat_slot_waits++;
+    wait_queue_sleep(&port->wq, &port->lock, 1);
+    spin_unlock_irqrestore(&port->lock, flags);
+    ahci_port_poll(port);
+    flags = spin_lock_irqsave(&port->lock);
+  }
+
+  uint8_t tag = (uint8_t)__builtin_ctz(free);
+  uint32_t bit = 1u << tag;
+  req->tag = tag;
+  port->slots_busy |= bit;
+  port->slot_req[tag] = req;
+
+  hba_cmd_header_t *cmd_header = &port->cmd_list[tag];
+  hba_cmd_tbl_t *cmd_table = port->cmd_tables[tag];
+  uint16_t prdt_entries;
+  if (ahci_fill_prdt(cmd_table, req->buffer, size, &prdt_entries) != size) {
+    port->slots_busy &= ~bit;
+    port->slot_req[tag] = NULL;
+    wait_queue_wake_all(&port->wq);
+    spin_unlock_irqrestore(&port->lock, flags);
+    terminal_printf(&main_terminal,
+                    "AHCI: Buffer does not fit in the PRD table on port %u\r\n",
                     port_num);
     return false;
   }
+  fis_reg_h2d_t fis;
+  ahci_build_rw_fis(port, &fis, req->lba, req->count, req->write, tag);
+  memcpy(cmd_table->cfis, &fis, sizeof(fis_reg_h2d_t));
+  cmd_header->cfl = sizeof(fis_reg_h2d_t) / sizeof(uint32_t);
+  cmd_header->w = req->write ? 1 : 0;
+  cmd_header->c = 0;
+  cmd_header->prdtl = prdt_entries;
+  cmd_header->prdbc = 0;
+
+  // Con NCQ el tag se marca en SActive antes de emitirlo
+  if (port->ncq_enabled) {
+    port->port_regs->sact = bit;
+    port->stat_ncq_commands++;
+  }
+  port->port_regs->ci = bit;
+  port->slots_issued |= bit;
+
+  port->stat_commands++;
+  uint32_t inflight = 0;
+  for (uint32_t slots = port->slots_issued; slots; slots &= slots - 1)
+    inflight++;
+  if (inflight > port->stat_max_inflight)
+    port->stat_max_inflight = inflight;
+  spin_unlock_irqrestore(&port->lock, flags);
+  return true;
+}
 
-  // terminal_printf(&main_terminal, "AHCI: Using command slot %d\n", slot);
+// Pasa a slots_done los slots emitidos que el HBA ya ha apagado en SActive
+// y CI. Desde el top half o un sondeo.
+static void ahci_port_reap(ahci_port_t *port, uint32_t port_is) {
+  uint32_t flags = spin_lock_irqsave(&port->lock);
+  uint32_t active = port->port_regs->sact | port->port_regs->ci;
+  uint32_t done = port->slots_issued & ~active;
+  port->slots_issued &= ~done;
+  port->slots_done |= done;
+  if (port_is & AHCI_PORT_IS_ERRORS)
+    port->error_pending = true;
+  spin_unlock_irqrestore(&port->lock, flags);
+}
+
+// ========================================================================
+// RECUPERACIÓN DE ERRORES (AHCI 1.3, 6.2.2)
+// ========================================================================
+
+// Espera acotada a que (registro & mask) == value. El registro va por
+// offset (hba_port_t es packed). No duerme: también se llega desde un
+// sondeo con las IRQs deshabilitadas.
+static bool ahci_wait_reg(hba_port_t *regs, uint32_t offset, uint32_t mask,
+                          uint32_t value, uint32_t timeout_ms) {
+  volatile uint32_t *reg = (volatile uint32_t *)((uint8_t *)regs + offset);
+  for (uint32_t i = 0; i < timeout_ms * 1000; i++) {
+    if ((*reg & mask) == value)
+      return true;
+    for (volatile int j = 0; j < 10; j++)
+      ;
+  }
+  return (*reg & mask) == value;
+}
+
+// Parar la lista de comandos borra PxCI y PxSACT: con eso se descartan
+// todos los comandos en vuelo. FRE se queda activo.
+static bool ahci_engine_stop(hba_port_t *regs) {
+  regs->cmd &= ~AHCI_PORT_CMD_ST;
+  return ahci_wait_reg(regs, offsetof(hba_port_t, cmd), AHCI_PORT_CMD_CR, 0,
+                       500);
+}
+
+// ST solo se puede activar con BSY y DRQ a 0
+static bool ahci_engine_start(hba_port_t *regs) {
+  if (!ahci_wait_reg(regs, offsetof(hba_port_t, tfd), ATA_SR_BSY | ATA_SR_DRQ,
+                     0, AHCI_TIMEOUT_MS))
+    return false;
+  regs->cmd |= AHCI_PORT_CMD_ST;
+  return ahci_wait_reg(regs, offsetof(hba_port_t, cmd), AHCI_PORT_CMD_CR,
+                       AHCI_PORT_CMD_CR, 500);
+}
+
+// COMRESET con la lista de comandos parada: DET = 1 al menos 1 ms y
+// esperar a que el enlace y la unidad vuelvan
+static bool ahci_port_comreset(hba_port_t *regs) {
+  regs->sctl = (regs->sctl & ~AHCI_PORT_SSTS_DET_MASK) | 1;
+  for (volatile int i = 0; i < 100000; i++)
+    __asm__ volatile("pause");
+  regs->sctl &= ~AHCI_PORT_SSTS_DET_MASK;
+  if (!ahci_wait_reg(regs, offsetof(hba_port_t, ssts),
+                     AHCI_PORT_SSTS_DET_MASK, AHCI_PORT_SSTS_DET_PRESENT, 1000))
+    return false;
+  regs->serr = 0xFFFFFFFF; // El enlace deja SERR.DIAG.X a 1
+  return ahci_wait_reg(regs, offsetof(hba_port_t, tfd),
+                       ATA_SR_BSY | ATA_SR_DRQ, 0, AHCI_TIMEOUT_MS);
+}
+
+// Solo se mira el primer byte (el tag), no hace falta uno por puerto
+static uint8_t ahci_ncq_log[512] __attribute__((aligned(4)));
+
+// Tras un error de NCQ la unidad rechaza los comandos en cola hasta que se
+// lee la página 10h. Sin comandos en vuelo (acaban de descartarse) se usa
+// el slot 0. Devuelve el tag que falló, -1 si no es de NCQ o -2 si la
+// lectura no termina.
+static int ahci_read_ncq_error_log(ahci_port_t *port) {
+  hba_port_t *regs = port->port_regs;
+  hba_cmd_header_t *cmd_header = &port->cmd_list[0];
+  hba_cmd_tbl_t *cmd_table = port->cmd_tables[0];
+  uint16_t prdt_entries;
+  if (ahci_fill_prdt(cmd_table, ahci_ncq_log, sizeof(ahci_ncq_log),
+                     &prdt_entries) != sizeof(ahci_ncq_log))
+    return -2;
 
-  // Preparar FIS
   fis_reg_h2d_t fis = {0};
   fis.fis_type = FIS_TYPE_REG_H2D;
-  fis.c = 1; // Command bit
+  fis.c = 1;
+  fis.command = ATA_CMD_READ_LOG_EXT;
+  fis.lba0 = ATA_LOG_NCQ_ERROR;
+  fis.countl = 1;
+  memcpy(cmd_table->cfis, &fis, sizeof(fis_reg_h2d_t));
+  cmd_header->cfl = sizeof(fis_reg_h2d_t) / sizeof(uint32_t);
+  cmd_header->w = 0;
+  cmd_header->c = 0;
+  cmd_header->prdtl = prdt_entries;
+  cmd_header->prdbc = 0;
 
-  if (lba > 0xFFFFFFF) {
-    // LBA48
-    fis.command = ATA_CMD_WRITE_DMA_EXT;
-    fis.lba0 = lba & 0xFF;
-    fis.lba1 = (lba >> 8) & 0xFF;
-    fis.lba2 = (lba >> 16) & 0xFF;
-    fis.lba3 = (lba >> 24) & 0xFF;
-    fis.lba4 = (lba >> 32) & 0xFF;
-    fis.lba5 = (lba >> 40) & 0xFF;
-    fis.device = 1 << 6; // LBA mode
-    fis.countl = count & 0xFF;
-    fis.counth = (count >> 8) & 0xFF;
-    // terminal_printf(&main_terminal, "AHCI: Using LBA48 command\n");
-  } else {
-    // LBA28
-    fis.command = ATA_CMD_WRITE_DMA;
-    fis.lba0 = lba & 0xFF;
-    fis.lba1 = (lba >> 8) & 0xFF;
-    fis.lba2 = (lba >> 16) & 0xFF;
-    fis.device = (1 << 6) | ((lba >> 24) & 0x0F); // LBA mode + upper 4 bits
-    fis.countl = count & 0xFF;
-    // terminal_printf(&main_terminal, "AHCI: Using LBA28 command\n");
+  regs->is = ~0U;
+  regs->ci = 1;
+  uint32_t timeout = AHCI_TIMEOUT_MS * 1000;
+  while ((regs->ci & 1) && !(regs->is & AHCI_PORT_IS_TFES) && timeout--) {
+    for (volatile int i = 0; i < 10; i++)
+      ;
+  }
+  if ((regs->ci & 1) || (regs->is & AHCI_PORT_IS_TFES))
+    return -2;
+
+  // Byte 0: NQ (bit 7) si el error no fue de un comando en cola
+  if (ahci_ncq_log[0] & 0x80)
+    return -1;
+  return ahci_ncq_log[0] & 0x1F;
+}
+
+// Secuencia de 6.2.2: parar la lista, COMRESET si la unidad sigue ocupada
+// y, si no hizo falta, leer el log de NCQ antes de volver a encolar
+static void ahci_port_recover(ahci_port_t *port) {
+  hba_port_t *regs = port->port_regs;
+  uint32_t tfd = regs->tfd;
+  uint32_t serr = regs->serr;
+  bool reset = false;
+  int tag = -1;
+
+  ahci_engine_stop(regs);
+  regs->serr = 0xFFFFFFFF;
+  regs->is = ~0U;
+
+  if (regs->tfd & (ATA_SR_BSY | ATA_SR_DRQ)) {
+    reset = true;
+    ahci_port_comreset(regs);
   }
+  bool ok = ahci_engine_start(regs);
 
-  // terminal_printf(&main_terminal,
-  //              "AHCI: FIS prepared - command=0x%02X, device=0x%02X\n",
-  //              fis.command, fis.device);
+  if (ok && port->ncq_enabled && !reset) {
+    tag = ahci_read_ncq_error_log(port);
+    if (tag == -2) {
+      // Tampoco atiende al log: solo queda el reset
+      ahci_engine_stop(regs);
+      reset = true;
+      ok = ahci_port_comreset(regs) && ahci_engine_start(regs);
+    }
+  }
+  regs->serr = 0xFFFFFFFF;
+  regs->is = ~0U;
+  port->stat_resets++;
 
-  // Enviar comando
-  bool result = ahci_send_command(port_num, slot, (uint8_t *)&fis,
-                                  (void *)buffer, count * 512, true);
+  terminal_printf(&main_terminal,
+                  "AHCI: Port %u error (TFD=0x%08x, SERR=0x%08x)%s",
+                  port->port_num, tfd, serr, reset ? ", COMRESET" : "");
+  if (tag >= 0)
+    terminal_printf(&main_terminal, ", NCQ tag %d", tag);
+  terminal_puts(&main_terminal,
+                ok ? ", recovered\r\n" : ", port did not restart\r\n");
+}
+
+// Llama a 'done' de los slots terminados y los libera
+static void ahci_port_finish(ahci_port_t *port, uint32_t finished,
+                             uint32_t failed, bool recovered) {
+  for (uint32_t slots = finished; slots; slots &= slots - 1) {
+    uint8_t tag = (uint8_t)__builtin_ctz(slots);
+    ahci_request_t *req = port->slot_req[tag];
+    if (!req)
+      continue;
+    req->error = (failed & (1u << tag)) != 0;
+    if (req->error)
+      port->stat_errors++;
+    if (req->done)
+      req->done(req);
+  }
+
+  uint32_t flags = spin_lock_irqsave(&port->lock);
+  for (uint32_t slots = finished; slots; slots &= slots - 1)
+    port->slot_req[__builtin_ctz(slots)] = NULL;
+  port->slots_busy &= ~finished;
+  if (recovered) {
+    // Los errores que dejaron los comandos descartados ya están tratados
+    port->error_pending = false;
+    port->recovering = false;
+  }
+  wait_queue_wake_all(&port->wq);
+  spin_unlock_irqrestore(&port->lock, flags);
+}
+
+// La recuperación la hace quien la reclame primero: el worker o un sondeo
+// de quien espera (si los workers están ocupados esperando a este disco)
+static void ahci_port_run_recovery(ahci_port_t *port) {
+  uint32_t flags = spin_lock_irqsave(&port->lock);
+  if (!port->recover_pending) {
+    spin_unlock_irqrestore(&port->lock, flags);
+    return;
+  }
+  port->recover_pending = false;
+  uint32_t failed = port->recover_failed;
+  port->recover_failed = 0;
+  spin_unlock_irqrestore(&port->lock, flags);
+
+  ahci_port_recover(port);
+  ahci_port_finish(port, failed, failed, true);
+}
+
+static void ahci_port_recover_work(void *arg) {
+  ahci_port_run_recovery((ahci_port_t *)arg);
+}
+
+// Termina los slots de slots_done. Si hubo error, los emitidos quedan para
+// la recuperación, que espera y sondea: no se hace en el bottom half.
+// Desde el bottom half o un sondeo: no duerme.
+static void ahci_port_complete(ahci_port_t *port) {
+  uint32_t flags = spin_lock_irqsave(&port->lock);
+  uint32_t done = port->slots_done;
+  bool recover = false;
+  port->slots_done = 0;
+  if (port->error_pending && !port->recovering) {
+    if (port->slots_issued) {
+      port->error_pending = false;
+      port->recovering = true;
+      port->recover_pending = true;
+      port->recover_failed = port->slots_issued;
+      port->slots_issued = 0;
+      recover = true;
+    } else if (!port->exclusive) {
+      // Sin comandos en vuelo no hay nada que reiniciar. Con un comando
+      // síncrono en marcha el error es suyo: lo recoge ahci_send_command.
+      port->error_pending = false;
+    }
+  }
+  spin_unlock_irqrestore(&port->lock, flags);
+
+  // Sin workqueue (arranque) no queda más remedio que hacerla aquí
+  if (recover && (!workqueue_running() || !queue_work_item(&port->recover_work)))
+    ahci_port_run_recovery(port);
+
+  if (done)
+    ahci_port_finish(port, done, 0, false);
+}
+
+// Sondeo para cuando no se puede esperar a la interrupción (arranque) o
+// se ha perdido
+static void ahci_port_poll(ahci_port_t *port) {
+  uint32_t port_is = port->port_regs->is;
+  if (port_is & AHCI_PORT_IS_ERRORS)
+    port->port_regs->is = port_is & AHCI_PORT_IS_ERRORS;
+  ahci_port_reap(port, port_is);
+  ahci_port_complete(port);
+  ahci_port_run_recovery(port);
+}
+
+static void ahci_sync_done(ahci_request_t *req) { req->completed = true; }
+
+// Se puede dormir esperando si la línea funciona (ya ha llegado alguna
+// interrupción) y el llamador no tiene las IRQs deshabilitadas
+static bool ahci_irq_usable(void) {
+  return ahci_controller.irq_line != 0xFF && ahci_controller.irq_seen &&
+         irq_line_active(ahci_controller.irq_line) && local_irq_enabled();
+}
+
+// Envía un comando y espera: duerme hasta la interrupción si puede y, si
+// no, sondea
+static bool ahci_rw_one(uint8_t port_num, uint64_t lba, uint32_t count,
+                        void *buffer, bool write) {
+  ahci_request_t req = {0};
+  req.lba = lba;
+  req.count = count;
+  req.buffer = buffer;
+  req.write = write;
+  req.done = ahci_sync_done;
+  if (!ahci_submit(port_num, &req))
+    return false;
+
+  ahci_port_t *port = &ahci_controller.ports[port_num];
+  bool can_sleep = ahci_irq_usable();
+  uint32_t start = ticks_since_boot;
+  uint32_t spins = 0;
+  uint32_t flags = spin_lock_irqsave(&port->lock);
+  while (!req.completed) {
+    // El plazo de un tick cubre una interrupción perdida
+    if (can_sleep)
+      wait_queue_sleep(&port->wq, &port->lock, 1);
+    if (req.completed)
+      break;
+    spin_unlock_irqrestore(&port->lock, flags);
+    if (ticks_since_boot - start > AHCI_TIMEOUT_TICKS ||
+        ++spins > AHCI_TIMEOUT_MS * 1000) {
+      terminal_printf(&main_terminal,
+                      "AHCI: Command timeout on port %u slot %u\r\n", port_num,
+                      req.tag);
+      flags = spin_lock_irqsave(&port->lock);
+      port->error_pending = true;
+      spin_unlock_irqrestore(&port->lock, flags);
+      start = ticks_since_boot;
+      spins = 0;
+    }
+    ahci_port_poll(port);
+    flags = spin_lock_irqsave(&port->lock);
+  }
+  spin_unlock_irqrestore(&port->lock, flags);
+  return !req.error;
+}
+
+// Divide la transferencia en los comandos más largos posibles: hasta
+// ahci_max_sectors() y lo que quepa en la tabla PRD
+static bool ahci_rw_sync(uint8_t port_num, uint64_t lba, uint32_t count,
+                         void *buffer, bool write) {
+  uint8_t *buf = (uint8_t *)buffer;
+  uint32_t max = ahci_max_sectors(port_num);
+
+  while (count > 0) {
+    uint32_t sectors = count < max ? count : max;
+    sectors = ahci_fill_prdt(NULL, buf, sectors * 512, NULL) / 512;
+    if (sectors == 0 || !ahci_rw_one(port_num, lba, sectors, buf, write))
+      return false;
+    buf += sectors * 512;
+    lba += sectors;
+    count -= sectors;
+  }
+  return true;
+}
+
+bool ahci_read_sectors(uint8_t port_num, uint64_t lba, uint32_t count,
+                       void *buffer) {
+  if (!buffer || count == 0)
+    return false;
+  ahci_port_t *port = &ahci_controller.ports[port_num];
+  if (port->device_type != 1)
+    return false; // Solo SATA
+  return ahci_rw_sync(port_num, lba, count, buffer, false);
+}
+
+bool ahci_write_sectors(uint8_t port_num, uint64_t lba, uint32_t count,
+                        const void *buffer) {
+  if (!buffer || count == 0) {
+    terminal_printf(&main_terminal, "AHCI: Invalid write parameters\n");
+    return false;
+  }
+
+  ahci_port_t *port = &ahci_controller.ports[port_num];
+  if (!port->initialized || port->device_type != 1) {
+    terminal_printf(&main_terminal,
+                    "AHCI: Port %u not initialized or not SATA\n", port_num);
+    return false;
+  }
+
+  bool result = ahci_rw_sync(port_num, lba, count, (void *)buffer, true);
 
   if (!result) {
     terminal_printf(&main_terminal, "AHCI: send_command failed\n");
@@ -1166,8 +1674,6 @@ bool ahci_write_sectors(uint8_t port_num, uint64_t lba, uint32_t count,
     terminal_printf(&main_terminal, "  IS: 0x%08x\n", port->port_regs->is);
     terminal_printf(&main_terminal, "  CI: 0x%08x\n", port->port_regs->ci);
     terminal_printf(&main_terminal, "  SERR: 0x%08x\n", port->port_regs->serr);
-  } else {
-    // terminal_printf(&main_terminal, "AHCI: Write completed successfully\n");
   }
 
   return result;
@@ -1185,6 +1691,14 @@ void ahci_list_devices(void) {
   terminal_printf(&main_terminal, "Controller: %04x:%04x\r\n",
                   ahci_controller.pci_device->vendor_id,
                   ahci_controller.pci_device->device_id);
+  if (ahci_controller.irq_line == 0xFF)
+    terminal_puts(&main_terminal, "IRQ: none, completions polled\r\n");
+  else
+    terminal_printf(&main_terminal, "IRQ: line %u %s, %u interrupts\r\n",
+                    ahci_controller.irq_line,
+                    irq_line_active(ahci_controller.irq_line) ? "active"
+                                                              : "disabled",
+                    irq_line_count(ahci_controller.irq_line));
   uint32_t devices_found = 0;
   for (uint8_t i = 0; i < ahci_controller.port_count; i++) {
     if (ahci_controller.ports[i].present) {
@@ -1259,6 +1773,23 @@ void ahci_print_port_status(uint8_t port_num) {
   terminal_printf(&main_terminal, "Command: 0x%08x\r\n", port->port_regs->cmd);
   terminal_printf(&main_terminal, "Status: 0x%08x\r\n", port->port_regs->is);
   terminal_printf(&main_terminal, "Error: 0x%08x\r\n", port->port_regs->serr);
+  if (port->device_type == 1) {
+    if (port->ncq_enabled)
+      terminal_printf(&main_terminal, "NCQ: enabled, depth %u\r\n",
+                      port->ncq_depth);
+    else
+      terminal_puts(&main_terminal, "NCQ: disabled\r\n");
+    terminal_printf(&main_terminal,
+                    "Max per command: %u sectors, %u PRD entries\r\n",
+                    ahci_max_sectors(port_num), AHCI_PRDT_ENTRIES);
+    terminal_printf(&main_terminal,
+                    "Commands: %u (%u queued), max in flight %u, slot waits "
+                    "%u\r\n",
+                    port->stat_commands, port->stat_ncq_commands,
+                    port->stat_max_inflight, port->stat_slot_waits);
+    terminal_printf(&main_terminal, "Errors: %u, port resets: %u\r\n",
+                    port->stat_errors, port->stat_resets);
+  }
   terminal_puts(&main_terminal, "\r\n");
 }
 const char *ahci_get_device_type_name(uint32_t signature) {
@@ -1278,11 +1809,72 @@ const char *ahci_get_device_type_name(uint32_t signature) {
 // ========================================================================
 // IRQ HANDLER
 // ========================================================================
-void ahci_irq_handler(struct regs *r) {
-  if (!ahci_controller.initialized) {
-    return;
+// Registrado en la línea de interrupt_line del PCI; irq_dispatch manda el
+// EOI y corre el bottom half
+
+// Bits de PxIS reconocidos por el top half, pendientes del bottom half
+static volatile uint32_t ahci_pending_port_is[32];
+static volatile uint32_t ahci_pending_ports = 0;
+
+// Bottom half (SOFTIRQ_BLOCK): terminar los comandos que el top half vio
+// acabar (o reiniciar el puerto si hubo error) e informar de cambios de
+// conexión
+static void ahci_softirq(void) {
+  uint32_t flags = local_irq_save();
+  uint32_t ports = ahci_pending_ports;
+  ahci_pending_ports = 0;
+  local_irq_restore(flags);
+
+  for (uint8_t port = 0; ports; port++, ports >>= 1) {
+    if (!(ports & 1))
+      continue;
+
+    flags = local_irq_save();
+    uint32_t port_is = ahci_pending_port_is[port];
+    ahci_pending_port_is[port] = 0;
+    local_irq_restore(flags);
+
+    ahci_port_complete(&ahci_controller.ports[port]);
+    if (port_is & AHCI_PORT_IS_PCS) {
+      terminal_printf(&main_terminal,
+                      "AHCI: Port connect change on port %u\r\n", port);
+    }
   }
+}
+
+// INTx del PCI (bit 10 del comando a 0) en la línea que asignó el BIOS.
+// Sin ella los comandos se completan sondeando.
+static void ahci_setup_irq(void) {
+  static uint8_t registered_line = 0xFF;
+
+  pci_device_t *pci = ahci_controller.pci_device;
+  uint16_t pci_cmd =
+      pci_config_read_word(pci->bus, pci->device, pci->function, 0x04);
+  pci_config_write_word(pci->bus, pci->device, pci->function, 0x04,
+                        pci_cmd & ~(1u << 10));
+
+  uint8_t line = pci->interrupt_line;
+  if (registered_line == 0xFF && line != 0 && line < 16 &&
+      irq_register_handler(line, ahci_irq_handler, NULL))
+    registered_line = line;
+  ahci_controller.irq_line = registered_line;
+  if (registered_line == 0xFF)
+    terminal_printf(&main_terminal,
+                    "AHCI: No usable IRQ (line %u), completions polled\r\n",
+                    line);
+}
+
+// Top half: reconocer PxIS/IS, recoger los slots terminados según SActive
+// y CI, anotar las causas y salir
+bool ahci_irq_handler(void *ctx) {
+  (void)ctx;
+  if (!ahci_controller.initialized)
+    return false;
+
   uint32_t global_is = ahci_controller.abar->is;
+  if (!global_is)
+    return false; // De otro dispositivo de la línea
+  ahci_controller.irq_seen = true;
   for (uint8_t port = 0; port < ahci_controller.port_count; port++) {
     if (!(global_is & (1 << port)))
       continue;
@@ -1290,21 +1882,16 @@ void ahci_irq_handler(struct regs *r) {
       continue;
     ahci_port_t *ahci_port = &ahci_controller.ports[port];
     uint32_t port_is = ahci_port->port_regs->is;
-    if (port_is & AHCI_PORT_IS_TFES) {
-      terminal_printf(&main_terminal, "AHCI: Task file error on port %u\r\n",
-                      port);
-    }
-    if (port_is & AHCI_PORT_IS_DHRS) {
-      // Device to Host Register FIS received
-    }
-    if (port_is & AHCI_PORT_IS_PCS) {
-      terminal_printf(&main_terminal,
-                      "AHCI: Port connect change on port %u\r\n", port);
-    }
     // Clear port interrupts
     ahci_port->port_regs->is = port_is;
+    ahci_port_reap(ahci_port, port_is);
+    ahci_pending_port_is[port] |= port_is;
+    ahci_pending_ports |= 1u << port;
   }
   // Clear global interrupts
   ahci_controller.abar->is = global_is;
-  pic_send_eoi(r->int_no - 32);
+
+  if (ahci_pending_ports)
+    raise_softirq(SOFTIRQ_BLOCK);
+  return true;
 }
\ No newline at end of file
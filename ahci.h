@@ -3,6 +3,9 @@
 
 #include "dma.h"
 #include "pci.h"
+#include "spinlock.h"
+#include "task.h"
+#include "workqueue.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -166,8 +169,13 @@
 #define ATA_CMD_READ_DMA_EXT 0x25
 #define ATA_CMD_WRITE_DMA 0xCA
 #define ATA_CMD_WRITE_DMA_EXT 0x35
+#define ATA_CMD_READ_FPDMA_QUEUED 0x60
+#define ATA_CMD_WRITE_FPDMA_QUEUED 0x61
 #define ATA_CMD_IDENTIFY 0xEC
 #define ATA_CMD_IDENTIFY_PACKET 0xA1
+#define ATA_CMD_READ_LOG_EXT 0x2F
+
+#define ATA_LOG_NCQ_ERROR 0x10 // Página de READ LOG EXT con el tag fallido
 
 // Command slot and FIS sizes
 #define AHCI_MAX_PORTS 32
@@ -176,6 +184,17 @@
 #define AHCI_RX_FIS_SIZE 256
 #define AHCI_CMD_TBL_SIZE 0x80
 
+// Tabla PRD: cada entrada cubre hasta 4 MiB físicamente contiguos. Con 128
+// entradas un comando admite al menos 512 KiB aunque ninguna página sea
+// contigua a la anterior.
+#define AHCI_PRDT_ENTRIES 128
+#define AHCI_PRD_MAX_BYTES (4 * 1024 * 1024)
+
+// Sectores por comando: 16 bits de cuenta con LBA48 (y en FPDMA QUEUED),
+// 8 bits con LBA28
+#define AHCI_MAX_SECTORS_LBA48 65535
+#define AHCI_MAX_SECTORS_LBA28 256
+
 #define AHCI_PORT_IE_MASK                                                      \
   (AHCI_PORT_IS_DHRS | AHCI_PORT_IS_PSS | AHCI_PORT_IS_DSS |                   \
    AHCI_PORT_IS_SDBS | AHCI_PORT_IS_UFS | AHCI_PORT_IS_TFES |                  \
@@ -281,7 +300,8 @@ typedef struct __attribute__((packed)) {
   uint8_t cfis[64];               // Command FIS
   uint8_t acmd[16];               // ATAPI command, 12 or 16 bytes
   uint8_t rsv[48];                // Reserved
-  hba_prdt_entry_t prdt_entry[1]; // Physical region descriptor table entries
+  // Physical region descriptor table entries
+  hba_prdt_entry_t prdt_entry[AHCI_PRDT_ENTRIES];
 } hba_cmd_tbl_t;
 
 typedef struct __attribute__((packed)) {
@@ -327,6 +347,38 @@ typedef struct __attribute__((packed)) {
   volatile uint32_t vendor[4]; // 0x70 ~ 0x7F, vendor specific
 } hba_port_t;
 
+// ========================================================================
+// COMANDOS ASÍNCRONOS (NCQ)
+// ========================================================================
+//
+// Cada puerto admite tantos comandos en vuelo como slots (hasta 32). Si el
+// controlador y el disco soportan NCQ se envían como READ/WRITE FPDMA
+// QUEUED con el slot como tag y el disco los reordena; si no, como READ/
+// WRITE DMA y el HBA los ejecuta en orden. La finalización llega por
+// interrupción: el top half compara SActive y CI con los slots emitidos y
+// el bottom half (SOFTIRQ_BLOCK) llama a 'done' de los que han terminado.
+// Si un comando falla se reinicia el puerto y fallan todos los que
+// estaban en vuelo.
+
+struct ahci_request;
+typedef void (*ahci_done_t)(struct ahci_request *req);
+
+typedef struct ahci_request {
+  // Los rellena quien envía. 'buffer' debe estar alineado a palabra, caber
+  // en la tabla PRD y seguir válido hasta que se llame a 'done'.
+  uint64_t lba;
+  uint32_t count;
+  void *buffer;
+  bool write;
+  ahci_done_t done; // Bottom half, sondeo o worker de recuperación: no duerme
+  void *private;
+
+  // Resultado, válido en 'done'
+  bool error;
+  volatile bool completed; // Para quien espera (lo pone su 'done')
+  uint8_t tag;
+} ahci_request_t;
+
 // AHCI Port structure
 typedef struct {
   uint8_t port_num;
@@ -344,7 +396,33 @@ typedef struct {
   dma_buffer_t *fis_buffer;
   dma_buffer_t *cmd_table_buffers[AHCI_MAX_CMDS];
 
-  bool command_slots[AHCI_MAX_CMDS]; // Track used slots
+  // Slots. Orden de locks: lock -> scheduler_lock (lo toma la wait queue)
+  spinlock_t lock;
+  uint32_t slot_mask;     // Slots utilizables
+  uint32_t slots_busy;    // Reservados (asíncronos y síncronos)
+  uint32_t slots_issued;  // Asíncronos emitidos al HBA sin terminar
+  uint32_t slots_done;    // Terminados, pendientes del bottom half
+  ahci_request_t *slot_req[AHCI_MAX_CMDS];
+  uint32_t exclusive;     // Comando síncrono esperando a vaciar el puerto
+  bool error_pending;     // Error visto en PxIS, falta reiniciar el puerto
+  bool recovering;
+  // Recuperación diferida a la workqueue (o a un sondeo, lo que llegue
+  // antes): recover_failed son los slots que se dan por fallidos
+  bool recover_pending;
+  uint32_t recover_failed;
+  work_t recover_work;
+  wait_queue_t wq;        // Slots libres y comandos terminados
+  bool ncq_enabled;
+  uint8_t ncq_depth;
+  bool lba48;             // Comandos EXT de hasta AHCI_MAX_SECTORS_LBA48
+
+  // Estadísticas
+  uint32_t stat_commands;
+  uint32_t stat_ncq_commands;
+  uint32_t stat_max_inflight;
+  uint32_t stat_slot_waits;
+  uint32_t stat_errors;
+  uint32_t stat_resets;
 } ahci_port_t;
 
 // AHCI Controller structure
@@ -359,6 +437,9 @@ typedef struct {
   bool supports_64bit;
   bool supports_ncq;
 
+  uint8_t irq_line;       // 0xFF = sin interrupción
+  volatile bool irq_seen; // Ya llegó alguna: las esperas pueden dormir
+
   ahci_port_t ports[AHCI_MAX_PORTS];
   uint32_t ports_implemented;
 } ahci_controller_t;
@@ -387,6 +468,21 @@ bool ahci_read_sectors(uint8_t port_num, uint64_t lba, uint32_t count,
 bool ahci_write_sectors(uint8_t port_num, uint64_t lba, uint32_t count,
                         const void *buffer);
 
+// Activar NCQ en el puerto con 'depth' tags (palabra 75 de IDENTIFY + 1).
+// Solo con el puerto sin comandos en vuelo.
+void ahci_enable_ncq(uint8_t port_num, uint32_t depth);
+
+// El disco admite LBA48 (palabra 83 de IDENTIFY): comandos más largos
+void ahci_set_lba48(uint8_t port_num, bool supported);
+
+// Sectores máximos por comando en el puerto
+uint32_t ahci_max_sectors(uint8_t port_num);
+
+// Envía la petición y vuelve sin esperar a que termine (sí a que haya un
+// slot libre). false si los parámetros no son válidos; entonces no se
+// llama a 'done'.
+bool ahci_submit(uint8_t port_num, ahci_request_t *req);
+
 // Utility functions
 void ahci_list_devices(void);
 void ahci_print_port_status(uint8_t port_num);
@@ -396,6 +492,6 @@ const char *ahci_get_device_type_name(uint32_t signature);
 struct regs;
 
 // IRQ handler
-void ahci_irq_handler(struct regs *r);
+bool ahci_irq_handler(void *ctx);
 
 #endif // AHCI_H
\ No newline at end of file
@@ -9,10 +9,13 @@
 #include "serial.h"
 #include "string.h"
 #include "terminal.h"
+#include "timer.h"
+#include "workqueue.h"
 
 // Increased cache size to prevent thrashing in bridged networks
 #define ARP_CACHE_SIZE 64
 #define ARP_REQUEST_TIMEOUT 5000 // 5 segundos
+#define ARP_AGING_INTERVAL_MS 60000 // Revisar entradas viejas cada minuto
 
 // Cache ARP
 typedef struct {
@@ -26,6 +29,25 @@ typedef struct {
 static arp_entry_t arp_cache[ARP_CACHE_SIZE];
 static uint32_t arp_sequence = 0;
 
+// Envejecimiento: el timer (softirq) encola el trabajo, que sí puede tomar
+// el lock de la pila
+static void arp_aging_timer_func(void *arg);
+static void arp_aging_work_func(void *arg);
+static ktimer_t arp_aging_timer = KTIMER_INIT(arp_aging_timer_func, NULL);
+static work_t arp_aging_work = WORK_INIT(arp_aging_work_func, NULL);
+
+static void arp_aging_timer_func(void *arg) {
+  (void)arg;
+  queue_work_item(&arp_aging_work); // Si ya estaba en cola, basta con esa
+}
+
+static void arp_aging_work_func(void *arg) {
+  (void)arg;
+  network_stack_lock();
+  arp_cleanup_old_entries();
+  network_stack_unlock();
+}
+
 static bool is_qemu_mode(void) {
   // Verificar si estamos en la red típica de QEMU (10.0.2.x)
   ip_addr_t our_ip;
@@ -83,6 +105,8 @@ void arp_init(void) {
                              "10.0.2.2 -> broadcast MAC\r\n");
   }
 
+  timer_add_periodic(&arp_aging_timer, TIMER_MS(ARP_AGING_INTERVAL_MS));
+
   serial_printf(COM1_BASE, "[ARP] Cache initialized\r\n");
 }
 
@@ -1,4 +1,5 @@
 #include "atapi.h"
+#include "ide.h"
 #include "io.h"
 #include "kernel.h"
 #include "memory.h"
@@ -33,17 +34,17 @@
 
 // Timeout values
 #define ATAPI_TIMEOUT_MS 5000
-#define ATAPI_SPIN_TIMEOUT 1000000
 
 // Global ATAPI devices
 static atapi_device_t atapi_devices[MAX_ATAPI_DEVICES];
 static uint32_t atapi_device_count = 0;
 static bool atapi_initialized = false;
 
-// Forward declarations
+// Forward declarations. 'irq': el dispositivo avisará con una interrupción
+// del canal y se puede dormir (ide_channel_wait)
 static bool atapi_wait_ready(atapi_device_t *device);
-static bool atapi_wait_drq(atapi_device_t *device);
-static bool atapi_wait_not_busy(atapi_device_t *device);
+static bool atapi_wait_drq(atapi_device_t *device, bool irq);
+static bool atapi_wait_not_busy(atapi_device_t *device, bool irq);
 static void atapi_select_drive(atapi_device_t *device);
 static void atapi_400ns_delay(atapi_device_t *device);
 static uint8_t atapi_read_status(atapi_device_t *device);
@@ -85,6 +86,10 @@ bool atapi_init(void) {
   terminal_printf(&main_terminal, "ATAPI: Initialized %u device(s)\r\n",
                   atapi_device_count);
 
+  // Los comandos esperan la interrupción del canal en vez de sondear
+  for (uint32_t i = 0; i < atapi_device_count; i++)
+    ide_channel_irq_enable(atapi_devices[i].bus);
+
   // Create driver instances for the system
   for (uint32_t i = 0; i < atapi_device_count; i++) {
     char name[16];
@@ -177,7 +182,7 @@ bool atapi_detect_device(uint8_t bus, uint8_t drive) {
   }
 
   // Wait for BSY to clear
-  if (!atapi_wait_not_busy(device)) {
+  if (!atapi_wait_not_busy(device, true)) {
     terminal_puts(&main_terminal, "ATAPI: Timeout waiting for ready\r\n");
     return false;
   }
@@ -190,7 +195,7 @@ bool atapi_detect_device(uint8_t bus, uint8_t drive) {
   }
 
   // Wait for DRQ
-  if (!atapi_wait_drq(device)) {
+  if (!atapi_wait_drq(device, true)) {
     terminal_puts(&main_terminal, "ATAPI: Timeout waiting for data\r\n");
     return false;
   }
@@ -309,8 +314,8 @@ atapi_err_t atapi_send_packet(atapi_device_t *device, uint8_t *packet,
   outb(device->io_base + ATA_REG_COMMAND, ATA_CMD_PACKET);
   atapi_400ns_delay(device);
 
-  // Wait for device to request packet
-  if (!atapi_wait_drq(device)) {
+  // Wait for device to request packet (sin interrupción)
+  if (!atapi_wait_drq(device, false)) {
     return ATAPI_ERR_TIMEOUT;
   }
 
@@ -322,7 +327,7 @@ atapi_err_t atapi_send_packet(atapi_device_t *device, uint8_t *packet,
 
   // If no data transfer expected, we're done
   if (!buffer || buffer_size == 0) {
-    atapi_wait_not_busy(device);
+    atapi_wait_not_busy(device, true);
     return ATAPI_ERR_NONE;
   }
 
@@ -332,7 +337,7 @@ atapi_err_t atapi_send_packet(atapi_device_t *device, uint8_t *packet,
     uint16_t *buf16 = (uint16_t *)buffer;
     uint32_t words_to_read = buffer_size / 2;
 
-    if (!atapi_wait_drq(device)) {
+    if (!atapi_wait_drq(device, true)) {
       return ATAPI_ERR_TIMEOUT;
     }
 
@@ -344,7 +349,7 @@ atapi_err_t atapi_send_packet(atapi_device_t *device, uint8_t *packet,
     uint16_t *buf16 = (uint16_t *)buffer;
     uint32_t words_to_write = buffer_size / 2;
 
-    if (!atapi_wait_drq(device)) {
+    if (!atapi_wait_drq(device, true)) {
       return ATAPI_ERR_TIMEOUT;
     }
 
@@ -354,7 +359,7 @@ atapi_err_t atapi_send_packet(atapi_device_t *device, uint8_t *packet,
   }
 
   // Wait for command completion
-  if (!atapi_wait_not_busy(device)) {
+  if (!atapi_wait_not_busy(device, true)) {
     return ATAPI_ERR_TIMEOUT;
   }
 
@@ -504,7 +509,9 @@ atapi_err_t atapi_read_sectors(uint32_t device_id, uint32_t lba, uint32_t count,
 
   while (sectors_read < count) {
     uint32_t sectors_to_read =
-        (count - sectors_read > 16) ? 16 : (count - sectors_read);
+        (count - sectors_read > ATAPI_MAX_SECTORS_PER_CMD)
+            ? ATAPI_MAX_SECTORS_PER_CMD
+            : (count - sectors_read);
 
     uint8_t packet[ATAPI_PACKET_SIZE] = {0};
     packet[0] = ATAPI_CMD_READ_10;
@@ -741,49 +748,19 @@ static uint8_t atapi_read_status(atapi_device_t *device) {
   return inb(device->io_base + ATA_REG_STATUS);
 }
 
-static bool atapi_wait_not_busy(atapi_device_t *device) {
-  uint32_t timeout = ATAPI_SPIN_TIMEOUT;
-
-  while (timeout--) {
-    uint8_t status = atapi_read_status(device);
-    if (!(status & ATA_STATUS_BSY)) {
-      return true;
-    }
-    __asm__ volatile("pause");
-  }
-
-  return false;
+static bool atapi_wait_not_busy(atapi_device_t *device, bool irq) {
+  return ide_channel_wait(device->bus, ATA_STATUS_BSY, 0, false, irq) == 0;
 }
 
+// Antes de enviar el comando: no hay interrupción que esperar
 static bool atapi_wait_ready(atapi_device_t *device) {
-  uint32_t timeout = ATAPI_SPIN_TIMEOUT;
-
-  while (timeout--) {
-    uint8_t status = atapi_read_status(device);
-    if (!(status & ATA_STATUS_BSY) && (status & ATA_STATUS_RDY)) {
-      return true;
-    }
-    __asm__ volatile("pause");
-  }
-
-  return false;
+  return ide_channel_wait(device->bus, ATA_STATUS_BSY | ATA_STATUS_RDY,
+                          ATA_STATUS_RDY, false, false) == 0;
 }
 
-static bool atapi_wait_drq(atapi_device_t *device) {
-  uint32_t timeout = ATAPI_SPIN_TIMEOUT;
-
-  while (timeout--) {
-    uint8_t status = atapi_read_status(device);
-    if (status & ATA_STATUS_ERR) {
-      return false;
-    }
-    if (status & ATA_STATUS_DRQ) {
-      return true;
-    }
-    __asm__ volatile("pause");
-  }
-
-  return false;
+static bool atapi_wait_drq(atapi_device_t *device, bool irq) {
+  return ide_channel_wait(device->bus, ATA_STATUS_DRQ, ATA_STATUS_DRQ, true,
+                          irq) == 0;
 }
 
 bool atapi_verify_device_signature(uint8_t bus, uint8_t drive) {
@@ -20,6 +20,7 @@
 // ATAPI Packet sizes
 #define ATAPI_PACKET_SIZE 12
 #define ATAPI_SECTOR_SIZE 2048 // CD/DVD sector size
+#define ATAPI_MAX_SECTORS_PER_CMD 16 // READ(10) por comando en atapi_read_sectors
 
 // ATAPI Device types
 #define ATAPI_TYPE_CDROM 0x05
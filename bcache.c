@@ -0,0 +1,1071 @@
+#include "bcache.h"
+#include "disk_io_daemon.h"
+#include "irq.h"
+#include "kernel.h"
+#include "memory.h"
+#include "spinlock.h"
+#include "string.h"
+#include "task.h"
+#include "task_utils.h"
+#include "terminal.h"
+
+// ========================================================================
+// ESTADO
+// ========================================================================
+
+#define BCACHE_VALID 0x01
+#define BCACHE_DIRTY 0x02
+#define BCACHE_PREFETCHED 0x04 // Traído por la lectura anticipada, sin leer
+#define BCACHE_WRITEBACK 0x08  // Volcado en la cola de disco: no desalojar
+
+typedef struct bcache_buf {
+  struct bcache_buf *hash_next;
+  struct bcache_buf *lru_prev; // Hacia los más recientes
+  struct bcache_buf *lru_next; // Hacia los menos recientes
+  uint64_t lba;
+  uint32_t dirty_since; // Tick en que se ensució
+  uint8_t dev;          // Índice en bcache_devs
+  uint8_t flags;
+  uint8_t *data;
+} bcache_buf_t;
+
+// Copia del disk_t físico: los disk_t de partición pueden ser temporales
+typedef struct bcache_dev {
+  bool used;
+  disk_t disk;
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t written; // Sectores volcados por la caché
+  uint32_t native;  // Sectores por bloque nativo (disk_native_sectors)
+  // Detección de lectura secuencial
+  uint64_t ra_next;   // LBA que tendría la siguiente lectura secuencial
+  uint64_t ra_end;    // Fin de lo ya pedido a la lectura anticipada
+  uint32_t ra_window; // Sectores de la próxima petición (0 = no secuencial)
+} bcache_dev_t;
+
+typedef struct bcache_ra_req {
+  uint8_t dev;
+  uint64_t lba;
+  uint32_t count;
+} bcache_ra_req_t;
+
+// bcache_mutex protege índices y LRU; las lecturas de fallos se hacen sin
+// él. bcache_io_mutex serializa los comandos a los discos que no admiten
+// varios a la vez. Orden: bcache_mutex -> bcache_io_mutex.
+static mutex_t bcache_mutex;
+static mutex_t bcache_io_mutex;
+// Cambia con cada escritura al dispositivo (ver bcache_io_write)
+static volatile uint32_t bcache_write_gen = 0;
+static bool bcache_ready = false;
+
+static bcache_buf_t *bcache_bufs = NULL;
+static uint8_t *bcache_data = NULL;
+static uint32_t bcache_nblocks = 0;
+static bcache_buf_t **bcache_hash = NULL;
+static uint32_t bcache_hash_mask = 0;
+static bcache_buf_t *lru_head = NULL; // Más reciente
+static bcache_buf_t *lru_tail = NULL; // Candidato a desalojo
+static uint8_t *bcache_run_buf = NULL; // Escrituras agrupadas
+static uint8_t *bcache_ra_buf = NULL;  // Lecturas anticipadas
+static uint8_t *bcache_edge_buf = NULL; // Bloques nativos de borde
+static uint32_t bcache_ra_max = BCACHE_RA_MAX_SECTORS;
+
+static bcache_dev_t bcache_devs[BCACHE_MAX_DEVICES];
+
+static uint32_t bcache_dirty = 0;
+static uint32_t stat_hits = 0;
+static uint32_t stat_misses = 0;
+static uint32_t stat_evictions = 0;
+static uint32_t stat_writeback_runs = 0;
+static uint32_t stat_writeback_sectors = 0;
+static uint32_t stat_write_through = 0;
+static uint32_t stat_write_errors = 0;
+static uint32_t stat_ra_requests = 0;
+static uint32_t stat_ra_dropped = 0;
+static uint32_t stat_ra_sectors = 0;
+static uint32_t stat_ra_hits = 0;
+static uint32_t stat_ra_errors = 0;
+static uint32_t stat_edge_fills = 0;
+
+static spinlock_t flusher_lock = SPINLOCK_INIT("bcache_flush");
+static wait_queue_t flusher_wq = WAIT_QUEUE_INIT("bcache_flush");
+
+// Cola de lectura anticipada: la llenan los lectores, la vacía bcache_ra
+static spinlock_t ra_lock = SPINLOCK_INIT("bcache_ra");
+static wait_queue_t ra_wq = WAIT_QUEUE_INIT("bcache_ra");
+static bcache_ra_req_t ra_queue[BCACHE_RA_QUEUE_LEN];
+static uint32_t ra_head = 0;
+static uint32_t ra_count = 0;
+static bool ra_running = false;
+
+// Volcados enviados a la cola de disk_io
+typedef struct bcache_wb {
+  disk_io_request_t req;
+  uint8_t dev;
+  // Sigue la copia de los sectores
+} bcache_wb_t;
+
+static spinlock_t wb_lock = SPINLOCK_INIT("bcache_wb");
+static wait_queue_t wb_wq = WAIT_QUEUE_INIT("bcache_wb");
+static uint32_t wb_inflight = 0;
+static disk_err_t wb_error = DISK_ERR_NONE; // Primer error aún sin informar
+
+// ========================================================================
+// ÍNDICES (requieren bcache_mutex)
+// ========================================================================
+
+static inline uint32_t bcache_hash_index(uint8_t dev, uint64_t lba) {
+  uint32_t key = (uint32_t)lba ^ (uint32_t)(lba >> 32) ^ ((uint32_t)dev << 24);
+  return (key * 2654435761u) & bcache_hash_mask;
+}
+
+static bcache_buf_t *bcache_lookup(uint8_t dev, uint64_t lba) {
+  bcache_buf_t *buf = bcache_hash[bcache_hash_index(dev, lba)];
+  while (buf && (buf->dev != dev || buf->lba != lba))
+    buf = buf->hash_next;
+  return buf;
+}
+
+static void bcache_hash_insert(bcache_buf_t *buf) {
+  bcache_buf_t **slot = &bcache_hash[bcache_hash_index(buf->dev, buf->lba)];
+  buf->hash_next = *slot;
+  *slot = buf;
+}
+
+static void bcache_hash_remove(bcache_buf_t *buf) {
+  bcache_buf_t **link = &bcache_hash[bcache_hash_index(buf->dev, buf->lba)];
+  while (*link && *link != buf)
+    link = &(*link)->hash_next;
+  if (*link)
+    *link = buf->hash_next;
+  buf->hash_next = NULL;
+}
+
+static void lru_unlink(bcache_buf_t *buf) {
+  if (buf->lru_prev)
+    buf->lru_prev->lru_next = buf->lru_next;
+  else
+    lru_head = buf->lru_next;
+  if (buf->lru_next)
+    buf->lru_next->lru_prev = buf->lru_prev;
+  else
+    lru_tail = buf->lru_prev;
+  buf->lru_prev = buf->lru_next = NULL;
+}
+
+static void lru_push_head(bcache_buf_t *buf) {
+  buf->lru_prev = NULL;
+  buf->lru_next = lru_head;
+  if (lru_head)
+    lru_head->lru_prev = buf;
+  lru_head = buf;
+  if (!lru_tail)
+    lru_tail = buf;
+}
+
+static inline void lru_touch(bcache_buf_t *buf) {
+  if (buf != lru_head) {
+    lru_unlink(buf);
+    lru_push_head(buf);
+  }
+}
+
+static void bcache_mark_clean(bcache_buf_t *buf) {
+  if (buf->flags & BCACHE_DIRTY) {
+    buf->flags &= ~BCACHE_DIRTY;
+    bcache_dirty--;
+  }
+}
+
+// ========================================================================
+// DISPOSITIVOS
+// ========================================================================
+
+// Índice del dispositivo físico de 'disk' (lo registra la primera vez) o
+// -1 si no se cachea
+static int bcache_dev_get(disk_t *disk) {
+  if (disk_is_atapi(disk))
+    return -1;
+
+  int free_slot = -1;
+  for (int i = 0; i < BCACHE_MAX_DEVICES; i++) {
+    if (bcache_devs[i].used &&
+        bcache_devs[i].disk.drive_number == disk->drive_number)
+      return i;
+    if (!bcache_devs[i].used && free_slot < 0)
+      free_slot = i;
+  }
+  if (free_slot < 0)
+    return -1;
+
+  // Vista del disco entero: LBA físico y límites del dispositivo
+  bcache_dev_t *dev = &bcache_devs[free_slot];
+  if (disk->is_partition && disk->physical_disk) {
+    memcpy(&dev->disk, disk->physical_disk, sizeof(disk_t));
+  } else {
+    memcpy(&dev->disk, disk, sizeof(disk_t));
+    if (disk->is_partition)
+      dev->disk.sector_count += disk->partition_lba_offset;
+  }
+  dev->disk.is_partition = false;
+  dev->disk.partition_lba_offset = 0;
+  dev->disk.physical_disk = NULL;
+  dev->hits = dev->misses = dev->written = 0;
+  dev->native = disk_native_sectors(&dev->disk);
+  dev->ra_next = dev->ra_end = 0;
+  dev->ra_window = 0;
+  dev->used = true;
+  return free_slot;
+}
+
+// ========================================================================
+// E/S AL DISPOSITIVO
+// ========================================================================
+
+// IDE, ATAPI y USB atienden un comando a la vez. SATA con NCQ admite
+// varios en vuelo: ahí no se serializa y las lecturas de varias tareas se
+// solapan.
+static inline bool bcache_dev_serialized(disk_t *disk) {
+  return disk_get_limits(disk)->queue_depth <= 1;
+}
+
+static disk_err_t bcache_io_read(disk_t *disk, uint64_t lba, uint32_t count,
+                                 void *buffer) {
+  bool serialized = bcache_dev_serialized(disk);
+  if (serialized)
+    mutex_lock(&bcache_io_mutex);
+  disk_err_t err = disk_read_device(disk, lba, count, buffer);
+  if (serialized)
+    mutex_unlock(&bcache_io_mutex);
+  return err;
+}
+
+// Al terminar cambia bcache_write_gen: una lectura hecha sin bcache_mutex
+// que se haya cruzado con la escritura no mete sus datos en la caché
+static disk_err_t bcache_io_write(disk_t *disk, uint64_t lba, uint32_t count,
+                                  const void *buffer) {
+  bool serialized = bcache_dev_serialized(disk);
+  if (serialized)
+    mutex_lock(&bcache_io_mutex);
+  disk_err_t err = disk_write_device(disk, lba, count, buffer);
+  if (serialized)
+    mutex_unlock(&bcache_io_mutex);
+  __atomic_fetch_add(&bcache_write_gen, 1, __ATOMIC_SEQ_CST);
+  return err;
+}
+
+// ========================================================================
+// VOLCADO (requiere bcache_mutex)
+// ========================================================================
+
+static inline bool bcache_can_write_back(const bcache_buf_t *buf) {
+  return buf && (buf->flags & (BCACHE_DIRTY | BCACHE_WRITEBACK)) ==
+                    BCACHE_DIRTY;
+}
+
+// Tramo de sucios contiguos a 'buf' que no estén ya en vuelo
+static uint32_t bcache_dirty_run(bcache_buf_t *buf, uint64_t *start_out) {
+  uint8_t dev = buf->dev;
+  uint64_t start = buf->lba;
+  uint32_t count = 1;
+
+  while (start > 0 && count < BCACHE_RUN_MAX_SECTORS &&
+         bcache_can_write_back(bcache_lookup(dev, start - 1))) {
+    start--;
+    count++;
+  }
+  while (count < BCACHE_RUN_MAX_SECTORS &&
+         bcache_can_write_back(bcache_lookup(dev, start + count)))
+    count++;
+
+  *start_out = start;
+  return count;
+}
+
+// Escribe 'buf' junto con los sucios contiguos del mismo dispositivo
+static disk_err_t bcache_writeback_run(bcache_buf_t *buf) {
+  uint8_t dev = buf->dev;
+  uint64_t start;
+  uint32_t count = bcache_dirty_run(buf, &start);
+
+  for (uint32_t i = 0; i < count; i++)
+    memcpy(bcache_run_buf + i * BCACHE_BLOCK_SIZE,
+           bcache_lookup(dev, start + i)->data, BCACHE_BLOCK_SIZE);
+
+  disk_err_t err =
+      bcache_io_write(&bcache_devs[dev].disk, start, count, bcache_run_buf);
+  if (err != DISK_ERR_NONE) {
+    stat_write_errors++;
+    terminal_printf(&main_terminal,
+                    "BCACHE: Writeback failed (drive 0x%02x, LBA %llu + %u): "
+                    "%d\r\n",
+                    bcache_devs[dev].disk.drive_number, start, count, err);
+    return err;
+  }
+
+  for (uint32_t i = 0; i < count; i++)
+    bcache_mark_clean(bcache_lookup(dev, start + i));
+  bcache_devs[dev].written += count;
+  stat_writeback_runs++;
+  stat_writeback_sectors += count;
+  return DISK_ERR_NONE;
+}
+
+// Buffer libre para un bloque nuevo: el menos usado, volcándolo si está
+// sucio. NULL si ninguno de los últimos se pudo volcar.
+static bcache_buf_t *bcache_get_free(void) {
+  bcache_buf_t *buf = lru_tail;
+  for (uint32_t tries = 0; buf && tries < 8; tries++, buf = buf->lru_prev) {
+    if (buf->flags & BCACHE_WRITEBACK)
+      continue;
+    if ((buf->flags & BCACHE_DIRTY) &&
+        bcache_writeback_run(buf) != DISK_ERR_NONE)
+      continue;
+    if (buf->flags & BCACHE_VALID) {
+      bcache_hash_remove(buf);
+      stat_evictions++;
+    }
+    buf->flags = 0;
+    return buf;
+  }
+  return NULL;
+}
+
+static void bcache_insert(bcache_buf_t *buf, uint8_t dev, uint64_t lba) {
+  buf->dev = dev;
+  buf->lba = lba;
+  buf->flags = BCACHE_VALID;
+  bcache_hash_insert(buf);
+  lru_touch(buf);
+}
+
+// ========================================================================
+// INICIALIZACIÓN
+// ========================================================================
+
+void bcache_init(void) {
+  mutex_init(&bcache_io_mutex, "bcache_io");
+
+  size_t per_block = sizeof(bcache_buf_t) + BCACHE_BLOCK_SIZE;
+  uint32_t nblocks = (uint32_t)(heap_available() / BCACHE_HEAP_SHARE / per_block);
+  if (nblocks > BCACHE_MAX_BLOCKS)
+    nblocks = BCACHE_MAX_BLOCKS;
+
+  // El heap puede estar fragmentado: probar con la mitad hasta el mínimo
+  for (; nblocks >= BCACHE_MIN_BLOCKS; nblocks /= 2) {
+    bcache_data = (uint8_t *)kernel_malloc(nblocks * BCACHE_BLOCK_SIZE);
+    if (bcache_data)
+      break;
+  }
+  if (!bcache_data) {
+    terminal_puts(&main_terminal,
+                  "BCACHE: Not enough memory, disk I/O is uncached\r\n");
+    return;
+  }
+
+  uint32_t hash_size = 64;
+  while (hash_size < nblocks / 2)
+    hash_size <<= 1;
+
+  bcache_bufs = (bcache_buf_t *)kernel_malloc(nblocks * sizeof(bcache_buf_t));
+  bcache_hash =
+      (bcache_buf_t **)kernel_malloc(hash_size * sizeof(bcache_buf_t *));
+  bcache_run_buf =
+      (uint8_t *)kernel_malloc(BCACHE_RUN_MAX_SECTORS * BCACHE_BLOCK_SIZE);
+  bcache_ra_buf =
+      (uint8_t *)kernel_malloc(BCACHE_RUN_MAX_SECTORS * BCACHE_BLOCK_SIZE);
+  bcache_edge_buf = (uint8_t *)kernel_malloc(DISK_EDGE_MAX_BYTES);
+  if (!bcache_bufs || !bcache_hash || !bcache_run_buf || !bcache_ra_buf ||
+      !bcache_edge_buf) {
+    kernel_free(bcache_data);
+    if (bcache_bufs)
+      kernel_free(bcache_bufs);
+    if (bcache_hash)
+      kernel_free(bcache_hash);
+    if (bcache_run_buf)
+      kernel_free(bcache_run_buf);
+    if (bcache_ra_buf)
+      kernel_free(bcache_ra_buf);
+    if (bcache_edge_buf)
+      kernel_free(bcache_edge_buf);
+    bcache_data = NULL;
+    terminal_puts(&main_terminal,
+                  "BCACHE: Not enough memory, disk I/O is uncached\r\n");
+    return;
+  }
+
+  memset(bcache_bufs, 0, nblocks * sizeof(bcache_buf_t));
+  memset(bcache_hash, 0, hash_size * sizeof(bcache_buf_t *));
+  memset(bcache_devs, 0, sizeof(bcache_devs));
+  bcache_hash_mask = hash_size - 1;
+  bcache_nblocks = nblocks;
+  // Que una ventana no desaloje más de un cuarto de la caché
+  while (bcache_ra_max > BCACHE_RA_MIN_SECTORS && bcache_ra_max > nblocks / 4)
+    bcache_ra_max /= 2;
+  for (uint32_t i = 0; i < nblocks; i++) {
+    bcache_bufs[i].data = bcache_data + i * BCACHE_BLOCK_SIZE;
+    lru_push_head(&bcache_bufs[i]);
+  }
+
+  mutex_init(&bcache_mutex, "bcache");
+  bcache_ready = true;
+  terminal_printf(&main_terminal, "BCACHE: %u blocks (%u KiB), %u buckets\r\n",
+                  nblocks, nblocks * BCACHE_BLOCK_SIZE / 1024, hash_size);
+}
+
+// ========================================================================
+// LECTURA ANTICIPADA
+// ========================================================================
+
+// Actualiza la detección secuencial de 'd' con una lectura de
+// [lba, lba + count). Devuelve cuántos sectores anticipar desde *ra_lba (0 =
+// ninguno). Requiere bcache_mutex.
+static uint32_t bcache_ra_detect(bcache_dev_t *d, uint64_t lba, uint32_t count,
+                                 uint64_t *ra_lba) {
+  uint64_t end = lba + count;
+  bool sequential = lba == d->ra_next;
+  d->ra_next = end;
+  if (!sequential) {
+    d->ra_window = 0;
+    d->ra_end = 0;
+    return 0;
+  }
+
+  if (!d->ra_window) {
+    d->ra_window = BCACHE_RA_MIN_SECTORS;
+    d->ra_end = end;
+  }
+  // Queda al menos media ventana anticipada por delante del lector
+  if (d->ra_end > end && d->ra_end - end >= d->ra_window / 2)
+    return 0;
+
+  uint64_t from = d->ra_end > end ? d->ra_end : end;
+  if (from >= d->disk.sector_count)
+    return 0;
+  uint32_t n = d->ra_window;
+  if (from + n > d->disk.sector_count)
+    n = (uint32_t)(d->disk.sector_count - from);
+
+  d->ra_end = from + n;
+  if (d->ra_window < bcache_ra_max)
+    d->ra_window *= 2;
+  if (d->ra_window > bcache_ra_max)
+    d->ra_window = bcache_ra_max;
+  *ra_lba = from;
+  return n;
+}
+
+static void bcache_ra_queue(uint8_t dev, uint64_t lba, uint32_t count) {
+  if (!ra_running || !count)
+    return;
+
+  uint32_t flags = spin_lock_irqsave(&ra_lock);
+  bcache_ra_req_t *tail =
+      ra_count ? &ra_queue[(ra_head + ra_count - 1) % BCACHE_RA_QUEUE_LEN]
+               : NULL;
+  if (tail && tail->dev == dev && tail->lba + tail->count == lba) {
+    tail->count += count; // Continúa la última petición
+  } else if (ra_count == BCACHE_RA_QUEUE_LEN) {
+    stat_ra_dropped++;
+    spin_unlock_irqrestore(&ra_lock, flags);
+    return;
+  } else {
+    bcache_ra_req_t *req = &ra_queue[(ra_head + ra_count) % BCACHE_RA_QUEUE_LEN];
+    req->dev = dev;
+    req->lba = lba;
+    req->count = count;
+    ra_count++;
+  }
+  stat_ra_requests++;
+  wait_queue_wake_one(&ra_wq);
+  spin_unlock_irqrestore(&ra_lock, flags);
+}
+
+void bcache_readahead(disk_t *disk, uint64_t lba, uint32_t count) {
+  if (!bcache_ready || !ra_running || !disk || !count)
+    return;
+
+  mutex_lock(&bcache_mutex);
+  int dev = bcache_dev_get(disk);
+  if (dev < 0 || lba >= bcache_devs[dev].disk.sector_count) {
+    mutex_unlock(&bcache_mutex);
+    return;
+  }
+  bcache_dev_t *d = &bcache_devs[dev];
+  if (lba + count > d->disk.sector_count)
+    count = (uint32_t)(d->disk.sector_count - lba);
+  // Si continúa lo ya anticipado por el disco, la detección no lo repite
+  if (d->ra_window && lba >= d->ra_next && lba <= d->ra_end &&
+      lba + count > d->ra_end)
+    d->ra_end = lba + count;
+  mutex_unlock(&bcache_mutex);
+
+  bcache_ra_queue((uint8_t)dev, lba, count);
+}
+
+// Trae a la caché los sectores de 'req' que falten, en tramos de hasta
+// BCACHE_RUN_MAX_SECTORS. El mutex no se tiene durante la lectura para que
+// los lectores no esperen a la ventana.
+static void bcache_ra_fill(const bcache_ra_req_t *req) {
+  uint64_t lba = req->lba;
+  uint64_t end = req->lba + req->count;
+
+  while (lba < end) {
+    mutex_lock(&bcache_mutex);
+    while (lba < end && bcache_lookup(req->dev, lba))
+      lba++;
+    uint32_t run = 0;
+    while (lba + run < end && run < BCACHE_RUN_MAX_SECTORS &&
+           !bcache_lookup(req->dev, lba + run))
+      run++;
+
+    if (run) {
+      uint32_t gen = bcache_write_gen;
+      mutex_unlock(&bcache_mutex);
+      disk_err_t err = bcache_io_read(&bcache_devs[req->dev].disk, lba, run,
+                                      bcache_ra_buf);
+      mutex_lock(&bcache_mutex);
+      if (err != DISK_ERR_NONE) {
+        stat_ra_errors++;
+        mutex_unlock(&bcache_mutex);
+        return;
+      }
+      // Lo que otra tarea haya metido mientras tanto es más reciente
+      for (uint32_t i = 0; i < run && gen == bcache_write_gen; i++) {
+        if (bcache_lookup(req->dev, lba + i))
+          continue;
+        bcache_buf_t *fresh = bcache_get_free();
+        if (!fresh)
+          break;
+        memcpy(fresh->data, bcache_ra_buf + i * BCACHE_BLOCK_SIZE,
+               BCACHE_BLOCK_SIZE);
+        bcache_insert(fresh, req->dev, lba + i);
+        fresh->flags |= BCACHE_PREFETCHED;
+      }
+      stat_ra_sectors += run;
+      lba += run;
+    }
+    mutex_unlock(&bcache_mutex);
+  }
+}
+
+static void bcache_ra_task(void *arg) {
+  (void)arg;
+  while (1) {
+    uint32_t flags = spin_lock_irqsave(&ra_lock);
+    while (!ra_count)
+      wait_queue_sleep(&ra_wq, &ra_lock, 0);
+    bcache_ra_req_t req = ra_queue[ra_head];
+    ra_head = (ra_head + 1) % BCACHE_RA_QUEUE_LEN;
+    ra_count--;
+    spin_unlock_irqrestore(&ra_lock, flags);
+
+    bcache_ra_fill(&req);
+  }
+}
+
+// ========================================================================
+// LECTURA Y ESCRITURA
+// ========================================================================
+
+// Bloque nativo mayor que 512 (USB 4K) que el tramo de fallos en 'lba'
+// empieza a mitad o no llega a cubrir: se lee entero con bcache_mutex
+// tomado, se copian a 'dst' los sectores pedidos desde 'lba' (como mucho
+// 'left') y el resto del bloque queda en la caché para las lecturas
+// vecinas. Devuelve los sectores copiados, 0 si falla la lectura.
+static uint32_t bcache_fill_edge(int dev, uint64_t lba, uint32_t left,
+                                 uint8_t *dst) {
+  bcache_dev_t *d = &bcache_devs[dev];
+  uint32_t head = (uint32_t)lba & (d->native - 1);
+  uint64_t start = lba - head;
+  uint32_t gen = bcache_write_gen;
+  if (bcache_io_read(&d->disk, start, d->native, bcache_edge_buf) !=
+      DISK_ERR_NONE)
+    return 0;
+
+  uint32_t part = d->native - head;
+  if (part > left)
+    part = left;
+  // Lo que ya esté en la caché manda, como en los tramos directos
+  for (uint32_t j = 0; j < part; j++) {
+    bcache_buf_t *buf = bcache_lookup(dev, lba + j);
+    memcpy(dst + j * BCACHE_BLOCK_SIZE,
+           buf ? buf->data
+               : bcache_edge_buf + (head + j) * BCACHE_BLOCK_SIZE,
+           BCACHE_BLOCK_SIZE);
+  }
+  for (uint32_t j = 0; j < d->native && gen == bcache_write_gen; j++) {
+    if (bcache_lookup(dev, start + j))
+      continue;
+    bcache_buf_t *fresh = bcache_get_free();
+    if (!fresh)
+      break;
+    memcpy(fresh->data, bcache_edge_buf + j * BCACHE_BLOCK_SIZE,
+           BCACHE_BLOCK_SIZE);
+    bcache_insert(fresh, (uint8_t)dev, start + j);
+  }
+  d->misses += part;
+  stat_misses += part;
+  stat_edge_fills++;
+  return part;
+}
+
+disk_err_t bcache_read(disk_t *disk, uint64_t lba, uint32_t count,
+                       void *buffer) {
+  if (!bcache_ready)
+    return disk_read_device(disk, lba, count, buffer);
+
+  mutex_lock(&bcache_mutex);
+  int dev = bcache_dev_get(disk);
+  if (dev < 0) {
+    mutex_unlock(&bcache_mutex);
+    return disk_read_device(disk, lba, count, buffer);
+  }
+
+  uint8_t *out = (uint8_t *)buffer;
+
+  uint32_t i = 0;
+  while (i < count) {
+    bcache_buf_t *buf = bcache_lookup(dev, lba + i);
+    if (buf) {
+      memcpy(out + i * BCACHE_BLOCK_SIZE, buf->data, BCACHE_BLOCK_SIZE);
+      lru_touch(buf);
+      if (buf->flags & BCACHE_PREFETCHED) {
+        buf->flags &= ~BCACHE_PREFETCHED;
+        stat_ra_hits++;
+      }
+      bcache_devs[dev].hits++;
+      stat_hits++;
+      i++;
+      continue;
+    }
+
+    // Tramo de fallos: un solo comando directo al buffer del llamador, sin
+    // el mutex para que otras tareas sigan usando la caché mientras tanto
+    uint32_t run = 1;
+    while (i + run < count && !bcache_lookup(dev, lba + i + run))
+      run++;
+
+    // Con bloque nativo mayor el tramo directo va alineado a él; los
+    // bordes pasan por la caché en lugar de por el buffer del driver
+    uint32_t native = bcache_devs[dev].native;
+    if (native > 1) {
+      if (((uint32_t)(lba + i) & (native - 1)) || run < native) {
+        uint32_t part = bcache_fill_edge(dev, lba + i, count - i,
+                                         out + i * BCACHE_BLOCK_SIZE);
+        if (part) {
+          i += part;
+          continue;
+        }
+      } else {
+        run &= ~(native - 1);
+      }
+    }
+
+    uint8_t *dst = out + i * BCACHE_BLOCK_SIZE;
+    uint32_t gen = bcache_write_gen;
+    mutex_unlock(&bcache_mutex);
+    disk_err_t err =
+        bcache_io_read(&bcache_devs[dev].disk, lba + i, run, dst);
+    mutex_lock(&bcache_mutex);
+    if (err != DISK_ERR_NONE) {
+      mutex_unlock(&bcache_mutex);
+      return err;
+    }
+    bcache_devs[dev].misses += run;
+    stat_misses += run;
+
+    // Otra tarea pudo escribir o traer alguno de estos sectores durante la
+    // lectura: lo que haya en la caché manda. Se copia antes de insertar
+    // porque insertar puede desalojar.
+    bool insert = gen == bcache_write_gen;
+    for (uint32_t j = 0; j < run; j++) {
+      bcache_buf_t *buf = bcache_lookup(dev, lba + i + j);
+      if (buf)
+        memcpy(dst + j * BCACHE_BLOCK_SIZE, buf->data, BCACHE_BLOCK_SIZE);
+    }
+    for (uint32_t j = 0; j < run && insert; j++) {
+      if (bcache_lookup(dev, lba + i + j))
+        continue;
+      bcache_buf_t *fresh = bcache_get_free();
+      if (!fresh)
+        break;
+      memcpy(fresh->data, dst + j * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE);
+      bcache_insert(fresh, dev, lba + i + j);
+    }
+    i += run;
+  }
+
+  uint64_t ra_lba = 0;
+  uint32_t ra_sectors = bcache_ra_detect(&bcache_devs[dev], lba, count, &ra_lba);
+  mutex_unlock(&bcache_mutex);
+
+  bcache_ra_queue((uint8_t)dev, ra_lba, ra_sectors);
+  return DISK_ERR_NONE;
+}
+
+disk_err_t bcache_write(disk_t *disk, uint64_t lba, uint32_t count,
+                        const void *buffer) {
+  if (!bcache_ready)
+    return disk_write_device(disk, lba, count, buffer);
+
+  mutex_lock(&bcache_mutex);
+  int dev = bcache_dev_get(disk);
+  if (dev < 0) {
+    mutex_unlock(&bcache_mutex);
+    return disk_write_device(disk, lba, count, buffer);
+  }
+
+  const uint8_t *in = (const uint8_t *)buffer;
+
+  if (count >= BCACHE_WRITE_THROUGH_SECTORS) {
+    // Escritura grande: directa, y las copias en caché quedan al día
+    disk_err_t err =
+        bcache_io_write(&bcache_devs[dev].disk, lba, count, buffer);
+    if (err == DISK_ERR_NONE) {
+      stat_write_through++;
+      for (uint32_t i = 0; i < count; i++) {
+        bcache_buf_t *buf = bcache_lookup(dev, lba + i);
+        if (buf) {
+          memcpy(buf->data, in + i * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE);
+          // Si hay una copia anterior en vuelo puede llegar después: el
+          // bloque sigue sucio para volver a escribirlo tras ella
+          if (buf->flags & BCACHE_WRITEBACK) {
+            if (!(buf->flags & BCACHE_DIRTY)) {
+              buf->flags |= BCACHE_DIRTY;
+              buf->dirty_since = ticks_since_boot;
+              bcache_dirty++;
+            }
+          } else {
+            bcache_mark_clean(buf);
+          }
+        }
+      }
+    }
+    mutex_unlock(&bcache_mutex);
+    return err;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    const uint8_t *src = in + i * BCACHE_BLOCK_SIZE;
+    bcache_buf_t *buf = bcache_lookup(dev, lba + i);
+    if (!buf) {
+      buf = bcache_get_free();
+      if (!buf) {
+        // Sin buffers volcables: este sector va directo
+        disk_err_t err =
+            bcache_io_write(&bcache_devs[dev].disk, lba + i, 1, src);
+        if (err != DISK_ERR_NONE) {
+          mutex_unlock(&bcache_mutex);
+          return err;
+        }
+        continue;
+      }
+      bcache_insert(buf, dev, lba + i);
+    } else {
+      lru_touch(buf);
+    }
+
+    memcpy(buf->data, src, BCACHE_BLOCK_SIZE);
+    if (!(buf->flags & BCACHE_DIRTY)) {
+      buf->flags |= BCACHE_DIRTY;
+      buf->dirty_since = ticks_since_boot;
+      bcache_dirty++;
+    }
+  }
+
+  bool pressure = bcache_dirty > bcache_nblocks / 2;
+  mutex_unlock(&bcache_mutex);
+
+  if (pressure)
+    wait_queue_wake_one(&flusher_wq);
+  return DISK_ERR_NONE;
+}
+
+// ========================================================================
+// VOLCADOR
+// ========================================================================
+
+disk_err_t bcache_device_read(disk_t *disk, uint64_t lba, uint32_t count,
+                              void *buffer) {
+  if (!bcache_ready)
+    return disk_read_device(disk, lba, count, buffer);
+  return bcache_io_read(disk, lba, count, buffer);
+}
+
+disk_err_t bcache_device_write(disk_t *disk, uint64_t lba, uint32_t count,
+                               const void *buffer) {
+  if (!bcache_ready)
+    return disk_write_device(disk, lba, count, buffer);
+  return bcache_io_write(disk, lba, count, buffer);
+}
+
+// Esperar a que queden como mucho 'limit' volcados en vuelo
+static void bcache_wb_wait(uint32_t limit) {
+  uint32_t flags = spin_lock_irqsave(&wb_lock);
+  while (wb_inflight > limit)
+    wait_queue_sleep(&wb_wq, &wb_lock, 0);
+  spin_unlock_irqrestore(&wb_lock, flags);
+}
+
+// Lo llama la tarea disk_io al terminar un volcado
+static void bcache_writeback_done(disk_io_request_t *req) {
+  bcache_wb_t *wb = (bcache_wb_t *)req->private;
+
+  mutex_lock(&bcache_mutex);
+  for (uint32_t i = 0; i < req->count; i++) {
+    bcache_buf_t *buf = bcache_lookup(wb->dev, req->lba + i);
+    if (!buf)
+      continue;
+    buf->flags &= ~BCACHE_WRITEBACK;
+    if (req->result != DISK_ERR_NONE && !(buf->flags & BCACHE_DIRTY)) {
+      buf->flags |= BCACHE_DIRTY;
+      buf->dirty_since = ticks_since_boot;
+      bcache_dirty++;
+    }
+  }
+  if (req->result == DISK_ERR_NONE) {
+    bcache_devs[wb->dev].written += req->count;
+    stat_writeback_runs++;
+    stat_writeback_sectors += req->count;
+  } else {
+    stat_write_errors++;
+    terminal_printf(&main_terminal,
+                    "BCACHE: Writeback failed (drive 0x%02x, LBA %llu + %u): "
+                    "%d\r\n",
+                    bcache_devs[wb->dev].disk.drive_number, req->lba,
+                    req->count, req->result);
+  }
+  mutex_unlock(&bcache_mutex);
+
+  uint32_t flags = spin_lock_irqsave(&wb_lock);
+  wb_inflight--;
+  if (req->result != DISK_ERR_NONE && wb_error == DISK_ERR_NONE)
+    wb_error = req->result;
+  wait_queue_wake_all(&wb_wq);
+  spin_unlock_irqrestore(&wb_lock, flags);
+
+  kernel_free(wb);
+}
+
+// Copia el tramo de 'buf' y lo envía a la cola de disco; los bloques
+// quedan limpios y fijados hasta bcache_writeback_done. false si no se
+// pudo enviar (se vuelca en el momento). Requiere bcache_mutex.
+static bool bcache_writeback_submit(bcache_buf_t *buf) {
+  uint8_t dev = buf->dev;
+  uint64_t start;
+  uint32_t count = bcache_dirty_run(buf, &start);
+
+  bcache_wb_t *wb =
+      (bcache_wb_t *)kernel_malloc(sizeof(bcache_wb_t) +
+                                   count * BCACHE_BLOCK_SIZE);
+  if (!wb)
+    return false;
+  uint8_t *data = (uint8_t *)(wb + 1);
+
+  for (uint32_t i = 0; i < count; i++) {
+    bcache_buf_t *b = bcache_lookup(dev, start + i);
+    memcpy(data + i * BCACHE_BLOCK_SIZE, b->data, BCACHE_BLOCK_SIZE);
+    bcache_mark_clean(b);
+    b->flags |= BCACHE_WRITEBACK;
+  }
+
+  memset(&wb->req, 0, sizeof(wb->req));
+  wb->dev = dev;
+  wb->req.op = DISK_IO_WRITE;
+  wb->req.flags = DISK_IO_NOCACHE;
+  wb->req.disk = &bcache_devs[dev].disk;
+  wb->req.lba = start;
+  wb->req.count = count;
+  wb->req.buffer = data;
+  wb->req.done = bcache_writeback_done;
+  wb->req.private = wb;
+
+  uint32_t flags = spin_lock_irqsave(&wb_lock);
+  wb_inflight++;
+  spin_unlock_irqrestore(&wb_lock, flags);
+
+  if (disk_io_submit(&wb->req) == DISK_ERR_NONE)
+    return true;
+
+  // Rechazada: deshacer y que el llamador escriba en el momento
+  for (uint32_t i = 0; i < count; i++) {
+    bcache_buf_t *b = bcache_lookup(dev, start + i);
+    b->flags = (b->flags & ~BCACHE_WRITEBACK) | BCACHE_DIRTY;
+    bcache_dirty++;
+  }
+  flags = spin_lock_irqsave(&wb_lock);
+  wb_inflight--;
+  spin_unlock_irqrestore(&wb_lock, flags);
+  kernel_free(wb);
+  return false;
+}
+
+// Vuelca los sucios que cumplan la condición. Suelta el mutex entre tramos
+// para no bloquear a los lectores durante todo el recorrido. Con disk_io en
+// marcha los tramos se encolan (hasta BCACHE_WB_MAX_INFLIGHT a la vez) y el
+// ascensor los ordena; si no, se escriben aquí.
+static disk_err_t bcache_writeback(int dev, bool only_expired) {
+  disk_err_t result = DISK_ERR_NONE;
+  bool async = disk_io_can_wait();
+  for (uint32_t i = 0; i < bcache_nblocks; i++) {
+    bcache_buf_t *buf = &bcache_bufs[i];
+    if (!bcache_can_write_back(buf))
+      continue;
+    if (async)
+      bcache_wb_wait(BCACHE_WB_MAX_INFLIGHT - 1);
+
+    mutex_lock(&bcache_mutex);
+    bool pressure = bcache_dirty > bcache_nblocks / 2;
+    if (bcache_can_write_back(buf) && (dev < 0 || buf->dev == dev) &&
+        (!only_expired || pressure ||
+         ticks_since_boot - buf->dirty_since >= BCACHE_DIRTY_EXPIRE_TICKS)) {
+      if (!async || !bcache_writeback_submit(buf)) {
+        disk_err_t err = bcache_writeback_run(buf);
+        if (err != DISK_ERR_NONE && result == DISK_ERR_NONE)
+          result = err;
+      }
+    }
+    mutex_unlock(&bcache_mutex);
+  }
+  return result;
+}
+
+disk_err_t bcache_sync(disk_t *disk) {
+  if (!bcache_ready || (!bcache_dirty && !wb_inflight))
+    return DISK_ERR_NONE;
+
+  int dev = -1;
+  if (disk) {
+    // Un disco sin bloques en la caché no tiene nada que volcar
+    mutex_lock(&bcache_mutex);
+    dev = bcache_dev_get(disk);
+    mutex_unlock(&bcache_mutex);
+    if (dev < 0)
+      return DISK_ERR_NONE;
+  }
+
+  disk_err_t result = bcache_writeback(dev, false);
+  if (disk_io_can_wait()) {
+    bcache_wb_wait(0);
+    // Bloques reescritos mientras su copia anterior estaba en vuelo
+    if (bcache_dirty) {
+      disk_err_t err = bcache_writeback(dev, false);
+      if (result == DISK_ERR_NONE)
+        result = err;
+      bcache_wb_wait(0);
+    }
+
+    uint32_t flags = spin_lock_irqsave(&wb_lock);
+    if (result == DISK_ERR_NONE)
+      result = wb_error;
+    wb_error = DISK_ERR_NONE;
+    spin_unlock_irqrestore(&wb_lock, flags);
+  }
+  return result;
+}
+
+void bcache_drop_clean(void) {
+  if (!bcache_ready)
+    return;
+
+  mutex_lock(&bcache_mutex);
+  for (uint32_t i = 0; i < bcache_nblocks; i++) {
+    bcache_buf_t *buf = &bcache_bufs[i];
+    if ((buf->flags & BCACHE_VALID) &&
+        !(buf->flags & (BCACHE_DIRTY | BCACHE_WRITEBACK))) {
+      bcache_hash_remove(buf);
+      buf->flags = 0;
+      // Los libres van al final: son los primeros en reutilizarse
+      lru_unlink(buf);
+      buf->lru_prev = lru_tail;
+      if (lru_tail)
+        lru_tail->lru_next = buf;
+      lru_tail = buf;
+      if (!lru_head)
+        lru_head = buf;
+    }
+  }
+  for (int i = 0; i < BCACHE_MAX_DEVICES; i++) {
+    bcache_devs[i].ra_window = 0;
+    bcache_devs[i].ra_end = 0;
+  }
+  mutex_unlock(&bcache_mutex);
+}
+
+static void bcache_flusher_task(void *arg) {
+  (void)arg;
+  while (1) {
+    uint32_t flags = spin_lock_irqsave(&flusher_lock);
+    wait_queue_sleep(&flusher_wq, &flusher_lock, BCACHE_FLUSH_INTERVAL_TICKS);
+    spin_unlock_irqrestore(&flusher_lock, flags);
+
+    if (bcache_dirty)
+      bcache_writeback(-1, true);
+  }
+}
+
+void bcache_start_flusher(void) {
+  if (!bcache_ready)
+    return;
+  if (!task_create("bcache_flush", bcache_flusher_task, NULL,
+                   TASK_PRIORITY_NORMAL))
+    terminal_puts(&main_terminal,
+                  "BCACHE: Failed to create flusher, dirty blocks are only "
+                  "written on sync\r\n");
+
+  if (task_create("bcache_ra", bcache_ra_task, NULL, TASK_PRIORITY_NORMAL))
+    ra_running = true;
+  else
+    terminal_puts(&main_terminal,
+                  "BCACHE: Failed to create read-ahead task\r\n");
+}
+
+// ========================================================================
+// ESTADÍSTICAS
+// ========================================================================
+
+char *bcache_format_stats(size_t *len) {
+  size_t size = 512 + BCACHE_MAX_DEVICES * 96;
+  char *buf = (char *)kernel_malloc(size);
+  if (!buf)
+    return NULL;
+
+  if (!bcache_ready) {
+    size_t pos = (size_t)snprintf(buf, size, "bcache: disabled\n");
+    *len = pos < size ? pos : size;
+    return buf;
+  }
+
+  mutex_lock(&bcache_mutex);
+  uint32_t lookups = stat_hits + stat_misses;
+  size_t pos = (size_t)snprintf(
+      buf, size,
+      "bcache: %u blocks (%u KiB), %u dirty, %u writeback runs queued\n"
+      "hits: %u  misses: %u  hit rate: %u%%\n"
+      "evictions: %u  writeback: %u runs / %u sectors\n"
+      "write-through: %u  write errors: %u\n"
+      "readahead: %u requests (%u dropped), %u sectors, %u used, "
+      "%u errors\n"
+      "edge blocks: %u\n",
+      bcache_nblocks, bcache_nblocks * BCACHE_BLOCK_SIZE / 1024, bcache_dirty,
+      wb_inflight,
+      stat_hits, stat_misses, lookups ? (uint32_t)((uint64_t)stat_hits * 100 / lookups) : 0,
+      stat_evictions, stat_writeback_runs, stat_writeback_sectors,
+      stat_write_through, stat_write_errors, stat_ra_requests,
+      stat_ra_dropped, stat_ra_sectors, stat_ra_hits, stat_ra_errors,
+      stat_edge_fills);
+  for (int i = 0; i < BCACHE_MAX_DEVICES && pos < size; i++) {
+    bcache_dev_t *dev = &bcache_devs[i];
+    if (!dev->used)
+      continue;
+    pos += (size_t)snprintf(buf + pos, size - pos,
+                            "  drive 0x%02x: hits %u misses %u written %u\n",
+                            dev->disk.drive_number, dev->hits, dev->misses,
+                            dev->written);
+  }
+  mutex_unlock(&bcache_mutex);
+
+  *len = pos < size ? pos : size;
+  return buf;
+}
@@ -0,0 +1,92 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "disk.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// ========================================================================
+// BUFFER CACHE DE BLOQUES
+// ========================================================================
+//
+// Caché LRU de sectores de 512 bytes por debajo de disk_read_dispatch /
+// disk_write_dispatch, común a todos los discos (IDE, SATA y USB). La
+// clave es (dispositivo físico, LBA físico): las particiones de un mismo
+// disco comparten los bloques aunque cada una tenga su propio disk_t, que
+// a menudo es una copia en el stack.
+//
+// Las escrituras quedan sucias en la caché; una tarea las vuelca al disco
+// cuando llevan BCACHE_DIRTY_EXPIRE_TICKS sucias, cuando la mitad de la
+// caché está sucia o en disk_flush_dispatch(). Los sectores sucios
+// contiguos se escriben con un solo comando, que pasa por la cola de
+// disk_io cuando está en marcha; hasta que termina, los bloques no se
+// desalojan. Las escrituras grandes van directas al disco (write-through)
+// para no vaciar la caché.
+//
+// ATAPI no se cachea: el medio se puede cambiar sin aviso.
+//
+// En los discos de bloque nativo mayor que 512 (USB 4K) las lecturas de
+// fallos se alinean al bloque nativo: los bloques enteros van directos al
+// buffer del llamador y los de los bordes se leen enteros a la caché, de
+// modo que los sectores vecinos ya están cuando se pidan.
+//
+// Lectura anticipada: si las lecturas de un disco son secuenciales, una
+// tarea trae a la caché los sectores siguientes en comandos grandes. La
+// ventana empieza en BCACHE_RA_MIN_SECTORS y se duplica mientras el acceso
+// siga siendo secuencial; se vuelve a pedir cuando el lector pasa la mitad
+// de lo ya anticipado. Los sistemas de archivos pueden pedirla también con
+// disk_readahead() siguiendo la cadena de clústeres del archivo.
+
+#define BCACHE_BLOCK_SIZE SECTOR_SIZE
+#define BCACHE_HEAP_SHARE 8          // Hasta 1/8 del heap libre al iniciar
+#define BCACHE_MIN_BLOCKS 256        // 128 KiB
+#define BCACHE_MAX_BLOCKS 8192       // 4 MiB
+#define BCACHE_MAX_DEVICES 16        // Discos físicos distintos
+#define BCACHE_RUN_MAX_SECTORS 128   // Máximo por escritura agrupada
+#define BCACHE_WRITE_THROUGH_SECTORS 128 // Desde aquí la escritura es directa
+#define BCACHE_DIRTY_EXPIRE_TICKS 500    // 5 s sucio antes de volcarse
+#define BCACHE_FLUSH_INTERVAL_TICKS 100  // Periodo del volcador
+#define BCACHE_RA_MIN_SECTORS 64         // Ventana inicial: 32 KiB
+#define BCACHE_RA_MAX_SECTORS 2048       // Ventana máxima: 1 MiB
+#define BCACHE_RA_QUEUE_LEN 16           // Peticiones pendientes
+#define BCACHE_WB_MAX_INFLIGHT 32        // Volcados en la cola de disco
+
+// Reserva la caché según la memoria libre. Hasta entonces (o si falla) las
+// lecturas y escrituras van directas al disco.
+void bcache_init(void);
+
+// Crea las tareas que vuelcan los bloques sucios y hacen la lectura
+// anticipada (requiere el planificador)
+void bcache_start_flusher(void);
+
+// 'lba' es físico (ya con el offset de partición aplicado)
+disk_err_t bcache_read(disk_t *disk, uint64_t lba, uint32_t count,
+                       void *buffer);
+disk_err_t bcache_write(disk_t *disk, uint64_t lba, uint32_t count,
+                        const void *buffer);
+
+// Encola la lectura anticipada de [lba, lba + count) y vuelve sin esperar.
+// Solo se leen los sectores que no estén ya en la caché; si la cola está
+// llena la petición se descarta.
+void bcache_readahead(disk_t *disk, uint64_t lba, uint32_t count);
+
+// E/S directa al dispositivo ('lba' físico), sin caché pero serializada
+// con la de la caché en los discos que no admiten varios comandos a la vez
+disk_err_t bcache_device_read(disk_t *disk, uint64_t lba, uint32_t count,
+                              void *buffer);
+disk_err_t bcache_device_write(disk_t *disk, uint64_t lba, uint32_t count,
+                               const void *buffer);
+
+// Escribe al disco los bloques sucios del dispositivo de 'disk' (NULL =
+// todos) y espera a que terminen
+disk_err_t bcache_sync(disk_t *disk);
+
+// Descarta los bloques limpios (los sucios se quedan). Para medir lecturas
+// en frío.
+void bcache_drop_clean(void);
+
+// Texto para /sys/bcache y lsblk. Buffer de kernel_malloc (lo libera el
+// llamador), longitud en *len.
+char *bcache_format_stats(size_t *len);
+
+#endif // BCACHE_H
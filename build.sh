@@ -12,6 +12,11 @@ RESET='\033[0m'
 GCC=i386-elf-gcc
 GCC_OPTS="-m32 -nostdlib -ffreestanding -O2 -U_FORTIFY_SOURCE -fno-builtin-memcpy -fno-builtin-memset -fno-stack-protector"
 
+# DEBUG=1 ./build.sh activa la instrumentación de depuración (estadísticas de locks)
+if [ "${DEBUG:-0}" = "1" ]; then
+    GCC_OPTS="$GCC_OPTS -DSPINLOCK_DEBUG"
+fi
+
 # Limpiar build anterior
 echo -e "${CYAN}Limpiando directorio build...${RESET}"
 rm -Rf build/*
@@ -43,10 +48,13 @@ compile "isr.c"        "$GCC $GCC_OPTS -c isr.c -o build/isr.o"
 compile "irq.c"        "$GCC $GCC_OPTS -c irq.c -o build/irq.o"
 compile "pmm.c"     "$GCC $GCC_OPTS -c pmm.c -o build/pmm.o"
 compile "memory.c"     "$GCC $GCC_OPTS -c memory.c -o build/memory.o"
+compile "spinlock.c"   "$GCC $GCC_OPTS -c spinlock.c -o build/spinlock.o"
+compile "fpu.c"        "$GCC $GCC_OPTS -c fpu.c -o build/fpu.o"
 compile "mmu.c"        "$GCC $GCC_OPTS -c mmu.c -o build/mmu.o"
 compile "vmm.c"        "$GCC $GCC_OPTS -c vmm.c -o build/vmm.o"
 compile "memutils.c"   "$GCC $GCC_OPTS -c memutils.c -o build/memutils.o"
 compile "string.c"     "$GCC $GCC_OPTS -c string.c -o build/string.o"
+compile "rbtree.c"     "$GCC $GCC_OPTS -c rbtree.c -o build/rbtree.o"
 compile "cpuid.c" "$GCC $GCC_OPTS -c cpuid.c -o build/cpuid.o"
 compile "math_utils.c" "$GCC $GCC_OPTS -c math_utils.c -o build/math_utils.o"
 compile "keyboard.c"   "$GCC $GCC_OPTS -c keyboard.c -o build/keyboard.o"
@@ -58,6 +66,14 @@ compile "vfs.c"        "$GCC $GCC_OPTS -c vfs.c -o build/vfs.o"
 compile "tmpfs.c"      "$GCC $GCC_OPTS -c tmpfs.c -o build/tmpfs.o"
 compile "fat32.c"      "$GCC $GCC_OPTS -c fat32.c -o build/fat32.o"
 compile "task.c"       "$GCC $GCC_OPTS -c task.c -o build/task.o"
+compile "sched_stats.c" "$GCC $GCC_OPTS -c sched_stats.c -o build/sched_stats.o"
+compile "workqueue.c"  "$GCC $GCC_OPTS -c workqueue.c -o build/workqueue.o"
+compile "softirq.c"    "$GCC $GCC_OPTS -c softirq.c -o build/softirq.o"
+compile "futex.c"      "$GCC $GCC_OPTS -c futex.c -o build/futex.o"
+compile "timer.c"      "$GCC $GCC_OPTS -c timer.c -o build/timer.o"
+compile "latency.c"    "$GCC $GCC_OPTS -c latency.c -o build/latency.o"
+compile "input.c"      "$GCC $GCC_OPTS -c input.c -o build/input.o"
+compile "bcache.c"     "$GCC $GCC_OPTS -c bcache.c -o build/bcache.o"
 compile "task_switch.s" "$GCC $GCC_OPTS -c task_switch.s -o build/task_switch.o"
 compile "task_utils.c" "$GCC $GCC_OPTS -c task_utils.c -o build/task_utils.o"
 compile "task_test.c"       "$GCC $GCC_OPTS -c task_test.c -o build/task_test.o"
@@ -114,9 +130,9 @@ echo -e "${GREEN}Enlazando kernel.bin...${RESET}"
 ld -m elf_i386 -T linker.ld -o build/kernel.bin \
     build/boot.o build/kernel.o build/gdt_flush.o build/gdt.o build/idt.o \
     build/isr.o build/idt_load.o build/isr_asm.o build/irq.o build/irq_asm.o build/vmm.o \
-    build/pmm.o build/memory.o build/cpuid.o build/mmu.o build/memutils.o build/string.o \
+    build/pmm.o build/memory.o build/spinlock.o build/fpu.o build/cpuid.o build/mmu.o build/memutils.o build/string.o build/rbtree.o \
     build/keyboard.o build/drawing.o build/math_utils.o build/terminal.o \
-    build/disk.o build/disk_io_daemon.o build/task.o build/task_switch.o build/task_utils.o \
+    build/disk.o build/disk_io_daemon.o build/task.o build/sched_stats.o build/task_switch.o build/task_utils.o build/workqueue.o build/softirq.o build/futex.o build/timer.o build/latency.o build/input.o build/bcache.o \
     build/task_test.o build/serial.o build/vfs.o build/tmpfs.o build/fat32.o build/log.o \
     build/module_loader.o build/driver_system.o build/ide.o \
     build/pci.o build/acpi.o build/dma.o build/ahci.o build/sata_disk.o \
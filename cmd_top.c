@@ -32,6 +32,9 @@ typedef struct {
   size_t stack_used;
   size_t stack_total;
   uint8_t cpu_percent;
+  sched_class_t sched_class;
+  uint32_t vruntime_ms; // vruntime de la clase justa
+  uint32_t wait_ms;     // Tiempo total READY esperando CPU
 } task_stats_t;
 
 // Obtener nombre del estado como string
@@ -163,6 +166,9 @@ static int collect_task_stats(task_stats_t *stats, int max_tasks,
     stats[count].total_runtime = current->total_runtime;
     stats[count].switch_count = current->switch_count;
     stats[count].stack_total = current->stack_size;
+    stats[count].sched_class = current->sched_class;
+    stats[count].vruntime_ms = (uint32_t)(current->vruntime / 1000);
+    stats[count].wait_ms = (uint32_t)(sched_stats_wait_us(current) / 1000);
 
     // ✅ Calcular uso de stack mejorado
     stats[count].stack_used = calculate_stack_usage(current);
@@ -294,21 +300,32 @@ static void display_top_screen(Terminal *term) {
   // === TABLE HEADER ===
   term->current_attrs.fg_color = TOP_COLOR_ACCENT;
   terminal_puts(term, "  PID  NAME             STATE    PRI  CPU%  SWITCHES  "
-                      "STACK      RUNTIME\r\n");
+                      "STACK      RUNTIME  VRUN(ms)  WAIT(ms)\r\n");
   term->current_attrs.fg_color = TOP_COLOR_HEADER;
   terminal_puts(term, "  "
                       "--------------------------------------------------------"
                       "------------------\r\n");
 
   // === TASK LIST ===
-  task_stats_t stats[MAX_TASKS];
-  int task_count = collect_task_stats(stats, MAX_TASKS, previous_running);
+  // Reservar según las tareas vivas (con margen por si se crean más
+  // mientras recorremos la lista)
+  int max_stats = (int)scheduler.task_count + 8;
+  task_stats_t *stats =
+      (task_stats_t *)kernel_malloc(max_stats * sizeof(task_stats_t));
+  if (!stats) {
+    terminal_puts(term, "  (not enough memory for task list)\r\n");
+    term->current_attrs.fg_color = old_fg;
+    term->current_attrs.bg_color = old_bg;
+    return;
+  }
+  int task_count = collect_task_stats(stats, max_stats, previous_running);
 
   // Limitar a 12 tareas para que quepan en pantalla
   int display_count = (task_count < 12) ? task_count : 12;
 
   // ✅ Ordenar por CPU% (de mayor a menor) para mostrar las más activas primero
-  for (int i = 0; i < task_count - 1; i++) {
+  // Solo hace falta colocar las primeras display_count (selección parcial)
+  for (int i = 0; i < display_count && i < task_count - 1; i++) {
     for (int j = i + 1; j < task_count; j++) {
       // Ordenar por: 1) CPU%, 2) Runtime si CPU% es igual
       if (stats[j].cpu_percent > stats[i].cpu_percent ||
@@ -407,7 +424,15 @@ static void display_top_screen(Terminal *term) {
     terminal_printf(term, "    ");
 
     // Runtime
-    terminal_printf(term, " %u\r\n", stats[i].total_runtime);
+    terminal_printf(term, " %-8u", stats[i].total_runtime);
+
+    // vruntime (solo clase justa) y espera en cola
+    if (stats[i].sched_class == SCHED_CLASS_RT) {
+      terminal_printf(term, " %-9s", "RT");
+    } else {
+      terminal_printf(term, " %-9u", stats[i].vruntime_ms);
+    }
+    terminal_printf(term, " %u\r\n", stats[i].wait_ms);
   }
 
   // Footer
@@ -442,6 +467,8 @@ static void display_top_screen(Terminal *term) {
   terminal_puts(term,
                 "  Press 'q' or Ctrl+C to quit  |  * = Currently running\r\n");
 
+  kernel_free(stats);
+
   // Restaurar colores
   term->current_attrs.fg_color = old_fg;
   term->current_attrs.bg_color = old_bg;
@@ -463,11 +490,9 @@ static void top_task_func(void *arg) {
     // Mostrar top
     display_top_screen(term);
 
-    // ✅ Esperar 1 segundo antes de actualizar (100 ticks a 100Hz)
-    task_sleep(200);
-
-    // Verificar si hay tecla presionada
-    int key = keyboard_getkey_nonblock();
+    // Esperar 2 segundos antes de actualizar (200 ticks a 100Hz), o hasta
+    // que se pulse una tecla: 'q' sale sin esperar al refresco
+    int key = keyboard_getkey_wait(200);
     if (key == 'q' || key == 'Q' || key == 3) { // 'q', 'Q', o Ctrl+C (ASCII 3)
       break;
     }
@@ -505,6 +530,18 @@ void cmd_top(Terminal *term) {
   terminal_puts(term, "Top monitor started. Press 'q' or Ctrl+C to quit.\r\n");
 }
 
+// Histogramas log2 de tramos en CPU, espera en cola y latencia de despertar
+static void print_sched_histograms(Terminal *term, task_sched_stats_t *st) {
+  terminal_puts(term, "  >= us        RUN     WAIT   WAKEUP\r\n");
+  for (uint32_t i = 0; i < SCHED_HIST_BUCKETS; i++) {
+    if (!st->hist_run[i] && !st->hist_wait[i] && !st->hist_wakeup[i])
+      continue;
+    terminal_printf(term, "  %-8u %8u %8u %8u\r\n",
+                    sched_hist_bucket_floor_us(i), st->hist_run[i],
+                    st->hist_wait[i], st->hist_wakeup[i]);
+  }
+}
+
 // ✅ FUNCIÓN ADICIONAL: Mostrar información detallada de una tarea específica
 void cmd_task_info(Terminal *term, uint32_t task_id) {
   task_t *task = task_find_by_id(task_id);
@@ -521,6 +558,20 @@ void cmd_task_info(Terminal *term, uint32_t task_id) {
   terminal_printf(term, "Runtime:      %u ticks\r\n", task->total_runtime);
   terminal_printf(term, "Switches:     %u\r\n", task->switch_count);
 
+  // Contabilidad medida con el reloj del planificador
+  task_sched_stats_t *st = &task->sched_stats;
+  terminal_printf(term, "\r\n--- Scheduling ---\r\n");
+  terminal_printf(term, "Class:        %s (weight %u, vruntime %u ms)\r\n",
+                  task->sched_class == SCHED_CLASS_RT ? "RT" : "FAIR",
+                  task->sched_weight, (uint32_t)(task->vruntime / 1000));
+  terminal_printf(term, "CPU time:     %u us in %u runs\r\n",
+                  (uint32_t)sched_stats_runtime_us(task), st->runs);
+  terminal_printf(term, "Queue wait:   %u us (max %u us)\r\n",
+                  (uint32_t)sched_stats_wait_us(task), st->max_wait_us);
+  terminal_printf(term, "Wakeups:      %u (max latency %u us)\r\n",
+                  st->wakeups, st->max_wakeup_us);
+  print_sched_histograms(term, st);
+
   // Información del stack CON DEBUG DETALLADO
   uintptr_t stack_bottom = (uintptr_t)task->stack_base;
   uintptr_t stack_top_calc = stack_bottom + task->stack_size;
@@ -7,13 +7,24 @@
 #include "serial.h"
 #include "string.h"
 #include "terminal.h"
+#include "timer.h"
 #include "udp.h"
+#include "workqueue.h"
+
+#define DHCP_TIMEOUT_MS 3000
+#define DHCP_MAX_RETRIES 5
 
 static dhcp_state_t dhcp_state = DHCP_STATE_IDLE;
 static uint32_t dhcp_xid = 0x12345678;
-static uint32_t dhcp_timeout_ticks = 0;
 static int dhcp_retries = 0;
 
+// Reintentos: el timer (softirq) encola el trabajo, que reenvía con el lock
+// de la pila tomado
+static void dhcp_timeout_func(void *arg);
+static void dhcp_retry_work_func(void *arg);
+static ktimer_t dhcp_timer = KTIMER_INIT(dhcp_timeout_func, NULL);
+static work_t dhcp_retry_work = WORK_INIT(dhcp_retry_work_func, NULL);
+
 static ip_addr_t offered_ip;
 static ip_addr_t server_id;
 static ip_addr_t dhcp_netmask;
@@ -105,7 +116,7 @@ bool dhcp_start(void) {
   dhcp_xid++;
   dhcp_state = DHCP_STATE_DISCOVER;
   dhcp_retries = 0;
-  dhcp_timeout_ticks = ticks_since_boot + 300; // 3 seconds
+  timer_mod(&dhcp_timer, TIMER_MS(DHCP_TIMEOUT_MS));
   dhcp_send_discover();
   return true;
 }
@@ -153,9 +164,10 @@ void dhcp_handle_packet(ip_addr_t src_ip, uint16_t src_port, uint8_t *data,
                   offered_ip[0], offered_ip[1], offered_ip[2], offered_ip[3],
                   src_ip[0], src_ip[1], src_ip[2], src_ip[3]);
     dhcp_state = DHCP_STATE_REQUEST;
-    dhcp_timeout_ticks = ticks_since_boot + 300;
+    timer_mod(&dhcp_timer, TIMER_MS(DHCP_TIMEOUT_MS));
     dhcp_send_request();
   } else if (msg_type == DHCP_ACK && dhcp_state == DHCP_STATE_REQUEST) {
+    timer_del(&dhcp_timer);
     terminal_printf(&main_terminal, "[DHCP] ACK: %d.%d.%d.%d\r\n",
                     offered_ip[0], offered_ip[1], offered_ip[2], offered_ip[3]);
 
@@ -174,30 +186,38 @@ void dhcp_handle_packet(ip_addr_t src_ip, uint16_t src_port, uint8_t *data,
   }
 }
 
-void dhcp_tick(void) {
-  if (dhcp_state == DHCP_STATE_IDLE || dhcp_state == DHCP_STATE_BOUND ||
-      dhcp_state == DHCP_STATE_FAILED) {
+static void dhcp_timeout_func(void *arg) {
+  (void)arg;
+  if (!workqueue_running()) {
+    timer_add(&dhcp_timer, TIMER_NS_PER_TICK); // Workqueue aún no lista
     return;
   }
+  queue_work_item(&dhcp_retry_work); // Si ya estaba en cola, basta con esa
+}
+
+static void dhcp_retry_work_func(void *arg) {
+  (void)arg;
+  network_stack_lock();
 
-  if (ticks_since_boot > dhcp_timeout_ticks) {
+  if (dhcp_state == DHCP_STATE_DISCOVER || dhcp_state == DHCP_STATE_REQUEST) {
     dhcp_retries++;
-    if (dhcp_retries > 5) {
+    if (dhcp_retries > DHCP_MAX_RETRIES) {
       terminal_puts(&main_terminal, "[DHCP] FAILED: Max retries reached\r\n");
       dhcp_state = DHCP_STATE_FAILED;
-      return;
-    }
-
-    serial_printf(COM1_BASE, "[DHCP] Timeout, retrying... (%d/5)\r\n",
-                  dhcp_retries);
-    dhcp_timeout_ticks = ticks_since_boot + 300;
-
-    if (dhcp_state == DHCP_STATE_DISCOVER) {
-      dhcp_send_discover();
-    } else if (dhcp_state == DHCP_STATE_REQUEST) {
-      dhcp_send_request();
+    } else {
+      serial_printf(COM1_BASE, "[DHCP] Timeout, retrying... (%d/%d)\r\n",
+                    dhcp_retries, DHCP_MAX_RETRIES);
+      timer_mod(&dhcp_timer, TIMER_MS(DHCP_TIMEOUT_MS));
+
+      if (dhcp_state == DHCP_STATE_DISCOVER) {
+        dhcp_send_discover();
+      } else {
+        dhcp_send_request();
+      }
     }
   }
+
+  network_stack_unlock();
 }
 
 dhcp_state_t dhcp_get_state(void) { return dhcp_state; }
@@ -61,7 +61,6 @@ typedef enum {
 
 void dhcp_init(void);
 bool dhcp_start(void);
-void dhcp_tick(void);
 dhcp_state_t dhcp_get_state(void);
 
 #endif // DHCP_H
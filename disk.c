@@ -1,6 +1,7 @@
 #include "disk.h"
 #include "ahci.h"
 #include "atapi.h"
+#include "bcache.h"
 #include "fat32.h"
 #include "ide.h"
 #include "io.h"
@@ -9,7 +10,9 @@
 #include "partition.h"
 #include "sata_disk.h"
 #include "serial.h"
+#include "spinlock.h"
 #include "string.h"
+#include "task_utils.h"
 #include "terminal.h"
 #include "usb_disk_wrapper.h"
 
@@ -597,6 +600,48 @@ static int disk_prepare_command(disk_t *disk, uint64_t lba, uint32_t count,
   return 0;
 }
 
+// SET MULTIPLE MODE con la mayor potencia de 2 hasta IDE_MULTIPLE_MAX que
+// admita el disco (IDENTIFY palabra 47): un DRQ por bloque, no por sector
+static void disk_set_multiple_mode(disk_t *disk, uint8_t max) {
+  uint8_t sectors = 1;
+  while (sectors * 2 <= max && sectors * 2 <= IDE_MULTIPLE_MAX)
+    sectors *= 2;
+  disk->multiple_sectors = 1;
+  if (sectors == 1)
+    return;
+
+  DISK_LOCK();
+  outb(ATA_DRIVE_SELECT, 0xE0 | (disk->drive_number << 4));
+  for (int i = 0; i < 4; i++)
+    inb(ATA_ALT_STATUS); // ~400ns delay
+  outb(ATA_SECTOR_COUNT, sectors);
+  outb(ATA_COMMAND_PORT, ATA_CMD_SET_MULTIPLE_MODE);
+  DISK_UNLOCK();
+  if (disk_wait_ready(disk, ticks_since_boot) == 0)
+    disk->multiple_sectors = sectors;
+}
+
+static uint8_t disk_pio_command(disk_t *disk, bool write) {
+  if (disk->multiple_sectors > 1) {
+    if (write)
+      return disk->supports_lba48 ? ATA_CMD_WRITE_MULTIPLE_EXT
+                                  : ATA_CMD_WRITE_MULTIPLE;
+    return disk->supports_lba48 ? ATA_CMD_READ_MULTIPLE_EXT
+                                : ATA_CMD_READ_MULTIPLE;
+  }
+  if (write)
+    return disk->supports_lba48 ? ATA_CMD_WRITE_SECTORS_EXT
+                                : ATA_CMD_WRITE_SECTORS;
+  return disk->supports_lba48 ? ATA_CMD_READ_SECTORS_EXT
+                              : ATA_CMD_READ_SECTORS;
+}
+
+// Sectores del siguiente bloque DRQ (el último puede ser más corto)
+static uint32_t disk_drq_block(disk_t *disk, uint32_t remaining) {
+  uint32_t block = disk->multiple_sectors ? disk->multiple_sectors : 1;
+  return remaining < block ? remaining : block;
+}
+
 disk_err_t disk_init(disk_t *disk, uint8_t drive_number) {
   if (!disk) {
     terminal_puts(&main_terminal, "Invalid disk pointer\r\n");
@@ -684,6 +729,7 @@ disk_err_t disk_init(disk_t *disk, uint8_t drive_number) {
       } else {
         disk->sector_count = *((uint32_t *)&buffer[60]); // Words 60-61
       }
+      disk_set_multiple_mode(disk, buffer[47] & 0xFF);
 
       disk->initialized = 1;
       disk->physical_disk = NULL;
@@ -753,15 +799,15 @@ disk_err_t disk_read(disk_t *disk, uint64_t lba, uint32_t count, void *buffer) {
     if (sectors_to_process > 255)
       sectors_to_process = 255;
 
-    uint8_t cmd =
-        disk->supports_lba48 ? ATA_CMD_READ_SECTORS_EXT : ATA_CMD_READ_SECTORS;
+    uint8_t cmd = disk_pio_command(disk, false);
     if (disk_prepare_command(disk, lba + sectors_done, sectors_to_process,
                              cmd) != 0) {
       disk_reset(disk);
       continue;
     }
 
-    for (uint32_t sector = 0; sector < sectors_to_process; sector++) {
+    for (uint32_t sector = 0; sector < sectors_to_process;) {
+      uint32_t block = disk_drq_block(disk, sectors_to_process - sector);
       if (disk_wait_drq(disk, ticks_since_boot) != 0) {
         disk_reset(disk);
         break;
@@ -772,9 +818,10 @@ disk_err_t disk_read(disk_t *disk, uint64_t lba, uint32_t count, void *buffer) {
         break;
       }
 
-      pio_read16(ATA_DATA_PORT, buf, SECTOR_SIZE / 2);
-      buf += SECTOR_SIZE;
-      sectors_done++;
+      pio_read16(ATA_DATA_PORT, buf, block * SECTOR_SIZE / 2);
+      buf += block * SECTOR_SIZE;
+      sector += block;
+      sectors_done += block;
     }
 
     if (sectors_done == count &&
@@ -808,23 +855,24 @@ disk_err_t disk_write(disk_t *disk, uint64_t lba, uint32_t count,
     if (sectors_to_process > 255)
       sectors_to_process = 255;
 
-    uint8_t cmd = disk->supports_lba48 ? ATA_CMD_WRITE_SECTORS_EXT
-                                       : ATA_CMD_WRITE_SECTORS;
+    uint8_t cmd = disk_pio_command(disk, true);
     if (disk_prepare_command(disk, lba + sectors_done, sectors_to_process,
                              cmd) != 0) {
       disk_reset(disk);
       continue;
     }
 
-    for (uint32_t sector = 0; sector < sectors_to_process; sector++) {
+    for (uint32_t sector = 0; sector < sectors_to_process;) {
+      uint32_t block = disk_drq_block(disk, sectors_to_process - sector);
       if (disk_wait_drq(disk, ticks_since_boot) != 0) {
         disk_reset(disk);
         break;
       }
 
-      pio_write16(ATA_DATA_PORT, buf, SECTOR_SIZE / 2);
-      buf += SECTOR_SIZE;
-      sectors_done++;
+      pio_write16(ATA_DATA_PORT, buf, block * SECTOR_SIZE / 2);
+      buf += block * SECTOR_SIZE;
+      sector += block;
+      sectors_done += block;
 
       // Wait for DRQ to clear
       if (disk_wait_ready(disk, ticks_since_boot) != 0) {
@@ -1029,98 +1077,153 @@ disk_err_t disk_read_dispatch(disk_t *disk, uint64_t lba, uint32_t count,
     }
   }
 
-  if (disk_is_atapi(disk)) {
-    uint32_t atapi_id = disk->drive_number - 0xE0;
-
-    if (!atapi_check_media(atapi_id)) {
-      return DISK_ERR_ATAPI;
-    }
-
-    // ATAPI usa actual_lba con offset aplicado
-    uint32_t atapi_lba = actual_lba / 4;
-    uint32_t atapi_count = (count + 3) / 4;
-
-    uint8_t *atapi_buffer = (uint8_t *)kernel_malloc(atapi_count * 2048);
-    if (!atapi_buffer) {
-      return DISK_ERR_ATAPI;
-    }
+  return bcache_read(disk, actual_lba, count, buffer);
+}
 
-    atapi_err_t result =
-        atapi_read_sectors(atapi_id, atapi_lba, atapi_count, atapi_buffer);
+void disk_readahead(disk_t *disk, uint64_t lba, uint32_t count) {
+  if (!disk || !disk->initialized || lba >= disk->sector_count)
+    return;
+  if (lba + count > disk->sector_count)
+    count = (uint32_t)(disk->sector_count - lba);
+  if (disk->is_partition)
+    lba += disk->partition_lba_offset;
+  bcache_readahead(disk, lba, count);
+}
 
-    if (result == ATAPI_ERR_NONE) {
-      uint32_t offset = (actual_lba % 4) * 512;
-      memcpy(buffer, atapi_buffer + offset, count * 512);
-      kernel_free(atapi_buffer);
-      return DISK_ERR_NONE;
+// ========================================================================
+// BLOQUE NATIVO MAYOR QUE 512
+// ========================================================================
+
+// Buffer de los bloques de borde, uno para todos los dispositivos
+static uint8_t disk_edge_buf[DISK_EDGE_MAX_BYTES] __attribute__((aligned(16)));
+static mutex_t disk_edge_mutex;
+static volatile bool disk_edge_mutex_ready = false;
+
+static void disk_edge_lock(void) {
+  if (!disk_edge_mutex_ready) {
+    uint32_t flags = local_irq_save();
+    if (!disk_edge_mutex_ready) {
+      mutex_init(&disk_edge_mutex, "disk_edge");
+      disk_edge_mutex_ready = true;
     }
+    local_irq_restore(flags);
+  }
+  mutex_lock(&disk_edge_mutex);
+}
 
-    kernel_free(atapi_buffer);
+uint32_t disk_native_sectors(disk_t *disk) {
+  if (!disk)
+    return 1;
+  uint32_t size = disk_get_limits(disk)->physical_block_size;
+  uint32_t native = size / SECTOR_SIZE;
+  if (size % SECTOR_SIZE || size > DISK_EDGE_MAX_BYTES ||
+      (native & (native - 1)))
+    return 1;
+  return native;
+}
 
-    switch (result) {
-    case ATAPI_ERR_NO_MEDIA:
-      return DISK_ERR_ATAPI;
-    case ATAPI_ERR_TIMEOUT:
-      return DISK_ERR_TIMEOUT;
-    case ATAPI_ERR_LBA_OUT_OF_RANGE:
-      return DISK_ERR_LBA_OUT_OF_RANGE;
-    default:
-      return DISK_ERR_ATAPI;
+disk_err_t disk_read_native(uint32_t native, uint64_t lba, uint32_t count,
+                            void *buffer, disk_block_read_t read, void *ctx) {
+  uint32_t shift = (uint32_t)__builtin_ctz(native);
+  uint32_t mask = native - 1;
+  uint8_t *out = (uint8_t *)buffer;
+
+  while (count) {
+    uint32_t head = (uint32_t)lba & mask;
+    uint32_t part;
+    disk_err_t err;
+
+    if (head || count < native) {
+      // Borde: el bloque entero al buffer intermedio y se copia lo pedido
+      part = native - head;
+      if (part > count)
+        part = count;
+      disk_edge_lock();
+      err = read(ctx, (uint32_t)(lba >> shift), 1, disk_edge_buf);
+      if (err == DISK_ERR_NONE)
+        memcpy(out, disk_edge_buf + head * SECTOR_SIZE, part * SECTOR_SIZE);
+      mutex_unlock(&disk_edge_mutex);
+    } else {
+      // Bloques enteros: directos al buffer del llamador
+      part = count & ~mask;
+      err = read(ctx, (uint32_t)(lba >> shift), part >> shift, out);
     }
-  }
+    if (err != DISK_ERR_NONE)
+      return err;
 
-  if (disk_is_usb(disk)) {
-    // USB usa actual_lba directamente
-    return usb_disk_read(disk, actual_lba, count, buffer);
+    lba += part;
+    count -= part;
+    out += part * SECTOR_SIZE;
   }
+  return DISK_ERR_NONE;
+}
 
-  if (disk->type == DEVICE_TYPE_SATA_DISK) {
-    uint32_t sata_disk_id;
-
-    // Determinar ID basado en drive_number
-    if (disk->drive_number >= 0xC0 && disk->drive_number < 0xD0) {
-      sata_disk_id = disk->drive_number - 0xC0; // Nuevo rango
-    } else if (disk->drive_number >= 0x80 && disk->drive_number < 0x90) {
-      sata_disk_id =
-          disk->drive_number - 0x80; // Rango antiguo (backward compatible)
+disk_err_t disk_write_native(uint32_t native, uint64_t lba, uint32_t count,
+                             const void *buffer, disk_block_read_t read,
+                             disk_block_write_t write, void *ctx) {
+  uint32_t shift = (uint32_t)__builtin_ctz(native);
+  uint32_t mask = native - 1;
+  const uint8_t *in = (const uint8_t *)buffer;
+
+  while (count) {
+    uint32_t head = (uint32_t)lba & mask;
+    uint32_t part;
+    disk_err_t err;
+
+    if (head || count < native) {
+      // Borde: leer el bloque, sustituir los sectores y escribirlo entero
+      uint32_t block = (uint32_t)(lba >> shift);
+      part = native - head;
+      if (part > count)
+        part = count;
+      disk_edge_lock();
+      err = read(ctx, block, 1, disk_edge_buf);
+      if (err == DISK_ERR_NONE) {
+        memcpy(disk_edge_buf + head * SECTOR_SIZE, in, part * SECTOR_SIZE);
+        err = write(ctx, block, 1, disk_edge_buf);
+      }
+      mutex_unlock(&disk_edge_mutex);
     } else {
-      return DISK_ERR_INVALID_PARAM;
+      part = count & ~mask;
+      err = write(ctx, (uint32_t)(lba >> shift), part >> shift, in);
     }
+    if (err != DISK_ERR_NONE)
+      return err;
 
-    return sata_to_legacy_disk_read(disk, actual_lba, count, buffer);
+    lba += part;
+    count -= part;
+    in += part * SECTOR_SIZE;
   }
+  return DISK_ERR_NONE;
+}
 
-  if (disk->type == DEVICE_TYPE_PATA_DISK) {
-    // Convertir drive_number a bus/drive
-    uint8_t bus = (disk->drive_number < 2) ? 0 : 1;
-    uint8_t drive = (disk->drive_number < 2) ? disk->drive_number
-                                             : (disk->drive_number - 2);
-
-    // Buscar el disco en el driver IDE
-    for (uint8_t i = 0; i < ide_get_disk_count(); i++) {
-      ide_disk_t *ide_disk = ide_get_disk_info(i);
-      if (ide_disk && ide_disk->bus == bus && ide_disk->drive == drive &&
-          ide_disk->present) {
-        // Verificar límites
-        if (actual_lba + count > ide_disk->sector_count) {
-          return DISK_ERR_LBA_OUT_OF_RANGE;
-        }
+// ATAPI: 'ctx' apunta al índice del dispositivo
+static disk_err_t disk_atapi_block_read(void *ctx, uint32_t block,
+                                        uint32_t count, void *buffer) {
+  switch (atapi_read_sectors(*(uint32_t *)ctx, block, count, buffer)) {
+  case ATAPI_ERR_NONE:
+    return DISK_ERR_NONE;
+  case ATAPI_ERR_TIMEOUT:
+    return DISK_ERR_TIMEOUT;
+  case ATAPI_ERR_LBA_OUT_OF_RANGE:
+    return DISK_ERR_LBA_OUT_OF_RANGE;
+  default:
+    return DISK_ERR_ATAPI;
+  }
+}
 
-        // Usar driver IDE para lectura
-        if (ide_read_sectors(ide_disk, actual_lba, count, buffer) == 0) {
-          return DISK_ERR_NONE;
-        } else {
-          return DISK_ERR_ATA;
-        }
-      }
-    }
+// ========================================================================
+// DRIVERS DE BLOQUE: PIO HEREDADO, ATAPI E IDE
+// ========================================================================
 
-    // Si no se encontró en el driver IDE, usar implementación tradicional
-    terminal_printf(&main_terminal,
-                    "DISK: IDE disk not in driver, using legacy read\n");
-  }
+// Un comando ATA con cuenta de 8 bits, uno a la vez
+static const block_queue_limits_t disk_default_limits = {
+    SECTOR_SIZE, SECTOR_SIZE, 255, 1, false};
 
-  // Implementación IDE tradicional (fallback)
+// PIO por los puertos del canal primario: lo que ningún driver reconoce y
+// los discos PATA que no están en el driver IDE
+static disk_err_t disk_legacy_read(disk_t *disk, uint64_t actual_lba,
+                                   uint32_t count, void *buffer) {
   // NOTA: No usar disk_read() recursivamente, usar la implementación real
   if (!disk || !disk->initialized || !buffer || count == 0) {
     return DISK_ERR_INVALID_PARAM;
@@ -1147,15 +1250,15 @@ disk_err_t disk_read_dispatch(disk_t *disk, uint64_t lba, uint32_t count,
     if (sectors_to_process > 255)
       sectors_to_process = 255;
 
-    uint8_t cmd =
-        disk->supports_lba48 ? ATA_CMD_READ_SECTORS_EXT : ATA_CMD_READ_SECTORS;
+    uint8_t cmd = disk_pio_command(disk, false);
     if (disk_prepare_command(disk, actual_lba + sectors_done,
                              sectors_to_process, cmd) != 0) {
       disk_reset(disk);
       continue;
     }
 
-    for (uint32_t sector = 0; sector < sectors_to_process; sector++) {
+    for (uint32_t sector = 0; sector < sectors_to_process;) {
+      uint32_t block = disk_drq_block(disk, sectors_to_process - sector);
       if (disk_wait_drq(disk, ticks_since_boot) != 0) {
         disk_reset(disk);
         break;
@@ -1166,9 +1269,10 @@ disk_err_t disk_read_dispatch(disk_t *disk, uint64_t lba, uint32_t count,
         break;
       }
 
-      pio_read16(ATA_DATA_PORT, buf, SECTOR_SIZE / 2);
-      buf += SECTOR_SIZE;
-      sectors_done++;
+      pio_read16(ATA_DATA_PORT, buf, block * SECTOR_SIZE / 2);
+      buf += block * SECTOR_SIZE;
+      sector += block;
+      sectors_done += block;
     }
 
     if (sectors_done == count &&
@@ -1182,239 +1286,8 @@ disk_err_t disk_read_dispatch(disk_t *disk, uint64_t lba, uint32_t count,
   return sectors_done == count ? DISK_ERR_NONE : DISK_ERR_ATA;
 }
 
-disk_err_t disk_write_dispatch(disk_t *disk, uint64_t lba, uint32_t count,
-                               const void *buffer) {
-  if (!disk || !disk->initialized) {
-    terminal_printf(&main_terminal,
-                    "DISK: Write dispatch - disk not initialized\n");
-    return DISK_ERR_NOT_INITIALIZED;
-  }
-
-  // terminal_printf(&main_terminal,
-  //                 "DISK: Write dispatch called - drive=0x%02x, type=%d, "
-  //                 "LBA=%llu, count=%u\n",
-  //                 disk->drive_number, disk->type, lba, count);
-
-  // ============================================================
-  // 1. Aplicar offset si es partición (CON VALIDACIONES MEJORADAS)
-  // ============================================================
-  uint64_t actual_lba = lba;
-  if (disk->is_partition) {
-    // Validar que partition_lba_offset sea razonable
-    if (disk->partition_lba_offset > 0xFFFFFFFF) {
-      terminal_printf(&main_terminal,
-                      "DISK: ERROR: partition_lba_offset too large: %llu\n",
-                      disk->partition_lba_offset);
-      return DISK_ERR_INVALID_PARAM;
-    }
-
-    actual_lba = lba + disk->partition_lba_offset;
-
-    // Validación mejorada de límites de partición
-    if (lba >= disk->sector_count) {
-      terminal_printf(&main_terminal,
-                      "DISK: ERROR: LBA %llu >= partition sector count %llu\n",
-                      lba, disk->sector_count);
-      return DISK_ERR_LBA_OUT_OF_RANGE;
-    }
-
-    if (lba + count > disk->sector_count) {
-      terminal_printf(
-          &main_terminal,
-          "DISK: Write beyond partition bounds (LBA %llu + %u > %llu)\n", lba,
-          count, disk->sector_count);
-      return DISK_ERR_LBA_OUT_OF_RANGE;
-    }
-
-    // terminal_printf(&main_terminal,
-    //                 "DISK: Partition write - offset: %llu, actual LBA:
-    //                 %llu\n", disk->partition_lba_offset, actual_lba);
-
-    // Si es partición, usar el disco físico para verificar límites globales
-    if (disk->physical_disk) {
-      uint64_t physical_limit = disk->physical_disk->sector_count;
-      if (actual_lba + count > physical_limit) {
-        terminal_printf(&main_terminal,
-                        "DISK: ERROR: Write beyond physical disk bounds (%llu "
-                        "+ %u > %llu)\n",
-                        actual_lba, count, physical_limit);
-        return DISK_ERR_LBA_OUT_OF_RANGE;
-      }
-    }
-  }
-
-  // ============================================================
-  // 2. DETECCIÓN MEJORADA DEL TIPO DE DISCO
-  // ============================================================
-
-  // Primero verificar dispositivos especiales
-  if (disk_is_atapi(disk)) {
-    terminal_puts(&main_terminal,
-                  "DISK: Write not supported on ATAPI device\n");
-    return DISK_ERR_ATAPI;
-  }
-
-  // Verificar USB
-  if (disk_is_usb(disk)) {
-    terminal_printf(&main_terminal, "DISK: Routing to USB disk\n");
-    return usb_disk_write(disk, actual_lba, count, buffer);
-  }
-
-  // NUEVO: Manejar discos IDE usando el driver
-  if (disk->type == DEVICE_TYPE_PATA_DISK) {
-    // Convertir drive_number a bus/drive
-    uint8_t bus = (disk->drive_number < 2) ? 0 : 1;
-    uint8_t drive = (disk->drive_number < 2) ? disk->drive_number
-                                             : (disk->drive_number - 2);
-
-    // Buscar el disco en el driver IDE
-    for (uint8_t i = 0; i < ide_get_disk_count(); i++) {
-      ide_disk_t *ide_disk = ide_get_disk_info(i);
-      if (ide_disk && ide_disk->bus == bus && ide_disk->drive == drive &&
-          ide_disk->present) {
-        // Verificar límites
-        if (actual_lba + count > ide_disk->sector_count) {
-          terminal_printf(&main_terminal,
-                          "DISK: LBA out of range for IDE disk\n");
-          return DISK_ERR_LBA_OUT_OF_RANGE;
-        }
-
-        // Usar driver IDE para escritura
-        if (ide_write_sectors(ide_disk, actual_lba, count, buffer) == 0) {
-          return DISK_ERR_NONE;
-        } else {
-          return DISK_ERR_ATA;
-        }
-      }
-    }
-
-    // Si no se encontró en el driver IDE, usar implementación tradicional
-    terminal_printf(&main_terminal,
-                    "DISK: IDE disk not in driver, using legacy write\n");
-    goto ide_write_path;
-  }
-
-  // DETECCIÓN MEJORADA DE SATA
-  bool is_sata = false;
-  uint32_t sata_disk_id = 0;
-
-  // Método 1: Por tipo explícito
-  if (disk->type == DEVICE_TYPE_SATA_DISK) {
-    is_sata = true;
-  }
-
-  // Método 2: Por rango de drive_number (CORREGIDO)
-  if (!is_sata) {
-    if (disk->drive_number >= 0xC0 && disk->drive_number <= 0xCF) {
-      // Nuevo rango para SATA: 0xC0-0xCF (para evitar conflictos con IDE)
-      is_sata = true;
-      sata_disk_id = disk->drive_number - 0xC0;
-      terminal_printf(
-          &main_terminal,
-          "DISK: Detected SATA by drive_number 0x%02x -> ID %u (new range)\n",
-          disk->drive_number, sata_disk_id);
-    } else if (disk->drive_number >= 0x80 && disk->drive_number <= 0x8F) {
-      // Rango antiguo para compatibilidad
-      is_sata = true;
-      sata_disk_id = disk->drive_number - 0x80;
-      terminal_printf(
-          &main_terminal,
-          "DISK: Detected SATA by drive_number 0x%02x -> ID %u (old range)\n",
-          disk->drive_number, sata_disk_id);
-    }
-  }
-
-  // Método 3: Por subsistema AHCI si está disponible
-  if (!is_sata && ahci_controller.initialized) {
-    // Verificar si este drive_number corresponde a un disco AHCI
-    if (sata_disk_get_count() > 0) {
-      // Asumir que drive_numbers bajos son IDE y altos son SATA
-      if (disk->drive_number >= 0x80) {
-        is_sata = true;
-        sata_disk_id = disk->drive_number & 0x0F; // Tomar bits bajos
-        terminal_printf(&main_terminal,
-                        "DISK: Inferred SATA from AHCI presence -> ID %u\n",
-                        sata_disk_id);
-      }
-    }
-  }
-
-  // ============================================================
-  // 3. MANEJO DE DISCOS SATA
-  // ============================================================
-  if (is_sata) {
-    // terminal_printf(&main_terminal,
-    //                 "DISK: Routing to SATA (disk_id=%u, actual_lba=%llu)\n",
-    //                 sata_disk_id, actual_lba);
-
-    // Verificar que el subsistema SATA esté inicializado
-    if (!sata_initialized) {
-      terminal_printf(&main_terminal, "DISK: SATA subsystem not initialized\n");
-      // Fallback a IDE si SATA no está disponible
-      terminal_printf(&main_terminal, "DISK: Falling back to IDE emulation\n");
-      is_sata = false;
-      goto ide_write_path;
-    }
-
-    // Verificar que el disco SATA existe
-    if (sata_disk_id >= sata_disk_get_count()) {
-      terminal_printf(&main_terminal,
-                      "DISK: Invalid SATA disk ID %u (max %u)\n", sata_disk_id,
-                      sata_disk_get_count());
-      return DISK_ERR_INVALID_PARAM;
-    }
-
-    sata_disk_t *sata_disk = sata_disk_get_info(sata_disk_id);
-    if (!sata_disk || !sata_disk->initialized || !sata_disk->present) {
-      terminal_printf(
-          &main_terminal,
-          "DISK: SATA disk %u not available (init=%d, present=%d)\n",
-          sata_disk_id, sata_disk ? sata_disk->initialized : 0,
-          sata_disk ? sata_disk->present : 0);
-      return DISK_ERR_NOT_INITIALIZED;
-    }
-
-    // Verificar límites del disco SATA
-    if (actual_lba + count > sata_disk->sector_count) {
-      terminal_printf(&main_terminal,
-                      "DISK: SATA LBA out of range (%llu + %u > %llu)\n",
-                      actual_lba, count, sata_disk->sector_count);
-      return DISK_ERR_LBA_OUT_OF_RANGE;
-    }
-
-    // Llamar a función SATA
-    disk_err_t result =
-        sata_to_legacy_disk_write(disk, actual_lba, count, buffer);
-
-    if (result == DISK_ERR_NONE) {
-      // terminal_printf(&main_terminal, "DISK: SATA write successful\n");
-      return DISK_ERR_NONE;
-    } else {
-      terminal_printf(&main_terminal, "DISK: SATA write failed with error %d\n",
-                      result);
-
-      // Diagnóstico detallado del puerto AHCI
-      if (sata_disk->ahci_port < 32) {
-        ahci_port_t *port = &ahci_controller.ports[sata_disk->ahci_port];
-        if (port->present) {
-          terminal_printf(&main_terminal,
-                          "DISK: AHCI Port %u status: CMD=0x%08x, SSTS=0x%08x, "
-                          "SERR=0x%08x\n",
-                          sata_disk->ahci_port, port->port_regs->cmd,
-                          port->port_regs->ssts, port->port_regs->serr);
-        }
-      }
-
-      // NO hacer fallback automático a IDE - si es SATA, debe funcionar con
-      // SATA
-      return result;
-    }
-  }
-
-  // ============================================================
-  // 4. MANEJO DE DISCOS IDE (FALLBACK)
-  // ============================================================
-ide_write_path:
+static disk_err_t disk_legacy_write(disk_t *disk, uint64_t actual_lba,
+                                    uint32_t count, const void *buffer) {
   terminal_printf(&main_terminal, "DISK: Using IDE write path\n");
 
   // Validaciones básicas
@@ -1467,8 +1340,7 @@ ide_write_path:
     //                 DISK_RETRIES - retries, sectors_done,
     //                 sectors_done + sectors_to_process - 1, count);
 
-    uint8_t cmd = disk->supports_lba48 ? ATA_CMD_WRITE_SECTORS_EXT
-                                       : ATA_CMD_WRITE_SECTORS;
+    uint8_t cmd = disk_pio_command(disk, true);
 
     // terminal_printf(&main_terminal, "DISK: Using command 0x%02X
     // (LBA48=%d)\n",
@@ -1482,7 +1354,8 @@ ide_write_path:
       continue;
     }
 
-    for (uint32_t sector = 0; sector < sectors_to_process; sector++) {
+    for (uint32_t sector = 0; sector < sectors_to_process;) {
+      uint32_t block = disk_drq_block(disk, sectors_to_process - sector);
       // terminal_printf(&main_terminal, "DISK: Writing sector %llu\n",
       //                 actual_lba + sectors_done + sector);
 
@@ -1492,9 +1365,10 @@ ide_write_path:
         break;
       }
 
-      pio_write16(ATA_DATA_PORT, buf, SECTOR_SIZE / 2);
-      buf += SECTOR_SIZE;
-      sectors_done++;
+      pio_write16(ATA_DATA_PORT, buf, block * SECTOR_SIZE / 2);
+      buf += block * SECTOR_SIZE;
+      sector += block;
+      sectors_done += block;
 
       if (disk_wait_ready(disk, ticks_since_boot) != 0) {
         terminal_puts(&main_terminal, "DISK: Ready wait failed after write\n");
@@ -1541,98 +1415,301 @@ ide_write_path:
   }
 }
 
-// Actualizar disk_flush_dispatch para incluir USB:
-disk_err_t disk_flush_dispatch(disk_t *disk) {
-  if (!disk || !disk->initialized) {
-    serial_printf(COM1_BASE, "DISK: Flush dispatch - disk not initialized\n");
-    return DISK_ERR_NOT_INITIALIZED;
+static bool disk_legacy_match(disk_t *disk) {
+  (void)disk;
+  return true;
+}
+
+static disk_err_t disk_legacy_submit(disk_t *disk, disk_op_t op, uint64_t lba,
+                                     uint32_t count, void *buffer) {
+  return op == DISK_OP_READ ? disk_legacy_read(disk, lba, count, buffer)
+                            : disk_legacy_write(disk, lba, count, buffer);
+}
+
+static const block_device_ops_t disk_legacy_ops = {
+    "legacy-pio", disk_legacy_match, disk_legacy_submit, disk_flush, NULL};
+
+static bool disk_atapi_match(disk_t *disk) { return disk_is_atapi(disk); }
+
+static disk_err_t disk_atapi_submit(disk_t *disk, disk_op_t op, uint64_t lba,
+                                    uint32_t count, void *buffer) {
+  if (op != DISK_OP_READ) {
+    terminal_puts(&main_terminal,
+                  "DISK: Write not supported on ATAPI device\n");
+    return DISK_ERR_ATAPI;
   }
+  uint32_t atapi_id = disk->drive_number - DISK_DRIVE_ATAPI_FIRST;
+  if (!atapi_check_media(atapi_id)) {
+    return DISK_ERR_ATAPI;
+  }
+  // Sectores de 2048
+  return disk_read_native(ATAPI_SECTOR_SIZE / SECTOR_SIZE, lba, count, buffer,
+                          disk_atapi_block_read, &atapi_id);
+}
 
-  serial_printf(COM1_BASE, "DISK: Flush dispatch - drive=0x%02x, type=%d\n",
-                disk->drive_number, disk->type);
+// Solo lectura: no hay caché de escritura que vaciar
+static disk_err_t disk_atapi_flush(disk_t *disk) {
+  (void)disk;
+  return DISK_ERR_NONE;
+}
 
-  if (disk_is_atapi(disk)) {
-    // ATAPI devices don't need flushing (read-only)
-    terminal_puts(&main_terminal, "DISK: ATAPI device, flush not needed\n");
-    return DISK_ERR_NONE;
+static void disk_atapi_limits(disk_t *disk, block_queue_limits_t *limits) {
+  (void)disk;
+  limits->physical_block_size = ATAPI_SECTOR_SIZE;
+  limits->max_transfer_sectors =
+      ATAPI_MAX_SECTORS_PER_CMD * (ATAPI_SECTOR_SIZE / SECTOR_SIZE);
+  limits->read_only = true;
+}
+
+static const block_device_ops_t disk_atapi_ops = {
+    "atapi", disk_atapi_match, disk_atapi_submit, disk_atapi_flush,
+    disk_atapi_limits};
+
+static ide_disk_t *disk_ide_lookup(disk_t *disk) {
+  // Convertir drive_number a bus/drive
+  uint8_t bus = (disk->drive_number < 2) ? 0 : 1;
+  uint8_t drive = (disk->drive_number < 2) ? disk->drive_number
+                                           : (disk->drive_number - 2);
+
+  for (uint8_t i = 0; i < ide_get_disk_count(); i++) {
+    ide_disk_t *ide_disk = ide_get_disk_info(i);
+    if (ide_disk && ide_disk->bus == bus && ide_disk->drive == drive &&
+        ide_disk->present)
+      return ide_disk;
   }
+  return NULL;
+}
 
-  // USB device
-  if (disk_is_usb(disk)) {
-    serial_printf(COM1_BASE, "DISK: USB device flush\n");
-    return usb_disk_flush(disk);
+// ATAPI también es PATA, pero se registra antes
+static bool disk_ide_match(disk_t *disk) {
+  return disk->type == DEVICE_TYPE_PATA_DISK && !disk_is_atapi(disk);
+}
+
+static disk_err_t disk_ide_submit(disk_t *disk, disk_op_t op, uint64_t lba,
+                                  uint32_t count, void *buffer) {
+  ide_disk_t *ide_disk = disk_ide_lookup(disk);
+  if (!ide_disk) {
+    terminal_printf(&main_terminal,
+                    "DISK: IDE disk not in driver, using legacy %s\n",
+                    op == DISK_OP_READ ? "read" : "write");
+    return disk_legacy_submit(disk, op, lba, count, buffer);
   }
 
-  // SATA device
-  if (disk->type == DEVICE_TYPE_SATA_DISK) {
-    // CORRECCIÓN: Calcular correctamente el ID del disco SATA
-    uint32_t sata_disk_id = 0;
+  if (lba + count > ide_disk->sector_count) {
+    return DISK_ERR_LBA_OUT_OF_RANGE;
+  }
+  int result = op == DISK_OP_READ
+                   ? ide_read_sectors(ide_disk, lba, count, buffer)
+                   : ide_write_sectors(ide_disk, lba, count, buffer);
+  return result == 0 ? DISK_ERR_NONE : DISK_ERR_ATA;
+}
 
-    if (disk->drive_number >= 0xC0 && disk->drive_number <= 0xCF) {
-      sata_disk_id = disk->drive_number - 0xC0;
-    } else if (disk->drive_number >= 0x80 && disk->drive_number <= 0x8F) {
-      sata_disk_id = disk->drive_number - 0x80;
-    } else {
+static disk_err_t disk_ide_flush(disk_t *disk) {
+  ide_disk_t *ide_disk = disk_ide_lookup(disk);
+  if (!ide_disk) {
+    serial_printf(COM1_BASE, "DISK: IDE device flush (legacy)\n");
+    return disk_flush(disk);
+  }
+  serial_printf(COM1_BASE, "DISK: IDE device flush via driver\n");
+  return ide_flush_cache(ide_disk) == 0 ? DISK_ERR_NONE : DISK_ERR_ATA;
+}
+
+// Comandos de hasta IDE_DMA_MAX_SECTORS, como los de PIO: los límites por
+// defecto
+static const block_device_ops_t disk_ide_ops = {
+    "ide", disk_ide_match, disk_ide_submit, disk_ide_flush, NULL};
+
+// ========================================================================
+// REGISTRO DE DRIVERS DE BLOQUE
+// ========================================================================
+
+static const block_device_ops_t *block_drivers[BLOCK_DEVICE_MAX_DRIVERS];
+static uint32_t block_driver_count = 0;
+static volatile bool block_builtin_registered = false;
+
+bool block_device_register(const block_device_ops_t *ops) {
+  if (!ops || !ops->match || !ops->submit)
+    return false;
+  uint32_t flags = local_irq_save();
+  bool ok = block_driver_count < BLOCK_DEVICE_MAX_DRIVERS;
+  if (ok)
+    block_drivers[block_driver_count++] = ops;
+  local_irq_restore(flags);
+  return ok;
+}
+
+// Los drivers del kernel, la primera vez que se resuelve un disco. Los
+// match() no se solapan salvo ATAPI/IDE, de ahí el orden.
+static void block_register_builtin(void) {
+  if (block_builtin_registered)
+    return;
+  uint32_t flags = local_irq_save();
+  if (!block_builtin_registered) {
+    block_device_register(&disk_atapi_ops);
+    block_device_register(&usb_block_ops);
+    block_device_register(&sata_block_ops);
+    block_device_register(&disk_ide_ops);
+    block_builtin_registered = true;
+  }
+  local_irq_restore(flags);
+}
+
+const block_device_ops_t *disk_get_ops(disk_t *disk) {
+  if (disk->ops && disk->ops_drive == disk->drive_number &&
+      disk->ops_type == disk->type)
+    return disk->ops;
+
+  block_register_builtin();
+  const block_device_ops_t *ops = &disk_legacy_ops;
+  for (uint32_t i = 0; i < block_driver_count; i++) {
+    if (block_drivers[i]->match(disk)) {
+      ops = block_drivers[i];
+      break;
+    }
+  }
+
+  block_queue_limits_t limits = disk_default_limits;
+  if (ops->limits)
+    ops->limits(disk, &limits);
+  if (!limits.max_transfer_sectors)
+    limits.max_transfer_sectors = disk_default_limits.max_transfer_sectors;
+  if (!limits.queue_depth)
+    limits.queue_depth = 1;
+
+  disk->limits = limits;
+  disk->ops_drive = disk->drive_number;
+  disk->ops_type = disk->type;
+  disk->ops = ops;
+  return ops;
+}
+
+const block_queue_limits_t *disk_get_limits(disk_t *disk) {
+  disk_get_ops(disk);
+  return &disk->limits;
+}
+
+void disk_list_drivers(void) {
+  terminal_puts(&main_terminal, "Block drivers:");
+  block_register_builtin();
+  for (uint32_t i = 0; i < block_driver_count; i++)
+    terminal_printf(&main_terminal, " %s", block_drivers[i]->name);
+  terminal_printf(&main_terminal, " (fallback %s)\r\n", disk_legacy_ops.name);
+
+  if (!main_disk.initialized)
+    return;
+  const block_device_ops_t *ops = disk_get_ops(&main_disk);
+  const block_queue_limits_t *l = &main_disk.limits;
+  terminal_printf(&main_terminal,
+                  "  main disk 0x%02x: %s, block %u/%u bytes, up to %u "
+                  "sectors per command, %u in flight%s\r\n",
+                  main_disk.drive_number, ops->name, l->logical_block_size,
+                  l->physical_block_size, l->max_transfer_sectors,
+                  l->queue_depth, l->read_only ? ", read-only" : "");
+}
+
+// ========================================================================
+// DESPACHO
+// ========================================================================
+
+// Lectura sin caché: 'lba' ya es físico (offset de partición aplicado)
+disk_err_t disk_read_device(disk_t *disk, uint64_t lba, uint32_t count,
+                            void *buffer) {
+  if (!disk || !disk->initialized) {
+    return DISK_ERR_NOT_INITIALIZED;
+  }
+  return disk_get_ops(disk)->submit(disk, DISK_OP_READ, lba, count, buffer);
+}
+
+disk_err_t disk_write_dispatch(disk_t *disk, uint64_t lba, uint32_t count,
+                               const void *buffer) {
+  if (!disk || !disk->initialized) {
+    terminal_printf(&main_terminal,
+                    "DISK: Write dispatch - disk not initialized\n");
+    return DISK_ERR_NOT_INITIALIZED;
+  }
+
+  // terminal_printf(&main_terminal,
+  //                 "DISK: Write dispatch called - drive=0x%02x, type=%d, "
+  //                 "LBA=%llu, count=%u\n",
+  //                 disk->drive_number, disk->type, lba, count);
+
+  // ============================================================
+  // 1. Aplicar offset si es partición (CON VALIDACIONES MEJORADAS)
+  // ============================================================
+  uint64_t actual_lba = lba;
+  if (disk->is_partition) {
+    // Validar que partition_lba_offset sea razonable
+    if (disk->partition_lba_offset > 0xFFFFFFFF) {
       terminal_printf(&main_terminal,
-                      "DISK: Invalid drive_number for SATA flush: 0x%02x\n",
-                      disk->drive_number);
+                      "DISK: ERROR: partition_lba_offset too large: %llu\n",
+                      disk->partition_lba_offset);
       return DISK_ERR_INVALID_PARAM;
     }
 
-    serial_printf(COM1_BASE, "DISK: SATA flush for disk ID %u\n", sata_disk_id);
+    actual_lba = lba + disk->partition_lba_offset;
 
-    sata_err_t result = sata_disk_flush(sata_disk_id);
+    // Validación mejorada de límites de partición
+    if (lba >= disk->sector_count) {
+      terminal_printf(&main_terminal,
+                      "DISK: ERROR: LBA %llu >= partition sector count %llu\n",
+                      lba, disk->sector_count);
+      return DISK_ERR_LBA_OUT_OF_RANGE;
+    }
 
-    switch (result) {
-    case SATA_ERR_NONE:
-      serial_printf(COM1_BASE, "DISK: SATA flush successful\n");
-      return DISK_ERR_NONE;
-    case SATA_ERR_INVALID_PARAM:
-      terminal_printf(&main_terminal, "DISK: Invalid SATA disk ID %u\n",
-                      sata_disk_id);
-      return DISK_ERR_INVALID_PARAM;
-    case SATA_ERR_NOT_INITIALIZED:
-      terminal_printf(&main_terminal, "DISK: SATA disk %u not initialized\n",
-                      sata_disk_id);
-      return DISK_ERR_NOT_INITIALIZED;
-    case SATA_ERR_IO_ERROR:
-      terminal_printf(&main_terminal, "DISK: SATA flush I/O error\n");
-      return DISK_ERR_ATA;
-    default:
-      terminal_printf(&main_terminal, "DISK: Unknown SATA flush error %d\n",
-                      result);
-      return DISK_ERR_ATA;
+    if (lba + count > disk->sector_count) {
+      terminal_printf(
+          &main_terminal,
+          "DISK: Write beyond partition bounds (LBA %llu + %u > %llu)\n", lba,
+          count, disk->sector_count);
+      return DISK_ERR_LBA_OUT_OF_RANGE;
     }
-  }
 
-  // NUEVO: IDE device usando driver
-  if (disk->type == DEVICE_TYPE_PATA_DISK) {
-    // Convertir drive_number a bus/drive
-    uint8_t bus = (disk->drive_number < 2) ? 0 : 1;
-    uint8_t drive = (disk->drive_number < 2) ? disk->drive_number
-                                             : (disk->drive_number - 2);
+    // terminal_printf(&main_terminal,
+    //                 "DISK: Partition write - offset: %llu, actual LBA:
+    //                 %llu\n", disk->partition_lba_offset, actual_lba);
 
-    // Buscar el disco en el driver IDE
-    for (uint8_t i = 0; i < ide_get_disk_count(); i++) {
-      ide_disk_t *ide_disk = ide_get_disk_info(i);
-      if (ide_disk && ide_disk->bus == bus && ide_disk->drive == drive &&
-          ide_disk->present) {
-        serial_printf(COM1_BASE, "DISK: IDE device flush via driver\n");
-        if (ide_flush_cache(ide_disk) == 0) {
-          return DISK_ERR_NONE;
-        } else {
-          return DISK_ERR_ATA;
-        }
+    // Si es partición, usar el disco físico para verificar límites globales
+    if (disk->physical_disk) {
+      uint64_t physical_limit = disk->physical_disk->sector_count;
+      if (actual_lba + count > physical_limit) {
+        terminal_printf(&main_terminal,
+                        "DISK: ERROR: Write beyond physical disk bounds (%llu "
+                        "+ %u > %llu)\n",
+                        actual_lba, count, physical_limit);
+        return DISK_ERR_LBA_OUT_OF_RANGE;
       }
     }
+  }
 
-    // Si no se encontró en el driver IDE, usar flush tradicional
-    serial_printf(COM1_BASE, "DISK: IDE device flush (legacy)\n");
+  return bcache_write(disk, actual_lba, count, buffer);
+}
+
+// Escritura sin caché: 'lba' ya es físico (offset de partición aplicado)
+disk_err_t disk_write_device(disk_t *disk, uint64_t lba, uint32_t count,
+                             const void *buffer) {
+  if (!disk || !disk->initialized) {
+    return DISK_ERR_NOT_INITIALIZED;
   }
+  return disk_get_ops(disk)->submit(disk, DISK_OP_WRITE, lba, count,
+                                    (void *)buffer);
+}
 
-  // IDE device (default)
-  serial_printf(COM1_BASE, "DISK: IDE device flush (legacy fallback)\n");
-  return disk_flush(disk);
+disk_err_t disk_flush_dispatch(disk_t *disk) {
+  if (!disk || !disk->initialized) {
+    serial_printf(COM1_BASE, "DISK: Flush dispatch - disk not initialized\n");
+    return DISK_ERR_NOT_INITIALIZED;
+  }
+
+  serial_printf(COM1_BASE, "DISK: Flush dispatch - drive=0x%02x, type=%d\n",
+                disk->drive_number, disk->type);
+
+  // Primero los bloques sucios de la caché, luego la del dispositivo
+  disk_err_t sync_err = bcache_sync(disk);
+  if (sync_err != DISK_ERR_NONE)
+    return sync_err;
+
+  const block_device_ops_t *ops = disk_get_ops(disk);
+  return ops->flush ? ops->flush(disk) : DISK_ERR_NONE;
 }
 
 void diagnose_disk_format(disk_t *disk) {
@@ -1955,5 +2032,17 @@ void cmd_lsblk(void) {
     }
   }
 
+  terminal_puts(&main_terminal, "\r\n");
+  disk_list_drivers();
+
+  // Buffer cache
+  size_t len = 0;
+  char *stats = bcache_format_stats(&len);
+  if (stats) {
+    terminal_puts(&main_terminal, "\r\nBuffer cache:\r\n");
+    terminal_puts(&main_terminal, stats);
+    kernel_free(stats);
+  }
+
   terminal_puts(&main_terminal, "\r\n");
 }
\ No newline at end of file
@@ -26,22 +26,40 @@ typedef enum {
   DEVICE_TYPE_UNKNOWN
 } device_type_t;
 
+// Disk operation states
+typedef enum { DISK_OP_NONE, DISK_OP_READ, DISK_OP_WRITE } disk_op_t;
+
+// Límites de la cola de un dispositivo (ver REGISTRO DE DRIVERS DE BLOQUE)
+typedef struct block_queue_limits {
+  uint32_t logical_block_size;   // Bytes por LBA de la interfaz (512)
+  uint32_t physical_block_size;  // Bloque nativo del medio
+  uint32_t max_transfer_sectors; // Sectores de 512 por comando
+  uint32_t queue_depth;          // Comandos en vuelo (1 = serializar)
+  bool read_only;
+} block_queue_limits_t;
+
+struct block_device_ops;
+
 struct disk_t {
   uint8_t drive_number;
   uint8_t initialized; // 0 = not initialized, 1 = initialized
   uint8_t present;
   uint8_t supports_lba48;        // 0 = LBA28 only, 1 = supports LBA48
+  uint8_t multiple_sectors;      // Bloque DRQ de READ/WRITE MULTIPLE (0/1 = no)
   uint64_t sector_count;         // Use uint64_t for LBA48 support
   device_type_t type;            // IDE or SATA
   uint64_t partition_lba_offset; // Offset LBA de la partición
   bool is_partition;             // true si es wrapper de partición
   disk_t *physical_disk; // Pointer to physical disk if this is a partition;
                          // NULL otherwise
+  // Driver de bloque, resuelto en el primer uso (disk_get_ops) para el
+  // drive_number y tipo de entonces; las copias del disk_t lo heredan
+  const struct block_device_ops *ops;
+  uint8_t ops_drive;
+  device_type_t ops_type;
+  block_queue_limits_t limits;
 };
 
-// Disk operation states
-typedef enum { DISK_OP_NONE, DISK_OP_READ, DISK_OP_WRITE } disk_op_t;
-
 // Error codes
 typedef enum {
   DISK_ERR_NONE = 0,
@@ -96,6 +114,77 @@ disk_err_t disk_read_dispatch(disk_t *disk, uint64_t lba, uint32_t count,
 disk_err_t disk_write_dispatch(disk_t *disk, uint64_t lba, uint32_t count,
                                const void *buffer);
 disk_err_t disk_flush_dispatch(disk_t *disk);
+// Pide traer [lba, lba + count) a la caché sin esperar (lba relativo a la
+// partición, como en disk_read_dispatch). Se recorta a los límites.
+void disk_readahead(disk_t *disk, uint64_t lba, uint32_t count);
+
+// Acceso directo al dispositivo, por debajo del buffer cache. 'lba' es
+// físico: no se aplica el offset de partición.
+disk_err_t disk_read_device(disk_t *disk, uint64_t lba, uint32_t count,
+                            void *buffer);
+disk_err_t disk_write_device(disk_t *disk, uint64_t lba, uint32_t count,
+                             const void *buffer);
+
+// ========================================================================
+// REGISTRO DE DRIVERS DE BLOQUE
+// ========================================================================
+//
+// Cada driver (ATAPI, USB, SATA, IDE) registra su tabla de operaciones. Al
+// usar un disk_t por primera vez se busca, en orden de registro, el primer
+// driver cuyo match() lo reconozca; si ninguno, queda el PIO heredado por
+// los puertos del canal primario. La tabla y los límites se guardan en el
+// disk_t, así que la E/S ya no vuelve a mirar drive_number ni tipo, y la
+// cola de disk_io y el buffer cache cortan y unen las peticiones según los
+// límites reales del dispositivo.
+
+#define BLOCK_DEVICE_MAX_DRIVERS 8
+
+typedef struct block_device_ops {
+  const char *name;
+  bool (*match)(disk_t *disk);
+  // 'lba' físico y en sectores de 512; en escritura 'buffer' no se toca
+  disk_err_t (*submit)(disk_t *disk, disk_op_t op, uint64_t lba,
+                       uint32_t count, void *buffer);
+  disk_err_t (*flush)(disk_t *disk);
+  // Opcional: ajusta los límites por defecto (512, 255 sectores, 1 en vuelo)
+  void (*limits)(disk_t *disk, block_queue_limits_t *limits);
+} block_device_ops_t;
+
+// false si la tabla está llena o le faltan match/submit
+bool block_device_register(const block_device_ops_t *ops);
+const block_device_ops_t *disk_get_ops(disk_t *disk);
+const block_queue_limits_t *disk_get_limits(disk_t *disk);
+void disk_list_drivers(void);
+
+// ========================================================================
+// BLOQUE NATIVO MAYOR QUE 512
+// ========================================================================
+//
+// ATAPI (2048) y los USB de 4K solo transfieren bloques enteros. La parte
+// de la petición alineada al bloque va directa al buffer del llamador; solo
+// los bloques de los bordes pasan por un buffer intermedio compartido
+// (lectura y copia, o leer-modificar-escribir). El buffer cache alinea sus
+// lecturas para que los bordes casi nunca lleguen hasta aquí.
+
+#define DISK_EDGE_MAX_BYTES 4096
+
+// Sectores de 512 por bloque nativo (physical_block_size de sus límites):
+// potencia de dos y como mucho DISK_EDGE_MAX_BYTES; 1 si no hace falta
+// alinear o no se puede
+uint32_t disk_native_sectors(disk_t *disk);
+
+// 'block' y 'count' en bloques nativos
+typedef disk_err_t (*disk_block_read_t)(void *ctx, uint32_t block,
+                                        uint32_t count, void *buffer);
+typedef disk_err_t (*disk_block_write_t)(void *ctx, uint32_t block,
+                                         uint32_t count, const void *buffer);
+
+// 'lba' y 'count' en sectores de 512; 'native' como disk_native_sectors
+disk_err_t disk_read_native(uint32_t native, uint64_t lba, uint32_t count,
+                            void *buffer, disk_block_read_t read, void *ctx);
+disk_err_t disk_write_native(uint32_t native, uint64_t lba, uint32_t count,
+                             const void *buffer, disk_block_read_t read,
+                             disk_block_write_t write, void *ctx);
 void diagnose_disk_format(disk_t *disk);
 
 disk_err_t disk_init_atapi(disk_t *disk, uint32_t atapi_device_id);
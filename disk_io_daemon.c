@@ -1,5 +1,6 @@
 // disk_io_daemon.c
 #include "disk_io_daemon.h"
+#include "bcache.h"
 #include "task.h"
 #include "task_utils.h"
 #include "disk.h"
@@ -8,513 +9,474 @@
 #include "memory.h"
 #include "irq.h"
 #include "log.h"
+#include "spinlock.h"
+#include "string.h"
 
-// Definiciones de mensajes
-#define MSG_DISK_READ_REQUEST   100
-#define MSG_DISK_WRITE_REQUEST  101
-#define MSG_DISK_FLUSH_REQUEST  102
-#define MSG_DISK_RESPONSE       103
-
-// Estructura de solicitud de disco
-typedef struct {
-    disk_t* disk;
-    uint64_t lba;
-    uint32_t sector_count;
-    void* buffer;           // Para lecturas: buffer donde escribir
-                           // Para escrituras: buffer a leer
-    uint32_t requester_id;
-    uint32_t request_id;    // ID único de la solicitud
-} disk_request_t;
-
-// Estructura de respuesta
-typedef struct {
-    disk_err_t result;
-    uint32_t request_id;
-    uint32_t sectors_processed;
-} disk_response_t;
-
-static uint32_t next_request_id = 1;
-static task_t* disk_io_task = NULL;
+// ========================================================================
+// ESTADO
+// ========================================================================
+
+typedef struct disk_io_queue {
+    bool used;
+    uint8_t drive_number;
+    disk_io_request_t* sorted;          // Pendientes por sector creciente
+    disk_io_request_t* fifo_head[2];    // Pendientes por llegada (por op)
+    disk_io_request_t* fifo_tail[2];
+    uint64_t head_pos;                  // Sector tras el último comando
+    uint32_t max_merge;                 // Sectores por comando (disk_io_merge_limit)
+    uint32_t pending;
+    bool busy;                          // Comando en curso
+    // Estadísticas
+    uint32_t submitted;
+    uint32_t dispatched;                // Comandos enviados al disco
+    uint32_t merged;                    // Peticiones unidas a otra
+    uint32_t expired;                   // Elegidas por plazo vencido
+    uint32_t max_depth;
+    uint64_t sectors;
+} disk_io_queue_t;
+
+// Orden de locks: io_lock -> scheduler_lock (lo toma la wait queue)
+static spinlock_t io_lock = SPINLOCK_INIT("disk_io");
+static wait_queue_t io_wq = WAIT_QUEUE_INIT("disk_io");        // Tarea disk_io
+static wait_queue_t io_done_wq = WAIT_QUEUE_INIT("disk_io_done"); // Esperas síncronas
+static disk_io_queue_t io_queues[DISK_IO_MAX_QUEUES];
+static uint32_t io_next_queue = 0;  // Turno entre discos
+static task_t* io_task = NULL;
+static uint32_t bounce_fallbacks = 0;
 
 // ========================================================================
-// FUNCIONES INTERNAS DEL DAEMON
+// COLAS (requieren io_lock)
 // ========================================================================
 
-static void process_read_request(disk_request_t* req) {
-    if (!req || !req->disk || !req->buffer) {
-        log_message(LOG_ERROR, "[DISK_IO] Invalid read request parameters\r\n");
-        return;
-    }
-    
-    log_message(LOG_INFO, 
-        "[DISK_IO] → Reading: LBA %llu, count %u, buffer 0x%08x, requester %u\r\n",
-        req->lba, req->sector_count, (uint32_t)req->buffer, req->requester_id);
-    
-    // Verificar tipo de disco
-    disk_err_t err;
-    if (disk_is_atapi(req->disk)) {
-        log_message(LOG_INFO, "[DISK_IO] Device type: ATAPI\r\n");
-        err = disk_read_dispatch(req->disk, req->lba, req->sector_count, req->buffer);
-    } else if (req->disk->type == DEVICE_TYPE_SATA_DISK) {
-        log_message(LOG_INFO, "[DISK_IO] Device type: SATA\r\n");
-        err = disk_read_dispatch(req->disk, req->lba, req->sector_count, req->buffer);
-    } else {
-        log_message(LOG_INFO, "[DISK_IO] Device type: IDE\r\n");
-        err = disk_read_dispatch(req->disk, req->lba, req->sector_count, req->buffer);
+static disk_io_queue_t* disk_io_queue_get(uint8_t drive_number, bool create) {
+    disk_io_queue_t* free_queue = NULL;
+    for (int i = 0; i < DISK_IO_MAX_QUEUES; i++) {
+        if (io_queues[i].used && io_queues[i].drive_number == drive_number)
+            return &io_queues[i];
+        if (!io_queues[i].used && !free_queue)
+            free_queue = &io_queues[i];
     }
-    
-    log_message(LOG_INFO, "[DISK_IO] ← Read result: %d\r\n", err);
-    
-    // Preparar respuesta
-    disk_response_t response = {
-        .result = err,
-        .request_id = req->request_id,
-        .sectors_processed = (err == DISK_ERR_NONE) ? req->sector_count : 0
-    };
-    
-    log_message(LOG_INFO, 
-        "[DISK_IO] Sending response to task %u (req_id: %u)\r\n",
-        req->requester_id, req->request_id);
-    
-    // Enviar respuesta al solicitante
-    if (!message_send(req->requester_id, MSG_DISK_RESPONSE, &response, sizeof(response))) {
-        log_message(LOG_ERROR, 
-            "[DISK_IO] Failed to send response to task %u\r\n", req->requester_id);
-    } else {
-        log_message(LOG_INFO, "[DISK_IO] Response sent successfully\r\n");
+    if (!create || !free_queue)
+        return NULL;
+
+    memset(free_queue, 0, sizeof(*free_queue));
+    free_queue->used = true;
+    free_queue->drive_number = drive_number;
+    return free_queue;
+}
+
+static void disk_io_enqueue(disk_io_queue_t* q, disk_io_request_t* req) {
+    // Por sector; a igual sector, por llegada
+    disk_io_request_t* prev = NULL;
+    disk_io_request_t* next = q->sorted;
+    while (next && next->sector <= req->sector) {
+        prev = next;
+        next = next->sort_next;
     }
+    req->sort_prev = prev;
+    req->sort_next = next;
+    if (prev)
+        prev->sort_next = req;
+    else
+        q->sorted = req;
+    if (next)
+        next->sort_prev = req;
+
+    req->fifo_prev = q->fifo_tail[req->op];
+    req->fifo_next = NULL;
+    if (q->fifo_tail[req->op])
+        q->fifo_tail[req->op]->fifo_next = req;
+    else
+        q->fifo_head[req->op] = req;
+    q->fifo_tail[req->op] = req;
+
+    q->pending++;
+    q->submitted++;
+    if (q->pending > q->max_depth)
+        q->max_depth = q->pending;
 }
 
-static void process_write_request(disk_request_t* req) {
-    if (!req || !req->disk || !req->buffer) {
-        log_message(LOG_WARN, "[DISK_IO] Invalid write request\r\n");
-        return;
+static void disk_io_dequeue(disk_io_queue_t* q, disk_io_request_t* req) {
+    if (req->sort_prev)
+        req->sort_prev->sort_next = req->sort_next;
+    else
+        q->sorted = req->sort_next;
+    if (req->sort_next)
+        req->sort_next->sort_prev = req->sort_prev;
+
+    if (req->fifo_prev)
+        req->fifo_prev->fifo_next = req->fifo_next;
+    else
+        q->fifo_head[req->op] = req->fifo_next;
+    if (req->fifo_next)
+        req->fifo_next->fifo_prev = req->fifo_prev;
+    else
+        q->fifo_tail[req->op] = req->fifo_prev;
+
+    req->sort_prev = req->sort_next = NULL;
+    req->fifo_prev = req->fifo_next = NULL;
+    q->pending--;
+}
+
+// 'b' sigue a 'a' en el disco y pueden ir en el mismo comando
+static inline bool disk_io_can_merge(const disk_io_request_t* a,
+                                     const disk_io_request_t* b) {
+    return a->op == b->op && a->flags == b->flags &&
+           a->sector + a->count == b->sector;
+}
+
+// Saca de 'q' el siguiente comando: la petición elegida y las contiguas,
+// encadenadas por batch_next en orden de sector
+static disk_io_request_t* disk_io_pick(disk_io_queue_t* q) {
+    disk_io_request_t* req = NULL;
+
+    // Plazo vencido: primero lecturas (alguien suele estar esperándolas)
+    for (int op = DISK_IO_READ; op <= DISK_IO_WRITE && !req; op++) {
+        disk_io_request_t* oldest = q->fifo_head[op];
+        if (oldest && (int32_t)(ticks_since_boot - oldest->deadline) >= 0) {
+            req = oldest;
+            q->expired++;
+        }
     }
-    
-    // ATAPI devices son read-only
-    if (disk_is_atapi(req->disk)) {
-        log_message(LOG_WARN, "[DISK_IO] Write not supported on ATAPI device\r\n");
-        
-        disk_response_t response = {
-            .result = DISK_ERR_ATAPI,
-            .request_id = req->request_id,
-            .sectors_processed = 0
-        };
-        message_send(req->requester_id, MSG_DISK_RESPONSE, &response, sizeof(response));
-        return;
+
+    // Ascensor C-LOOK: la primera por delante del cabezal, o volver al
+    // principio
+    if (!req) {
+        req = q->sorted;
+        while (req && req->sector < q->head_pos)
+            req = req->sort_next;
+        if (!req)
+            req = q->sorted;
     }
-    
-    // Verificar tipo de disco
-    disk_err_t err;
-    if (req->disk->type == DEVICE_TYPE_SATA_DISK) {
-        log_message(LOG_INFO, 
-            "[DISK_IO] Writing %u sectors to SATA disk at LBA %llu\r\n",
-            req->sector_count, req->lba);
-        err = disk_write_dispatch(req->disk, req->lba, req->sector_count, req->buffer);
-    } else {
-        log_message(LOG_INFO, 
-            "[DISK_IO] Writing %u sectors to IDE disk at LBA %llu\r\n",
-            req->sector_count, req->lba);
-        err = disk_write_dispatch(req->disk, req->lba, req->sector_count, req->buffer);
+
+    disk_io_request_t* first = req;
+    disk_io_request_t* last = req;
+    uint32_t total = req->count;
+    while (first->sort_prev && disk_io_can_merge(first->sort_prev, first) &&
+           total + first->sort_prev->count <= q->max_merge) {
+        first = first->sort_prev;
+        total += first->count;
     }
-    
-    // Preparar respuesta
-    disk_response_t response = {
-        .result = err,
-        .request_id = req->request_id,
-        .sectors_processed = (err == DISK_ERR_NONE) ? req->sector_count : 0
-    };
-    
-    // Enviar respuesta
-    if (!message_send(req->requester_id, MSG_DISK_RESPONSE, &response, sizeof(response))) {
-        log_message(LOG_ERROR, 
-            "[DISK_IO] Failed to send response to task %u\r\n", req->requester_id);
+    while (last->sort_next && disk_io_can_merge(last, last->sort_next) &&
+           total + last->sort_next->count <= q->max_merge) {
+        last = last->sort_next;
+        total += last->count;
+    }
+
+    uint32_t n = 0;
+    disk_io_request_t* r = first;
+    while (1) {
+        disk_io_request_t* next = r->sort_next;
+        disk_io_dequeue(q, r);
+        r->batch_next = (r == last) ? NULL : next;
+        n++;
+        if (r == last)
+            break;
+        r = next;
+    }
+
+    q->head_pos = first->sector + total;
+    q->dispatched++;
+    q->merged += n - 1;
+    q->sectors += total;
+    return first;
+}
+
+// ========================================================================
+// EJECUCIÓN (tarea disk_io, sin io_lock)
+// ========================================================================
+
+static disk_err_t disk_io_execute(disk_io_request_t* req, uint32_t count,
+                                  void* buffer) {
+    if (req->flags & DISK_IO_NOCACHE) {
+        return req->op == DISK_IO_READ
+                   ? bcache_device_read(req->disk, req->sector, count, buffer)
+                   : bcache_device_write(req->disk, req->sector, count, buffer);
     }
+    // Límites y offset de partición ya aplicados al encolar
+    return req->op == DISK_IO_READ
+               ? bcache_read(req->disk, req->sector, count, buffer)
+               : bcache_write(req->disk, req->sector, count, buffer);
 }
 
-static void process_flush_request(disk_request_t* req) {
-    if (!req || !req->disk) {
-        log_message(LOG_WARN, "[DISK_IO] Invalid flush request\r\n");
+// Un comando para todo el lote. Si los buffers no son consecutivos en
+// memoria se usa uno intermedio.
+static void disk_io_run_batch(disk_io_request_t* batch) {
+    uint32_t total = 0;
+    bool contiguous = true;
+    for (disk_io_request_t* r = batch; r; r = r->batch_next) {
+        if (r != batch && (uint8_t*)r->buffer != (uint8_t*)batch->buffer +
+                                                      total * SECTOR_SIZE)
+            contiguous = false;
+        total += r->count;
+    }
+
+    if (contiguous) {
+        disk_err_t err = disk_io_execute(batch, total, batch->buffer);
+        for (disk_io_request_t* r = batch; r; r = r->batch_next)
+            r->result = err;
         return;
     }
-    
-    log_message(LOG_INFO, 
-        "[DISK_IO] Flushing disk cache (drive 0x%02x)\r\n", req->disk->drive_number);
-    
-    disk_err_t err = disk_flush_dispatch(req->disk);
-    
-    disk_response_t response = {
-        .result = err,
-        .request_id = req->request_id,
-        .sectors_processed = 0
-    };
-    
-    if (!message_send(req->requester_id, MSG_DISK_RESPONSE, &response, sizeof(response))) {
-        log_message(LOG_ERROR, 
-            "[DISK_IO] Failed to send flush response to task %u\r\n", req->requester_id);
+
+    uint8_t* bounce = (uint8_t*)kernel_malloc((size_t)total * SECTOR_SIZE);
+    if (!bounce) {
+        // Sin memoria: un comando por petición
+        bounce_fallbacks++;
+        for (disk_io_request_t* r = batch; r; r = r->batch_next)
+            r->result = disk_io_execute(r, r->count, r->buffer);
+        return;
+    }
+
+    uint32_t pos = 0;
+    if (batch->op == DISK_IO_WRITE) {
+        for (disk_io_request_t* r = batch; r; r = r->batch_next) {
+            memcpy(bounce + pos, r->buffer, r->count * SECTOR_SIZE);
+            pos += r->count * SECTOR_SIZE;
+        }
     }
+
+    disk_err_t err = disk_io_execute(batch, total, bounce);
+
+    pos = 0;
+    for (disk_io_request_t* r = batch; r; r = r->batch_next) {
+        if (batch->op == DISK_IO_READ && err == DISK_ERR_NONE)
+            memcpy(r->buffer, bounce + pos, r->count * SECTOR_SIZE);
+        pos += r->count * SECTOR_SIZE;
+        r->result = err;
+    }
+    kernel_free(bounce);
 }
 
-// ========================================================================
-// FUNCIÓN PRINCIPAL DEL DAEMON
-// ========================================================================
+// 'done' puede liberar la petición: no se toca después
+static void disk_io_complete(disk_io_request_t* batch) {
+    while (batch) {
+        disk_io_request_t* next = batch->batch_next;
+        batch->done(batch);
+        batch = next;
+    }
+}
 
-void disk_io_daemon(void* arg) {
+static void disk_io_task_main(void* arg) {
     (void)arg;
-    message_t msg;
-    uint32_t requests_processed = 0;
-    uint32_t last_activity = ticks_since_boot;
-    
-    log_message(LOG_INFO, "[DISK_IO] Daemon started (task ID: %u)\n", 
-                   task_current()->task_id);
-    
-    // ✅ FIX: Asegurar que estamos en estado READY
-    task_current()->state = TASK_READY;
-    
     while (1) {
-        // ✅ FIX: Usar receive NO BLOQUEANTE con yield
-        if (message_receive(&msg, false)) {
-            disk_request_t* req = (disk_request_t*)msg.data;
-            last_activity = ticks_since_boot;
-            
-            switch (msg.type) {
-                case MSG_DISK_READ_REQUEST:
-                    process_read_request(req);
-                    requests_processed++;
-                    break;
-                    
-                case MSG_DISK_WRITE_REQUEST:
-                    process_write_request(req);
-                    requests_processed++;
+        uint32_t flags = spin_lock_irqsave(&io_lock);
+        disk_io_queue_t* q = NULL;
+        while (!q) {
+            for (uint32_t i = 0; i < DISK_IO_MAX_QUEUES; i++) {
+                disk_io_queue_t* candidate =
+                    &io_queues[(io_next_queue + i) % DISK_IO_MAX_QUEUES];
+                if (candidate->used && candidate->pending) {
+                    q = candidate;
+                    io_next_queue = (uint32_t)(candidate - io_queues) + 1;
                     break;
-                    
-                case MSG_DISK_FLUSH_REQUEST:
-                    process_flush_request(req);
-                    requests_processed++;
-                    break;
-                    
-                default:
-                    log_message(LOG_INFO, 
-                        "[DISK_IO] Unknown message type: %u\n", msg.type);
-                    break;
-            }
-            
-            // Debug cada 10 requests
-            if (requests_processed % 10 == 0) {
-                log_message(LOG_INFO, 
-                    "[DISK_IO] Processed %u requests\n", requests_processed);
+                }
             }
-        } else {
-            // ✅ FIX: Si no hay mensajes, sleep corto en lugar de busy-wait
-            task_sleep(1);
-        }
-        
-        // ✅ FIX: Yield después de cada iteración
-        task_yield();
-        
-        // ✅ FIX: Verificar timeout de inactividad (prevenir deadlocks)
-        if (ticks_since_boot - last_activity > 1000) { // 10 segundos
-            log_message(LOG_INFO, 
-                "[DISK_IO] Activity timeout, resetting state\n");
-            last_activity = ticks_since_boot;
-            
-            // Forzar estado READY por si acaso
-            task_current()->state = TASK_READY;
+            if (!q)
+                wait_queue_sleep(&io_wq, &io_lock, 0);
         }
+        disk_io_request_t* batch = disk_io_pick(q);
+        q->busy = true;
+        spin_unlock_irqrestore(&io_lock, flags);
+
+        disk_io_run_batch(batch);
+        disk_io_complete(batch);
+
+        flags = spin_lock_irqsave(&io_lock);
+        q->busy = false;
+        wait_queue_wake_all(&io_done_wq);
+        spin_unlock_irqrestore(&io_lock, flags);
     }
 }
 
 // ========================================================================
-// API PÚBLICA PARA OTRAS TAREAS
+// ENVÍO
 // ========================================================================
 
-disk_err_t async_disk_read(disk_t* disk, uint64_t lba, uint32_t count, void* buffer) {
-    // ✅ CRÍTICO: Verificar que estamos en una tarea con cola de mensajes
+bool disk_io_running(void) { return io_task != NULL; }
+
+// Lo que el dispositivo hace en un comando, sin pasar del tope de la cola
+// y en bloques nativos enteros: unir más solo haría que el driver lo
+// partiera en un comando extra de pocos sectores
+static uint32_t disk_io_merge_limit(const block_queue_limits_t* limits) {
+    uint32_t max = limits->max_transfer_sectors;
+    if (max > DISK_IO_MAX_MERGE_SECTORS)
+        max = DISK_IO_MAX_MERGE_SECTORS;
+    uint32_t native = limits->physical_block_size / SECTOR_SIZE;
+    if (native > 1 && max > native)
+        max -= max % native;
+    return max;
+}
+
+bool disk_io_can_wait(void) {
     task_t* current = task_current();
-    if (!current) {
-        log_message(LOG_WARN, "[DISK_IO] No current task, using sync I/O\r\n");
-        return disk_read_dispatch(disk, lba, count, buffer);
-    }
-    
-    if (!disk_io_task) {
-        log_message(LOG_WARN, "[DISK_IO] Daemon not running, using synchronous I/O\r\n");
-        return disk_read_dispatch(disk, lba, count, buffer);
-    }
-    
-    // Verificar que el daemon esté vivo
-    if (disk_io_task->state == TASK_FINISHED || disk_io_task->state == TASK_ZOMBIE) {
-        log_message(LOG_WARN, "[DISK_IO] Daemon dead, using synchronous I/O\r\n");
-        return disk_read_dispatch(disk, lba, count, buffer);
-    }
-    
-    // ✅ Verificar que nuestra tarea tenga cola de mensajes
-    message_queue_t* my_queue = message_queue_get(current->task_id);
-    if (!my_queue) {
-        log_message(LOG_INFO, "[DISK_IO] Task %s has no message queue, creating one...\r\n", 
-                       current->name);
-        my_queue = message_queue_create(current->task_id);
-        if (!my_queue) {
-            log_message(LOG_ERROR, "[DISK_IO] Failed to create queue, using sync I/O\r\n");
-            return disk_read_dispatch(disk, lba, count, buffer);
+    return io_task && current && current != io_task;
+}
+
+disk_err_t disk_io_submit(disk_io_request_t* req) {
+    if (!req || !req->disk || !req->buffer || !req->count || !req->done)
+        return DISK_ERR_INVALID_PARAM;
+    if (!req->disk->initialized)
+        return DISK_ERR_NOT_INITIALIZED;
+    const block_queue_limits_t* limits = disk_get_limits(req->disk);
+    if (req->op == DISK_IO_WRITE && limits->read_only)
+        return DISK_ERR_ATAPI;
+    uint32_t max_merge = disk_io_merge_limit(limits);
+
+    req->sector = req->lba;
+    if (!(req->flags & DISK_IO_NOCACHE) && req->disk->is_partition) {
+        if (req->lba + req->count > req->disk->sector_count) {
+            terminal_printf(&main_terminal,
+                "DISK_IO: Request beyond partition bounds (LBA %llu + %u > %llu)\r\n",
+                req->lba, req->count, req->disk->sector_count);
+            return DISK_ERR_LBA_OUT_OF_RANGE;
         }
+        req->sector += req->disk->partition_lba_offset;
     }
-    
-    // Crear solicitud
-    disk_request_t req = {
-        .disk = disk,
-        .lba = lba,
-        .sector_count = count,
-        .buffer = buffer,
-        .requester_id = current->task_id,
-        .request_id = next_request_id++
-    };
-    
-    log_message(LOG_INFO, "[DISK_IO] Task %s (ID:%u) sending read request %u to disk_io (ID:%u)\r\n", 
-                   current->name, current->task_id, req.request_id, disk_io_task->task_id);
-    
-    // Enviar solicitud
-    if (!message_send(disk_io_task->task_id, MSG_DISK_READ_REQUEST, &req, sizeof(req))) {
-        log_message(LOG_ERROR, "[DISK_IO] Failed to send read request\r\n");
-        return DISK_ERR_ATA;
-    }
-    
-    log_message(LOG_INFO, "[DISK_IO] Request sent, waiting for response...\r\n");
-    
-    // ✅ Esperar respuesta con timeout
-    uint32_t start_tick = ticks_since_boot;
-    uint32_t timeout_ticks = 100; // 5 segundos a 100Hz
-    uint32_t attempts = 0;
-    
-    while ((ticks_since_boot - start_tick) < timeout_ticks) {
-        attempts++;
-        
-        task_yield();
-        
-        // Intentar recibir mensaje (NON-blocking)
-        message_t response_msg;
-        if (message_receive(&response_msg, false)) {
-            log_message(LOG_INFO, "[DISK_IO] Received message type %u\r\n", response_msg.type);
-            
-            if (response_msg.type == MSG_DISK_RESPONSE) {
-                disk_response_t* response = (disk_response_t*)response_msg.data;
-                log_message(LOG_INFO, "[DISK_IO] Response: req_id=%u (expected %u), result=%d\r\n",
-                               response->request_id, req.request_id, response->result);
-                
-                if (response->request_id == req.request_id) {
-                    log_message(LOG_INFO, "[DISK_IO] ✓ Got correct response after %u attempts\r\n", 
-                                   attempts);
-                    return response->result;
-                } else {
-                    log_message(LOG_ERROR, "[DISK_IO] ✗ Wrong request_id, continuing wait...\r\n");
-                }
-            } else {
-                log_message(LOG_ERROR, "[DISK_IO] ✗ Wrong message type, continuing wait...\r\n");
-            }
-        }
-        
-        // Debug periódico
-        if (attempts % 100 == 0) {
-            log_message(LOG_INFO, "[DISK_IO] Still waiting... (attempt %u, elapsed %u ticks, daemon state: %d)\r\n",
-                           attempts, ticks_since_boot - start_tick, disk_io_task->state);
-            
-            // Verificar estado de la cola del daemon
-            message_queue_t* daemon_queue = message_queue_get(disk_io_task->task_id);
-            if (daemon_queue) {
-                log_message(LOG_INFO, "[DISK_IO]   Daemon queue: %u pending messages\r\n", 
-                               daemon_queue->message_count);
-            }
-            
-            // Verificar nuestra cola
-            log_message(LOG_INFO, "[DISK_IO]   Our queue: %u pending messages\r\n", 
-                           my_queue->message_count);
+    req->deadline = ticks_since_boot + (req->op == DISK_IO_READ
+                                            ? DISK_IO_READ_DEADLINE_TICKS
+                                            : DISK_IO_WRITE_DEADLINE_TICKS);
+    req->result = DISK_ERR_NONE;
+    req->completed = false;
+    req->batch_next = NULL;
+
+    disk_io_queue_t* q = NULL;
+    uint32_t flags = spin_lock_irqsave(&io_lock);
+    if (io_task) {
+        q = disk_io_queue_get(req->disk->drive_number, true);
+        if (q) {
+            q->max_merge = max_merge;
+            disk_io_enqueue(q, req);
+            wait_queue_wake_one(&io_wq);
         }
-        
-        // Sleep corto
-        task_sleep(1);
     }
-    
-    log_message(LOG_ERROR, "[DISK_IO] ✗ Timeout after %u attempts (%u ticks)\r\n", 
-                   attempts, ticks_since_boot - start_tick);
-    return DISK_ERR_TIMEOUT;
+    spin_unlock_irqrestore(&io_lock, flags);
+
+    // Sin tarea o sin colas libres: en el momento, con el mismo contrato
+    if (!q) {
+        req->result = disk_io_execute(req, req->count, req->buffer);
+        req->done(req);
+    }
+    return DISK_ERR_NONE;
 }
 
-disk_err_t async_disk_write(disk_t* disk, uint64_t lba, uint32_t count, const void* buffer) {
-    // ✅ FIX: Verificaciones más robustas
-    if (!disk_io_task) {
-        log_message(LOG_WARN, "[DISK_IO] Daemon not running, using synchronous I/O\n");
-        return disk_write_dispatch(disk, lba, count, buffer);
+static void disk_io_sync_done(disk_io_request_t* req) {
+    req->completed = true;
+}
+
+// Encola y duerme hasta que la petición termina
+static disk_err_t disk_io_submit_and_wait(disk_io_op_t op, disk_t* disk,
+                                          uint64_t lba, uint32_t count,
+                                          void* buffer) {
+    disk_io_request_t req;
+    memset(&req, 0, sizeof(req));
+    req.op = op;
+    req.disk = disk;
+    req.lba = lba;
+    req.count = count;
+    req.buffer = buffer;
+    req.done = disk_io_sync_done;
+
+    disk_err_t err = disk_io_submit(&req);
+    if (err != DISK_ERR_NONE)
+        return err;
+
+    uint32_t flags = spin_lock_irqsave(&io_lock);
+    while (!req.completed)
+        wait_queue_sleep(&io_done_wq, &io_lock, 0);
+    spin_unlock_irqrestore(&io_lock, flags);
+    return req.result;
+}
+
+// ========================================================================
+// API PÚBLICA PARA OTRAS TAREAS
+// ========================================================================
+
+disk_err_t async_disk_read(disk_t* disk, uint64_t lba, uint32_t count, void* buffer) {
+    if (!disk_io_can_wait()) {
+        return disk_read_dispatch(disk, lba, count, buffer);
     }
-    
-    // Verificar que el daemon esté vivo y en estado válido
-    if (disk_io_task->state == TASK_FINISHED || disk_io_task->state == TASK_ZOMBIE) {
-        log_message(LOG_WARN, "[DISK_IO] Daemon dead, using synchronous I/O\n");
-        return disk_write_dispatch(disk, lba, count, buffer);
+    return disk_io_submit_and_wait(DISK_IO_READ, disk, lba, count, buffer);
+}
+
+disk_err_t async_disk_read_owned(disk_t* disk, uint64_t lba, uint32_t count,
+                                 void** out_buffer) {
+    if (!out_buffer || !disk) return DISK_ERR_INVALID_PARAM;
+    *out_buffer = NULL;
+    
+    uint32_t sector_size = disk_get_limits(disk)->logical_block_size;
+    void* buffer = kernel_malloc((size_t)count * sector_size);
+    if (!buffer) return DISK_ERR_INVALID_PARAM;
+    
+    disk_err_t err = async_disk_read(disk, lba, count, buffer);
+    if (err != DISK_ERR_NONE) {
+        kernel_free(buffer);
+        return err;
     }
-    
-    task_t* current = task_current();
-    if (!current) {
-        log_message(LOG_WARN, "[DISK_IO] No current task, using sync I/O\n");
+    *out_buffer = buffer;
+    return DISK_ERR_NONE;
+}
+
+disk_err_t async_disk_write(disk_t* disk, uint64_t lba, uint32_t count, const void* buffer) {
+    if (!disk_io_can_wait()) {
         return disk_write_dispatch(disk, lba, count, buffer);
     }
-    
-    // ✅ FIX: Asegurar que tenemos cola de mensajes
-    message_queue_t* my_queue = message_queue_get(current->task_id);
-    if (!my_queue) {
-        log_message(LOG_INFO, "[DISK_IO] Task %s has no message queue, creating one...\n", 
-                       current->name);
-        my_queue = message_queue_create(current->task_id);
-        if (!my_queue) {
-            log_message(LOG_WARN, "[DISK_IO] Failed to create queue, using sync I/O\n");
-            return disk_write_dispatch(disk, lba, count, buffer);
-        }
-    }
-    
-    // Crear solicitud
-    disk_request_t req = {
-        .disk = disk,
-        .lba = lba,
-        .sector_count = count,
-        .buffer = (void*)buffer,  // Cast away const
-        .requester_id = current->task_id,
-        .request_id = next_request_id++
-    };
-    
-    log_message(LOG_INFO, 
-        "[DISK_IO] Task %s sending write request %u to disk_io\n", 
-        current->name, req.request_id);
-    
-    // ✅ FIX: Verificar estado del daemon antes de enviar
-    log_message(LOG_INFO, "[DISK_IO] Daemon state: %d\n", disk_io_task->state);
-    
-    // Enviar solicitud
-    if (!message_send(disk_io_task->task_id, MSG_DISK_WRITE_REQUEST, &req, sizeof(req))) {
-        log_message(LOG_ERROR, "[DISK_IO] Failed to send write request\n");
-        return DISK_ERR_ATA;
-    }
-    
-    log_message(LOG_INFO, "[DISK_IO] Write request sent, waiting for response...\n");
-    
-    // ✅ FIX: Esperar respuesta con mejor manejo de timeouts
-    uint32_t start_tick = ticks_since_boot;
-    uint32_t timeout_ticks = 1000; // 10 segundos a 100Hz
-    uint32_t attempts = 0;
-    
-    while ((ticks_since_boot - start_tick) < timeout_ticks) {
-        attempts++;
-        
-        // ✅ FIX: Yield periódicamente para permitir que el daemon se ejecute
-        if (attempts % 5 == 0) {
-            task_yield();
-        }
-        
-        // Intentar recibir mensaje (non-blocking)
-        message_t response_msg;
-        if (message_receive(&response_msg, false)) {
-            log_message(LOG_INFO, "[DISK_IO] Received message type %u\n", response_msg.type);
-            
-            if (response_msg.type == MSG_DISK_RESPONSE) {
-                disk_response_t* response = (disk_response_t*)response_msg.data;
-                log_message(LOG_INFO, 
-                    "[DISK_IO] Response: req_id=%u (expected %u), result=%d\n",
-                    response->request_id, req.request_id, response->result);
-                
-                if (response->request_id == req.request_id) {
-                    log_message(LOG_INFO, 
-                        "[DISK_IO] ✓ Got correct write response after %u attempts\n", 
-                        attempts);
-                    return response->result;
-                } else {
-                    log_message(LOG_ERROR, 
-                        "[DISK_IO] ✗ Wrong request_id (got %u, expected %u), continuing...\n",
-                        response->request_id, req.request_id);
-                    // ✅ Re-enqueue el mensaje para el destinatario correcto
-                    message_send(response_msg.sender_id, response_msg.type, 
-                                response_msg.data, response_msg.size);
-                }
-            } else {
-                log_message(LOG_ERROR, 
-                    "[DISK_IO] ✗ Wrong message type %u, re-queueing...\n", response_msg.type);
-                // Re-enqueue mensajes que no son para nosotros
-                message_send(response_msg.sender_id, response_msg.type, 
-                            response_msg.data, response_msg.size);
-            }
-        }
-        
-        // ✅ FIX: Debug más informativo
-        if (attempts % 50 == 0) {
-            uint32_t elapsed = ticks_since_boot - start_tick;
-            log_message(LOG_INFO,
-                "[DISK_IO] Still waiting for write response... (attempt %u, elapsed %u ticks)\n",
-                attempts, elapsed);
-            log_message(LOG_INFO, 
-                "[DISK_IO]   Daemon state: %d, Our queue: %u messages\n",
-                disk_io_task->state, my_queue->message_count);
-            
-            // Verificar cola del daemon
-            message_queue_t* daemon_queue = message_queue_get(disk_io_task->task_id);
-            if (daemon_queue) {
-                log_message(LOG_INFO, 
-                    "[DISK_IO]   Daemon queue: %u pending messages\n", 
-                    daemon_queue->message_count);
-            }
-        }
-        
-        // Sleep corto
-        task_sleep(10);
-    }
-    
-    log_message(LOG_ERROR, 
-        "[DISK_IO] ✗ Write timeout after %u attempts (%u ticks)\n", 
-        attempts, ticks_since_boot - start_tick);
-    return DISK_ERR_TIMEOUT;
+    return disk_io_submit_and_wait(DISK_IO_WRITE, disk, lba, count, (void*)buffer);
 }
 
 disk_err_t async_disk_flush(disk_t* disk) {
-    if (!disk_io_task) {
-        return disk_flush_dispatch(disk);
-    }
-    
-    disk_request_t req = {
-        .disk = disk,
-        .lba = 0,
-        .sector_count = 0,
-        .buffer = NULL,
-        .requester_id = task_current()->task_id,
-        .request_id = next_request_id++
-    };
-    
-    if (!message_send(disk_io_task->task_id, MSG_DISK_FLUSH_REQUEST, &req, sizeof(req))) {
-        log_message(LOG_ERROR, "[DISK_IO] Failed to send flush request\r\n");
-        return DISK_ERR_ATA;
+    if (!disk) return DISK_ERR_INVALID_PARAM;
+    
+    if (disk_io_can_wait()) {
+        // Lo ya encolado para este disco va antes que el flush
+        uint32_t flags = spin_lock_irqsave(&io_lock);
+        disk_io_queue_t* q = disk_io_queue_get(disk->drive_number, false);
+        while (q && (q->pending || q->busy))
+            wait_queue_sleep(&io_done_wq, &io_lock, 0);
+        spin_unlock_irqrestore(&io_lock, flags);
     }
-    
-    message_t response_msg;
-    uint32_t timeout = ticks_since_boot + 200;
-    
-    while (ticks_since_boot < timeout) {
-        if (message_receive(&response_msg, false)) {
-            if (response_msg.type == MSG_DISK_RESPONSE) {
-                disk_response_t* response = (disk_response_t*)response_msg.data;
-                if (response->request_id == req.request_id) {
-                    return response->result;
-                }
-            }
-        }
-        task_sleep(10);
-    }
-    
-    return DISK_ERR_TIMEOUT;
+    return disk_flush_dispatch(disk);
 }
 
 void disk_io_daemon_init(void) {
-    disk_io_task = task_create("disk_io", disk_io_daemon, NULL, TASK_PRIORITY_NORMAL);
+    if (io_task) return;
     
-    if (disk_io_task) {
-        log_message(LOG_INFO, 
-            "[DISK_IO] Daemon initialized (task ID: %u)\r\n", disk_io_task->task_id);
+    io_task = task_create("disk_io", disk_io_task_main, NULL, TASK_PRIORITY_NORMAL);
+    if (io_task) {
+        log_message(LOG_INFO, "[DISK_IO] Request queue running\r\n");
     } else {
-        log_message(LOG_ERROR, "[DISK_IO] Failed to create daemon task\r\n");
+        log_message(LOG_ERROR, "[DISK_IO] Failed to create task, async I/O is synchronous\r\n");
+    }
+}
+
+void disk_io_print_stats(void) {
+    terminal_puts(&main_terminal, "\r\n=== Disk request queues ===\r\n");
+    if (!io_task) {
+        terminal_puts(&main_terminal, "disk_io not running: requests are synchronous\r\n");
+        return;
+    }
+    
+    disk_io_queue_t snapshot[DISK_IO_MAX_QUEUES];
+    uint32_t flags = spin_lock_irqsave(&io_lock);
+    memcpy(snapshot, io_queues, sizeof(snapshot));
+    spin_unlock_irqrestore(&io_lock, flags);
+    
+    bool any = false;
+    for (int i = 0; i < DISK_IO_MAX_QUEUES; i++) {
+        disk_io_queue_t* q = &snapshot[i];
+        if (!q->used) continue;
+        any = true;
+        terminal_printf(&main_terminal,
+            "drive 0x%02x: %u requests -> %u commands (%u merged), %llu sectors\r\n"
+            "            pending %u, max depth %u, deadline picks %u, "
+            "up to %u sectors per command\r\n",
+            q->drive_number, q->submitted, q->dispatched, q->merged, q->sectors,
+            q->pending, q->max_depth, q->expired, q->max_merge);
     }
+    if (!any)
+        terminal_puts(&main_terminal, "No requests yet\r\n");
+    if (bounce_fallbacks)
+        terminal_printf(&main_terminal, "Unmerged for lack of memory: %u\r\n",
+                        bounce_fallbacks);
 }
 
 void cmd_async_read_test(void) {
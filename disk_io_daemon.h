@@ -7,17 +7,88 @@
 
 #include "disk.h"
 
-// Inicializar el daemon
+// ========================================================================
+// COLA DE PETICIONES DE BLOQUE
+// ========================================================================
+//
+// Cada disco físico tiene su cola. La tarea "disk_io" las atiende por
+// turnos: en cada cola elige la siguiente petición con un ascensor (C-LOOK,
+// por LBA físico creciente desde la última posición) salvo que la lectura
+// o escritura más antigua haya vencido su plazo, y antes de ejecutarla le
+// une las peticiones contiguas del mismo tipo hasta lo que el dispositivo
+// hace en un comando (sus límites en disk.h), con DISK_IO_MAX_MERGE_SECTORS
+// como tope.
+// Al terminar se llama al callback de cada petición desde la tarea disk_io.
+
+#define DISK_IO_MAX_QUEUES 16
+#define DISK_IO_MAX_MERGE_SECTORS 1024 // 512 KiB por comando como mucho
+#define DISK_IO_READ_DEADLINE_TICKS 50   // 500 ms
+#define DISK_IO_WRITE_DEADLINE_TICKS 500 // 5 s
+
+typedef enum { DISK_IO_READ = 0, DISK_IO_WRITE } disk_io_op_t;
+
+// Sin pasar por el buffer cache: 'lba' es físico y se escribe directo al
+// dispositivo (lo usa el volcador de la caché)
+#define DISK_IO_NOCACHE 0x01
+
+struct disk_io_request;
+typedef void (*disk_io_done_t)(struct disk_io_request *req);
+
+typedef struct disk_io_request {
+  // Los rellena quien envía. 'disk' y 'buffer' deben seguir válidos hasta
+  // que se llame a 'done'.
+  disk_io_op_t op;
+  uint32_t flags; // DISK_IO_*
+  disk_t *disk;
+  uint64_t lba; // Relativo a la partición (salvo DISK_IO_NOCACHE)
+  uint32_t count;
+  void *buffer;
+  disk_io_done_t done;
+  void *private;
+
+  // Resultado, válido en 'done'
+  disk_err_t result;
+
+  // Internos de la cola
+  uint64_t sector; // LBA físico
+  uint32_t deadline;
+  volatile bool completed;
+  struct disk_io_request *sort_prev, *sort_next; // Por sector
+  struct disk_io_request *fifo_prev, *fifo_next; // Por llegada y tipo
+  struct disk_io_request *batch_next;            // Unidas en un comando
+} disk_io_request_t;
+
+// Crea la tarea disk_io (requiere el planificador). Antes de llamarla, y si
+// falla, la API asíncrona hace la E/S en el momento.
 void disk_io_daemon_init(void);
+bool disk_io_running(void);
+
+// Encola la petición y vuelve sin esperar. Si los parámetros no son
+// válidos devuelve el error y no se llama a 'done'.
+disk_err_t disk_io_submit(disk_io_request_t *req);
+
+// true si el llamador puede dormir esperando a la cola (no es la propia
+// tarea disk_io ni se está arrancando)
+bool disk_io_can_wait(void);
 
-// Función principal del daemon (no llamar directamente)
-void disk_io_daemon(void* arg);
+void disk_io_print_stats(void);
+
+// ========================================================================
+// API SÍNCRONA SOBRE LA COLA
+// ========================================================================
 
 // API pública para I/O asíncrono
 disk_err_t async_disk_read(disk_t* disk, uint64_t lba, uint32_t count, void* buffer);
 disk_err_t async_disk_write(disk_t* disk, uint64_t lba, uint32_t count, const void* buffer);
+// Espera a que terminen las peticiones ya encoladas para el disco y vacía
+// su caché de escritura
 disk_err_t async_disk_flush(disk_t* disk);
 
+// Lectura sin copia: el daemon reserva el buffer (kernel_malloc) y transfiere
+// su propiedad; el llamador debe liberarlo con kernel_free
+disk_err_t async_disk_read_owned(disk_t* disk, uint64_t lba, uint32_t count,
+                                 void** out_buffer);
+
 void cmd_async_read_test(void);
 void cmd_async_write_test(void);
 
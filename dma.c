@@ -380,6 +380,56 @@ void dma_free_prdt(dma_prdt_entry_t* prdt) {
     }
 }
 
+// ========================================================================
+// GESTIÓN DE PRDT PARA BUS-MASTER IDE
+// ========================================================================
+
+uint32_t dma_fill_ide_prdt(dma_ide_prd_t* prdt, uint32_t max_entries,
+                           const void* buffer, uint32_t size) {
+    uint32_t virt = (uint32_t)buffer;
+    uint32_t done = 0;
+    uint32_t entries = 0;
+    uint32_t run_start = 0;
+    uint32_t run_bytes = 0;
+
+    while (done < size) {
+        uint32_t phys = mmu_virtual_to_physical(virt + done);
+        if (phys == 0) {
+            break;
+        }
+        // Un trozo de página nunca cruza un límite de 64 KiB
+        uint32_t chunk = 0x1000 - ((virt + done) & 0xFFF);
+        if (chunk > size - done) {
+            chunk = size - done;
+        }
+
+        if (entries && phys == run_start + run_bytes &&
+            (run_start >> 16) == ((phys + chunk - 1) >> 16)) {
+            run_bytes += chunk;
+        } else {
+            if (entries == max_entries) {
+                break;
+            }
+            entries++;
+            run_start = phys;
+            run_bytes = chunk;
+            if (prdt) {
+                prdt[entries - 1].physical_address = phys;
+                prdt[entries - 1].flags = 0;
+            }
+        }
+        if (prdt) {
+            prdt[entries - 1].byte_count = (uint16_t)run_bytes; // 64 KiB = 0
+        }
+        done += chunk;
+    }
+
+    if (prdt && entries) {
+        prdt[entries - 1].flags = DMA_IDE_PRD_EOT;
+    }
+    return done;
+}
+
 // ========================================================================
 // FUNCIONES AUXILIARES
 // ========================================================================
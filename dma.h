@@ -111,6 +111,17 @@ typedef struct __attribute__((packed)) {
     uint32_t interrupt_on_completion : 1; // Interrupt on completion
 } dma_prdt_entry_t;
 
+// PRD de bus-master IDE (SFF-8038i): 8 bytes, tabla alineada a 4 bytes y
+// sin cruzar un límite de 64 KiB. Ninguna región puede cruzar un límite de
+// 64 KiB; byte_count 0 significa 64 KiB.
+typedef struct __attribute__((packed)) {
+    uint32_t physical_address;
+    uint16_t byte_count;
+    uint16_t flags;                 // DMA_IDE_PRD_EOT en la última
+} dma_ide_prd_t;
+
+#define DMA_IDE_PRD_EOT 0x8000
+
 // DMA Descriptor for AHCI command
 typedef struct {
     uint8_t command_fis[64];        // Command FIS
@@ -139,6 +150,13 @@ bool dma_buffer_is_valid(dma_buffer_t* buffer);
 dma_prdt_entry_t* dma_create_prdt(void* data_buffer, uint32_t size, uint32_t max_entries);
 void dma_free_prdt(dma_prdt_entry_t* prdt);
 
+// Describe 'buffer' en la tabla PRD de bus-master IDE: une las páginas
+// físicamente contiguas y corta en los límites de 64 KiB. Devuelve los
+// bytes cubiertos, menos que 'size' si no caben en max_entries o hay una
+// página sin mapear. Con prdt == NULL solo cuenta.
+uint32_t dma_fill_ide_prdt(dma_ide_prd_t* prdt, uint32_t max_entries,
+                           const void* buffer, uint32_t size);
+
 // Utility functions
 uint32_t dma_virt_to_phys(void* virtual_addr);
 void* dma_phys_to_virt(uint32_t physical_addr);
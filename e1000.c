@@ -5,13 +5,24 @@
 #include "memory.h"
 #include "mmu.h"
 #include "pci.h"
+#include "network_daemon.h"
 #include "serial.h"
+#include "softirq.h"
+#include "spinlock.h"
 #include "string.h"
 #include "terminal.h"
 
 // Dispositivo E1000 global
 e1000_device_t e1000_device = {0};
 
+// Locks de los anillos de descriptores (TX y RX son independientes)
+static spinlock_t e1000_tx_lock = SPINLOCK_INIT("e1000_tx");
+static spinlock_t e1000_rx_lock = SPINLOCK_INIT("e1000_rx");
+
+// Causas de interrupción leídas por el top half y aún no atendidas
+static volatile uint32_t e1000_pending_icr = 0;
+static void e1000_softirq(void);
+
 // ===================================================
 // FUNCIONES DE ACCESO A REGISTROS
 // ===================================================
@@ -512,7 +523,8 @@ bool e1000_init(void) {
   ctrl &= ~E1000_CTRL_PHY_RST; // No PHY reset
   e1000_write_reg(E1000_REG_CTRL, ctrl);
 
-  // 9. Habilitar interrupciones
+  // 9. Habilitar interrupciones (el trabajo se hace en SOFTIRQ_NET)
+  open_softirq(SOFTIRQ_NET, e1000_softirq);
   e1000_enable_interrupts();
 
   // 10. Verificar link status
@@ -536,26 +548,25 @@ bool e1000_init(void) {
 // ===================================================
 
 bool e1000_send_packet(const uint8_t *data, uint32_t length) {
-  uint32_t flags;
-  __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
+  uint32_t flags = spin_lock_irqsave(&e1000_tx_lock);
 
   if (!e1000_device.initialized) {
     terminal_puts(&main_terminal, "[E1000] Device not initialized\r\n");
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    spin_unlock_irqrestore(&e1000_tx_lock, flags);
     return false;
   }
 
   if (length > E1000_MAX_PKT_SIZE || length == 0) {
     terminal_printf(&main_terminal, "[E1000] Invalid packet length: %u\r\n",
                     length);
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    spin_unlock_irqrestore(&e1000_tx_lock, flags);
     return false;
   }
 
   // Verificar si el link está up
   if (!e1000_is_link_up()) {
     terminal_puts(&main_terminal, "[E1000] Link is down, cannot send\r\n");
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    spin_unlock_irqrestore(&e1000_tx_lock, flags);
     return false;
   }
 
@@ -586,7 +597,7 @@ bool e1000_send_packet(const uint8_t *data, uint32_t length) {
     // Re-inicializar
     e1000_init_tx();
 
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    spin_unlock_irqrestore(&e1000_tx_lock, flags);
     return false;
   }
 
@@ -620,7 +631,7 @@ bool e1000_send_packet(const uint8_t *data, uint32_t length) {
   //                 "[E1000] Packet sent: %u bytes, next_idx=%u\r\n", length,
   //                 next_idx);
 
-  __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+  spin_unlock_irqrestore(&e1000_tx_lock, flags);
   return true;
 }
 
@@ -629,11 +640,10 @@ bool e1000_send_packet(const uint8_t *data, uint32_t length) {
 // ===================================================
 
 uint32_t e1000_receive_packet(uint8_t *buffer, uint32_t max_len) {
-  uint32_t flags;
-  __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
+  uint32_t flags = spin_lock_irqsave(&e1000_rx_lock);
 
   if (!e1000_device.initialized) {
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    spin_unlock_irqrestore(&e1000_rx_lock, flags);
     return 0;
   }
 
@@ -644,7 +654,7 @@ uint32_t e1000_receive_packet(uint8_t *buffer, uint32_t max_len) {
 
   // Verificar si hay paquete disponible (Check DD bit)
   if (!(desc->status & E1000_RXD_STAT_DD)) {
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    spin_unlock_irqrestore(&e1000_rx_lock, flags);
     return 0;
   }
 
@@ -664,7 +674,7 @@ uint32_t e1000_receive_packet(uint8_t *buffer, uint32_t max_len) {
     // use
     e1000_write_reg(E1000_REG_RDT, old_rx_idx);
 
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    spin_unlock_irqrestore(&e1000_rx_lock, flags);
     return 0;
   }
 
@@ -687,7 +697,7 @@ uint32_t e1000_receive_packet(uint8_t *buffer, uint32_t max_len) {
   // DEBUG: Packet received
   // terminal_printf(&main_terminal, "[E1000] RX packet: %u bytes\r\n", length);
 
-  __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+  spin_unlock_irqrestore(&e1000_rx_lock, flags);
   return length;
 }
 
@@ -713,6 +723,7 @@ bool e1000_is_link_up(void) {
   return e1000_device.link_up;
 }
 
+// Top half: leer y reconocer las causas, el resto en el bottom half
 void e1000_handle_interrupt(void) {
   // Leear interrupt cause
   uint32_t icr = e1000_read_reg(E1000_REG_ICR);
@@ -720,6 +731,20 @@ void e1000_handle_interrupt(void) {
   // Limpiar interrupciones
   e1000_write_reg(E1000_REG_ICR, icr);
 
+  if (!icr)
+    return;
+
+  e1000_pending_icr |= icr;
+  raise_softirq(SOFTIRQ_NET);
+  irq_exit();
+}
+
+static void e1000_softirq(void) {
+  uint32_t flags = local_irq_save();
+  uint32_t icr = e1000_pending_icr;
+  e1000_pending_icr = 0;
+  local_irq_restore(flags);
+
   if (icr & E1000_ICR_LSC) {
     // Cambio en link status
     e1000_is_link_up();
@@ -728,8 +753,9 @@ void e1000_handle_interrupt(void) {
   }
 
   if (icr & E1000_ICR_RXT0) {
-    // Timer de recepción
-    // Podemos usar esto para polling si no queremos interrupciones
+    // Hay paquetes: despertar el sondeo de la red en lugar de esperar al
+    // siguiente intervalo
+    network_daemon_kick();
   }
 
   if (icr & E1000_ICR_RXO) {
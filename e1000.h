@@ -168,7 +168,7 @@ bool e1000_send_packet(const uint8_t *data, uint32_t length);
 uint32_t e1000_receive_packet(uint8_t *buffer, uint32_t max_len);
 void e1000_get_mac(uint8_t *mac);
 bool e1000_is_link_up(void);
-void e1000_handle_interrupt(void);
+void e1000_handle_interrupt(void); // Top half (reconoce y programa SOFTIRQ_NET)
 void e1000_print_stats(void);
 void e1000_check_status(void);
 void e1000_reset_tx_ring(void);
@@ -5,6 +5,7 @@
 #include "rtc.h"
 #include "serial.h"
 #include "string.h"
+#include "task.h"
 #include "terminal.h"
 #include "vfs.h"
 
@@ -2391,6 +2392,65 @@ int fat32_create(vfs_node_t *parent, const char *name, vfs_node_t **out) {
   return VFS_OK;
 }
 
+// Lectura anticipada de un archivo: si las lecturas son secuenciales, pide
+// al disco los clústeres siguientes de la cadena, agrupando los contiguos,
+// así también se anticipa en archivos fragmentados. 'end' es el offset
+// donde terminó esta lectura y 'cluster' (índice 'index') el siguiente
+// clúster del archivo.
+static void fat32_readahead(fat32_fs_t *fs, fat32_node_t *node_data,
+                            uint32_t offset, uint32_t end, uint32_t cluster,
+                            uint32_t index) {
+  bool sequential = offset == node_data->ra_next_offset;
+  node_data->ra_next_offset = end;
+  if (!sequential) {
+    node_data->ra_window = 0;
+    node_data->ra_end = 0;
+    return;
+  }
+
+  if (!node_data->ra_window) {
+    node_data->ra_window = FAT32_RA_MIN_BYTES;
+    node_data->ra_end = end;
+  }
+  // Queda al menos media ventana anticipada por delante del lector
+  if (node_data->ra_end > end &&
+      node_data->ra_end - end >= node_data->ra_window / 2)
+    return;
+
+  uint32_t from = node_data->ra_end > end ? node_data->ra_end : end;
+  if (from >= node_data->size)
+    return;
+  uint32_t to = node_data->size - from > node_data->ra_window
+                    ? from + node_data->ra_window
+                    : node_data->size;
+  node_data->ra_end = to;
+  if (node_data->ra_window < FAT32_RA_MAX_BYTES)
+    node_data->ra_window *= 2;
+
+  uint32_t spc = fs->boot_sector.sectors_per_cluster;
+  uint32_t run_first = 0;
+  uint32_t run_len = 0;
+  for (; cluster >= 2 && cluster < fs->total_clusters + 2 &&
+         (uint64_t)index * fs->cluster_size < to;
+       index++) {
+    if ((uint64_t)(index + 1) * fs->cluster_size > from) {
+      if (run_len && cluster == run_first + run_len) {
+        run_len++;
+      } else {
+        if (run_len)
+          disk_readahead(fs->disk, fat32_cluster_to_sector(fs, run_first),
+                         run_len * spc);
+        run_first = cluster;
+        run_len = 1;
+      }
+    }
+    cluster = fat32_get_fat_entry(fs, cluster);
+  }
+  if (run_len)
+    disk_readahead(fs->disk, fat32_cluster_to_sector(fs, run_first),
+                   run_len * spc);
+}
+
 int fat32_read(vfs_node_t *node, uint8_t *buf, uint32_t size, uint32_t offset) {
   if (!node || !buf)
     return VFS_ERR;
@@ -2411,9 +2471,14 @@ int fat32_read(vfs_node_t *node, uint8_t *buf, uint32_t size, uint32_t offset) {
   uint32_t cluster_offset = offset / fs->cluster_size;
   uint32_t intra_offset = offset % fs->cluster_size;
 
-  // Skip to starting cluster
+  // Skip to starting cluster (desde la última posición si no la pasamos)
   uint32_t cluster = start_cluster;
-  for (uint32_t i = 0; i < cluster_offset; i++) {
+  uint32_t index = 0;
+  if (node_data->seq_cluster && node_data->seq_index <= cluster_offset) {
+    cluster = node_data->seq_cluster;
+    index = node_data->seq_index;
+  }
+  for (; index < cluster_offset; index++) {
     cluster = fat32_get_fat_entry(fs, cluster);
     if (cluster >= FAT32_EOC)
       return bytes_read;
@@ -2439,10 +2504,16 @@ int fat32_read(vfs_node_t *node, uint8_t *buf, uint32_t size, uint32_t offset) {
     bytes_to_read -= bytes_to_copy;
     intra_offset = 0;
 
+    // La siguiente lectura secuencial puede seguir en este mismo clúster
+    node_data->seq_cluster = cluster;
+    node_data->seq_index = index;
+
     cluster = fat32_get_fat_entry(fs, cluster);
+    index++;
   }
 
   kernel_free(cluster_buffer);
+  fat32_readahead(fs, node_data, offset, offset + bytes_read, cluster, index);
   return bytes_read;
 }
 
@@ -2494,6 +2565,12 @@ int fat32_write(vfs_node_t *node, const uint8_t *buf, uint32_t size,
   uint32_t bytes_written = 0;
   bool first_cluster_changed = false;
 
+  // La cadena puede cambiar: olvidar la posición y la lectura anticipada
+  node_data->seq_cluster = 0;
+  node_data->seq_index = 0;
+  node_data->ra_window = 0;
+  node_data->ra_end = 0;
+
   char log_buf[256];
   snprintf(log_buf, sizeof(log_buf),
            "FAT32: Writing %u bytes at offset %u (current size: %u)\n", size,
@@ -4040,6 +4117,8 @@ static int fat32_initialize_fat(disk_t *disk, uint32_t fat_start_sector,
         kernel_free(sector_buffer);
         return VFS_ERR;
       }
+      // Miles de sectores seguidos: dejar correr a otras tareas
+      cond_resched();
     }
 
     terminal_printf(&main_terminal, "FAT32: Initialized FAT %u (%u sectors)\n",
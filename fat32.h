@@ -35,6 +35,11 @@
 #define FAT32_MAX_VOLUME_LABEL 11
 #define FAT32_AUTO_SPC 0
 
+// Lectura anticipada por archivo (ventana en bytes, se duplica mientras las
+// lecturas sean secuenciales)
+#define FAT32_RA_MIN_BYTES (32 * 1024)
+#define FAT32_RA_MAX_BYTES (1024 * 1024)
+
 // Boot sector structure (packed)
 typedef struct __attribute__((packed)) {
   uint8_t jmp_boot[3];         // Jump instruction
@@ -146,6 +151,14 @@ typedef struct {
   uint8_t is_directory;     // 1 if directory, 0 if file
   uint32_t parent_cluster;  // Cluster of the parent directory (0 for root)
   uint8_t short_name[11];   // Short 8.3 name for locating dir entry
+  // Última posición alcanzada en la cadena, para no recorrerla desde el
+  // principio en cada lectura (0 = sin posición)
+  uint32_t seq_cluster;
+  uint32_t seq_index;
+  // Lectura anticipada
+  uint32_t ra_next_offset; // Offset de la siguiente lectura secuencial
+  uint32_t ra_end;         // Hasta dónde se pidió ya la lectura anticipada
+  uint32_t ra_window;      // Bytes de la próxima petición (0 = no secuencial)
 } fat32_node_t;
 
 // Function prototypes
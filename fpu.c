@@ -0,0 +1,270 @@
+#include "fpu.h"
+#include "cpuid.h"
+#include "isr.h"
+#include "kernel.h"
+#include "memory.h"
+#include "spinlock.h"
+#include "task.h"
+#include "terminal.h"
+
+// ========================================================================
+// ESTADO GLOBAL
+// ========================================================================
+
+static bool fpu_present = false; // Hay FPU utilizable (x87)
+static bool fpu_use_fxsr = false; // FXSAVE/FXRSTOR disponibles y activados
+static bool fpu_sse_on = false;   // CR4.OSFXSR activado
+
+// Tarea cuyo estado está cargado ahora mismo en los registros FPU/SSE
+static task_t *fpu_owner = NULL;
+static uint32_t fpu_nm_count = 0;
+static uint32_t fpu_saves = 0;
+
+// Copia de los registros mientras el kernel usa SSE (sin anidamiento: las
+// secciones kernel_fpu_begin/end corren con IRQs deshabilitadas)
+static uint8_t kernel_fpu_area[FPU_STATE_SIZE]
+    __attribute__((aligned(FPU_STATE_ALIGN)));
+static bool kernel_fpu_ts_was_set = false;
+
+// ========================================================================
+// ACCESO A REGISTROS DE CONTROL
+// ========================================================================
+
+static inline uint32_t fpu_read_cr0(void) {
+  uint32_t cr0;
+  __asm__ __volatile__("mov %%cr0, %0" : "=r"(cr0));
+  return cr0;
+}
+
+static inline void fpu_write_cr0(uint32_t cr0) {
+  __asm__ __volatile__("mov %0, %%cr0" : : "r"(cr0) : "memory");
+}
+
+static inline uint32_t fpu_read_cr4(void) {
+  uint32_t cr4;
+  __asm__ __volatile__("mov %%cr4, %0" : "=r"(cr4));
+  return cr4;
+}
+
+static inline void fpu_write_cr4(uint32_t cr4) {
+  __asm__ __volatile__("mov %0, %%cr4" : : "r"(cr4) : "memory");
+}
+
+static inline void fpu_clts(void) { __asm__ __volatile__("clts" ::: "memory"); }
+
+static inline void fpu_stts(void) {
+  uint32_t cr0 = fpu_read_cr0();
+  // Escribir CR0 serializa: evitarlo si TS ya está puesto
+  if (!(cr0 & CR0_TS))
+    fpu_write_cr0(cr0 | CR0_TS);
+}
+
+// ========================================================================
+// GUARDAR / RESTAURAR
+// ========================================================================
+
+static inline void fpu_save(uint8_t *area) {
+  if (fpu_use_fxsr)
+    __asm__ __volatile__("fxsave (%0)" : : "r"(area) : "memory");
+  else
+    __asm__ __volatile__("fnsave (%0)\n\tfwait" : : "r"(area) : "memory");
+}
+
+static inline void fpu_restore(uint8_t *area) {
+  if (fpu_use_fxsr)
+    __asm__ __volatile__("fxrstor (%0)" : : "r"(area) : "memory");
+  else
+    __asm__ __volatile__("frstor (%0)" : : "r"(area) : "memory");
+}
+
+static inline void fpu_load_clean_state(void) {
+  __asm__ __volatile__("fninit" ::: "memory");
+  if (fpu_sse_on) {
+    uint32_t mxcsr = MXCSR_DEFAULT;
+    __asm__ __volatile__("ldmxcsr %0" : : "m"(mxcsr));
+  }
+}
+
+// ========================================================================
+// INICIALIZACIÓN
+// ========================================================================
+
+void fpu_init(void) {
+  if (!cpu_info.caps.has_fpu) {
+    terminal_puts(&main_terminal, "FPU: Not present, x87/SSE disabled\r\n");
+    return;
+  }
+
+  // EM=0 (no emular), MP=1 (WAIT respeta TS), NE=1 (errores x87 nativos)
+  uint32_t cr0 = fpu_read_cr0();
+  cr0 &= ~(CR0_EM | CR0_TS);
+  cr0 |= CR0_MP | CR0_NE;
+  fpu_write_cr0(cr0);
+
+  fpu_present = true;
+  fpu_use_fxsr = cpu_info.caps.has_fxsr;
+
+  if (fpu_use_fxsr && cpu_info.caps.has_sse) {
+    fpu_write_cr4(fpu_read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+    fpu_sse_on = true;
+  }
+
+  fpu_load_clean_state();
+
+  terminal_printf(&main_terminal, "FPU: x87 enabled, %s, SSE %s\r\n",
+                  fpu_use_fxsr ? "FXSAVE" : "FNSAVE",
+                  fpu_sse_on ? (cpu_info.caps.has_sse2 ? "+SSE2 enabled"
+                                                       : "enabled")
+                             : "not available");
+}
+
+bool fpu_available(void) { return fpu_present; }
+
+bool fpu_sse_enabled(void) { return fpu_sse_on; }
+
+// ========================================================================
+// ÁREAS POR TAREA
+// ========================================================================
+
+bool fpu_state_alloc(task_t *task) {
+  if (!task)
+    return false;
+
+  task->fpu.raw = NULL;
+  task->fpu.area = NULL;
+  task->fpu.used = false;
+
+  if (!fpu_present)
+    return true; // Nada que guardar
+
+  void *raw = kernel_malloc(FPU_STATE_SIZE + FPU_STATE_ALIGN - 1);
+  if (!raw)
+    return false;
+
+  uintptr_t aligned = ((uintptr_t)raw + FPU_STATE_ALIGN - 1) &
+                      ~(uintptr_t)(FPU_STATE_ALIGN - 1);
+  task->fpu.raw = raw;
+  task->fpu.area = (uint8_t *)aligned;
+  return true;
+}
+
+void fpu_state_release(task_t *task) {
+  if (!task)
+    return;
+
+  uint32_t flags = local_irq_save();
+  // El estado en registros ya no pertenece a nadie
+  if (fpu_owner == task)
+    fpu_owner = NULL;
+  void *raw = task->fpu.raw;
+  task->fpu.raw = NULL;
+  task->fpu.area = NULL;
+  task->fpu.used = false;
+  local_irq_restore(flags);
+
+  if (raw)
+    kernel_free(raw);
+}
+
+// ========================================================================
+// CAMBIO DE CONTEXTO PEREZOSO
+// ========================================================================
+
+void fpu_prepare_switch(task_t *next) {
+  if (!fpu_present)
+    return;
+
+  // Si la tarea entrante ya es la dueña sus registros siguen cargados;
+  // en otro caso cualquier uso de la FPU generará #NM
+  if (next == fpu_owner)
+    fpu_clts();
+  else
+    fpu_stts();
+}
+
+void fpu_handle_nm(struct regs *r) {
+  if (!fpu_present) {
+    // Sin FPU no hay nada que emular: comportarse como antes
+    panic_screen("Device Not Available (no FPU present)", r);
+    return;
+  }
+
+  uint32_t flags = local_irq_save();
+  fpu_clts();
+  fpu_nm_count++;
+
+  task_t *current = scheduler.current_task;
+  if (current == fpu_owner) {
+    local_irq_restore(flags);
+    return;
+  }
+
+  // Guardar el estado del dueño anterior en su área
+  if (fpu_owner && fpu_owner->fpu.area) {
+    fpu_save(fpu_owner->fpu.area);
+    fpu_saves++;
+  }
+
+  if (current && current->fpu.area) {
+    if (current->fpu.used) {
+      fpu_restore(current->fpu.area);
+    } else {
+      fpu_load_clean_state();
+      current->fpu.used = true;
+    }
+    fpu_owner = current;
+  } else {
+    // Arranque (sin tarea) o tarea sin área: estado limpio y sin dueño
+    fpu_load_clean_state();
+    fpu_owner = NULL;
+  }
+
+  local_irq_restore(flags);
+}
+
+// ========================================================================
+// USO DE SSE DENTRO DEL KERNEL
+// ========================================================================
+
+bool kernel_fpu_begin(uint32_t *flags) {
+  if (!fpu_sse_on)
+    return false;
+
+  *flags = local_irq_save();
+  // Con TS activo los registros siguen siendo del dueño (aún sin guardar):
+  // hay que preservarlos igual que si TS estuviera limpio
+  kernel_fpu_ts_was_set = (fpu_read_cr0() & CR0_TS) != 0;
+  fpu_clts();
+  fpu_save(kernel_fpu_area);
+  return true;
+}
+
+void kernel_fpu_end(uint32_t flags) {
+  __asm__ __volatile__("sfence" ::: "memory");
+  fpu_restore(kernel_fpu_area);
+  if (kernel_fpu_ts_was_set)
+    fpu_stts();
+  local_irq_restore(flags);
+}
+
+// ========================================================================
+// INFORMACIÓN
+// ========================================================================
+
+uint32_t fpu_get_nm_count(void) { return fpu_nm_count; }
+
+void fpu_print_info(void) {
+  terminal_puts(&main_terminal, "\r\n=== FPU/SSE State ===\r\n");
+  if (!fpu_present) {
+    terminal_puts(&main_terminal, "No FPU present\r\n");
+    return;
+  }
+  terminal_printf(&main_terminal, "Save method:  %s\r\n",
+                  fpu_use_fxsr ? "FXSAVE/FXRSTOR" : "FNSAVE/FRSTOR");
+  terminal_printf(&main_terminal, "SSE:          %s\r\n",
+                  fpu_sse_on ? "enabled (CR4.OSFXSR)" : "disabled");
+  terminal_printf(&main_terminal, "Owner:        %s\r\n",
+                  fpu_owner ? fpu_owner->name : "(none)");
+  terminal_printf(&main_terminal, "#NM traps:    %u\r\n", fpu_nm_count);
+  terminal_printf(&main_terminal, "State saves:  %u\r\n", fpu_saves);
+}
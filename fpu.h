@@ -0,0 +1,63 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ========================================================================
+// ESTADO FPU/SSE POR TAREA (CAMBIO PEREZOSO)
+// ========================================================================
+//
+// Cada tarea tiene su área FXSAVE (o FNSAVE si la CPU no tiene FXSR). En el
+// cambio de contexto solo se activa CR0.TS; la primera instrucción x87/SSE
+// de la nueva tarea provoca #NM (vector 7) y es entonces cuando se guarda
+// el estado del dueño anterior y se carga el de la tarea actual. Las tareas
+// que nunca tocan la FPU no pagan nada.
+
+#define FPU_STATE_SIZE 512 // FXSAVE necesita 512 bytes alineados a 16
+#define FPU_STATE_ALIGN 16
+
+#define CR0_MP (1u << 1)
+#define CR0_EM (1u << 2)
+#define CR0_TS (1u << 3)
+#define CR0_NE (1u << 5)
+#define CR4_OSFXSR (1u << 9)
+#define CR4_OSXMMEXCPT (1u << 10)
+
+#define MXCSR_DEFAULT 0x1F80 // Todas las excepciones SSE enmascaradas
+
+struct task;
+struct regs;
+
+// Área de estado de una tarea (se reserva junto con la tarea)
+typedef struct fpu_state {
+  void *raw;     // Bloque devuelto por kernel_malloc
+  uint8_t *area; // Puntero alineado a FPU_STATE_ALIGN dentro de raw
+  bool used;     // La tarea ya ha ejecutado alguna instrucción FPU/SSE
+} fpu_state_t;
+
+void fpu_init(void);
+bool fpu_available(void);
+bool fpu_sse_enabled(void);
+
+bool fpu_state_alloc(struct task *task);
+void fpu_state_release(struct task *task);
+
+// Llamar con IRQs deshabilitadas justo antes de task_switch_context
+void fpu_prepare_switch(struct task *next);
+
+// Manejador de #NM (Device Not Available)
+void fpu_handle_nm(struct regs *r);
+
+// Uso de registros SSE dentro del kernel (memcpy no temporal, etc.). Guarda
+// los registros vivos en un área propia y los restaura al terminar, así el
+// estado de la tarea dueña no se toca. Deshabilita IRQs mientras dura: usar
+// solo para tramos cortos. Devuelve false si SSE no está activo.
+bool kernel_fpu_begin(uint32_t *flags);
+void kernel_fpu_end(uint32_t flags);
+
+// Estadísticas
+uint32_t fpu_get_nm_count(void);
+void fpu_print_info(void);
+
+#endif // FPU_H
@@ -0,0 +1,212 @@
+#include "futex.h"
+#include "irq.h"
+#include "kernel.h"
+#include "spinlock.h"
+#include "syscalls.h"
+#include "task.h"
+#include "terminal.h"
+
+// ========================================================================
+// ESTADO
+// ========================================================================
+
+typedef struct futex_key {
+  address_space_t *as;
+  uint32_t uaddr;
+} futex_key_t;
+
+// Una espera en curso. Vive en el stack de kernel de la tarea dormida, que
+// no lo abandona hasta volver a tomar el lock del bucket.
+typedef struct futex_q {
+  futex_key_t key;
+  wait_queue_t wq;
+  bool woken;
+  struct futex_q *next;
+} futex_q_t;
+
+typedef struct futex_bucket {
+  spinlock_t lock;
+  futex_q_t *head;
+} futex_bucket_t;
+
+static futex_bucket_t futex_hash[FUTEX_HASH_SIZE];
+
+static inline futex_key_t futex_key(task_t *task, volatile uint32_t *uaddr) {
+  futex_key_t key = {task ? task->address_space : NULL, (uint32_t)uaddr};
+  return key;
+}
+
+static inline bool futex_key_eq(const futex_key_t *a, const futex_key_t *b) {
+  return a->as == b->as && a->uaddr == b->uaddr;
+}
+
+// Hash multiplicativo (Knuth) de la palabra y el espacio de direcciones
+static inline futex_bucket_t *futex_bucket(const futex_key_t *key) {
+  uint32_t h = (key->uaddr >> 2) ^ ((uint32_t)key->as >> 4);
+  h *= 0x9E3779B1u;
+  return &futex_hash[(h >> 16) & (FUTEX_HASH_SIZE - 1)];
+}
+
+static void futex_unlink(futex_bucket_t *b, futex_q_t *q) {
+  futex_q_t **link = &b->head;
+  while (*link && *link != q)
+    link = &(*link)->next;
+  if (*link)
+    *link = q->next;
+  q->next = NULL;
+}
+
+void futex_init(void) {
+  for (uint32_t i = 0; i < FUTEX_HASH_SIZE; i++) {
+    spinlock_init(&futex_hash[i].lock, "futex");
+    futex_hash[i].head = NULL;
+  }
+}
+
+// ========================================================================
+// WAIT / WAKE
+// ========================================================================
+
+int futex_wait(task_t *task, volatile uint32_t *uaddr, uint32_t val,
+               uint32_t timeout_ticks) {
+  futex_q_t q;
+  q.key = futex_key(task, uaddr);
+  wait_queue_init(&q.wq, "futex");
+  q.woken = false;
+
+  futex_bucket_t *b = futex_bucket(&q.key);
+  uint32_t deadline = timeout_ticks ? ticks_since_boot + timeout_ticks : 0;
+
+  // Comparar y encolarse bajo el lock del bucket: un WAKE hecho después de
+  // que otro hilo cambie el valor ya nos encuentra en la lista
+  uint32_t flags = spin_lock_irqsave(&b->lock);
+  if (*uaddr != val) {
+    spin_unlock_irqrestore(&b->lock, flags);
+    return -EAGAIN;
+  }
+  q.next = b->head;
+  b->head = &q;
+  if (task)
+    task->futex_wait_q = &q;
+
+  while (!q.woken) {
+    uint32_t remaining = 0;
+    if (deadline) {
+      int32_t left = (int32_t)(deadline - ticks_since_boot);
+      if (left <= 0)
+        break;
+      remaining = (uint32_t)left;
+    }
+    wait_queue_sleep(&q.wq, &b->lock, remaining);
+  }
+
+  if (!q.woken)
+    futex_unlink(b, &q);
+  if (task)
+    task->futex_wait_q = NULL;
+  spin_unlock_irqrestore(&b->lock, flags);
+
+  return q.woken ? 0 : -ETIMEDOUT;
+}
+
+uint32_t futex_wake(task_t *task, volatile uint32_t *uaddr, uint32_t count) {
+  futex_key_t key = futex_key(task, uaddr);
+  futex_bucket_t *b = futex_bucket(&key);
+  uint32_t woken = 0;
+
+  uint32_t flags = spin_lock_irqsave(&b->lock);
+  futex_q_t **link = &b->head;
+  while (*link && woken < count) {
+    futex_q_t *q = *link;
+    if (!futex_key_eq(&q->key, &key)) {
+      link = &q->next;
+      continue;
+    }
+    *link = q->next;
+    q->next = NULL;
+    q->woken = true;
+    wait_queue_wake_one(&q->wq);
+    woken++;
+  }
+  spin_unlock_irqrestore(&b->lock, flags);
+
+  return woken;
+}
+
+void futex_task_exit(task_t *task) {
+  futex_q_t *q = task->futex_wait_q;
+  if (!q)
+    return;
+
+  // Un WAKE concurrente toca q solo con el lock del bucket: después de
+  // tomarlo ya nadie lo ve
+  futex_bucket_t *b = futex_bucket(&q->key);
+  uint32_t flags = spin_lock_irqsave(&b->lock);
+  if (!q->woken)
+    futex_unlink(b, q);
+  task->futex_wait_q = NULL;
+  spin_unlock_irqrestore(&b->lock, flags);
+}
+
+// ========================================================================
+// PRUEBA
+// ========================================================================
+
+static volatile uint32_t futextest_word = 0;
+
+static void futextest_waiter(void *arg) {
+  (void)arg;
+  futex_wait(task_current(), &futextest_word, 0, 0);
+  while (1)
+    task_sleep(1000);
+}
+
+// Espera hasta 1 s a que 'task' esté dormida en FUTEX_WAIT
+static bool futextest_wait_blocked(task_t *task) {
+  for (int i = 0; i < 100; i++) {
+    if (task->futex_wait_q && task->state != TASK_READY &&
+        task->state != TASK_RUNNING)
+      return true;
+    task_sleep(10);
+  }
+  return false;
+}
+
+void cmd_futextest(void) {
+  terminal_puts(&main_terminal, "\r\n=== Futex test ===\r\n");
+  futextest_word = 0;
+  bool ok = true;
+
+  // 1. Una espera normal se despierta
+  task_t *w = task_create("futex_waiter", futextest_waiter, NULL,
+                          TASK_PRIORITY_NORMAL);
+  if (!w || !futextest_wait_blocked(w)) {
+    terminal_puts(&main_terminal, "FAIL: waiter did not block\r\n");
+    if (w)
+      task_destroy(w);
+    return;
+  }
+  uint32_t woken = futex_wake(task_current(), &futextest_word, 1);
+  terminal_printf(&main_terminal, "wake live waiter: %u woken %s\r\n", woken,
+                  woken == 1 ? "(ok)" : "(FAIL)");
+  ok &= woken == 1;
+  task_destroy(w);
+
+  // 2. Matar a una tarea dormida en FUTEX_WAIT no deja su espera (en el
+  // stack ya liberado) en el bucket
+  w = task_create("futex_victim", futextest_waiter, NULL,
+                  TASK_PRIORITY_NORMAL);
+  if (!w || !futextest_wait_blocked(w)) {
+    terminal_puts(&main_terminal, "FAIL: victim did not block\r\n");
+    if (w)
+      task_destroy(w);
+    return;
+  }
+  task_destroy(w);
+  woken = futex_wake(task_current(), &futextest_word, 1);
+  terminal_printf(&main_terminal, "wake after kill: %u woken %s\r\n", woken,
+                  woken == 0 ? "(ok)" : "(FAIL)");
+  ok &= woken == 0;
+
+  terminal_puts(&main_terminal, ok ? "PASS\r\n" : "FAIL\r\n");
+}
@@ -0,0 +1,44 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ========================================================================
+// FUTEX (ESPERA/DESPERTAR SOBRE UN ENTERO DE USUARIO)
+// ========================================================================
+//
+// Un mutex de usuario sin contención se resuelve con una instrucción
+// atómica sin entrar al kernel; solo al competir se llama a FUTEX_WAIT /
+// FUTEX_WAKE. Cada espera se identifica por (espacio de direcciones,
+// dirección virtual) y va a uno de FUTEX_HASH_SIZE buckets, cada uno con
+// su propio lock, así que WAKE solo recorre las esperas que comparten
+// bucket y solo despierta a las de la misma clave.
+
+#define FUTEX_HASH_SIZE 64 // Potencia de 2
+
+struct task;
+
+void futex_init(void);
+
+// Duerme si *uaddr == val. Devuelve 0 al ser despertado, -EAGAIN si el
+// valor ya no coincidía y -ETIMEDOUT si vencen timeout_ticks (0 = sin
+// límite). uaddr debe estar validado y alineado a 4 bytes.
+int futex_wait(struct task *task, volatile uint32_t *uaddr, uint32_t val,
+               uint32_t timeout_ticks);
+
+// Despierta hasta 'count' esperas sobre uaddr. Devuelve cuántas despertó.
+uint32_t futex_wake(struct task *task, volatile uint32_t *uaddr,
+                    uint32_t count);
+
+// Saca del bucket la espera de una tarea que se destruye dormida en
+// FUTEX_WAIT, antes de liberar el stack donde vive. La tarea ya no está
+// en el planificador.
+void futex_task_exit(struct task *task);
+
+// Comando "futextest": destruye una tarea dormida en FUTEX_WAIT y despierta
+// después la misma dirección
+void cmd_futextest(void);
+
+#endif // FUTEX_H
@@ -1,9 +1,14 @@
 // ide.c - Driver de discos IDE/ATA
 #include "ide.h"
+#include "dma.h"
 #include "io.h"
+#include "irq.h"
 #include "kernel.h"
 #include "memory.h"
+#include "pci.h"
+#include "spinlock.h"
 #include "string.h"
+#include "task.h"
 #include "terminal.h"
 #include "driver_system.h"
 
@@ -12,6 +17,8 @@ extern Terminal main_terminal;
 // Estado global del driver IDE
 static ide_driver_priv_t *ide_priv = NULL;
 
+static void ide_set_multiple_mode(ide_disk_t *disk);
+
 // ========================================================================
 // FUNCIONES DE BAJO NIVEL
 // ========================================================================
@@ -21,9 +28,10 @@ void ide_select_drive(ide_disk_t *disk) {
     outb(disk->io_base + ATA_DRIVE_SELECT, drive_select);
 }
 
+// io_ctrl ya es el puerto de Alternate Status / Device Control
 void ide_400ns_delay(ide_disk_t *disk) {
     for (int i = 0; i < 4; i++) {
-        inb(disk->io_ctrl + ATA_ALT_STATUS);
+        inb(disk->io_ctrl);
     }
 }
 
@@ -31,40 +39,177 @@ uint8_t ide_read_status(ide_disk_t *disk) {
     return inb(disk->io_base + ATA_STATUS_PORT);
 }
 
-int ide_wait_ready(ide_disk_t *disk) {
-    uint32_t timeout = 1000000; // ~1 segundo
-    
-    while (timeout--) {
-        uint8_t status = ide_read_status(disk);
-        if (!(status & ATA_STATUS_BSY) && (status & ATA_STATUS_RDY)) {
+// ========================================================================
+// ESPERA POR INTERRUPCIÓN
+// ========================================================================
+
+typedef struct {
+    uint8_t irq;
+    uint16_t io_base;
+    uint16_t io_ctrl;
+    bool irq_registered;
+    volatile bool irq_seen;    // Ya ha llegado alguna: se puede dormir
+    volatile uint32_t irq_seq; // Interrupciones recibidas
+    spinlock_t lock;
+    wait_queue_t wq;
+
+    // Estadísticas
+    uint32_t waits;       // Esperas que no se cumplían al empezar
+    uint32_t sleeps;      // Veces que se durmió
+    uint32_t poll_waits;  // Esperas resueltas sondeando
+    uint32_t timeouts;
+
+    // Bus-master DMA (bm_base == 0: no hay)
+    uint16_t bm_base;
+    dma_buffer_t *prdt;
+    uint32_t dma_errors;
+} ide_channel_t;
+
+// El resto de campos (estadísticas, bus-master) empiezan a cero
+static ide_channel_t ide_channels[2] = {
+    {.irq = 14, .io_base = ATA_PRIMARY_IO, .io_ctrl = ATA_PRIMARY_CTRL,
+     .lock = SPINLOCK_INIT("ide0"), .wq = WAIT_QUEUE_INIT("ide0")},
+    {.irq = 15, .io_base = ATA_SECONDARY_IO, .io_ctrl = ATA_SECONDARY_CTRL,
+     .lock = SPINLOCK_INIT("ide1"), .wq = WAIT_QUEUE_INIT("ide1")},
+};
+
+static bool ide_dma_on = true; // Ver ide_set_dma_enabled()
+
+// Top half: leer el registro de estado reconoce la interrupción en el
+// dispositivo (el de estado alternativo no)
+static bool ide_irq_handler(void *ctx) {
+    ide_channel_t *ch = (ide_channel_t *)ctx;
+    uint8_t status = inb(ch->io_base + ATA_STATUS_PORT);
+    if (status == 0xFF) {
+        return false; // Canal sin dispositivos
+    }
+    if (ch->bm_base) {
+        // El bit de interrupción del bus-master se borra escribiendo un 1;
+        // el de error lo mira quien espera el comando DMA
+        uint8_t bm_status = inb(ch->bm_base + IDE_BM_STATUS);
+        if (bm_status & IDE_BM_STATUS_IRQ) {
+            outb(ch->bm_base + IDE_BM_STATUS,
+                 (bm_status & IDE_BM_STATUS_DRV_DMA) | IDE_BM_STATUS_IRQ);
+        }
+    }
+
+    uint32_t flags = spin_lock_irqsave(&ch->lock);
+    ch->irq_seq++;
+    ch->irq_seen = true;
+    wait_queue_wake_all(&ch->wq);
+    spin_unlock_irqrestore(&ch->lock, flags);
+    return true;
+}
+
+void ide_channel_irq_enable(uint8_t bus) {
+    if (bus > 1 || ide_channels[bus].irq_registered) {
+        return;
+    }
+    ide_channel_t *ch = &ide_channels[bus];
+
+    // nIEN = 0: el dispositivo puede generar INTRQ
+    outb(ch->io_ctrl, 0x00);
+    inb(ch->io_base + ATA_STATUS_PORT);
+
+    if (!irq_register_handler(ch->irq, ide_irq_handler, ch)) {
+        terminal_printf(&main_terminal, "IDE: Cannot use IRQ %u, polling\r\n",
+                        ch->irq);
+        return;
+    }
+    ch->irq_registered = true;
+}
+
+int ide_channel_wait(uint8_t bus, uint8_t mask, uint8_t value, bool check_err,
+                     bool irq) {
+    ide_channel_t *ch = &ide_channels[bus & 1];
+    uint32_t start = ticks_since_boot;
+    uint32_t spins = 0;
+    bool counted = false;
+
+    for (;;) {
+        uint32_t seq = ch->irq_seq;
+        bool can_sleep = irq && ch->irq_seen && irq_line_active(ch->irq) &&
+                         local_irq_enabled();
+        // Sondeando hay que leer el registro de estado para reconocer la
+        // interrupción; durmiendo lo hace el handler
+        uint8_t status = can_sleep ? inb(ch->io_ctrl)
+                                   : inb(ch->io_base + ATA_STATUS_PORT);
+        if ((status & mask) == value) {
             return 0;
         }
-        if (status & ATA_STATUS_ERR) {
+        if (check_err && (status & ATA_STATUS_ERR)) {
             return -1;
         }
-        __asm__ volatile("pause");
+
+        if (!counted) {
+            counted = true;
+            if (can_sleep) {
+                ch->waits++;
+            } else {
+                ch->poll_waits++;
+            }
+        }
+        if (++spins > 1000000 ||
+            ticks_since_boot - start > IDE_IRQ_TIMEOUT_TICKS) {
+            ch->timeouts++;
+            return -2;
+        }
+        if (!can_sleep || spins < IDE_IRQ_SPINS) {
+            __asm__ volatile("pause");
+            continue;
+        }
+
+        // Si la interrupción llegó después de leer 'seq' no se duerme; si
+        // se pierde, el plazo de un tick vuelve a mirar el estado
+        uint32_t flags = spin_lock_irqsave(&ch->lock);
+        if (ch->irq_seq == seq) {
+            ch->sleeps++;
+            wait_queue_sleep(&ch->wq, &ch->lock, 1);
+        }
+        spin_unlock_irqrestore(&ch->lock, flags);
     }
-    
-    terminal_printf(&main_terminal, "IDE: Timeout waiting for drive ready\r\n");
-    return -1;
 }
 
-int ide_wait_drq(ide_disk_t *disk) {
-    uint32_t timeout = 1000000;
-    
-    while (timeout--) {
-        uint8_t status = ide_read_status(disk);
-        if (status & ATA_STATUS_DRQ) {
-            return 0;
+void ide_print_irq_stats(void) {
+    for (uint8_t bus = 0; bus < 2; bus++) {
+        ide_channel_t *ch = &ide_channels[bus];
+        if (!ch->irq_registered) {
+            continue;
         }
-        if (status & ATA_STATUS_ERR) {
-            return -1;
+        terminal_printf(&main_terminal,
+                        "IDE channel %u: IRQ %u %s, %u interrupts, %u waits, "
+                        "%u sleeps, %u polled, %u timeouts\r\n",
+                        bus, ch->irq,
+                        irq_line_active(ch->irq) ? "active" : "disabled",
+                        ch->irq_seq, ch->waits, ch->sleeps, ch->poll_waits,
+                        ch->timeouts);
+        if (ch->bm_base) {
+            terminal_printf(&main_terminal,
+                            "  Bus-master at 0x%04x, %u DMA errors%s\r\n",
+                            ch->bm_base, ch->dma_errors,
+                            ide_dma_on ? "" : " (DMA disabled)");
         }
-        __asm__ volatile("pause");
     }
-    
-    terminal_printf(&main_terminal, "IDE: Timeout waiting for DRQ\r\n");
-    return -1;
+}
+
+// Esperas de un comando en curso: el dispositivo avisa con una interrupción
+static int ide_wait_status(ide_disk_t *disk, uint8_t mask, uint8_t value,
+                           bool irq, const char *what) {
+    int ret = ide_channel_wait(disk->bus, mask, value, true, irq);
+    if (ret == -2) {
+        terminal_printf(&main_terminal, "IDE: Timeout waiting for %s\r\n",
+                        what);
+    }
+    return ret == 0 ? 0 : -1;
+}
+
+int ide_wait_ready(ide_disk_t *disk) {
+    return ide_wait_status(disk, ATA_STATUS_BSY | ATA_STATUS_RDY,
+                           ATA_STATUS_RDY, true, "drive ready");
+}
+
+int ide_wait_drq(ide_disk_t *disk) {
+    return ide_wait_status(disk, ATA_STATUS_DRQ, ATA_STATUS_DRQ, true, "DRQ");
 }
 
 int ide_check_error(ide_disk_t *disk, char *error_msg, size_t msg_size) {
@@ -118,7 +263,7 @@ ide_device_type_t ide_detect_device_type(uint8_t bus, uint8_t drive) {
     
     // 2. Esperar 400ns (leer alternate status 4 veces)
     for (int i = 0; i < 4; i++) {
-        inb(ctrl_port + ATA_ALT_STATUS);
+        inb(ctrl_port);
     }
     
     // 3. Verificar si el dispositivo responde
@@ -159,7 +304,7 @@ ide_device_type_t ide_detect_device_type(uint8_t bus, uint8_t drive) {
         
         // 8. Intentar comando IDENTIFY para determinar tipo
         outb(io_base + ATA_DRIVE_SELECT, drive_select);
-        for (int i = 0; i < 4; i++) inb(ctrl_port + ATA_ALT_STATUS);
+        for (int i = 0; i < 4; i++) inb(ctrl_port);
         
         outb(io_base + ATA_COMMAND_PORT, ATA_CMD_IDENTIFY);
         
@@ -258,6 +403,9 @@ bool ide_identify_device(ide_disk_t *disk) {
     
     // 8. Extraer información del dispositivo
     disk->supports_lba48 = (identify_data[83] & (1 << 10)) ? true : false;
+    disk->supports_dma = (identify_data[49] & (1 << 8)) ? true : false;
+    disk->udma_modes = (identify_data[53] & (1 << 2)) ? identify_data[88] & 0x7F : 0;
+    disk->multiple_max = identify_data[47] & 0xFF;
     
     // Contar sectores
     if (disk->supports_lba48) {
@@ -342,7 +490,7 @@ bool ide_detect_disk(uint8_t bus, uint8_t drive, ide_disk_t *disk) {
         
         // Enviar DEVICE RESET
         outb(disk->io_ctrl + ATA_DEVCTL, 0x04); // Set SRST
-        for (int i = 0; i < 4; i++) inb(disk->io_ctrl + ATA_ALT_STATUS);
+        for (int i = 0; i < 4; i++) inb(disk->io_ctrl);
         outb(disk->io_ctrl + ATA_DEVCTL, 0x00); // Clear SRST
         for (volatile int i = 0; i < 100000; i++); // Esperar
         
@@ -354,6 +502,7 @@ bool ide_detect_disk(uint8_t bus, uint8_t drive, ide_disk_t *disk) {
     
     disk->present = true;
     disk->initialized = true;
+    ide_set_multiple_mode(disk);
     
     uint64_t size_mb = (disk->sector_count * 512) / (1024 * 1024);
     terminal_printf(&main_terminal, "IDE: Disk detected successfully: %s, %llu MB (%llu sectors)\r\n",
@@ -366,6 +515,57 @@ bool ide_detect_disk(uint8_t bus, uint8_t drive, ide_disk_t *disk) {
 // OPERACIONES DE LECTURA/ESCRITURA
 // ========================================================================
 
+// SET MULTIPLE MODE con la mayor potencia de 2 que admita el disco (hasta
+// IDE_MULTIPLE_MAX): la transferencia PIO espera un DRQ por bloque y no por
+// sector. Si el disco no lo admite o lo rechaza se queda en 1.
+static void ide_set_multiple_mode(ide_disk_t *disk) {
+    disk->multiple_sectors = 1;
+    uint8_t sectors = 1;
+    while (sectors * 2 <= disk->multiple_max && sectors * 2 <= IDE_MULTIPLE_MAX) {
+        sectors *= 2;
+    }
+    if (sectors == 1) {
+        return;
+    }
+
+    ide_select_drive(disk);
+    ide_400ns_delay(disk);
+    if (ide_channel_wait(disk->bus, ATA_STATUS_BSY | ATA_STATUS_RDY,
+                         ATA_STATUS_RDY, true, false) != 0) {
+        return;
+    }
+    outb(disk->io_base + ATA_SECTOR_COUNT, sectors);
+    outb(disk->io_base + ATA_COMMAND_PORT, ATA_CMD_SET_MULTIPLE_MODE);
+    ide_400ns_delay(disk);
+    if (ide_channel_wait(disk->bus, ATA_STATUS_BSY, 0, false, false) != 0 ||
+        (ide_read_status(disk) & ATA_STATUS_ERR)) {
+        terminal_printf(&main_terminal, "IDE: SET MULTIPLE %u rejected\r\n", sectors);
+        return;
+    }
+    disk->multiple_sectors = sectors;
+    terminal_printf(&main_terminal, "IDE: %u sectors per DRQ block\r\n", sectors);
+}
+
+// Comando PIO según LBA48 y el bloque DRQ configurado
+static uint8_t ide_pio_command(ide_disk_t *disk, bool write) {
+    if (disk->multiple_sectors > 1) {
+        if (write) {
+            return disk->supports_lba48 ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_MULTIPLE;
+        }
+        return disk->supports_lba48 ? ATA_CMD_READ_MULTIPLE_EXT : ATA_CMD_READ_MULTIPLE;
+    }
+    if (write) {
+        return disk->supports_lba48 ? ATA_CMD_WRITE_SECTORS_EXT : ATA_CMD_WRITE_SECTORS;
+    }
+    return disk->supports_lba48 ? ATA_CMD_READ_SECTORS_EXT : ATA_CMD_READ_SECTORS;
+}
+
+// Sectores del siguiente bloque DRQ (el último puede ser más corto)
+static uint32_t ide_drq_block(ide_disk_t *disk, uint32_t remaining) {
+    uint32_t block = disk->multiple_sectors ? disk->multiple_sectors : 1;
+    return remaining < block ? remaining : block;
+}
+
 static int ide_prepare_command(ide_disk_t *disk, uint64_t lba, uint32_t count, uint8_t cmd) {
     if (count == 0 || count > 255) {
         return -1;
@@ -407,8 +607,9 @@ static int ide_prepare_command(ide_disk_t *disk, uint64_t lba, uint32_t count, u
         outb(disk->io_base + ATA_LBA_HIGH, (lba >> 16) & 0xFF);
     }
     
-    // Esperar a que esté listo
-    if (ide_wait_ready(disk) != 0) {
+    // Esperar a que esté listo (no hay comando en curso que interrumpa)
+    if (ide_wait_status(disk, ATA_STATUS_BSY | ATA_STATUS_RDY, ATA_STATUS_RDY,
+                        false, "drive ready") != 0) {
         return -1;
     }
     
@@ -418,6 +619,170 @@ static int ide_prepare_command(ide_disk_t *disk, uint64_t lba, uint32_t count, u
     return 0;
 }
 
+// ========================================================================
+// BUS-MASTER DMA
+// ========================================================================
+
+bool ide_dma_available(void) {
+    return ide_channels[0].prdt || ide_channels[1].prdt;
+}
+
+void ide_set_dma_enabled(bool enabled) { ide_dma_on = enabled; }
+
+bool ide_dma_enabled(void) { return ide_dma_on && ide_dma_available(); }
+
+// Busca la controladora IDE del PCI con bus-master y prepara la tabla PRD
+// de los canales con discos que admiten DMA
+static void ide_dma_init(ide_driver_priv_t *priv) {
+    pci_device_t *pci = pci_find_device_by_class(PCI_CLASS_STORAGE, 0x01);
+    if (!pci || !(pci->prog_if & 0x80)) {
+        terminal_puts(&main_terminal, "IDE: No bus-master controller, using PIO\r\n");
+        return;
+    }
+    uint32_t bar4 = pci_config_read_dword(pci->bus, pci->device, pci->function, 0x20);
+    if (!(bar4 & 1) || (bar4 & 0xFFFC) == 0) {
+        terminal_puts(&main_terminal, "IDE: BMIDE is not an I/O BAR, using PIO\r\n");
+        return;
+    }
+    if (!dma_init()) {
+        return;
+    }
+    pci_enable_io_space(pci);
+    pci_enable_bus_mastering(pci);
+
+    for (uint8_t bus = 0; bus < 2; bus++) {
+        uint8_t dma_drives = 0;
+        for (uint8_t drive = 0; drive < 2; drive++) {
+            ide_disk_t *disk = &priv->disks[bus * 2 + drive];
+            if (disk->initialized && disk->supports_dma) {
+                dma_drives |= 1 << drive;
+            }
+        }
+        if (!dma_drives) {
+            continue;
+        }
+
+        ide_channel_t *ch = &ide_channels[bus];
+        // Alineada a su tamaño: nunca cruza un límite de 64 KiB
+        ch->prdt = dma_alloc_buffer(IDE_PRD_ENTRIES * sizeof(dma_ide_prd_t),
+                                    IDE_PRD_ENTRIES * sizeof(dma_ide_prd_t));
+        if (!ch->prdt) {
+            continue;
+        }
+        ch->bm_base = (uint16_t)(bar4 & 0xFFFC) + bus * 8;
+        outb(ch->bm_base + IDE_BM_CMD, 0);
+        outb(ch->bm_base + IDE_BM_STATUS,
+             (dma_drives << 5) | IDE_BM_STATUS_ERROR | IDE_BM_STATUS_IRQ);
+        terminal_printf(&main_terminal, "IDE: Bus-master DMA on channel %u (0x%04x)\r\n",
+                        bus, ch->bm_base);
+    }
+}
+
+static bool ide_dma_usable(ide_disk_t *disk, const void *buffer) {
+    ide_channel_t *ch = &ide_channels[disk->bus & 1];
+    // Las regiones del PRD deben empezar en dirección par
+    return ide_dma_on && ch->prdt && disk->supports_dma &&
+           !((uintptr_t)buffer & 1);
+}
+
+// Reset por software del canal (afecta a las dos unidades): aborta un
+// comando que no terminó. Hasta que BSY baja no se puede reenviar nada.
+static int ide_channel_reset(ide_disk_t *disk) {
+    ide_channel_t *ch = &ide_channels[disk->bus & 1];
+    outb(ch->io_ctrl, 0x04); // SRST
+    for (int i = 0; i < 16; i++) { // Mínimo 5 us
+        inb(ch->io_ctrl);
+    }
+    outb(ch->io_ctrl, 0x00); // Soltar SRST con nIEN = 0
+    ide_400ns_delay(disk);
+    if (ide_channel_wait(disk->bus, ATA_STATUS_BSY, 0, false, false) != 0) {
+        terminal_printf(&main_terminal, "IDE: channel %u still busy after reset\r\n",
+                        disk->bus & 1);
+        return -1;
+    }
+    // El modo múltiple puede no sobrevivir al reset, en ninguna de las dos
+    if (ide_priv) {
+        for (uint8_t drive = 0; drive < 2; drive++) {
+            ide_disk_t *d = &ide_priv->disks[(disk->bus & 1) * 2 + drive];
+            if (d->initialized && d->multiple_sectors > 1) {
+                ide_set_multiple_mode(d);
+            }
+        }
+    }
+    return 0;
+}
+
+// Un comando DMA de hasta IDE_DMA_MAX_SECTORS que quepa en la tabla PRD
+static int ide_dma_command(ide_disk_t *disk, uint64_t lba, uint32_t count,
+                           void *buffer, bool write) {
+    ide_channel_t *ch = &ide_channels[disk->bus & 1];
+    dma_ide_prd_t *prdt = (dma_ide_prd_t *)ch->prdt->virtual_address;
+    uint32_t bytes = count * 512;
+    if (dma_fill_ide_prdt(prdt, IDE_PRD_ENTRIES, buffer, bytes) != bytes) {
+        return -1;
+    }
+
+    uint16_t bm = ch->bm_base;
+    uint8_t direction = write ? 0 : IDE_BM_CMD_READ;
+    outb(bm + IDE_BM_CMD, direction); // Parado
+    outl(bm + IDE_BM_PRDT, ch->prdt->physical_address);
+    outb(bm + IDE_BM_STATUS, (inb(bm + IDE_BM_STATUS) & IDE_BM_STATUS_DRV_DMA) |
+                                 IDE_BM_STATUS_ERROR | IDE_BM_STATUS_IRQ);
+
+    uint8_t cmd;
+    if (write) {
+        cmd = disk->supports_lba48 ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA;
+    } else {
+        cmd = disk->supports_lba48 ? ATA_CMD_READ_DMA_EXT : ATA_CMD_READ_DMA;
+    }
+    if (ide_prepare_command(disk, lba, count, cmd) != 0) {
+        return -1;
+    }
+    outb(bm + IDE_BM_CMD, direction | IDE_BM_CMD_START);
+    ide_400ns_delay(disk);
+
+    // Termina con BSY y DRQ a 0 y la interrupción del canal
+    int ret = ide_channel_wait(disk->bus, ATA_STATUS_BSY | ATA_STATUS_DRQ, 0,
+                               true, true);
+    outb(bm + IDE_BM_CMD, direction);
+    uint8_t bm_status = inb(bm + IDE_BM_STATUS);
+    outb(bm + IDE_BM_STATUS, (bm_status & IDE_BM_STATUS_DRV_DMA) |
+                                 IDE_BM_STATUS_ERROR | IDE_BM_STATUS_IRQ);
+
+    if (ret != 0 || (bm_status & IDE_BM_STATUS_ERROR) ||
+        ide_check_error(disk, NULL, 0) != 0) {
+        ch->dma_errors++;
+        terminal_printf(&main_terminal,
+                        "IDE: DMA %s failed at LBA %llu (bm 0x%02x), using PIO\r\n",
+                        write ? "write" : "read", lba, bm_status);
+        // Si venció el plazo la unidad sigue con el comando: el reintento
+        // PIO no puede empezar hasta que se aborte
+        if (ret == -2) {
+            ide_channel_reset(disk);
+        }
+        return -1;
+    }
+    disk->dma_count++;
+    return 0;
+}
+
+// Toda la transferencia en los comandos DMA más largos posibles
+static int ide_dma_transfer(ide_disk_t *disk, uint64_t lba, uint32_t count,
+                            void *buffer, bool write) {
+    uint8_t *buf = (uint8_t *)buffer;
+    while (count > 0) {
+        uint32_t sectors = count < IDE_DMA_MAX_SECTORS ? count : IDE_DMA_MAX_SECTORS;
+        sectors = dma_fill_ide_prdt(NULL, IDE_PRD_ENTRIES, buf, sectors * 512) / 512;
+        if (sectors == 0 || ide_dma_command(disk, lba, sectors, buf, write) != 0) {
+            return -1;
+        }
+        buf += sectors * 512;
+        lba += sectors;
+        count -= sectors;
+    }
+    return 0;
+}
+
 int ide_read_sectors(ide_disk_t *disk, uint64_t lba, uint32_t count, void *buffer) {
     if (!disk || !disk->initialized || !buffer || count == 0) {
         return -1;
@@ -429,6 +794,12 @@ int ide_read_sectors(ide_disk_t *disk, uint64_t lba, uint32_t count, void *buffe
         return -1;
     }
     
+    if (ide_dma_usable(disk, buffer) &&
+        ide_dma_transfer(disk, lba, count, buffer, false) == 0) {
+        disk->read_count++;
+        return 0;
+    }
+    
     uint8_t *buf = (uint8_t *)buffer;
     uint32_t sectors_done = 0;
     int retries = IDE_RETRIES;
@@ -440,13 +811,15 @@ int ide_read_sectors(ide_disk_t *disk, uint64_t lba, uint32_t count, void *buffe
             sectors_to_process = 255;
         }
         
-        uint8_t cmd = disk->supports_lba48 ? ATA_CMD_READ_SECTORS_EXT : ATA_CMD_READ_SECTORS;
+        uint8_t cmd = ide_pio_command(disk, false);
         
         if (ide_prepare_command(disk, lba + sectors_done, sectors_to_process, cmd) != 0) {
             continue;
         }
         
-        for (uint32_t sector = 0; sector < sectors_to_process; sector++) {
+        // Una interrupción y un DRQ por bloque
+        for (uint32_t sector = 0; sector < sectors_to_process;) {
+            uint32_t block = ide_drq_block(disk, sectors_to_process - sector);
             if (ide_wait_drq(disk) != 0) {
                 break;
             }
@@ -456,9 +829,10 @@ int ide_read_sectors(ide_disk_t *disk, uint64_t lba, uint32_t count, void *buffe
                 break;
             }
             
-            pio_read16(disk->io_base + ATA_DATA_PORT, buf, 256); // 512 bytes = 256 words
-            buf += 512;
-            sectors_done++;
+            pio_read16(disk->io_base + ATA_DATA_PORT, buf, block * 256); // 256 words por sector
+            buf += block * 512;
+            sector += block;
+            sectors_done += block;
         }
         
         if (sectors_done == count && ide_check_error(disk, NULL, 0) == 0) {
@@ -482,6 +856,14 @@ int ide_write_sectors(ide_disk_t *disk, uint64_t lba, uint32_t count, const void
         return -1;
     }
     
+    // Con la caché volcada, como tras la escritura por PIO
+    if (ide_dma_usable(disk, buffer) &&
+        ide_dma_transfer(disk, lba, count, (void *)buffer, true) == 0 &&
+        ide_flush_cache(disk) == 0) {
+        disk->write_count++;
+        return 0;
+    }
+    
     const uint8_t *buf = (const uint8_t *)buffer;
     uint32_t sectors_done = 0;
     int retries = IDE_RETRIES;
@@ -493,20 +875,25 @@ int ide_write_sectors(ide_disk_t *disk, uint64_t lba, uint32_t count, const void
             sectors_to_process = 255;
         }
         
-        uint8_t cmd = disk->supports_lba48 ? ATA_CMD_WRITE_SECTORS_EXT : ATA_CMD_WRITE_SECTORS;
+        uint8_t cmd = ide_pio_command(disk, true);
         
         if (ide_prepare_command(disk, lba + sectors_done, sectors_to_process, cmd) != 0) {
             continue;
         }
         
-        for (uint32_t sector = 0; sector < sectors_to_process; sector++) {
-            if (ide_wait_drq(disk) != 0) {
+        for (uint32_t sector = 0; sector < sectors_to_process;) {
+            uint32_t block = ide_drq_block(disk, sectors_to_process - sector);
+            // El primer DRQ de una escritura PIO no genera interrupción; los
+            // siguientes ya están cuando vuelve ide_wait_ready
+            if (ide_wait_status(disk, ATA_STATUS_DRQ, ATA_STATUS_DRQ,
+                                sector != 0, "DRQ") != 0) {
                 break;
             }
             
-            pio_write16(disk->io_base + ATA_DATA_PORT, buf, 256); // 512 bytes = 256 words
-            buf += 512;
-            sectors_done++;
+            pio_write16(disk->io_base + ATA_DATA_PORT, buf, block * 256); // 256 words por sector
+            buf += block * 512;
+            sector += block;
+            sectors_done += block;
             
             // Esperar a que termine la escritura
             if (ide_wait_ready(disk) != 0) {
@@ -568,6 +955,7 @@ static int ide_driver_init(driver_instance_t *drv, void *config) {
             
             if (ide_detect_disk(bus, drive, disk)) {
                 priv->disk_count++;
+                ide_channel_irq_enable(bus);
                 terminal_printf(&main_terminal, "IDE: Found disk at bus %u, drive %u\r\n",
                                 bus, drive);
             } else {
@@ -577,6 +965,8 @@ static int ide_driver_init(driver_instance_t *drv, void *config) {
         }
     }
     
+    ide_dma_init(priv);
+    
     priv->initialized = true;
     priv->driver_instance = drv;
     
@@ -740,10 +1130,19 @@ void ide_list_devices(void) {
         terminal_printf(&main_terminal, "  Firmware: %s\r\n", disk->firmware);
         terminal_printf(&main_terminal, "  Sectors: %llu\r\n", disk->sector_count);
         terminal_printf(&main_terminal, "  LBA48: %s\r\n", disk->supports_lba48 ? "Yes" : "No");
-        terminal_printf(&main_terminal, "  Reads: %llu, Writes: %llu, Errors: %llu\r\n",
-                       disk->read_count, disk->write_count, disk->error_count);
+        terminal_printf(&main_terminal, "  PIO: %u sectors per DRQ block (max %u)\r\n",
+                        disk->multiple_sectors, disk->multiple_max);
+        terminal_printf(&main_terminal, "  DMA: %s (UDMA modes 0x%02x)\r\n",
+                        !disk->supports_dma ? "No"
+                        : ide_channels[disk->bus & 1].prdt ? "Bus-master"
+                                                          : "No controller",
+                        disk->udma_modes);
+        terminal_printf(&main_terminal, "  Reads: %llu, Writes: %llu, Errors: %llu, DMA commands: %llu\r\n",
+                       disk->read_count, disk->write_count, disk->error_count,
+                       disk->dma_count);
         terminal_puts(&main_terminal, "\r\n");
     }
+    ide_print_irq_stats();
 }
 
 uint8_t ide_get_disk_count(void) {
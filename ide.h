@@ -13,6 +13,15 @@
 #define ATA_CMD_WRITE_SECTORS_EXT 0x34
 #define ATA_CMD_IDENTIFY 0xEC
 #define ATA_CMD_SET_FEATURES 0xEF
+#define ATA_CMD_READ_MULTIPLE 0xC4
+#define ATA_CMD_READ_MULTIPLE_EXT 0x29
+#define ATA_CMD_WRITE_MULTIPLE 0xC5
+#define ATA_CMD_WRITE_MULTIPLE_EXT 0x39
+#define ATA_CMD_SET_MULTIPLE_MODE 0xC6
+#define ATA_CMD_READ_DMA 0xC8
+#define ATA_CMD_READ_DMA_EXT 0x25
+#define ATA_CMD_WRITE_DMA 0xCA
+#define ATA_CMD_WRITE_DMA_EXT 0x35
 #define ATA_CMD_CACHE_FLUSH 0xE7
 #define ATA_CMD_DEVICE_RESET 0x08
 
@@ -36,6 +45,20 @@
 #define ATA_DEVCTL 0x206   // Device Control (write) - offset en puerto de control
 #define ATA_ALT_STATUS 0x206 // Alternate Status (read) - offset en puerto de control
 
+// Bus-master IDE (BAR4 de la controladora PCI; el secundario en +8)
+#define IDE_BM_CMD 0x0
+#define IDE_BM_STATUS 0x2
+#define IDE_BM_PRDT 0x4
+#define IDE_BM_CMD_START 0x01
+#define IDE_BM_CMD_READ 0x08 // Del dispositivo a memoria
+#define IDE_BM_STATUS_ACTIVE 0x01
+#define IDE_BM_STATUS_ERROR 0x02
+#define IDE_BM_STATUS_IRQ 0x04
+#define IDE_BM_STATUS_DRV_DMA 0x60 // "Drive N DMA capable", lectura/escritura
+
+#define IDE_PRD_ENTRIES 64       // 512 bytes de tabla por canal
+#define IDE_DMA_MAX_SECTORS 255  // Lo que admite ide_prepare_command
+
 // Estados ATA
 #define ATA_STATUS_BSY 0x80
 #define ATA_STATUS_RDY 0x40
@@ -55,6 +78,9 @@
 #define SATA_SIGNATURE_LBA_MID 0x3C
 #define SATA_SIGNATURE_LBA_HIGH 0xC3
 
+// READ/WRITE MULTIPLE: sectores por bloque DRQ como máximo
+#define IDE_MULTIPLE_MAX 16
+
 // Timeouts
 #define IDE_TIMEOUT_MS 5000
 #define IDE_RETRIES 3
@@ -74,6 +100,10 @@ typedef struct {
     bool present;         // Dispositivo presente
     bool initialized;     // Inicializado
     bool supports_lba48;  // Soporta LBA48
+    bool supports_dma;    // Multiword/Ultra DMA (IDENTIFY palabra 49)
+    uint8_t udma_modes;   // Modos Ultra DMA soportados (palabra 88)
+    uint8_t multiple_max; // Máximo por bloque DRQ (palabra 47), 0 = no hay
+    uint8_t multiple_sectors; // Bloque DRQ configurado; 1 = READ/WRITE SECTORS
     uint64_t sector_count;// Número de sectores
     uint32_t sector_size; // Tamaño de sector (512 bytes para IDE)
     
@@ -90,6 +120,7 @@ typedef struct {
     uint64_t read_count;
     uint64_t write_count;
     uint64_t error_count;
+    uint64_t dma_count;   // Comandos hechos por DMA
 } ide_disk_t;
 
 // Estructura privada del driver IDE
@@ -122,6 +153,46 @@ int ide_wait_drq(ide_disk_t *disk);
 uint8_t ide_read_status(ide_disk_t *disk);
 int ide_check_error(ide_disk_t *disk, char *error_msg, size_t msg_size);
 
+// ========================================================================
+// ESPERA POR INTERRUPCIÓN (compartida con ATAPI)
+// ========================================================================
+//
+// Cada canal (0 = primario, IRQ 14; 1 = secundario, IRQ 15) tiene su wait
+// queue. El handler lee el registro de estado, que reconoce la interrupción
+// en el dispositivo, y despierta a quien espere. Las esperas miran el
+// estado alternativo, giran IDE_IRQ_SPINS lecturas por si el dispositivo
+// ya está listo y luego duermen hasta la siguiente interrupción. Mientras
+// el canal no haya dado ninguna, o si el llamador no puede dormir, se
+// sondea como antes.
+
+#define IDE_IRQ_SPINS 64          // Lecturas de estado antes de dormir
+#define IDE_IRQ_TIMEOUT_TICKS 100 // 1 s, como las esperas por sondeo
+
+// Registra el handler del canal y quita nIEN (se puede llamar varias veces)
+void ide_channel_irq_enable(uint8_t bus);
+
+// Espera a que (estado & mask) == value. 'irq': el comando en curso avisará
+// con una interrupción y se puede dormir. Devuelve 0, -1 si el dispositivo
+// marca ERR (con check_err) o -2 si vence el plazo.
+int ide_channel_wait(uint8_t bus, uint8_t mask, uint8_t value, bool check_err,
+                     bool irq);
+void ide_print_irq_stats(void);
+
+// ========================================================================
+// BUS-MASTER DMA
+// ========================================================================
+//
+// Si la controladora IDE del PCI tiene bus-master (prog_if bit 7, BAR4),
+// las lecturas y escrituras de discos con DMA van con READ/WRITE DMA (EXT)
+// y una tabla PRD por canal; el comando termina con la interrupción del
+// canal. Sin BMIDE, con buffers de dirección impar o si el comando DMA
+// falla, se usa PIO.
+
+bool ide_dma_available(void);
+// Para comparar en diskbench: con false todo va por PIO
+void ide_set_dma_enabled(bool enabled);
+bool ide_dma_enabled(void);
+
 // Funciones de información
 void ide_list_devices(void);
 uint8_t ide_get_disk_count(void);
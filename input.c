@@ -0,0 +1,124 @@
+#include "input.h"
+#include "kernel.h"
+#include "sched_stats.h"
+#include "spinlock.h"
+#include "task.h"
+#include "terminal.h"
+
+// ========================================================================
+// ESTADO
+// ========================================================================
+
+// Orden de locks: input_lock -> scheduler_lock (lo toma la wait queue)
+static spinlock_t input_lock = SPINLOCK_INIT("input");
+static wait_queue_t input_wq = WAIT_QUEUE_INIT("input");
+static volatile uint32_t input_seq = 0;
+
+static uint32_t input_counts[NR_INPUT_SOURCES];
+static uint32_t input_boosted_wakeups = 0;
+
+// Tecla -> glifo. Solo se mide la tecla más antigua sin pintar: las que
+// llegan antes del siguiente repintado salen en el mismo.
+static uint64_t key_pending_since = 0; // 0 = nada pendiente
+static uint32_t key_samples = 0;
+static uint64_t key_total_us = 0;
+static uint32_t key_max_us = 0;
+static uint32_t key_hist[SCHED_HIST_BUCKETS];
+
+static const char *const input_source_names[NR_INPUT_SOURCES] = {"keyboard",
+                                                                 "mouse"};
+
+// ========================================================================
+// EVENTOS
+// ========================================================================
+
+void input_event(input_source_t source) {
+  uint32_t flags = spin_lock_irqsave(&input_lock);
+  input_seq++;
+  if (source < NR_INPUT_SOURCES)
+    input_counts[source]++;
+  if (source == INPUT_SOURCE_KEYBOARD && !key_pending_since)
+    key_pending_since = sched_clock();
+  input_boosted_wakeups += wait_queue_wake_all_boosted(&input_wq);
+  spin_unlock_irqrestore(&input_lock, flags);
+}
+
+uint32_t input_event_seq(void) { return input_seq; }
+
+bool input_wait(uint32_t seen_seq, uint32_t timeout_ticks) {
+  uint32_t flags = spin_lock_irqsave(&input_lock);
+  if (input_seq == seen_seq)
+    wait_queue_sleep(&input_wq, &input_lock, timeout_ticks);
+  bool arrived = input_seq != seen_seq;
+  spin_unlock_irqrestore(&input_lock, flags);
+  return arrived;
+}
+
+// ========================================================================
+// LATENCIA TECLA -> GLIFO
+// ========================================================================
+
+void input_glyph_drawn(void) {
+  if (!key_pending_since)
+    return;
+
+  uint32_t flags = spin_lock_irqsave(&input_lock);
+  if (key_pending_since) {
+    uint64_t us64 = sched_clock_to_us(sched_clock() - key_pending_since);
+    uint32_t us = us64 > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)us64;
+    key_pending_since = 0;
+    key_samples++;
+    key_total_us += us;
+    if (us > key_max_us)
+      key_max_us = us;
+    key_hist[sched_hist_bucket(us)]++;
+  }
+  spin_unlock_irqrestore(&input_lock, flags);
+}
+
+void input_latency_reset(void) {
+  uint32_t flags = spin_lock_irqsave(&input_lock);
+  key_pending_since = 0;
+  key_samples = 0;
+  key_total_us = 0;
+  key_max_us = 0;
+  for (uint32_t i = 0; i < SCHED_HIST_BUCKETS; i++)
+    key_hist[i] = 0;
+  spin_unlock_irqrestore(&input_lock, flags);
+}
+
+void input_print_stats(void) {
+  uint32_t flags = spin_lock_irqsave(&input_lock);
+  uint32_t samples = key_samples;
+  uint64_t total_us = key_total_us;
+  uint32_t max_us = key_max_us;
+  uint32_t hist[SCHED_HIST_BUCKETS];
+  for (uint32_t i = 0; i < SCHED_HIST_BUCKETS; i++)
+    hist[i] = key_hist[i];
+  spin_unlock_irqrestore(&input_lock, flags);
+
+  terminal_puts(&main_terminal, "\r\n=== Input latency ===\r\n");
+  for (uint32_t i = 0; i < NR_INPUT_SOURCES; i++)
+    terminal_printf(&main_terminal, "%-9s %u events\r\n",
+                    input_source_names[i], input_counts[i]);
+  terminal_printf(&main_terminal, "Boosted wakeups: %u\r\n",
+                  input_boosted_wakeups);
+
+  if (!samples) {
+    terminal_puts(&main_terminal, "No keypresses measured yet\r\n");
+    return;
+  }
+  if (!sched_clock_mhz())
+    terminal_puts(&main_terminal,
+                  "No TSC: durations have timer tick resolution\r\n");
+
+  terminal_printf(&main_terminal,
+                  "Keypress -> glyph: %u samples, avg %u us, max %u us\r\n",
+                  samples, (uint32_t)(total_us / samples), max_us);
+  for (uint32_t i = 0; i < SCHED_HIST_BUCKETS; i++) {
+    if (hist[i])
+      terminal_printf(&main_terminal, "  >=%uus %u\r\n",
+                      sched_hist_bucket_floor_us(i), hist[i]);
+  }
+  terminal_puts(&main_terminal, "'inputlat reset' clears the samples\r\n");
+}
@@ -0,0 +1,44 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ========================================================================
+// EVENTOS DE ENTRADA Y LATENCIA TECLA -> GLIFO
+// ========================================================================
+//
+// Teclado (PS/2 y USB) y mouse avisan aquí de cada evento. Las tareas
+// interactivas (shell, editor, top, lecturas de stdin) esperan en
+// input_wait() en lugar de dormir un número fijo de ticks; al llegar un
+// evento se despiertan con ventaja en el planificador y desalojan a la
+// tarea actual sin esperar al fin de su quantum.
+//
+// Para medir el efecto, cada tecla se marca con sched_clock() al entrar y
+// la medida se cierra cuando quien pinta la pantalla llama a
+// input_glyph_drawn(). Se ve con el comando "inputlat".
+
+typedef enum {
+  INPUT_SOURCE_KEYBOARD = 0,
+  INPUT_SOURCE_MOUSE,
+  NR_INPUT_SOURCES
+} input_source_t;
+
+// Notificar un evento (válido desde IRQ y desde tarea)
+void input_event(input_source_t source);
+
+// Contador de eventos: se lee antes de comprobar la condición y se pasa a
+// input_wait() para no perder un evento que llegue entre medias
+uint32_t input_event_seq(void);
+
+// Dormir hasta que haya un evento posterior a 'seen_seq' o venzan
+// timeout_ticks (0 = sin límite). Devuelve true si hubo evento.
+bool input_wait(uint32_t seen_seq, uint32_t timeout_ticks);
+
+// La tecla más antigua sin pintar ya está en pantalla
+void input_glyph_drawn(void);
+
+void input_latency_reset(void);
+void input_print_stats(void);
+
+#endif // INPUT_H
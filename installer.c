@@ -7,6 +7,7 @@
 #include "terminal.h"
 #include "kernel.h"
 #include "serial.h"
+#include "task.h"
 
 extern Terminal main_terminal;
 
@@ -354,6 +355,7 @@ install_err_t installer_copy_files(installer_state_t *state) {
         }
         written += result;
         state->bytes_written += result;
+        cond_resched();
         
         if (written % 16384 == 0) {
             terminal_printf(&main_terminal, "    Progress: %u/%u bytes\n", 
@@ -389,6 +391,7 @@ install_err_t installer_copy_files(installer_state_t *state) {
             }
             written += result;
             state->bytes_written += result;
+            cond_resched();
         }
         vfs_close(fd);
         state->files_written++;
@@ -424,6 +427,7 @@ install_err_t installer_copy_files(installer_state_t *state) {
                 }
                 written += result;
                 state->bytes_written += result;
+                cond_resched();
             }
             vfs_close(fd);
             state->files_written++;
@@ -25,7 +25,7 @@ extern timer_irq_handler
 extern keyboard_irq_handler
 extern serial_irq_handler_line
 extern irq_common_handler
-extern ahci_irq_handler
+extern irq_dispatch
 extern mouse_irq_handler
 section .text
 
@@ -57,7 +57,25 @@ irq0_entry:
 irq1_entry:
     cli
     pusha
+    push ds
+    push es
+    push fs
+    push gs
+
+    ; Set kernel data segments (el handler puede cambiar de tarea)
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+
     call keyboard_irq_handler
+
+    ; Restore segments
+    pop gs
+    pop fs
+    pop es
+    pop ds
     popa
     iretd
 
@@ -155,11 +173,34 @@ irq52_entry:
     popa
     iretd
 
-irq5_entry:
+; Líneas con handlers registrados (irq_register_handler): pasan el número
+; de IRQ a irq_dispatch, que llama a los handlers y manda el EOI
+%macro IRQ_DISPATCH_STUB 1
+irq%{1}_entry:
     pusha
-    call irq_common_handler
+    push ds
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+
+    push dword %1
+    call irq_dispatch
+    add esp, 4
+    pop gs
+    pop fs
+    pop es
+    pop ds
     popa
     iretd
+%endmacro
+
+IRQ_DISPATCH_STUB 5
 
 
 irq6_entry:
@@ -180,23 +221,11 @@ irq8_entry:
     popa
     iretd
 
-irq9_entry:
-    pusha
-    call irq_common_handler
-    popa
-    iretd
+IRQ_DISPATCH_STUB 9
 
-irq10_entry:
-    pusha
-    call irq_common_handler
-    popa
-    iretd
+IRQ_DISPATCH_STUB 10
 
-irq11_entry:
-    pusha
-    call irq_common_handler
-    popa
-    iretd
+IRQ_DISPATCH_STUB 11
 
 irq12_entry:
     cli
@@ -230,35 +259,7 @@ irq13_entry:
     popa
     iretd
 
-irq14_entry:
-    cli
-    pusha
-    push ds
-    push es
-    push fs
-    push gs
-    
-    ; Set kernel data segments
-    mov ax, 0x10
-    mov ds, ax
-    mov es, ax
-    mov fs, ax
-    mov gs, ax
-    
-    call ahci_irq_handler
-    
-    ; Restore segments
-    pop gs
-    pop fs
-    pop es
-    pop ds
-    popa
-    sti
-    iretd
+IRQ_DISPATCH_STUB 14
 
-irq15_entry:
-    pusha
-    call irq_common_handler
-    popa
-    iretd
+IRQ_DISPATCH_STUB 15
 
@@ -4,6 +4,7 @@
 #include "io.h"
 #include "kernel.h"
 #include "mouse.h"
+#include "softirq.h"
 #include "task.h"
 
 volatile uint32_t ticks = 0;
@@ -46,6 +47,133 @@ void irq_common_handler(struct regs *r) {
   pic_send_eoi(irq);
 }
 
+// ========================================================================
+// LÍNEAS CON HANDLERS REGISTRADOS
+// ========================================================================
+
+typedef struct {
+  irq_line_handler_t handlers[IRQ_MAX_SHARED];
+  void *ctx[IRQ_MAX_SHARED];
+  uint8_t count;
+  bool active;
+  uint32_t unhandled; // Seguidas sin que nadie la reconozca
+  uint32_t total;
+} irq_line_t;
+
+static irq_line_t irq_lines[16];
+
+extern void irq5_entry();
+extern void irq9_entry();
+extern void irq10_entry();
+extern void irq11_entry();
+extern void irq14_entry();
+extern void irq15_entry();
+
+// Solo estas líneas tienen stub que pasa el número a irq_dispatch
+static uintptr_t irq_line_stub(uint8_t irq) {
+  switch (irq) {
+  case 5:
+    return (uintptr_t)irq5_entry;
+  case 9:
+    return (uintptr_t)irq9_entry;
+  case 10:
+    return (uintptr_t)irq10_entry;
+  case 11:
+    return (uintptr_t)irq11_entry;
+  case 14:
+    return (uintptr_t)irq14_entry;
+  case 15:
+    return (uintptr_t)irq15_entry;
+  default:
+    return 0;
+  }
+}
+
+static bool irq_using_apic(void) {
+  return apic_info.initialized && apic_info.using_apic;
+}
+
+static void irq_line_unmask(uint8_t irq, uintptr_t stub) {
+  if (irq_using_apic()) {
+    idt_set_gate(48 + irq, stub, 0x08,
+                 IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_INTERRUPT32);
+    ioapic_set_irq(apic_irq_to_gsi(irq), 48 + irq, false);
+    return;
+  }
+
+  // PIC: idt_init ya apunta el vector 32 + irq al stub
+  if (irq >= 8) {
+    outb(PIC2_DATA, inb(PIC2_DATA) & ~(1 << (irq - 8)));
+    outb(PIC1_DATA, inb(PIC1_DATA) & ~(1 << 2)); // Cascada
+  } else {
+    outb(PIC1_DATA, inb(PIC1_DATA) & ~(1 << irq));
+  }
+}
+
+static void irq_line_mask(uint8_t irq) {
+  if (irq_using_apic()) {
+    ioapic_mask_irq(apic_irq_to_gsi(irq));
+  } else if (irq >= 8) {
+    outb(PIC2_DATA, inb(PIC2_DATA) | (1 << (irq - 8)));
+  } else {
+    outb(PIC1_DATA, inb(PIC1_DATA) | (1 << irq));
+  }
+}
+
+bool irq_register_handler(uint8_t irq, irq_line_handler_t handler, void *ctx) {
+  uintptr_t stub = irq < 16 ? irq_line_stub(irq) : 0;
+  if (!stub || !handler)
+    return false;
+
+  uint32_t flags = local_irq_save();
+  irq_line_t *line = &irq_lines[irq];
+  if (line->count >= IRQ_MAX_SHARED) {
+    local_irq_restore(flags);
+    return false;
+  }
+  line->handlers[line->count] = handler;
+  line->ctx[line->count] = ctx;
+  line->count++;
+  if (!line->active) {
+    line->active = true;
+    line->unhandled = 0;
+    irq_line_unmask(irq, stub);
+  }
+  local_irq_restore(flags);
+
+  terminal_printf(&main_terminal, "IRQ: Line %u enabled (%u handlers)\r\n",
+                  irq, line->count);
+  return true;
+}
+
+bool irq_line_active(uint8_t irq) { return irq < 16 && irq_lines[irq].active; }
+
+uint32_t irq_line_count(uint8_t irq) {
+  return irq < 16 ? irq_lines[irq].total : 0;
+}
+
+void irq_dispatch(uint32_t irq) {
+  irq_line_t *line = &irq_lines[irq & 15];
+  bool handled = false;
+  for (uint8_t i = 0; i < line->count; i++)
+    handled |= line->handlers[i](line->ctx[i]);
+
+  line->total++;
+  if (handled) {
+    line->unhandled = 0;
+  } else if (++line->unhandled >= IRQ_UNHANDLED_LIMIT && line->active) {
+    line->active = false;
+    irq_line_mask(irq);
+    terminal_printf(&main_terminal,
+                    "IRQ: Line %u disabled (%u interrupts nobody handled)\r\n",
+                    irq, line->unhandled);
+  }
+
+  pic_send_eoi(irq);
+  irq_exit();
+  scheduler_irq_preempt();
+}
+
 void timer_irq_handler() {
   ticks++;
   ticks_since_boot++;
@@ -56,13 +184,24 @@ void timer_irq_handler() {
   pic_send_eoi(0);
 
   if (scheduler.scheduler_enabled) {
-    scheduler_tick();
+    // Top half mínimo: el resto (trabajos diferidos vencidos...) va al
+    // softirq, que corre ya con IRQs habilitadas
+    raise_softirq(SOFTIRQ_TIMER);
+    irq_exit();
+
+    // Punto de expulsión después de los bottom halves, así un worker
+    // despertado ya cuenta. Si esta IRQ interrumpió a un softirq no se
+    // cambia de tarea: se retomaría a medias en otro contexto
+    if (!softirq_in_progress()) {
+      scheduler_tick();
+    }
   }
 }
 
 void mouse_irq_handler() {
   mouse_handle_irq();
   pic_send_eoi(12);
+  scheduler_irq_preempt();
 }
 
 // Canal 0, modo 3 (Square Wave Generator), acceso low/high, modo binario
@@ -220,7 +359,7 @@ void irq_setup_apic(void) {
   idt_set_gate(60, (uintptr_t)irq12_entry, 0x08,
                IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_INTERRUPT32);
 
-  // IDE - IRQ 14 y 15 (masked por ahora)
+  // IDE - IRQ 14 y 15 (masked hasta que un driver registre su handler)
   uint32_t gsi_ide1 = apic_irq_to_gsi(14);
   ioapic_set_irq(gsi_ide1, 62, true);
   terminal_printf(&main_terminal,
@@ -2,6 +2,7 @@
 #define IRQ_H
 
 #include "isr.h"
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -30,6 +31,29 @@ extern volatile uint32_t ticks_since_boot;
 // Tipo para manejadores de IRQ
 typedef void (*irq_handler_t)(struct regs *);
 
+// ========================================================================
+// LÍNEAS CON HANDLERS REGISTRADOS
+// ========================================================================
+//
+// IRQ 5, 9, 10, 11 (PCI) y 14, 15 (IDE): los drivers registran su top half
+// e irq_dispatch() (llamado desde irq.asm) los llama todos, manda el EOI,
+// corre los bottom halves y deja expulsar a la tarea actual. Al registrar el
+// primero se desenmascara la línea en el I/O APIC (vector 48 + irq) o en el
+// PIC. Si la línea llega IRQ_UNHANDLED_LIMIT veces seguidas sin que ningún
+// handler la reconozca (otro dispositivo que comparte una línea por nivel)
+// se vuelve a enmascarar y los drivers siguen sondeando.
+
+#define IRQ_MAX_SHARED 4
+#define IRQ_UNHANDLED_LIMIT 10000
+
+// Devuelve true si la interrupción era de su dispositivo
+typedef bool (*irq_line_handler_t)(void *ctx);
+
+bool irq_register_handler(uint8_t irq, irq_line_handler_t handler, void *ctx);
+bool irq_line_active(uint8_t irq);
+uint32_t irq_line_count(uint8_t irq);
+void irq_dispatch(uint32_t irq);
+
 // Funciones públicas
 void timer_irq_handler(void); // <-- Debe estar visible
 void irq_common_handler(struct regs *r);
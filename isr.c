@@ -398,6 +398,10 @@ void isr_handler(struct regs *r) {
 
   // Manejar excepciones críticas
   switch (r->int_no) {
+  case 7: // Device Not Available (cambio perezoso de FPU/SSE)
+    fpu_handle_nm(r);
+    break;
+
   case 14: // Page Fault
     handle_page_fault(r);
     break;
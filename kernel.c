@@ -2,6 +2,7 @@
 #include "acpi.h"
 #include "apic.h"
 #include "atapi.h"
+#include "bcache.h"
 #include "chardev.h"
 #include "chardev_vfs.h"
 #include "cpuid.h"
@@ -12,13 +13,17 @@
 #include "driver_system.h"
 #include "e1000.h"
 #include "fat32.h"
+#include "fpu.h"
 #include "gdt.h"
 #include "ide.h"
 #include "idt.h"
+#include "input.h"
 #include "io.h"
 #include "irq.h"
 #include "keyboard.h"
+#include "latency.h"
 #include "log.h"
+#include "memutils.h"
 #include "mmu.h"
 #include "module_loader.h"
 #include "mouse.h"
@@ -29,14 +34,17 @@
 #include "pci.h"
 #include "pmm.h"
 #include "sata_disk.h"
+#include "sched_stats.h"
 #include "serial.h"
 #include "syscalls.h"
 #include "task.h"
 #include "task_utils.h"
 #include "terminal.h"
+#include "timer.h"
 #include "tmpfs.h"
 #include "usb_hid.h"
 #include "vfs.h"
+#include "workqueue.h"
 
 // Global definition of BootInfo.
 BootInfo boot_info;
@@ -91,6 +99,9 @@ void unmount_callback(const char *mountpoint, const char *fs_name, void *arg) {
 void shutdown(void) {
   terminal_printf(&main_terminal, "\n\nSystem shutdown initiated\r\n");
   serial_write_string(COM1_BASE, "System shutdown initiated\r\n");
+  // Volcar la caché de bloques mientras el planificador sigue activo (el
+  // volcador podría tener el mutex de la caché)
+  bcache_sync(NULL);
   terminal_destroy(&main_terminal);
   // 1. Deshabilitar interrupciones
   __asm__ volatile("cli");
@@ -237,6 +248,10 @@ void cmain(uint32_t magic, struct multiboot_tag *mb_info) {
   idt_init();
 
   cpuid_init();
+  fpu_init();
+  sched_clock_init();
+  latency_init(); // IRQs-off / preempt-off tracer (usa sched_clock)
+  memutils_init();
 
   // Inicializar PIT a 100Hz temporalmente
   uint32_t divisor = 1193180 / 100;
@@ -257,6 +272,7 @@ void cmain(uint32_t magic, struct multiboot_tag *mb_info) {
   // NUEVO: Ahora sí inicializar el timer (usará APIC si está disponible)
   __asm__ volatile("cli");
   pit_init(100); // Esto usará APIC timer si está disponible
+  timers_init(); // Rueda de timers del kernel (softirq TIMER)
 
   // 7. Inicializar ACPI/PCI/APIC (MODIFICADO)
   irq_setup_apic();
@@ -298,6 +314,9 @@ void cmain(uint32_t magic, struct multiboot_tag *mb_info) {
   vfs_register_fs(&sysfs_type);
   vfs_register_fs(&devfs_type);
 
+  // Buffer cache de bloques, antes de la primera lectura de disco
+  bcache_init();
+
   // 8. Inicializar SATA/AHCI
   bool sata_available = false;
   if (sata_disk_init()) {
@@ -407,11 +426,14 @@ void cmain(uint32_t magic, struct multiboot_tag *mb_info) {
 
   message_system_init();
 
-  // disk_io_daemon_init();
-  task_t *mem_defrag =
-      task_create("Memory Defrag", memory_defrag_task, NULL, TASK_PRIORITY_LOW);
-  task_t *cleanup =
-      task_create("cleanupd", cleanup_task, NULL, TASK_PRIORITY_LOW);
+  // Workers para el trabajo diferido (defrag, recolector, red, disco)
+  workqueue_init();
+
+  // Cola de peticiones de disco (la usa el volcador del buffer cache)
+  disk_io_daemon_init();
+  memory_defrag_start();
+  task_cleanup_start();
+  bcache_start_flusher();
   // Crear tarea principal del loop
   task_t *main_loop =
       task_create("main_loop", main_loop_task, NULL, TASK_PRIORITY_HIGH);
@@ -556,12 +578,16 @@ void cmain(uint32_t magic, struct multiboot_tag *mb_info) {
 static void main_loop_task(void *arg) {
   (void)arg;
   uint32_t last_update = 0;
+  uint32_t seen_input = input_event_seq();
   terminal_printf(&main_terminal, "[MAIN_LOOP] Task started\r\n");
   keyboard_set_handler(keyboard_terminal_handler);
   while (1) {
     uint32_t current_time = ticks_since_boot * 10; // 10ms per tick a 100Hz
-    // Actualizar cada 50ms (5 ticks)
-    if (current_time - last_update >= 50) {
+    uint32_t input_seq = input_event_seq();
+    // Actualizar cada 50ms (5 ticks) o en cuanto llega entrada: el eco de
+    // la tecla no espera al siguiente parpadeo del cursor
+    if (input_seq != seen_input || current_time - last_update >= 50) {
+      seen_input = input_seq;
       // Actualizar cursor de terminal
       terminal_update_cursor_blink(&main_terminal, current_time);
       static uint8_t last_cursor_visible = 1;
@@ -583,9 +609,9 @@ static void main_loop_task(void *arg) {
     // Poll USB HID (since we don't have proper USB interrupts yet)
     usb_hid_poll();
 
-    // CRÍTICO: Dormir en lugar de yield inmediato
-    // Esto permite que otras tareas se ejecuten
-    task_sleep(1); // Dormir 10ms, luego el scheduler lo despertará
+    // Dormir hasta el próximo tick (sondeo USB) o hasta que llegue entrada;
+    // el despertar por entrada desaloja a la tarea que esté en CPU
+    input_wait(seen_input, 1);
   }
 }
 
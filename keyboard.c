@@ -1,11 +1,13 @@
 #include "keyboard.h"
 #include "idt.h"
+#include "input.h"
 #include "io.h"
 #include "irq.h"
 #include "isr.h"
 #include "kernel.h"
 #include "memory.h"
 #include "string.h"
+#include "task.h"
 #include "terminal.h"
 #include "vfs.h"
 
@@ -198,6 +200,10 @@ void keyboard_inject_scancode(uint8_t scancode) {
     keyboard_buffer_count++;
   }
 
+  // Despertar a quien espera entrada antes de que el callback pinte
+  if (key != 0)
+    input_event(INPUT_SOURCE_KEYBOARD);
+
   // Call callback with key (including specials)
   if (keyboard_callback && key != 0) {
     keyboard_callback(key);
@@ -208,6 +214,8 @@ void keyboard_irq_handler() {
   uint8_t scancode = inb(0x60);
   keyboard_inject_scancode(scancode);
   pic_send_eoi(1);
+  // La tarea despertada por la tecla no espera al fin del quantum
+  scheduler_irq_preempt();
 }
 
 void keyboard_set_handler(KeyboardCallback handler) {
@@ -300,6 +308,26 @@ int keyboard_getkey_nonblock(void) {
   return key;
 }
 
+int keyboard_getkey_wait(uint32_t timeout_ticks) {
+  uint32_t deadline = ticks_since_boot + timeout_ticks;
+  while (1) {
+    // Leer la secuencia antes de mirar el buffer: una tecla que llegue
+    // entre medias hace que input_wait() vuelva al instante
+    uint32_t seq = input_event_seq();
+    int key = keyboard_getkey_nonblock();
+    if (key != -1)
+      return key;
+
+    uint32_t left = 0;
+    if (timeout_ticks) {
+      left = deadline - ticks_since_boot;
+      if ((int32_t)left <= 0)
+        return -1;
+    }
+    input_wait(seq, left);
+  }
+}
+
 void keyboard_clear_buffer(void) {
   uint32_t flags;
   __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
@@ -117,6 +117,9 @@ int keyboard_load_layout(const char *filename, const char *layout_name);
 
 int keyboard_available(void);
 int keyboard_getkey_nonblock(void);
+// Bloquea hasta que haya tecla o venzan timeout_ticks (0 = sin límite).
+// Devuelve -1 si venció.
+int keyboard_getkey_wait(uint32_t timeout_ticks);
 void keyboard_clear_buffer(void);
 
 // Driver registration functions (previously in keyboard_driver.h)
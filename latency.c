@@ -0,0 +1,105 @@
+#include "latency.h"
+#include "kernel.h"
+#include "sched_stats.h"
+#include "spinlock.h"
+#include "terminal.h"
+
+// ========================================================================
+// ESTADO
+// ========================================================================
+
+typedef struct latency_max {
+  uint64_t cycles; // Peor duración vista
+  void *start_where;
+  void *end_where;
+  uint32_t count; // Secciones medidas
+} latency_max_t;
+
+volatile bool latency_trace_enabled = false;
+
+static uint64_t irqsoff_start = 0; // 0 = IRQs habilitadas o sin medir
+static void *irqsoff_where = NULL;
+
+static latency_max_t irqsoff_max;
+static latency_max_t preemptoff_max;
+
+static void latency_note(latency_max_t *max, uint64_t cycles,
+                         void *start_where, void *end_where) {
+  max->count++;
+  if (cycles > max->cycles) {
+    max->cycles = cycles;
+    max->start_where = start_where;
+    max->end_where = end_where;
+  }
+}
+
+// ========================================================================
+// GANCHOS
+// ========================================================================
+
+void latency_init(void) {
+  latency_reset();
+  latency_trace_enabled = true;
+}
+
+void latency_irqs_off(void *where) {
+  irqsoff_start = sched_clock();
+  irqsoff_where = where;
+}
+
+void latency_irqs_on(void *where) {
+  if (!irqsoff_start)
+    return;
+  latency_note(&irqsoff_max, sched_clock() - irqsoff_start, irqsoff_where,
+               where);
+  irqsoff_start = 0;
+}
+
+void latency_preempt_on(uint64_t start, void *start_where, void *end_where) {
+  uint32_t flags = local_irq_save();
+  latency_note(&preemptoff_max, sched_clock() - start, start_where,
+               end_where);
+  local_irq_restore(flags);
+}
+
+// ========================================================================
+// REPORTE
+// ========================================================================
+
+void latency_reset(void) {
+  uint32_t flags = local_irq_save();
+  irqsoff_max = (latency_max_t){0};
+  preemptoff_max = (latency_max_t){0};
+  local_irq_restore(flags);
+}
+
+static void latency_print_one(const char *title, const latency_max_t *max) {
+  terminal_printf(&main_terminal,
+                  "%-12s max %u us over %u sections\r\n"
+                  "             from 0x%08x to 0x%08x\r\n",
+                  title, (uint32_t)sched_clock_to_us(max->cycles), max->count,
+                  (uint32_t)max->start_where, (uint32_t)max->end_where);
+}
+
+void latency_print_stats(void) {
+  uint32_t flags = local_irq_save();
+  latency_max_t irqs = irqsoff_max;
+  latency_max_t preempt = preemptoff_max;
+  local_irq_restore(flags);
+
+  terminal_puts(&main_terminal, "\r\n=== Latency tracer ===\r\n");
+  if (!latency_trace_enabled) {
+    terminal_puts(&main_terminal, "Tracer not running\r\n");
+    return;
+  }
+  if (!sched_clock_mhz())
+    terminal_puts(&main_terminal,
+                  "No TSC: durations have timer tick resolution\r\n");
+
+  latency_print_one("irqs-off", &irqs);
+  // Solo hay secciones si algún código usa preempt_disable()
+  if (preempt.count)
+    latency_print_one("preempt-off", &preempt);
+  terminal_puts(&main_terminal,
+                "Look up addresses in kernel.sym; 'latency reset' clears\r\n");
+}
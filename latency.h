@@ -0,0 +1,36 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ========================================================================
+// LATENCY TRACER (IRQS-OFF Y PREEMPT-OFF)
+// ========================================================================
+//
+// Mide con el reloj del planificador cuánto tiempo seguido pasa la CPU con
+// interrupciones deshabilitadas (local_irq_save -> local_irq_restore) y
+// cuánto una tarea pasa sin poder ser expulsada (preempt_disable ->
+// preempt_enable). Guarda el peor caso de cada uno con las direcciones de
+// inicio y fin (buscarlas en kernel.sym). Se ve con el comando "latency".
+//
+// Solo ve lo que pasa por local_irq_save/restore: los cli/sti sueltos y
+// la entrada a un handler de IRQ no cuentan.
+
+// Lo consultan los inline de spinlock.h antes de llamar al tracer
+extern volatile bool latency_trace_enabled;
+
+// Arrancar el tracer (después de sched_clock_init)
+void latency_init(void);
+
+// Ganchos de local_irq_save/restore (se llaman con IRQs deshabilitadas)
+void latency_irqs_off(void *where);
+void latency_irqs_on(void *where);
+
+// Fin de una sección sin expulsión que empezó en 'start' (sched_clock)
+void latency_preempt_on(uint64_t start, void *start_where, void *end_where);
+
+void latency_reset(void);
+void latency_print_stats(void);
+
+#endif // LATENCY_H
@@ -5,9 +5,11 @@
 #include "log.h"
 #include "memutils.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "string.h"
 #include "task.h"
 #include "task_utils.h"
+#include "workqueue.h"
 
 // ==================== VARIABLES HEAP ====================
 
@@ -16,6 +18,9 @@ void *kernel_heap_end = NULL;
 heap_block_t *free_list = NULL;
 defrag_stats_t defrag_stats = {0};
 
+// Protege free_list y las cabeceras de bloque
+static spinlock_t heap_lock = SPINLOCK_INIT("heap");
+
 // ==================== FUNCIONES HEAP ====================
 
 void heap_init(void *heap_memory, size_t heap_size) {
@@ -41,12 +46,10 @@ void heap_init(void *heap_memory, size_t heap_size) {
 }
 
 void *kernel_malloc(size_t size) {
-  // Deshabilitar interrupciones
-  uint32_t flags;
-  __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
+  uint32_t flags = spin_lock_irqsave(&heap_lock);
 
   if (size == 0 || !kernel_heap_start) {
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    spin_unlock_irqrestore(&heap_lock, flags);
     return NULL;
   }
 
@@ -66,7 +69,7 @@ void *kernel_malloc(size_t size) {
   while (current) {
     if (current->magic != HEAP_MAGIC_FREE) {
       // Corrupción detectada
-      __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+      spin_unlock_irqrestore(&heap_lock, flags);
       return NULL;
     }
 
@@ -90,7 +93,7 @@ void *kernel_malloc(size_t size) {
   }
 
   if (!best_fit) {
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    spin_unlock_irqrestore(&heap_lock, flags);
     return NULL;
   }
 
@@ -120,7 +123,7 @@ void *kernel_malloc(size_t size) {
     free_list = current->next;
   }
 
-  __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+  spin_unlock_irqrestore(&heap_lock, flags);
 
   // Limpiar memoria para allocaciones grandes
   void *ptr = (void *)((uint8_t *)current + sizeof(heap_block_t));
@@ -136,8 +139,7 @@ int kernel_free(void *ptr) {
     return 0;
   }
 
-  uint32_t flags;
-  __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
+  uint32_t flags = spin_lock_irqsave(&heap_lock);
 
   heap_block_t *block = (heap_block_t *)((uint8_t *)ptr - sizeof(heap_block_t));
 
@@ -146,12 +148,12 @@ int kernel_free(void *ptr) {
       ((uint8_t *)block < (uint8_t *)kernel_heap_start) ||
       ((uint8_t *)block + sizeof(heap_block_t) + block->size >
        (uint8_t *)kernel_heap_end)) {
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    spin_unlock_irqrestore(&heap_lock, flags);
     return 0;
   }
 
   if (block->magic != HEAP_MAGIC_OCCUPIED) {
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    spin_unlock_irqrestore(&heap_lock, flags);
     return 0;
   }
 
@@ -186,7 +188,7 @@ int kernel_free(void *ptr) {
     }
   }
 
-  __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+  spin_unlock_irqrestore(&heap_lock, flags);
   return 1;
 }
 
@@ -314,8 +316,7 @@ heap_info_t heap_stats_fast(void) {
 // ==================== DEFRAGMENTACIÓN ====================
 
 void heap_defragment(void) {
-  uint32_t flags;
-  __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
+  uint32_t flags = spin_lock_irqsave(&heap_lock);
 
   uint32_t start_time = ticks_since_boot;
   uint32_t merged_count = 0;
@@ -325,6 +326,13 @@ void heap_defragment(void) {
   heap_info_t before = heap_stats_fast();
 
   while (merged_this_pass && passes < 10) {
+    if (passes > 0) {
+      // Entre pasadas no queda ningún puntero a la lista: soltar el lock
+      // deja correr las IRQs y, si el tick lo pidió, a otras tareas
+      spin_unlock_irqrestore(&heap_lock, flags);
+      cond_resched();
+      flags = spin_lock_irqsave(&heap_lock);
+    }
     merged_this_pass = false;
     passes++;
 
@@ -358,7 +366,7 @@ void heap_defragment(void) {
   defrag_stats.largest_block_before = before.largest_free_block;
   defrag_stats.largest_block_after = after.largest_free_block;
 
-  __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+  spin_unlock_irqrestore(&heap_lock, flags);
 
   if (merged_count > 0) {
     log_message(LOG_INFO, "[DEFRAG] %u blocks merged in %u passes",
@@ -675,69 +683,78 @@ static bool needs_defragmentation(heap_info_t *info) {
 }
 
 // ========================================================================
-// TAREA DE DEFRAGMENTACIÓN PERIÓDICA
+// DEFRAGMENTACIÓN PERIÓDICA (WORKQUEUE)
 // ========================================================================
 
+#define DEFRAG_CHECK_INTERVAL_MS 5000
+
+static work_t defrag_work;
+static uint32_t defrag_last_run = 0;
+static uint32_t defrag_check_count = 0;
+
+// Un chequeo por ejecución; se vuelve a programar en la workqueue en lugar
+// de tener una tarea propia durmiendo en bucle
 void memory_defrag_task(void *arg) {
   (void)arg;
 
-  uint32_t last_defrag = 0;
-  uint32_t check_count = 0;
+  uint32_t check_count = ++defrag_check_count;
 
-  log_message(LOG_INFO, "[DEFRAG] Task started\r\n");
-  log_message(LOG_INFO,
-              "[DEFRAG] Thresholds: %.1f%% fragmentation, %u sec interval\r\n",
-              FRAGMENTATION_THRESHOLD, MIN_DEFRAG_INTERVAL_MS / 1000);
-
-  while (1) {
-    // Dormir 5 segundos entre chequeos
-    task_sleep(5000);
-    check_count++;
-
-    // Obtener estadísticas rápidas del heap
-    heap_info_t info = heap_stats_fast();
-
-    uint32_t time_since_last = ticks_since_boot - last_defrag;
-    bool should_defrag = false;
-    const char *reason = "";
-
-    // Verificar si necesita defragmentación
-    if (needs_defragmentation(&info) &&
-        time_since_last > (MIN_DEFRAG_INTERVAL_MS / 10)) {
-      should_defrag = true;
-      reason = "high fragmentation";
-    }
+  // Obtener estadísticas rápidas del heap
+  heap_info_t info = heap_stats_fast();
 
-    // Forzar defragmentación periódica cada minuto
-    if (time_since_last > (FORCE_DEFRAG_INTERVAL_MS / 10)) {
-      should_defrag = true;
-      reason = "periodic maintenance";
-    }
+  uint32_t time_since_last = ticks_since_boot - defrag_last_run;
+  bool should_defrag = false;
+  const char *reason = "";
+
+  // Verificar si necesita defragmentación
+  if (needs_defragmentation(&info) &&
+      time_since_last > (MIN_DEFRAG_INTERVAL_MS / 10)) {
+    should_defrag = true;
+    reason = "high fragmentation";
+  }
 
-    if (should_defrag) {
-      log_message(LOG_INFO, "[DEFRAG] Starting defragmentation: %s\r\n",
-                  reason);
-      log_message(LOG_INFO,
-                  "[DEFRAG] Current: %.2f%% fragmentation, %u free blocks, "
-                  "largest: %u bytes\r\n",
-                  info.fragmentation, info.free_blocks_count,
-                  info.largest_free_block);
+  // Forzar defragmentación periódica cada minuto
+  if (time_since_last > (FORCE_DEFRAG_INTERVAL_MS / 10)) {
+    should_defrag = true;
+    reason = "periodic maintenance";
+  }
 
-      // Ejecutar defragmentación
-      heap_defragment();
+  if (should_defrag) {
+    log_message(LOG_INFO, "[DEFRAG] Starting defragmentation: %s\r\n",
+                reason);
+    log_message(LOG_INFO,
+                "[DEFRAG] Current: %.2f%% fragmentation, %u free blocks, "
+                "largest: %u bytes\r\n",
+                info.fragmentation, info.free_blocks_count,
+                info.largest_free_block);
 
-      last_defrag = ticks_since_boot;
-    }
+    // Ejecutar defragmentación
+    heap_defragment();
 
-    // Debug cada 12 checks (1 minuto)
-    if (check_count % 12 == 0) {
-      log_message(LOG_INFO,
-                  "[DEFRAG] Stats - Total: %u defrags, Merges: %u blocks\r\n",
-                  defrag_stats.total_defrags, defrag_stats.successful_merges);
-    }
+    defrag_last_run = ticks_since_boot;
+  }
 
-    task_yield();
+  // Debug cada 12 checks (1 minuto)
+  if (check_count % 12 == 0) {
+    log_message(LOG_INFO,
+                "[DEFRAG] Stats - Total: %u defrags, Merges: %u blocks\r\n",
+                defrag_stats.total_defrags, defrag_stats.successful_merges);
   }
+
+  queue_delayed_work(&defrag_work, DEFRAG_CHECK_INTERVAL_MS);
+}
+
+void memory_defrag_start(void) {
+  work_init(&defrag_work, memory_defrag_task, NULL);
+  if (!queue_delayed_work(&defrag_work, DEFRAG_CHECK_INTERVAL_MS)) {
+    log_message(LOG_ERROR, "[DEFRAG] Workqueue not available\r\n");
+    return;
+  }
+  log_message(LOG_INFO,
+              "[DEFRAG] Scheduled every %u sec (%.1f%% threshold, %u sec "
+              "interval)\r\n",
+              DEFRAG_CHECK_INTERVAL_MS / 1000, FRAGMENTATION_THRESHOLD,
+              MIN_DEFRAG_INTERVAL_MS / 1000);
 }
 
 // ========================================================================
@@ -127,7 +127,8 @@ void heap_print_test_results(const heap_test_results_t *results,
 
 // ==================== DEFRAGMENTATION ====================
 
-void memory_defrag_task(void *arg);
+void memory_defrag_task(void *arg); // Trabajo de la workqueue
+void memory_defrag_start(void);
 void defrag_print_stats(void);
 void cmd_defrag_stats(void);
 void cmd_force_defrag(void);
@@ -1,35 +1,391 @@
 #include "memutils.h"
+#include "cpuid.h"
+#include "fpu.h"
+#include "irq.h"
+#include "kernel.h"
+#include "memory.h"
+#include "spinlock.h"
+#include "terminal.h"
 
-void *memcpy(void *dest, const void *src, size_t count) {
-    uint8_t *d = (uint8_t *)dest;
-    const uint8_t *s = (const uint8_t *)src;
+// ========================================================================
+// SELECCIÓN DE IMPLEMENTACIÓN
+// ========================================================================
+//
+// Hasta que memutils_init() mira CPUID se usa rep movsd/stosd, que funciona
+// en cualquier i386. Las copias grandes (framebuffer, clusters enteros) van
+// con stores no temporales SSE2 para no expulsar la caché.
+
+static memutils_impl_t mem_impl = MEMUTILS_IMPL_REP;
+static bool mem_nt_enabled = false;
+
+static const char *mem_impl_names[MEMUTILS_IMPL_COUNT] = {
+    "byte", "rep movsd", "erms movsb", "sse2 nt"};
+
+// ========================================================================
+// VARIANTES DE COPIA
+// ========================================================================
+
+static inline void copy_bytes(uint8_t *d, const uint8_t *s, size_t count) {
     for (size_t i = 0; i < count; i++) {
         d[i] = s[i];
     }
+}
+
+static inline void copy_rep_movsd(void *d, const void *s, size_t count) {
+    size_t dwords = count >> 2;
+    size_t tail = count & 3;
+    __asm__ __volatile__("rep movsl"
+                         : "+D"(d), "+S"(s), "+c"(dwords)
+                         :
+                         : "memory");
+    __asm__ __volatile__("rep movsb"
+                         : "+D"(d), "+S"(s), "+c"(tail)
+                         :
+                         : "memory");
+}
+
+static inline void copy_erms(void *d, const void *s, size_t count) {
+    __asm__ __volatile__("rep movsb"
+                         : "+D"(d), "+S"(s), "+c"(count)
+                         :
+                         : "memory");
+}
+
+// Copia con movntdq en bloques de 64 bytes. El destino se alinea a 16 con
+// movsb; el origen puede estar desalineado (movdqu)
+static void copy_sse2_nt(uint8_t *d, const uint8_t *s, size_t count) {
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    if (head > count)
+        head = count;
+    copy_erms(d, s, head);
+    d += head;
+    s += head;
+    count -= head;
+
+    while (count >= 64) {
+        // Trozos acotados: kernel_fpu_begin deshabilita IRQs
+        size_t chunk = count > MEMUTILS_NT_CHUNK ? MEMUTILS_NT_CHUNK : count;
+        chunk &= ~(size_t)63;
+        uint32_t flags;
+        if (!kernel_fpu_begin(&flags))
+            break;
+        for (size_t off = 0; off < chunk; off += 64) {
+            __asm__ __volatile__("movdqu 0(%1), %%xmm0\n\t"
+                                 "movdqu 16(%1), %%xmm1\n\t"
+                                 "movdqu 32(%1), %%xmm2\n\t"
+                                 "movdqu 48(%1), %%xmm3\n\t"
+                                 "movntdq %%xmm0, 0(%0)\n\t"
+                                 "movntdq %%xmm1, 16(%0)\n\t"
+                                 "movntdq %%xmm2, 32(%0)\n\t"
+                                 "movntdq %%xmm3, 48(%0)\n\t"
+                                 :
+                                 : "r"(d + off), "r"(s + off)
+                                 : "memory");
+        }
+        kernel_fpu_end(flags); // Incluye sfence
+        d += chunk;
+        s += chunk;
+        count -= chunk;
+    }
+
+    copy_rep_movsd(d, s, count);
+}
+
+static inline void *memcpy_impl(memutils_impl_t impl, void *dest,
+                                const void *src, size_t count) {
+    switch (impl) {
+    case MEMUTILS_IMPL_BYTE:
+        copy_bytes((uint8_t *)dest, (const uint8_t *)src, count);
+        break;
+    case MEMUTILS_IMPL_ERMS:
+        copy_erms(dest, src, count);
+        break;
+    case MEMUTILS_IMPL_SSE2_NT:
+        copy_sse2_nt((uint8_t *)dest, (const uint8_t *)src, count);
+        break;
+    case MEMUTILS_IMPL_REP:
+    default:
+        copy_rep_movsd(dest, src, count);
+        break;
+    }
     return dest;
 }
 
-void *memset(void *dest, int value, size_t count) {
-    uint8_t *d = (uint8_t *)dest;
+// ========================================================================
+// VARIANTES DE RELLENO
+// ========================================================================
+
+static inline void set_bytes(uint8_t *d, uint8_t value, size_t count) {
     for (size_t i = 0; i < count; i++) {
-        d[i] = (uint8_t)value;
+        d[i] = value;
+    }
+}
+
+static inline void set_rep_stosd(void *d, uint8_t value, size_t count) {
+    uint32_t pattern = value * 0x01010101u;
+    size_t dwords = count >> 2;
+    size_t tail = count & 3;
+    __asm__ __volatile__("rep stosl"
+                         : "+D"(d), "+c"(dwords)
+                         : "a"(pattern)
+                         : "memory");
+    __asm__ __volatile__("rep stosb"
+                         : "+D"(d), "+c"(tail)
+                         : "a"(pattern)
+                         : "memory");
+}
+
+static inline void set_erms(void *d, uint8_t value, size_t count) {
+    __asm__ __volatile__("rep stosb"
+                         : "+D"(d), "+c"(count)
+                         : "a"((uint32_t)value)
+                         : "memory");
+}
+
+static void set_sse2_nt(uint8_t *d, uint8_t value, size_t count) {
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    if (head > count)
+        head = count;
+    set_erms(d, value, head);
+    d += head;
+    count -= head;
+
+    uint32_t pattern = value * 0x01010101u;
+    while (count >= 64) {
+        size_t chunk = count > MEMUTILS_NT_CHUNK ? MEMUTILS_NT_CHUNK : count;
+        chunk &= ~(size_t)63;
+        uint32_t flags;
+        if (!kernel_fpu_begin(&flags))
+            break;
+        __asm__ __volatile__("movd %0, %%xmm0\n\t"
+                             "pshufd $0, %%xmm0, %%xmm0"
+                             :
+                             : "r"(pattern));
+        for (size_t off = 0; off < chunk; off += 64) {
+            __asm__ __volatile__("movntdq %%xmm0, 0(%0)\n\t"
+                                 "movntdq %%xmm0, 16(%0)\n\t"
+                                 "movntdq %%xmm0, 32(%0)\n\t"
+                                 "movntdq %%xmm0, 48(%0)\n\t"
+                                 :
+                                 : "r"(d + off)
+                                 : "memory");
+        }
+        kernel_fpu_end(flags);
+        d += chunk;
+        count -= chunk;
+    }
+
+    set_rep_stosd(d, value, count);
+}
+
+static inline void *memset_impl(memutils_impl_t impl, void *dest,
+                                uint8_t value, size_t count) {
+    switch (impl) {
+    case MEMUTILS_IMPL_BYTE:
+        set_bytes((uint8_t *)dest, value, count);
+        break;
+    case MEMUTILS_IMPL_ERMS:
+        set_erms(dest, value, count);
+        break;
+    case MEMUTILS_IMPL_SSE2_NT:
+        set_sse2_nt((uint8_t *)dest, value, count);
+        break;
+    case MEMUTILS_IMPL_REP:
+    default:
+        set_rep_stosd(dest, value, count);
+        break;
     }
     return dest;
 }
 
+// ========================================================================
+// API
+// ========================================================================
+
+void *memcpy(void *dest, const void *src, size_t count) {
+    if (count >= MEMUTILS_NT_THRESHOLD && mem_nt_enabled)
+        return memcpy_impl(MEMUTILS_IMPL_SSE2_NT, dest, src, count);
+    return memcpy_impl(mem_impl, dest, src, count);
+}
+
+void *memset(void *dest, int value, size_t count) {
+    if (count >= MEMUTILS_NT_THRESHOLD && mem_nt_enabled)
+        return memset_impl(MEMUTILS_IMPL_SSE2_NT, dest, (uint8_t)value, count);
+    return memset_impl(mem_impl, dest, (uint8_t)value, count);
+}
+
 void *memmove(void *dest, const void *src, size_t count) {
     uint8_t *d = (uint8_t *)dest;
     const uint8_t *s = (const uint8_t *)src;
-    if (s < d) {
-        // Copia hacia atrás
-        for (size_t i = count; i > 0; i--) {
-            d[i-1] = s[i-1];
-        }
-    } else {
-        // Copia hacia adelante
-        for (size_t i = 0; i < count; i++) {
-            d[i] = s[i];
-        }
+    if (d == s || count == 0)
+        return dest;
+
+    // Sin solapamiento peligroso (destino por debajo o zonas disjuntas) se
+    // copia hacia adelante con la implementación rápida
+    if (d < s || d >= s + count)
+        return memcpy(dest, src, count);
+
+    // Copia hacia atrás: primero los bytes sueltos del final y luego dwords
+    // con DF=1. Los handlers de IRQ asumen DF=0, así que se hace sin IRQs
+    d += count;
+    s += count;
+    size_t tail = count & 3;
+    while (tail--) {
+        *--d = *--s;
+    }
+    size_t dwords = count >> 2;
+    if (dwords) {
+        d -= 4;
+        s -= 4;
+        uint32_t flags = local_irq_save();
+        __asm__ __volatile__("std\n\t"
+                             "rep movsl\n\t"
+                             "cld"
+                             : "+D"(d), "+S"(s), "+c"(dwords)
+                             :
+                             : "memory");
+        local_irq_restore(flags);
     }
     return dest;
 }
+
+// ========================================================================
+// INICIALIZACIÓN
+// ========================================================================
+
+void memutils_init(void) {
+    if (cpu_info.extended_features_ebx & CPUID_FEAT_EXT_ERMS)
+        mem_impl = MEMUTILS_IMPL_ERMS;
+    else
+        mem_impl = MEMUTILS_IMPL_REP;
+
+    // movntdq necesita SSE2 y CR4.OSFXSR (fpu_init debe haber corrido)
+    mem_nt_enabled = cpu_info.caps.has_sse2 && fpu_sse_enabled();
+
+    terminal_printf(&main_terminal, "MEM: memcpy/memset using %s%s\r\n",
+                    mem_impl_names[mem_impl],
+                    mem_nt_enabled ? ", sse2 nt for large blocks" : "");
+}
+
+memutils_impl_t memutils_get_impl(void) { return mem_impl; }
+
+bool memutils_impl_available(memutils_impl_t impl) {
+    switch (impl) {
+    case MEMUTILS_IMPL_BYTE:
+    case MEMUTILS_IMPL_REP:
+        return true;
+    case MEMUTILS_IMPL_ERMS:
+        // rep movsb funciona siempre; sin ERMS simplemente es lento
+        return (cpu_info.extended_features_ebx & CPUID_FEAT_EXT_ERMS) != 0;
+    case MEMUTILS_IMPL_SSE2_NT:
+        return cpu_info.caps.has_sse2 && fpu_sse_enabled();
+    default:
+        return false;
+    }
+}
+
+const char *memutils_impl_name(memutils_impl_t impl) {
+    return impl < MEMUTILS_IMPL_COUNT ? mem_impl_names[impl] : "unknown";
+}
+
+// ========================================================================
+// MICROBENCHMARK
+// ========================================================================
+
+#define MEMBENCH_TICKS 10 // ~100 ms por medida con el PIT a 100 Hz
+
+static const uint32_t membench_sizes[] = {64, 1024, 16 * 1024, 256 * 1024,
+                                          2 * 1024 * 1024};
+#define MEMBENCH_SIZE_COUNT                                                    \
+    (sizeof(membench_sizes) / sizeof(membench_sizes[0]))
+
+// Devuelve MB/s copiando (o rellenando) bloques de 'size' bytes
+static uint32_t membench_run(memutils_impl_t impl, bool do_set, uint8_t *dst,
+                             const uint8_t *src, uint32_t size) {
+    uint64_t bytes = 0;
+
+    // Arrancar alineados a un tick para no medir fracciones
+    uint32_t start = ticks_since_boot;
+    while (ticks_since_boot == start) {
+        __asm__ __volatile__("pause");
+    }
+    start = ticks_since_boot;
+
+    while (ticks_since_boot - start < MEMBENCH_TICKS) {
+        if (do_set)
+            memset_impl(impl, dst, 0x5A, size);
+        else
+            memcpy_impl(impl, dst, src, size);
+        bytes += size;
+    }
+
+    uint32_t elapsed = ticks_since_boot - start; // En ticks de 10 ms
+    uint32_t kib = (uint32_t)(bytes >> 10);
+    // MB/s = KiB * 100 / ticks / 1024 (sin divisiones de 64 bits)
+    return (uint32_t)(((uint64_t)kib * 100) >> 10) / (elapsed ? elapsed : 1);
+}
+
+static void membench_table(bool do_set, uint8_t *dst, const uint8_t *src) {
+    terminal_printf(&main_terminal, "\r\n%s (MB/s)\r\n",
+                    do_set ? "memset" : "memcpy");
+    terminal_puts(&main_terminal, "SIZE     ");
+    for (int impl = 0; impl < MEMUTILS_IMPL_COUNT; impl++) {
+        terminal_printf(&main_terminal, "%-12s", mem_impl_names[impl]);
+    }
+    terminal_puts(&main_terminal, "\r\n");
+
+    for (uint32_t i = 0; i < MEMBENCH_SIZE_COUNT; i++) {
+        uint32_t size = membench_sizes[i];
+        if (size >= 1024 * 1024)
+            terminal_printf(&main_terminal, "%-4uMiB  ", size >> 20);
+        else if (size >= 1024)
+            terminal_printf(&main_terminal, "%-4uKiB  ", size >> 10);
+        else
+            terminal_printf(&main_terminal, "%-4uB    ", size);
+
+        for (int impl = 0; impl < MEMUTILS_IMPL_COUNT; impl++) {
+            if (!memutils_impl_available((memutils_impl_t)impl)) {
+                terminal_printf(&main_terminal, "%-12s", "n/a");
+                continue;
+            }
+            uint32_t mbs =
+                membench_run((memutils_impl_t)impl, do_set, dst, src, size);
+            terminal_printf(&main_terminal, "%-12u", mbs);
+        }
+        terminal_puts(&main_terminal, "\r\n");
+    }
+}
+
+void memutils_benchmark(void) {
+    if (!local_irq_enabled()) {
+        terminal_puts(&main_terminal,
+                      "membench: interrupts disabled, cannot time\r\n");
+        return;
+    }
+
+    uint32_t max_size = membench_sizes[MEMBENCH_SIZE_COUNT - 1];
+    uint8_t *src = (uint8_t *)kernel_malloc(max_size);
+    uint8_t *dst = (uint8_t *)kernel_malloc(max_size);
+    if (!src || !dst) {
+        terminal_puts(&main_terminal, "membench: out of memory\r\n");
+        if (src)
+            kernel_free(src);
+        if (dst)
+            kernel_free(dst);
+        return;
+    }
+
+    memset_impl(MEMUTILS_IMPL_REP, src, 0xA5, max_size);
+    memset_impl(MEMUTILS_IMPL_REP, dst, 0, max_size);
+
+    terminal_printf(&main_terminal,
+                    "\r\n=== Memory benchmark (active: %s%s) ===\r\n",
+                    mem_impl_names[mem_impl],
+                    mem_nt_enabled ? " + sse2 nt" : "");
+    membench_table(false, dst, src);
+    membench_table(true, dst, src);
+    terminal_puts(&main_terminal, "\r\n");
+
+    kernel_free(dst);
+    kernel_free(src);
+}
@@ -1,9 +1,24 @@
 #ifndef MEMUTILS_H
 #define MEMUTILS_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+// Implementaciones disponibles (se elige una en memutils_init según CPUID)
+typedef enum {
+    MEMUTILS_IMPL_BYTE = 0, // Bucle byte a byte (referencia)
+    MEMUTILS_IMPL_REP,      // rep movsd/stosd + cola con movsb
+    MEMUTILS_IMPL_ERMS,     // rep movsb/stosb (Enhanced REP MOVSB)
+    MEMUTILS_IMPL_SSE2_NT,  // movntdq, sin pasar por la caché
+    MEMUTILS_IMPL_COUNT
+} memutils_impl_t;
+
+// A partir de este tamaño memcpy/memset usan stores no temporales
+#define MEMUTILS_NT_THRESHOLD (256 * 1024)
+// Bytes copiados por cada sección SSE (con IRQs deshabilitadas)
+#define MEMUTILS_NT_CHUNK (64 * 1024)
+
 
 // Copia 'count' bytes de 'src' a 'dest'. Devuelve 'dest'.
 void *memcpy(void *dest, const void *src, size_t count);
@@ -14,4 +29,13 @@ void *memset(void *dest, int value, size_t count);
 // Mueve 'count' bytes de 'src' a 'dest', permitiendo solapamiento. Devuelve 'dest'.
 void *memmove(void *dest, const void *src, size_t count);
 
+// Selección de la implementación al arrancar (después de cpuid_init y fpu_init)
+void memutils_init(void);
+memutils_impl_t memutils_get_impl(void);
+bool memutils_impl_available(memutils_impl_t impl);
+const char *memutils_impl_name(memutils_impl_t impl);
+
+// Microbenchmark: MB/s de cada implementación por clase de tamaño
+void memutils_benchmark(void);
+
 #endif
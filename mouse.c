@@ -1,6 +1,7 @@
 // mouse.c - Versión standalone sin Window Manager
 #include "mouse.h"
 #include "drawing.h"
+#include "input.h"
 #include "io.h"
 #include "irq.h"
 #include "kernel.h"
@@ -249,6 +250,7 @@ void mouse_process_packet(void) {
   }
 
   mouse_state.packet_ready = false;
+  input_event(INPUT_SOURCE_MOUSE);
 }
 
 void mouse_inject_event(int dx, int dy, uint8_t buttons) {
@@ -296,6 +298,7 @@ void mouse_inject_event(int dx, int dy, uint8_t buttons) {
   if (mouse_state.cursor_visible) {
     mouse_draw_cursor();
   }
+  input_event(INPUT_SOURCE_MOUSE);
 }
 
 // Dibujar cursor simple
@@ -3,70 +3,82 @@
 #include "network_stack.h"
 #include "task.h"
 #include "terminal.h"
+#include "workqueue.h"
 
-static task_t *network_daemon_task = NULL;
+// La NIC se sondea desde la workqueue: un trabajo procesa hasta
+// NET_POLL_BUDGET paquetes y se reprograma, en lugar de una tarea propia
+// girando con task_yield
+#define NET_POLL_INTERVAL_MS 10 // Un tick del PIT
+#define NET_POLL_BUDGET 32
+
+static work_t net_poll_work;
 static volatile bool daemon_running = false;
 
-// Función principal del daemon de red
 void network_daemon_func(void *arg) {
   (void)arg; // No usado
 
-  terminal_puts(&main_terminal,
-                "[NET_DAEMON] Network daemon started (kernel task)\r\n");
-  daemon_running = true;
-
-  while (daemon_running) {
-    // ✅ Protección crítica contra race conditions
-    uint32_t flags;
-    __asm__ __volatile__("pushf; cli; pop %0" : "=r"(flags));
-
-    // Procesar paquetes de red
-    network_stack_tick();
-
-    __asm__ __volatile__("push %0; popf" : : "r"(flags));
+  if (!daemon_running) {
+    terminal_puts(&main_terminal, "[NET_DAEMON] Network daemon stopped\r\n");
+    return;
+  }
 
-    // Ceder CPU a otras tareas - usar yield para mayor estabilidad
-    task_yield();
+  // Procesar paquetes de red (network_stack_tick toma el lock de la pila)
+  uint32_t processed = 0;
+  while (processed < NET_POLL_BUDGET && network_stack_tick()) {
+    processed++;
   }
 
-  terminal_puts(&main_terminal, "[NET_DAEMON] Network daemon stopped\r\n");
+  // Presupuesto agotado: probablemente quedan paquetes, volver enseguida
+  if (processed == NET_POLL_BUDGET) {
+    queue_work_item(&net_poll_work);
+  } else {
+    queue_delayed_work(&net_poll_work, NET_POLL_INTERVAL_MS);
+  }
 }
 
 // Iniciar el daemon de red
 bool network_daemon_start(void) {
-  if (network_daemon_task != NULL) {
+  if (daemon_running) {
     terminal_puts(&main_terminal, "[NET_DAEMON] Daemon already running\r\n");
     return false;
   }
 
-  // Crear tarea kernel de alta prioridad para procesamiento de red
-  network_daemon_task =
-      task_create("net_daemon", network_daemon_func, NULL, TASK_PRIORITY_HIGH);
+  work_init(&net_poll_work, network_daemon_func, NULL);
+  daemon_running = true;
 
-  if (!network_daemon_task) {
+  if (!queue_work_item(&net_poll_work)) {
+    daemon_running = false;
     terminal_puts(&main_terminal,
-                  "[NET_DAEMON] Failed to create network daemon task\r\n");
+                  "[NET_DAEMON] Failed to queue network poll work\r\n");
     return false;
   }
 
   terminal_puts(&main_terminal,
-                "[NET_DAEMON] Network daemon task created successfully\r\n");
+                "[NET_DAEMON] Network polling scheduled on workqueue\r\n");
   return true;
 }
 
+// Adelantar el sondeo (p.ej. desde el bottom half de la NIC)
+void network_daemon_kick(void) {
+  if (!daemon_running) {
+    return;
+  }
+  // Si estaba esperando su intervalo se ejecuta ya
+  if (cancel_delayed_work(&net_poll_work)) {
+    queue_work_item(&net_poll_work);
+  }
+}
+
 // Detener el daemon de red
 void network_daemon_stop(void) {
-  if (!network_daemon_task) {
+  if (!daemon_running) {
     return;
   }
 
+  // Si estaba diferido se cancela; si ya está en cola verá el flag y no se
+  // reprogramará
   daemon_running = false;
-
-  // Esperar a que termine (simplificado - en producción usaríamos
-  // sincronización)
-  task_sleep(100);
-
-  network_daemon_task = NULL;
+  cancel_delayed_work(&net_poll_work);
 }
 
 // Verificar si el daemon está corriendo
@@ -3,12 +3,14 @@
 
 #include <stdbool.h>
 
-// Función del daemon de red
+// Trabajo de sondeo de la red (se ejecuta en la workqueue)
 void network_daemon_func(void *arg);
 
 // Iniciar/detener el daemon
 bool network_daemon_start(void);
 void network_daemon_stop(void);
+// Ejecutar el sondeo cuanto antes (hay paquetes pendientes)
+void network_daemon_kick(void);
 
 // Estado del daemon
 bool network_daemon_is_running(void);
@@ -11,6 +11,7 @@
 #include "network.h"
 #include "network_daemon.h"
 #include "serial.h"
+#include "spinlock.h"
 #include "string.h"
 #include "task.h"
 #include "tcp.h"
@@ -20,6 +21,48 @@
 
 static network_config_t net_config;
 
+// ===================================================
+// LOCK DE LA PILA DE RED
+// ===================================================
+//
+// La pila es reentrante sobre sí misma (tick -> tcp_input -> ip_send ->
+// arp_resolve -> tick), por eso el lock es recursivo por tarea. No
+// deshabilita IRQs: ningún handler toca la pila y arp_resolve necesita
+// que el timer siga avanzando mientras espera respuesta.
+
+static spinlock_t net_stack_lock = SPINLOCK_INIT("net_stack");
+static task_t *net_stack_owner = NULL;
+static uint32_t net_stack_depth = 0;
+
+void network_stack_lock(void) {
+  task_t *self = scheduler.current_task;
+
+  if (net_stack_depth > 0 && net_stack_owner == self) {
+    net_stack_depth++;
+    return;
+  }
+
+  // Si otra tarea lo tiene, cederle la CPU en vez de girar todo el quantum
+  while (!spin_trylock(&net_stack_lock)) {
+    if (scheduler.scheduler_enabled)
+      task_yield();
+    else
+      __asm__ __volatile__("pause");
+  }
+
+  net_stack_owner = self;
+  net_stack_depth = 1;
+}
+
+void network_stack_unlock(void) {
+  if (net_stack_depth == 0)
+    return;
+  if (--net_stack_depth == 0) {
+    net_stack_owner = NULL;
+    spin_unlock(&net_stack_lock);
+  }
+}
+
 void network_stack_init(void) {
   serial_printf(COM1_BASE, "\r\n=== Network Stack Initialization ===\r\n");
 
@@ -67,9 +110,9 @@ void network_stack_init(void) {
   }
 }
 
-// Procesar paquetes recibidos
-void network_stack_tick(void) {
-  static uint32_t last_arp_cleanup = 0;
+// Procesar paquetes recibidos. Devuelve true si había un paquete
+bool network_stack_tick(void) {
+  network_stack_lock();
 
   // Recibir y procesar paquetes
   uint8_t buffer[1522];
@@ -127,20 +170,20 @@ void network_stack_tick(void) {
     }
   }
   tcp_maintenance();
-  dhcp_tick(); // Allow DHCP to handle timeouts
-  // Limpiar cache ARP periódicamente (cada 60 segundos)
-  if (ticks_since_boot - last_arp_cleanup >
-      6000) { // 6000 ticks = 60 segundos a 100Hz
-    // Podríamos implementar aging aquí
-    arp_cleanup_old_entries();
-    last_arp_cleanup = ticks_since_boot;
-  }
+  // Los reintentos de DHCP y TCP y el envejecimiento de la cache ARP van
+  // por timers del kernel (timer.h), no se sondean aquí
+
+  network_stack_unlock();
+  return length > 0;
 }
 
 // Enviar paquete IP
 bool network_send_ip_packet(const uint8_t *data, uint32_t length,
                             ip_addr_t dest_ip, uint8_t protocol) {
-  return ip_send_packet(dest_ip, protocol, (uint8_t *)data, length);
+  network_stack_lock();
+  bool ok = ip_send_packet(dest_ip, protocol, (uint8_t *)data, length);
+  network_stack_unlock();
+  return ok;
 }
 
 // Configuración estática
@@ -36,7 +36,11 @@ typedef struct {
 
 // Funciones principales
 void network_stack_init(void);
-void network_stack_tick(void);
+bool network_stack_tick(void);
+
+// Serialización de la pila (recursivo por tarea)
+void network_stack_lock(void);
+void network_stack_unlock(void);
 bool network_send_ip_packet(const uint8_t *data, uint32_t length,
                             ip_addr_t dest_ip, uint8_t protocol);
 uint32_t network_receive_ip_packet(uint8_t *buffer, uint32_t max_len,
@@ -4,6 +4,7 @@
 #include "mbr.h"
 #include "serial.h"
 #include "string.h"
+#include "task.h"
 #include "terminal.h"
 #include "vfs.h"
 
@@ -800,6 +801,8 @@ part_mgr_err_t partition_manager_auto_mount_all(void) {
       if (part->type == PART_TYPE_EMPTY) {
         continue;
       }
+      // Montar lee BPB y directorios: punto de replanificación por partición
+      cond_resched();
 
       terminal_printf(&main_terminal,
                       "  Partition %d: Type=0x%02X (%s), Size=%llu MB\r\n",
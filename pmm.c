@@ -5,6 +5,7 @@
 #include "memory.h"
 #include "memutils.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "string.h"
 #include "terminal.h"
 
@@ -14,6 +15,9 @@ mem_region_t mem_regions[MAX_MEMORY_REGIONS];
 uint32_t mem_region_count = 0;
 pmm_bitmap_t pmm_bitmap = {0};
 
+// Protege el bitmap y el contador de páginas libres
+static spinlock_t pmm_lock = SPINLOCK_INIT("pmm");
+
 // ==================== FUNCIONES PMM ====================
 
 void pmm_init(struct multiboot_tag_mmap *mmap_tag) {
@@ -180,6 +184,8 @@ void pmm_exclude_kernel_heap(void *heap_start, size_t heap_size) {
 }
 
 void *pmm_alloc_page(void) {
+  uint32_t flags = spin_lock_irqsave(&pmm_lock);
+
   // Buscar primera página libre en el bitmap
   for (uint32_t i = 0; i < (pmm_bitmap.total_pages + 31) / 32; i++) {
     if (pmm_bitmap.bitmap[i] != 0) {
@@ -211,12 +217,14 @@ void *pmm_alloc_page(void) {
           pmm_bitmap.bitmap[i] &= ~(1 << j);
           pmm_bitmap.free_pages--;
 
+          spin_unlock_irqrestore(&pmm_lock, flags);
           return (void *)(uintptr_t)page_addr;
         }
       }
     }
   }
 
+  spin_unlock_irqrestore(&pmm_lock, flags);
   return NULL; // No hay memoria disponible
 }
 
@@ -226,6 +234,7 @@ void *pmm_alloc_pages(uint32_t count) {
 
   // Búsqueda simple de bloques contiguos
   uint32_t consecutive = 0;
+  uint32_t flags = spin_lock_irqsave(&pmm_lock);
   uint32_t start_idx = 0;
 
   for (uint32_t i = 0; i < pmm_bitmap.total_pages; i++) {
@@ -266,6 +275,7 @@ void *pmm_alloc_pages(uint32_t count) {
         }
 
         pmm_bitmap.free_pages -= count;
+        spin_unlock_irqrestore(&pmm_lock, flags);
         return (void *)(uintptr_t)page_addr;
       }
     } else {
@@ -273,10 +283,11 @@ void *pmm_alloc_pages(uint32_t count) {
     }
   }
 
+  spin_unlock_irqrestore(&pmm_lock, flags);
   return NULL; // No hay bloque contiguo del tamaño solicitado
 }
 
-void pmm_free_page(void *page) {
+static void pmm_free_page_locked(void *page) {
   uint64_t page_addr = (uint64_t)(uintptr_t)page;
 
   if (page_addr % PAGE_SIZE != 0) {
@@ -312,10 +323,18 @@ void pmm_free_page(void *page) {
   }
 }
 
+void pmm_free_page(void *page) {
+  uint32_t flags = spin_lock_irqsave(&pmm_lock);
+  pmm_free_page_locked(page);
+  spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
 void pmm_free_pages(void *base, uint32_t count) {
+  uint32_t flags = spin_lock_irqsave(&pmm_lock);
   for (uint32_t i = 0; i < count; i++) {
-    pmm_free_page((void *)((uintptr_t)base + i * PAGE_SIZE));
+    pmm_free_page_locked((void *)((uintptr_t)base + i * PAGE_SIZE));
   }
+  spin_unlock_irqrestore(&pmm_lock, flags);
 }
 
 uint32_t pmm_get_free_pages(void) { return pmm_bitmap.free_pages; }
@@ -0,0 +1,255 @@
+#include "rbtree.h"
+
+// ========================================================================
+// ROTACIONES
+// ========================================================================
+
+static void rb_replace_child(rb_node_t *parent, rb_node_t *old,
+                             rb_node_t *new_node, rb_root_t *root) {
+  if (!parent)
+    root->node = new_node;
+  else if (parent->left == old)
+    parent->left = new_node;
+  else
+    parent->right = new_node;
+}
+
+static void rb_rotate_left(rb_node_t *node, rb_root_t *root) {
+  rb_node_t *right = node->right;
+
+  node->right = right->left;
+  if (right->left)
+    right->left->parent = node;
+
+  right->parent = node->parent;
+  rb_replace_child(node->parent, node, right, root);
+
+  right->left = node;
+  node->parent = right;
+}
+
+static void rb_rotate_right(rb_node_t *node, rb_root_t *root) {
+  rb_node_t *left = node->left;
+
+  node->left = left->right;
+  if (left->right)
+    left->right->parent = node;
+
+  left->parent = node->parent;
+  rb_replace_child(node->parent, node, left, root);
+
+  left->right = node;
+  node->parent = left;
+}
+
+static inline bool rb_is_red(const rb_node_t *node) {
+  return node && node->color == RB_RED;
+}
+
+static inline bool rb_is_black(const rb_node_t *node) {
+  return !node || node->color == RB_BLACK;
+}
+
+// ========================================================================
+// INSERCIÓN
+// ========================================================================
+
+void rb_insert_color(rb_node_t *node, rb_root_t *root) {
+  rb_node_t *parent;
+
+  while ((parent = node->parent) && parent->color == RB_RED) {
+    // El padre es rojo, así que no es la raíz y hay abuelo
+    rb_node_t *gparent = parent->parent;
+
+    if (parent == gparent->left) {
+      rb_node_t *uncle = gparent->right;
+      if (rb_is_red(uncle)) {
+        // Tío rojo: recolorear y seguir subiendo
+        parent->color = RB_BLACK;
+        uncle->color = RB_BLACK;
+        gparent->color = RB_RED;
+        node = gparent;
+        continue;
+      }
+      if (node == parent->right) {
+        rb_rotate_left(parent, root);
+        node = parent;
+        parent = node->parent;
+      }
+      parent->color = RB_BLACK;
+      gparent->color = RB_RED;
+      rb_rotate_right(gparent, root);
+    } else {
+      rb_node_t *uncle = gparent->left;
+      if (rb_is_red(uncle)) {
+        parent->color = RB_BLACK;
+        uncle->color = RB_BLACK;
+        gparent->color = RB_RED;
+        node = gparent;
+        continue;
+      }
+      if (node == parent->left) {
+        rb_rotate_right(parent, root);
+        node = parent;
+        parent = node->parent;
+      }
+      parent->color = RB_BLACK;
+      gparent->color = RB_RED;
+      rb_rotate_left(gparent, root);
+    }
+  }
+
+  root->node->color = RB_BLACK;
+}
+
+void rb_insert_color_cached(rb_node_t *node, rb_root_cached_t *root,
+                            bool leftmost) {
+  if (leftmost)
+    root->leftmost = node;
+  rb_insert_color(node, &root->root);
+}
+
+// ========================================================================
+// BORRADO
+// ========================================================================
+
+// Restaurar la altura negra tras quitar un nodo negro. 'node' (puede ser
+// NULL) ocupa el sitio del hueco y 'parent' es su padre.
+static void rb_erase_color(rb_node_t *node, rb_node_t *parent,
+                           rb_root_t *root) {
+  while (node != root->node && rb_is_black(node)) {
+    if (node == parent->left) {
+      rb_node_t *sibling = parent->right;
+      if (rb_is_red(sibling)) {
+        sibling->color = RB_BLACK;
+        parent->color = RB_RED;
+        rb_rotate_left(parent, root);
+        sibling = parent->right;
+      }
+      if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+        sibling->color = RB_RED;
+        node = parent;
+        parent = node->parent;
+        continue;
+      }
+      if (rb_is_black(sibling->right)) {
+        sibling->left->color = RB_BLACK;
+        sibling->color = RB_RED;
+        rb_rotate_right(sibling, root);
+        sibling = parent->right;
+      }
+      sibling->color = parent->color;
+      parent->color = RB_BLACK;
+      sibling->right->color = RB_BLACK;
+      rb_rotate_left(parent, root);
+      node = root->node;
+    } else {
+      rb_node_t *sibling = parent->left;
+      if (rb_is_red(sibling)) {
+        sibling->color = RB_BLACK;
+        parent->color = RB_RED;
+        rb_rotate_right(parent, root);
+        sibling = parent->left;
+      }
+      if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+        sibling->color = RB_RED;
+        node = parent;
+        parent = node->parent;
+        continue;
+      }
+      if (rb_is_black(sibling->left)) {
+        sibling->right->color = RB_BLACK;
+        sibling->color = RB_RED;
+        rb_rotate_left(sibling, root);
+        sibling = parent->left;
+      }
+      sibling->color = parent->color;
+      parent->color = RB_BLACK;
+      sibling->left->color = RB_BLACK;
+      rb_rotate_right(parent, root);
+      node = root->node;
+    }
+  }
+
+  if (node)
+    node->color = RB_BLACK;
+}
+
+void rb_erase(rb_node_t *node, rb_root_t *root) {
+  rb_node_t *child;
+  rb_node_t *parent;
+  uint32_t color;
+
+  if (node->left && node->right) {
+    // Dos hijos: el sucesor (mínimo del subárbol derecho) ocupa su lugar
+    rb_node_t *succ = node->right;
+    while (succ->left)
+      succ = succ->left;
+
+    child = succ->right;
+    parent = succ->parent;
+    color = succ->color;
+
+    if (parent == node) {
+      parent = succ;
+    } else {
+      if (child)
+        child->parent = parent;
+      parent->left = child;
+      succ->right = node->right;
+      node->right->parent = succ;
+    }
+
+    succ->parent = node->parent;
+    succ->left = node->left;
+    succ->color = node->color;
+    rb_replace_child(node->parent, node, succ, root);
+    node->left->parent = succ;
+  } else {
+    child = node->left ? node->left : node->right;
+    parent = node->parent;
+    color = node->color;
+
+    if (child)
+      child->parent = parent;
+    rb_replace_child(parent, node, child, root);
+  }
+
+  if (color == RB_BLACK)
+    rb_erase_color(child, parent, root);
+
+  node->parent = node->left = node->right = NULL;
+}
+
+void rb_erase_cached(rb_node_t *node, rb_root_cached_t *root) {
+  if (root->leftmost == node)
+    root->leftmost = rb_next(node);
+  rb_erase(node, &root->root);
+}
+
+// ========================================================================
+// RECORRIDO
+// ========================================================================
+
+rb_node_t *rb_first(const rb_root_t *root) {
+  rb_node_t *node = root->node;
+  if (!node)
+    return NULL;
+  while (node->left)
+    node = node->left;
+  return node;
+}
+
+rb_node_t *rb_next(const rb_node_t *node) {
+  if (node->right) {
+    node = node->right;
+    while (node->left)
+      node = node->left;
+    return (rb_node_t *)node;
+  }
+
+  rb_node_t *parent;
+  while ((parent = node->parent) && node == parent->right)
+    node = parent;
+  return parent;
+}
@@ -0,0 +1,71 @@
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ========================================================================
+// ÁRBOL ROJO-NEGRO INTRUSIVO
+// ========================================================================
+//
+// El nodo va embebido en la estructura del usuario (como wait_next en
+// task_t) y se recupera con rb_entry(). El árbol no sabe comparar: quien
+// inserta baja por los hijos con su propio criterio y llama a
+// rb_link_node() + rb_insert_color(). rb_root_cached_t guarda además el
+// nodo más a la izquierda para obtener el mínimo en O(1).
+
+#define RB_RED 0
+#define RB_BLACK 1
+
+typedef struct rb_node {
+  struct rb_node *parent;
+  struct rb_node *left;
+  struct rb_node *right;
+  uint32_t color;
+} rb_node_t;
+
+typedef struct {
+  rb_node_t *node;
+} rb_root_t;
+
+typedef struct {
+  rb_root_t root;
+  rb_node_t *leftmost;
+} rb_root_cached_t;
+
+#define RB_ROOT {NULL}
+#define RB_ROOT_CACHED {{NULL}, NULL}
+
+#define rb_entry(ptr, type, member)                                            \
+  ((type *)((uint8_t *)(ptr) - offsetof(type, member)))
+
+static inline void rb_link_node(rb_node_t *node, rb_node_t *parent,
+                                rb_node_t **link) {
+  node->parent = parent;
+  node->left = node->right = NULL;
+  node->color = RB_RED;
+  *link = node;
+}
+
+static inline bool rb_empty_cached(const rb_root_cached_t *root) {
+  return root->root.node == NULL;
+}
+
+static inline rb_node_t *rb_first_cached(const rb_root_cached_t *root) {
+  return root->leftmost;
+}
+
+// Rebalancear tras enlazar un nodo nuevo con rb_link_node()
+void rb_insert_color(rb_node_t *node, rb_root_t *root);
+// 'leftmost' = true si el nodo se enlazó como nuevo mínimo
+void rb_insert_color_cached(rb_node_t *node, rb_root_cached_t *root,
+                            bool leftmost);
+
+void rb_erase(rb_node_t *node, rb_root_t *root);
+void rb_erase_cached(rb_node_t *node, rb_root_cached_t *root);
+
+rb_node_t *rb_first(const rb_root_t *root);
+rb_node_t *rb_next(const rb_node_t *node);
+
+#endif // RBTREE_H
@@ -202,6 +202,7 @@ bool sata_disk_setup(sata_disk_t *disk, uint8_t ahci_port) {
                     ahci_port);
     return false;
   }
+  mutex_init(&disk->io_lock, "sata_io");
   terminal_printf(&main_terminal,
                   "SATA: I/O buffer allocated at virt=0x%08x, phys=0x%08x\r\n",
                   disk->io_buffer->virtual_address,
@@ -276,6 +277,10 @@ bool sata_disk_setup(sata_disk_t *disk, uint8_t ahci_port) {
   // Verificar otras características
   disk->supports_dma = (identify_data[49] & (1 << 8)) != 0;
   disk->supports_ncq = (identify_data[76] & (1 << 8)) != 0;
+  ahci_set_lba48(ahci_port, disk->supports_lba48);
+  // FPDMA QUEUED siempre usa LBA48. Profundidad en la palabra 75 (0-31).
+  if (disk->supports_ncq && disk->supports_lba48)
+    ahci_enable_ncq(ahci_port, (identify_data[75] & 0x1F) + 1);
   // Extraer modelo (palabras 27-46)
   for (int i = 0; i < 20; i++) {
     uint16_t word = identify_data[27 + i];
@@ -310,6 +315,15 @@ bool sata_disk_setup(sata_disk_t *disk, uint8_t ahci_port) {
 // ========================================================================
 // OPERACIONES DE DISCO
 // ========================================================================
+
+// AHCI arma la tabla PRD página a página, así que el DMA puede ir directo
+// al buffer del llamador en comandos largos siempre que esté alineado a
+// palabra. Así tampoco se serializan las tareas en io_buffer, que es uno
+// por disco.
+static inline bool sata_buffer_dma_ok(const void *buffer) {
+  return ((uint32_t)buffer & 1) == 0;
+}
+
 sata_err_t sata_disk_read(uint32_t disk_id, uint64_t lba, uint32_t count,
                           void *buffer) {
   if (!sata_initialized || disk_id >= sata_disk_count || !buffer ||
@@ -323,17 +337,23 @@ sata_err_t sata_disk_read(uint32_t disk_id, uint64_t lba, uint32_t count,
   if (lba + count > disk->sector_count) {
     return SATA_ERR_LBA_OUT_OF_RANGE;
   }
-  // Para transfers grandes, dividir en chunks
+  if (sata_buffer_dma_ok(buffer)) {
+    return ahci_read_sectors(disk->ahci_port, lba, count, buffer)
+               ? SATA_ERR_NONE
+               : SATA_ERR_IO_ERROR;
+  }
+  // Buffer desalineado: por el buffer DMA interno, en chunks
   uint32_t sectors_per_transfer = SATA_IO_BUFFER_SIZE / SECTOR_SIZE;
   uint8_t *dest_ptr = (uint8_t *)buffer;
   uint64_t current_lba = lba;
   uint32_t remaining = count;
+  mutex_lock(&disk->io_lock);
   while (remaining > 0) {
     uint32_t transfer_count =
         (remaining > sectors_per_transfer) ? sectors_per_transfer : remaining;
-    // Usar buffer DMA interno
     if (!ahci_read_sectors(disk->ahci_port, current_lba, transfer_count,
                            disk->io_buffer->virtual_address)) {
+      mutex_unlock(&disk->io_lock);
       return SATA_ERR_IO_ERROR;
     }
     // Copiar datos al buffer de usuario
@@ -343,6 +363,7 @@ sata_err_t sata_disk_read(uint32_t disk_id, uint64_t lba, uint32_t count,
     current_lba += transfer_count;
     remaining -= transfer_count;
   }
+  mutex_unlock(&disk->io_lock);
   return SATA_ERR_NONE;
 }
 sata_err_t sata_disk_write(uint32_t disk_id, uint64_t lba, uint32_t count,
@@ -358,11 +379,17 @@ sata_err_t sata_disk_write(uint32_t disk_id, uint64_t lba, uint32_t count,
   if (lba + count > disk->sector_count) {
     return SATA_ERR_LBA_OUT_OF_RANGE;
   }
-  // Para transfers grandes, dividir en chunks
+  if (sata_buffer_dma_ok(buffer)) {
+    return ahci_write_sectors(disk->ahci_port, lba, count, buffer)
+               ? SATA_ERR_NONE
+               : SATA_ERR_IO_ERROR;
+  }
+  // Buffer desalineado: por el buffer DMA interno, en chunks
   uint32_t sectors_per_transfer = SATA_IO_BUFFER_SIZE / SECTOR_SIZE;
   const uint8_t *src_ptr = (const uint8_t *)buffer;
   uint64_t current_lba = lba;
   uint32_t remaining = count;
+  mutex_lock(&disk->io_lock);
   while (remaining > 0) {
     uint32_t transfer_count =
         (remaining > sectors_per_transfer) ? sectors_per_transfer : remaining;
@@ -371,12 +398,14 @@ sata_err_t sata_disk_write(uint32_t disk_id, uint64_t lba, uint32_t count,
            transfer_count * SECTOR_SIZE);
     if (!ahci_write_sectors(disk->ahci_port, current_lba, transfer_count,
                             disk->io_buffer->virtual_address)) {
+      mutex_unlock(&disk->io_lock);
       return SATA_ERR_IO_ERROR;
     }
     src_ptr += transfer_count * SECTOR_SIZE;
     current_lba += transfer_count;
     remaining -= transfer_count;
   }
+  mutex_unlock(&disk->io_lock);
   return SATA_ERR_NONE;
 }
 
@@ -679,6 +708,72 @@ disk_err_t sata_to_legacy_disk_write(disk_t *disk, uint64_t lba, uint32_t count,
   return DISK_ERR_NONE;
 }
 
+// ========================================================================
+// DRIVER DE BLOQUE
+// ========================================================================
+
+// Índice en sata_disks según drive_number (0xC0-0xCF, o el rango antiguo
+// 0x80-0x8F); -1 si no corresponde a ningún disco
+static int sata_block_disk_id(const disk_t *disk) {
+  uint32_t id;
+  if (disk->drive_number >= 0xC0 && disk->drive_number <= 0xCF)
+    id = disk->drive_number - 0xC0;
+  else if (disk->drive_number >= 0x80 && disk->drive_number <= 0x8F)
+    id = disk->drive_number - 0x80;
+  else
+    return -1;
+  return id < sata_disk_count ? (int)id : -1;
+}
+
+static bool sata_block_match(disk_t *disk) {
+  return disk->type == DEVICE_TYPE_SATA_DISK;
+}
+
+static disk_err_t sata_block_submit(disk_t *disk, disk_op_t op, uint64_t lba,
+                                    uint32_t count, void *buffer) {
+  return op == DISK_OP_READ
+             ? sata_to_legacy_disk_read(disk, lba, count, buffer)
+             : sata_to_legacy_disk_write(disk, lba, count, buffer);
+}
+
+static disk_err_t sata_block_flush(disk_t *disk) {
+  int id = sata_block_disk_id(disk);
+  if (id < 0) {
+    terminal_printf(&main_terminal,
+                    "SATA: Invalid drive_number for flush: 0x%02x\n",
+                    disk->drive_number);
+    return DISK_ERR_INVALID_PARAM;
+  }
+
+  switch (sata_disk_flush((uint32_t)id)) {
+  case SATA_ERR_NONE:
+    return DISK_ERR_NONE;
+  case SATA_ERR_INVALID_PARAM:
+    return DISK_ERR_INVALID_PARAM;
+  case SATA_ERR_NOT_INITIALIZED:
+    return DISK_ERR_NOT_INITIALIZED;
+  default:
+    terminal_printf(&main_terminal, "SATA: Flush failed on disk %d\n", id);
+    return DISK_ERR_ATA;
+  }
+}
+
+// Comandos tan largos como admita el puerto y, con NCQ, tantos en vuelo
+// como etiquetas
+static void sata_block_limits(disk_t *disk, block_queue_limits_t *limits) {
+  int id = sata_block_disk_id(disk);
+  if (id < 0)
+    return;
+  uint8_t port_num = sata_disks[id].ahci_port;
+  ahci_port_t *port = &ahci_controller.ports[port_num];
+  limits->max_transfer_sectors = ahci_max_sectors(port_num);
+  limits->queue_depth = port->ncq_enabled ? port->ncq_depth : 1;
+}
+
+const block_device_ops_t sata_block_ops = {
+    "sata", sata_block_match, sata_block_submit, sata_block_flush,
+    sata_block_limits};
+
 // Test function para verificar funcionamiento
 bool sata_disk_test(uint32_t disk_id) {
   if (!sata_initialized || disk_id >= sata_disk_count) {
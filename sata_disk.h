@@ -3,6 +3,7 @@
 
 #include "disk.h"
 #include "dma.h"
+#include "task_utils.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -43,6 +44,7 @@ typedef struct {
 
   // I/O Buffer
   dma_buffer_t *io_buffer; // DMA buffer for I/O operations
+  mutex_t io_lock;         // io_buffer es compartido por las tareas
 
   // Statistics
   uint64_t read_count;  // Number of read operations
@@ -78,6 +80,9 @@ disk_err_t sata_to_legacy_disk_read(disk_t *disk, uint64_t lba, uint32_t count,
 disk_err_t sata_to_legacy_disk_write(disk_t *disk, uint64_t lba, uint32_t count,
                                      const void *buffer);
 
+// Driver para el registro de disk.h
+extern const block_device_ops_t sata_block_ops;
+
 // Testing
 bool sata_disk_test(uint32_t disk_id);
 void sata_disk_debug_port(uint8_t port_num);
@@ -0,0 +1,227 @@
+#include "sched_stats.h"
+#include "cpuid.h"
+#include "io.h"
+#include "irq.h"
+#include "kernel.h"
+#include "memory.h"
+#include "string.h"
+#include "task.h"
+#include "task_utils.h"
+#include "terminal.h"
+
+// ========================================================================
+// RELOJ DEL PLANIFICADOR
+// ========================================================================
+
+static bool clock_use_tsc = false;
+static uint32_t clock_cycles_per_us = 1;
+
+// Histogramas globales (suma de todas las tareas)
+static uint32_t sys_hist_wait[SCHED_HIST_BUCKETS];
+static uint32_t sys_hist_wakeup[SCHED_HIST_BUCKETS];
+
+static inline uint64_t sched_rdtsc(void) {
+  uint32_t lo, hi;
+  __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+// Mide el TSC durante 10 ms con el canal 2 del PIT en modo 0 (mismo
+// método que la calibración del timer del APIC; no necesita IRQs)
+static uint32_t sched_clock_calibrate(void) {
+  uint8_t gate = inb(0x61);
+  outb(0x61, gate & ~0x02); // Speaker apagado
+  outb(0x43, 0xB0);         // Canal 2, LSB/MSB, modo 0
+  outb(0x42, 11931 & 0xFF); // 10 ms a 1.193182 MHz
+  outb(0x42, 11931 >> 8);
+
+  uint32_t flags = local_irq_save();
+  outb(0x61, (gate & ~0x02) | 0x01); // Arrancar el conteo
+  uint64_t start = sched_rdtsc();
+  uint32_t spins = 0;
+  while ((inb(0x61) & 0x20) == 0 && ++spins < 100000000)
+    ;
+  uint64_t end = sched_rdtsc();
+  local_irq_restore(flags);
+  outb(0x61, gate);
+
+  return (uint32_t)((end - start) / 10000);
+}
+
+void sched_clock_init(void) {
+  if (cpu_info.caps.has_tsc) {
+    uint32_t cycles_per_us = sched_clock_calibrate();
+    if (cycles_per_us > 0) {
+      clock_cycles_per_us = cycles_per_us;
+      clock_use_tsc = true;
+    }
+  }
+
+  if (clock_use_tsc)
+    terminal_printf(&main_terminal, "Sched clock: TSC at %u MHz\r\n",
+                    clock_cycles_per_us);
+  else
+    terminal_puts(&main_terminal,
+                  "Sched clock: no TSC, using timer ticks (10 ms)\r\n");
+}
+
+uint64_t sched_clock(void) {
+  if (clock_use_tsc)
+    return sched_rdtsc();
+  // Sin TSC: ticks convertidos a us (resolución de un tick)
+  return (uint64_t)ticks_since_boot * SCHED_TICK_US;
+}
+
+uint64_t sched_clock_to_us(uint64_t cycles) {
+  return cycles / clock_cycles_per_us;
+}
+
+uint32_t sched_clock_mhz(void) {
+  return clock_use_tsc ? clock_cycles_per_us : 0;
+}
+
+// ========================================================================
+// HISTOGRAMAS
+// ========================================================================
+
+uint32_t sched_hist_bucket(uint32_t us) {
+  if (us < 16)
+    return 0;
+  uint32_t bucket = 31 - (uint32_t)__builtin_clz(us) - 3;
+  return bucket < SCHED_HIST_BUCKETS ? bucket : SCHED_HIST_BUCKETS - 1;
+}
+
+uint32_t sched_hist_bucket_floor_us(uint32_t bucket) {
+  return bucket == 0 ? 0 : 1u << (bucket + 3);
+}
+
+static inline uint32_t sched_cycles_to_us32(uint64_t cycles) {
+  uint64_t us = sched_clock_to_us(cycles);
+  return us > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)us;
+}
+
+// ========================================================================
+// GANCHOS DEL PLANIFICADOR
+// ========================================================================
+
+void sched_stats_ready(task_t *task, bool waking) {
+  task_sched_stats_t *st = &task->sched_stats;
+  if (st->ready_since)
+    return; // Ya estaba en cola
+  st->ready_since = sched_clock();
+  if (waking) {
+    st->wakeup_pending = true;
+    st->wakeups++;
+  }
+}
+
+void sched_stats_run(task_t *task) {
+  task_sched_stats_t *st = &task->sched_stats;
+  uint64_t now = sched_clock();
+
+  if (st->ready_since) {
+    uint64_t waited = now - st->ready_since;
+    uint32_t us = sched_cycles_to_us32(waited);
+    uint32_t bucket = sched_hist_bucket(us);
+
+    st->wait_cycles += waited;
+    st->hist_wait[bucket]++;
+    sys_hist_wait[bucket]++;
+    if (us > st->max_wait_us)
+      st->max_wait_us = us;
+
+    if (st->wakeup_pending) {
+      st->hist_wakeup[bucket]++;
+      sys_hist_wakeup[bucket]++;
+      if (us > st->max_wakeup_us)
+        st->max_wakeup_us = us;
+    }
+    st->ready_since = 0;
+  }
+  st->wakeup_pending = false;
+  // Si ya estaba en CPU (despertada antes de ceder) el tramo continúa
+  if (!st->exec_start) {
+    st->exec_start = now;
+    st->runs++;
+  }
+}
+
+void sched_stats_stop(task_t *task) {
+  task_sched_stats_t *st = &task->sched_stats;
+  if (!st->exec_start)
+    return;
+
+  uint64_t ran = sched_clock() - st->exec_start;
+  uint32_t us = sched_cycles_to_us32(ran);
+  st->runtime_cycles += ran;
+  st->hist_run[sched_hist_bucket(us)]++;
+  st->exec_start = 0;
+
+  task_profiling_update(task, us);
+}
+
+uint64_t sched_stats_runtime_us(task_t *task) {
+  task_sched_stats_t *st = &task->sched_stats;
+  uint64_t cycles = st->runtime_cycles;
+  if (st->exec_start)
+    cycles += sched_clock() - st->exec_start;
+  return sched_clock_to_us(cycles);
+}
+
+uint64_t sched_stats_wait_us(task_t *task) {
+  task_sched_stats_t *st = &task->sched_stats;
+  uint64_t cycles = st->wait_cycles;
+  if (st->ready_since)
+    cycles += sched_clock() - st->ready_since;
+  return sched_clock_to_us(cycles);
+}
+
+// ========================================================================
+// /sys/sched
+// ========================================================================
+
+static size_t sched_format_hist(char *buf, size_t size, const char *title,
+                                const uint32_t *hist) {
+  size_t pos = (size_t)snprintf(buf, size, "%s:\n", title);
+  for (uint32_t i = 0; i < SCHED_HIST_BUCKETS && pos < size; i++) {
+    if (!hist[i])
+      continue;
+    pos += (size_t)snprintf(buf + pos, size - pos, "  >=%uus %u\n",
+                            sched_hist_bucket_floor_us(i), hist[i]);
+  }
+  return pos < size ? pos : size;
+}
+
+char *sched_stats_format(size_t *len) {
+  size_t size = 2048 + (size_t)(scheduler.task_count + 8) * 112;
+  char *buf = (char *)kernel_malloc(size);
+  if (!buf)
+    return NULL;
+
+  size_t pos = (size_t)snprintf(buf, size, "clock: %s %u MHz\n",
+                                clock_use_tsc ? "tsc" : "ticks",
+                                sched_clock_mhz());
+  pos += sched_format_hist(buf + pos, size - pos, "wait", sys_hist_wait);
+  pos += sched_format_hist(buf + pos, size - pos, "wakeup", sys_hist_wakeup);
+  pos += (size_t)snprintf(buf + pos, size - pos,
+                          "pid name runtime_ms wait_ms runs wakeups "
+                          "max_wait_us max_wakeup_us\n");
+
+  task_t *t = scheduler.task_list;
+  if (t) {
+    do {
+      if (pos + 112 >= size)
+        break;
+      task_sched_stats_t *st = &t->sched_stats;
+      pos += (size_t)snprintf(
+          buf + pos, size - pos, "%u %s %u %u %u %u %u %u\n", t->task_id,
+          t->name, (uint32_t)(sched_stats_runtime_us(t) / 1000),
+          (uint32_t)(sched_stats_wait_us(t) / 1000), st->runs, st->wakeups,
+          st->max_wait_us, st->max_wakeup_us);
+      t = t->next;
+    } while (t != scheduler.task_list);
+  }
+
+  *len = pos < size ? pos : size - 1;
+  return buf;
+}
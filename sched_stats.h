@@ -0,0 +1,63 @@
+#ifndef SCHED_STATS_H
+#define SCHED_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ========================================================================
+// CONTABILIDAD DE CPU Y LATENCIAS DEL PLANIFICADOR
+// ========================================================================
+//
+// Cada cambio de contexto se marca con el TSC: al salir de la CPU se suma
+// el tramo ejecutado, al entrar se suma lo que la tarea pasó READY en cola
+// y, si venía de dormir o esperar, la latencia despertar -> ejecutar. Los
+// tres valores van además a histogramas log2 por tarea (en us) que se ven
+// con "taskinfo <pid>" y en /sys/sched.
+
+// Bucket 0: < 16 us; bucket i: [2^(i+3), 2^(i+4)) us; el último acumula
+// todo lo que supere ~262 ms
+#define SCHED_HIST_BUCKETS 16
+
+typedef struct task_sched_stats {
+  uint64_t exec_start;     // Reloj al entrar en CPU (0 = no está en CPU)
+  uint64_t ready_since;    // Reloj al pasar a READY (0 = no está en cola)
+  uint64_t runtime_cycles; // CPU total consumida
+  uint64_t wait_cycles;    // Total READY esperando CPU
+  uint32_t runs;           // Veces que entró en CPU
+  uint32_t wakeups;        // Veces que volvió de dormir/esperar
+  bool wakeup_pending;     // El paso a READY actual fue un despertar
+  uint32_t max_wait_us;
+  uint32_t max_wakeup_us;
+  uint32_t hist_run[SCHED_HIST_BUCKETS];    // Duración de cada tramo en CPU
+  uint32_t hist_wait[SCHED_HIST_BUCKETS];   // Espera en cola por tramo
+  uint32_t hist_wakeup[SCHED_HIST_BUCKETS]; // Despertar -> ejecutar
+} task_sched_stats_t;
+
+struct task;
+
+// Reloj del planificador: TSC calibrado contra el PIT (o ticks si no hay)
+void sched_clock_init(void);
+uint64_t sched_clock(void);
+uint64_t sched_clock_to_us(uint64_t cycles);
+uint32_t sched_clock_mhz(void);
+
+// Ganchos del planificador (llamar con scheduler_lock tomado)
+void sched_stats_ready(struct task *task, bool waking);
+void sched_stats_run(struct task *task);
+void sched_stats_stop(struct task *task);
+
+// Totales en us (incluye el tramo en curso si la tarea está en CPU)
+uint64_t sched_stats_runtime_us(struct task *task);
+uint64_t sched_stats_wait_us(struct task *task);
+
+// Bucket de una duración en us y límite inferior en us de un bucket (0
+// para el primero)
+uint32_t sched_hist_bucket(uint32_t us);
+uint32_t sched_hist_bucket_floor_us(uint32_t bucket);
+
+// Texto de /sys/sched. Devuelve un buffer de kernel_malloc (lo libera el
+// llamador) y su longitud en *len.
+char *sched_stats_format(size_t *len);
+
+#endif // SCHED_STATS_H
@@ -2,6 +2,7 @@
 #include "chardev.h" // <-- Añadido para usar estructuras comunes
 #include "io.h"
 #include "irq.h"
+#include "softirq.h"
 #include "task.h"
 #include "terminal.h"
 #include "vfs.h"
@@ -230,14 +231,18 @@ void serial_init(void) {
 // ============================================================================
 // IRQ HANDLER
 // ============================================================================
-void serial_irq_handler_line(int irq) {
-  if (irq != 3 && irq != 4) {
-    pic_send_eoi(irq);
-    return;
-  }
-
-  uint16_t port = (irq == 4) ? COM1_BASE : COM2_BASE;
-
+// Top half: silencia la UART (IER=0), marca el puerto y programa el tasklet.
+// El vaciado de FIFOs se hace en el bottom half con IRQs habilitadas, que
+// vuelve a habilitar RX (y THRE si queda algo por enviar).
+#define SERIAL_PENDING_COM1 0x01
+#define SERIAL_PENDING_COM2 0x02
+
+static volatile uint32_t serial_pending_ports = 0;
+static void serial_tasklet_func(uint32_t data);
+static tasklet_t serial_tasklet =
+    TASKLET_INIT("serial", serial_tasklet_func, 0);
+
+static void serial_service_port(uint16_t port) {
   volatile char *tx_queue = (port == COM1_BASE) ? tx_queue_com1 : tx_queue_com2;
   volatile int *tx_head = (port == COM1_BASE) ? &tx_head_com1 : &tx_head_com2;
   volatile int *tx_tail = (port == COM1_BASE) ? &tx_tail_com1 : &tx_tail_com2;
@@ -301,7 +306,42 @@ void serial_irq_handler_line(int irq) {
     }
   }
 
+  // Reactivar las interrupciones de la UART
+  uint32_t flags = local_irq_save();
+  outb(port + UART_IER, UART_IER_RX | (*tx_busy ? UART_IER_THRE : 0));
+  local_irq_restore(flags);
+}
+
+static void serial_tasklet_func(uint32_t data) {
+  (void)data;
+
+  uint32_t flags = local_irq_save();
+  uint32_t pending = serial_pending_ports;
+  serial_pending_ports = 0;
+  local_irq_restore(flags);
+
+  if (pending & SERIAL_PENDING_COM1)
+    serial_service_port(COM1_BASE);
+  if (pending & SERIAL_PENDING_COM2)
+    serial_service_port(COM2_BASE);
+}
+
+void serial_irq_handler_line(int irq) {
+  if (irq != 3 && irq != 4) {
+    pic_send_eoi(irq);
+    return;
+  }
+
+  uint16_t port = (irq == 4) ? COM1_BASE : COM2_BASE;
+
+  // La UART mantiene la línea activa hasta vaciar sus FIFOs: se enmascara
+  // en el dispositivo hasta que el bottom half la atienda
+  outb(port + UART_IER, 0x00);
+  serial_pending_ports |= (irq == 4) ? SERIAL_PENDING_COM1 : SERIAL_PENDING_COM2;
+
   pic_send_eoi(irq);
+  tasklet_schedule(&serial_tasklet);
+  irq_exit();
 }
 
 // ============================================================================
@@ -320,8 +360,10 @@ int serial_write_char(uint16_t port, char c) {
   uint32_t flags;
   __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
 
-  // Polling mode if interrupts disabled or scheduler not running
-  if (!(flags & 0x200) || !scheduler.scheduler_enabled) {
+  // Polling mode if interrupts disabled, scheduler not running or inside a
+  // bottom half (must not yield there)
+  if (!(flags & 0x200) || !scheduler.scheduler_enabled ||
+      softirq_in_progress()) {
     uint32_t timeout = 1000000;
     while (!serial_can_write(port) && timeout > 0) {
       __asm__ __volatile__("pause");
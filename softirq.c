@@ -0,0 +1,177 @@
+#include "softirq.h"
+#include "kernel.h"
+#include "spinlock.h"
+#include "terminal.h"
+#include "workqueue.h"
+
+// ========================================================================
+// ESTADO
+// ========================================================================
+
+static void tasklet_action(void);
+static void softirq_work_func(void *arg);
+
+static softirq_handler_t softirq_vec[NR_SOFTIRQS] = {
+    [SOFTIRQ_TASKLET] = tasklet_action,
+};
+
+static const char *softirq_names[NR_SOFTIRQS] = {"TIMER", "NET", "BLOCK",
+                                                 "TASKLET"};
+
+static volatile uint32_t softirq_pending = 0;
+static volatile bool softirq_running = false;
+
+// Cola de tasklets programados (se toca con IRQs deshabilitadas)
+static tasklet_t *tasklet_head = NULL;
+static tasklet_t **tasklet_tail = &tasklet_head;
+
+// Continuación en la workqueue cuando irq_exit agota sus vueltas
+static work_t softirq_work = WORK_INIT(softirq_work_func, NULL);
+
+static uint32_t softirq_counts[NR_SOFTIRQS];
+static uint32_t softirq_deferred = 0;
+static uint32_t tasklet_runs = 0;
+
+// ========================================================================
+// NÚCLEO
+// ========================================================================
+
+void open_softirq(softirq_nr_t nr, softirq_handler_t handler) {
+  if (nr < NR_SOFTIRQS)
+    softirq_vec[nr] = handler;
+}
+
+void raise_softirq(softirq_nr_t nr) {
+  if (nr >= NR_SOFTIRQS)
+    return;
+  uint32_t flags = local_irq_save();
+  softirq_pending |= 1u << nr;
+  local_irq_restore(flags);
+}
+
+bool softirq_in_progress(void) { return softirq_running; }
+
+// Ejecuta los softirqs pendientes con IRQs habilitadas. Una IRQ que llegue
+// mientras tanto solo marca su bit y lo recoge la siguiente vuelta.
+static void do_softirq(void) {
+  uint32_t flags = local_irq_save();
+  if (softirq_running || !softirq_pending) {
+    local_irq_restore(flags);
+    return;
+  }
+  softirq_running = true;
+
+  uint32_t restart = SOFTIRQ_MAX_RESTART;
+  uint32_t pending;
+  while ((pending = softirq_pending) != 0 && restart-- > 0) {
+    softirq_pending = 0;
+    __asm__ __volatile__("sti");
+
+    for (uint32_t nr = 0; pending; nr++, pending >>= 1) {
+      if (!(pending & 1))
+        continue;
+      softirq_counts[nr]++;
+      if (softirq_vec[nr])
+        softirq_vec[nr]();
+    }
+
+    __asm__ __volatile__("cli");
+  }
+
+  softirq_running = false;
+
+  // Carga sostenida: lo que quede lo termina un worker, así las tareas
+  // interrumpidas pueden avanzar
+  if (softirq_pending) {
+    softirq_deferred++;
+    queue_work_item(&softirq_work);
+  }
+
+  local_irq_restore(flags);
+}
+
+void irq_exit(void) {
+  if (!softirq_pending || softirq_running)
+    return;
+  do_softirq();
+}
+
+static void softirq_work_func(void *arg) {
+  (void)arg;
+  do_softirq();
+}
+
+// ========================================================================
+// TASKLETS
+// ========================================================================
+
+void tasklet_init(tasklet_t *t, const char *name, void (*func)(uint32_t),
+                  uint32_t data) {
+  if (!t)
+    return;
+  t->next = NULL;
+  t->state = 0;
+  t->func = func;
+  t->data = data;
+  t->name = name ? name : "tasklet";
+  t->runs = 0;
+}
+
+void tasklet_schedule(tasklet_t *t) {
+  if (!t || !t->func)
+    return;
+
+  uint32_t flags = local_irq_save();
+  if (!(t->state & TASKLET_SCHEDULED)) {
+    t->state |= TASKLET_SCHEDULED;
+    t->next = NULL;
+    *tasklet_tail = t;
+    tasklet_tail = &t->next;
+    softirq_pending |= 1u << SOFTIRQ_TASKLET;
+  }
+  local_irq_restore(flags);
+}
+
+static void tasklet_action(void) {
+  // Tomar la lista entera; los que se reprogramen durante la ejecución
+  // entran en una lista nueva y se ejecutan en la siguiente vuelta
+  uint32_t flags = local_irq_save();
+  tasklet_t *list = tasklet_head;
+  tasklet_head = NULL;
+  tasklet_tail = &tasklet_head;
+  local_irq_restore(flags);
+
+  while (list) {
+    tasklet_t *t = list;
+    list = t->next;
+
+    flags = local_irq_save();
+    t->state = (t->state & ~TASKLET_SCHEDULED) | TASKLET_RUNNING;
+    local_irq_restore(flags);
+
+    t->func(t->data);
+    t->runs++;
+    tasklet_runs++;
+
+    flags = local_irq_save();
+    t->state &= ~TASKLET_RUNNING;
+    local_irq_restore(flags);
+  }
+}
+
+// ========================================================================
+// ESTADÍSTICAS
+// ========================================================================
+
+void softirq_print_stats(void) {
+  terminal_puts(&main_terminal, "\r\n=== Softirqs ===\r\n");
+  terminal_puts(&main_terminal, "VECTOR    RUNS\r\n");
+  for (int nr = 0; nr < NR_SOFTIRQS; nr++) {
+    terminal_printf(&main_terminal, "%-8s  %u%s\r\n", softirq_names[nr],
+                    softirq_counts[nr], softirq_vec[nr] ? "" : "  (unused)");
+  }
+  terminal_printf(&main_terminal, "Tasklet runs: %u\r\n", tasklet_runs);
+  terminal_printf(&main_terminal, "Deferred to workqueue: %u\r\n",
+                  softirq_deferred);
+  terminal_printf(&main_terminal, "Pending now: 0x%02x\r\n", softirq_pending);
+}
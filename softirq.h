@@ -0,0 +1,64 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ========================================================================
+// BOTTOM HALVES: SOFTIRQS Y TASKLETS
+// ========================================================================
+//
+// Los handlers de IRQ (top half) solo reconocen el dispositivo, mandan el
+// EOI y marcan trabajo pendiente con raise_softirq() o tasklet_schedule().
+// irq_exit(), al final del top half, ejecuta lo pendiente con las IRQs
+// habilitadas antes de volver a la tarea interrumpida. Si hay demasiado
+// trabajo seguido, el resto se pasa a la workqueue para no matar de hambre
+// a las tareas.
+
+typedef enum {
+  SOFTIRQ_TIMER = 0, // Trabajos diferidos / timers del kernel
+  SOFTIRQ_NET,       // Recepción y eventos de la NIC
+  SOFTIRQ_BLOCK,     // Finalización de E/S de disco
+  SOFTIRQ_TASKLET,   // Cola de tasklets
+  NR_SOFTIRQS
+} softirq_nr_t;
+
+#define SOFTIRQ_MAX_RESTART 10 // Vueltas en irq_exit antes de diferir
+
+typedef void (*softirq_handler_t)(void);
+
+// Tasklet: función diferida que nunca corre dos veces a la vez y que se
+// puede programar desde IRQ sin reservar memoria
+#define TASKLET_SCHEDULED 0x01
+#define TASKLET_RUNNING 0x02
+
+typedef struct tasklet {
+  struct tasklet *next;
+  volatile uint32_t state;
+  void (*func)(uint32_t data);
+  uint32_t data;
+  const char *name;
+  uint32_t runs;
+} tasklet_t;
+
+#define TASKLET_INIT(tname, fn, d) {NULL, 0, fn, d, tname, 0}
+
+void open_softirq(softirq_nr_t nr, softirq_handler_t handler);
+
+// Marcar pendiente (desde cualquier contexto, normalmente un top half)
+void raise_softirq(softirq_nr_t nr);
+
+// Ejecutar lo pendiente con IRQs habilitadas. Llamar al final del top half,
+// después del EOI. No hace nada si ya se están ejecutando bottom halves.
+void irq_exit(void);
+
+// true mientras se ejecutan bottom halves (no se debe cambiar de tarea)
+bool softirq_in_progress(void);
+
+void tasklet_init(tasklet_t *t, const char *name, void (*func)(uint32_t),
+                  uint32_t data);
+void tasklet_schedule(tasklet_t *t);
+
+void softirq_print_stats(void);
+
+#endif // SOFTIRQ_H
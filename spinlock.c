@@ -0,0 +1,200 @@
+#include "spinlock.h"
+#include "kernel.h"
+#include "terminal.h"
+
+// ========================================================================
+// PRIMITIVAS ATÓMICAS
+// ========================================================================
+
+static inline uint32_t atomic_fetch_inc(volatile uint32_t *ptr) {
+  uint32_t value = 1;
+  __asm__ __volatile__("lock; xaddl %0, %1"
+                       : "+r"(value), "+m"(*ptr)
+                       :
+                       : "memory", "cc");
+  return value;
+}
+
+static inline bool atomic_cmpxchg(volatile uint32_t *ptr, uint32_t expected,
+                                  uint32_t desired) {
+  uint32_t prev;
+  __asm__ __volatile__("lock; cmpxchgl %2, %1"
+                       : "=a"(prev), "+m"(*ptr)
+                       : "r"(desired), "0"(expected)
+                       : "memory", "cc");
+  return prev == expected;
+}
+
+static inline void cpu_relax(void) { __asm__ __volatile__("pause"); }
+
+// ========================================================================
+// ESTADÍSTICAS DE RETENCIÓN (SOLO DEBUG)
+// ========================================================================
+
+#ifdef SPINLOCK_DEBUG
+static spinlock_t *registered_locks = NULL;
+
+static inline uint64_t spinlock_rdtsc(void) {
+  uint32_t lo, hi;
+  __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+static void spinlock_register(spinlock_t *lock) {
+  // Se llama con el lock ya tomado, así que no hay carrera sobre 'registered'
+  if (lock->registered)
+    return;
+  uint32_t flags = local_irq_save();
+  lock->registered = true;
+  lock->next_registered = registered_locks;
+  registered_locks = lock;
+  local_irq_restore(flags);
+}
+
+static inline void spinlock_note_acquired(spinlock_t *lock, bool contended) {
+  spinlock_register(lock);
+  lock->acquisitions++;
+  if (contended)
+    lock->contentions++;
+  lock->acquired_at = spinlock_rdtsc();
+}
+
+static inline void spinlock_note_released(spinlock_t *lock) {
+  uint64_t held = spinlock_rdtsc() - lock->acquired_at;
+  lock->total_hold_cycles += held;
+  if (held > lock->max_hold_cycles)
+    lock->max_hold_cycles = held;
+}
+#else
+#define spinlock_note_acquired(lock, contended) ((void)0)
+#define spinlock_note_released(lock) ((void)0)
+#endif
+
+// ========================================================================
+// API
+// ========================================================================
+
+void spinlock_init(spinlock_t *lock, const char *name) {
+  if (!lock)
+    return;
+  lock->next_ticket = 0;
+  lock->owner_ticket = 0;
+  lock->name = name ? name : "unnamed_lock";
+#ifdef SPINLOCK_DEBUG
+  lock->acquired_at = 0;
+  lock->total_hold_cycles = 0;
+  lock->max_hold_cycles = 0;
+  lock->acquisitions = 0;
+  lock->contentions = 0;
+  // Los locks inicializados en tiempo de ejecución pueden vivir en la pila o
+  // en memoria dinámica (mutex, semáforos...): no se enlazan en la lista
+  // global para no dejar punteros colgantes. Solo se reportan los estáticos.
+  lock->registered = true;
+  lock->next_registered = NULL;
+#endif
+}
+
+void spin_lock(spinlock_t *lock) {
+  uint32_t ticket = atomic_fetch_inc(&lock->next_ticket);
+  bool contended = false;
+
+  while (lock->owner_ticket != ticket) {
+    contended = true;
+    cpu_relax();
+  }
+  __asm__ __volatile__("" ::: "memory");
+
+  spinlock_note_acquired(lock, contended);
+  (void)contended;
+}
+
+bool spin_trylock(spinlock_t *lock) {
+  uint32_t owner = lock->owner_ticket;
+  if (lock->next_ticket != owner)
+    return false;
+  if (!atomic_cmpxchg(&lock->next_ticket, owner, owner + 1))
+    return false;
+
+  spinlock_note_acquired(lock, false);
+  return true;
+}
+
+void spin_unlock(spinlock_t *lock) {
+  spinlock_note_released(lock);
+  // En x86 un store normal tiene semántica release; solo evitamos que el
+  // compilador reordene los accesos de la sección crítica
+  __asm__ __volatile__("" ::: "memory");
+  lock->owner_ticket = lock->owner_ticket + 1;
+}
+
+bool spin_is_locked(spinlock_t *lock) {
+  return lock->next_ticket != lock->owner_ticket;
+}
+
+uint32_t spin_lock_irqsave(spinlock_t *lock) {
+  uint32_t flags = local_irq_save();
+  spin_lock(lock);
+  return flags;
+}
+
+bool spin_trylock_irqsave(spinlock_t *lock, uint32_t *flags) {
+  uint32_t saved = local_irq_save();
+  if (!spin_trylock(lock)) {
+    local_irq_restore(saved);
+    return false;
+  }
+  *flags = saved;
+  return true;
+}
+
+void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags) {
+  spin_unlock(lock);
+  local_irq_restore(flags);
+}
+
+// ========================================================================
+// REPORTE
+// ========================================================================
+
+void spinlock_print_stats(void) {
+#ifdef SPINLOCK_DEBUG
+  terminal_puts(&main_terminal, "\r\n=== Spinlock Statistics ===\r\n");
+  terminal_puts(&main_terminal,
+                "NAME              ACQUIRED  CONTENDED  AVG CYC    MAX CYC\r\n");
+
+  // La lista solo crece por la cabeza, se puede recorrer sin bloquear
+  for (spinlock_t *lock = registered_locks; lock; lock = lock->next_registered) {
+    // Evitar división de 64 bits (no enlazamos libgcc)
+    uint64_t total = lock->total_hold_cycles;
+    uint32_t count = lock->acquisitions;
+    while (total > 0xFFFFFFFFULL && count > 1) {
+      total >>= 1;
+      count >>= 1;
+    }
+    uint32_t avg = count ? (uint32_t)total / count : 0;
+    uint32_t max = lock->max_hold_cycles > 0xFFFFFFFFULL
+                       ? 0xFFFFFFFF
+                       : (uint32_t)lock->max_hold_cycles;
+    terminal_printf(&main_terminal, "%-16s  %-8u  %-9u  %-9u  %u%s\r\n",
+                    lock->name, lock->acquisitions, lock->contentions, avg, max,
+                    spin_is_locked(lock) ? "  [HELD]" : "");
+  }
+  terminal_puts(&main_terminal, "\r\n");
+#else
+  terminal_puts(&main_terminal,
+                "Lock statistics not available (build with DEBUG=1)\r\n");
+#endif
+}
+
+void spinlock_reset_stats(void) {
+#ifdef SPINLOCK_DEBUG
+  uint32_t flags = local_irq_save();
+  for (spinlock_t *lock = registered_locks; lock; lock = lock->next_registered) {
+    lock->total_hold_cycles = 0;
+    lock->max_hold_cycles = 0;
+    lock->acquisitions = 0;
+    lock->contentions = 0;
+  }
+  local_irq_restore(flags);
+#endif
+}
@@ -0,0 +1,91 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "latency.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ========================================================================
+// SPINLOCKS TIPO TICKET
+// ========================================================================
+//
+// Cada CPU que quiere el lock toma un ticket (lock xadd sobre next_ticket)
+// y espera a que owner_ticket llegue a su número. Esto da orden FIFO y
+// evita starvation cuando haya SMP. En uniprocesador las variantes
+// _irqsave son las que realmente protegen contra los IRQ handlers.
+//
+// Compilar con -DSPINLOCK_DEBUG (DEBUG=1 ./build.sh) para registrar
+// tiempos de retención con rdtsc y verlos con el comando "locks".
+
+#define EFLAGS_IF 0x200
+
+typedef struct spinlock {
+  volatile uint32_t next_ticket;  // Próximo ticket a repartir
+  volatile uint32_t owner_ticket; // Ticket que tiene el lock ahora
+  const char *name;
+#ifdef SPINLOCK_DEBUG
+  uint64_t acquired_at;       // TSC al adquirir
+  uint64_t total_hold_cycles; // Suma de ciclos retenidos
+  uint64_t max_hold_cycles;   // Peor caso
+  uint32_t acquisitions;
+  uint32_t contentions; // Veces que hubo que esperar
+  bool registered;
+  struct spinlock *next_registered;
+#endif
+} spinlock_t;
+
+#ifdef SPINLOCK_DEBUG
+#define SPINLOCK_INIT(lock_name)                                               \
+  { 0, 0, lock_name, 0, 0, 0, 0, 0, false, NULL }
+#else
+#define SPINLOCK_INIT(lock_name) {0, 0, lock_name}
+#endif
+
+// ------------------------------------------------------------------------
+// Control de interrupciones locales
+// ------------------------------------------------------------------------
+//
+// Las transiciones habilitadas <-> deshabilitadas pasan por el latency
+// tracer; las anidadas (IRQs ya deshabilitadas) no.
+
+static inline uint32_t local_irq_save(void) {
+  uint32_t flags;
+  __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags)::"memory");
+  if ((flags & EFLAGS_IF) && latency_trace_enabled)
+    latency_irqs_off(__builtin_return_address(0));
+  return flags;
+}
+
+static inline void local_irq_restore(uint32_t flags) {
+  if ((flags & EFLAGS_IF) && latency_trace_enabled)
+    latency_irqs_on(__builtin_return_address(0));
+  __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags) : "memory", "cc");
+}
+
+static inline bool local_irq_enabled(void) {
+  uint32_t flags;
+  __asm__ __volatile__("pushf\n\tpop %0" : "=r"(flags));
+  return (flags & EFLAGS_IF) != 0;
+}
+
+// ------------------------------------------------------------------------
+// API
+// ------------------------------------------------------------------------
+
+void spinlock_init(spinlock_t *lock, const char *name);
+void spin_lock(spinlock_t *lock);
+bool spin_trylock(spinlock_t *lock);
+void spin_unlock(spinlock_t *lock);
+bool spin_is_locked(spinlock_t *lock);
+
+// Variantes que además deshabilitan IRQs locales (datos compartidos con ISRs)
+uint32_t spin_lock_irqsave(spinlock_t *lock);
+bool spin_trylock_irqsave(spinlock_t *lock, uint32_t *flags);
+void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags);
+
+// Estadísticas (solo con SPINLOCK_DEBUG, si no imprime un aviso)
+void spinlock_print_stats(void);
+void spinlock_reset_stats(void);
+
+#endif // SPINLOCK_H
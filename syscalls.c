@@ -1,6 +1,7 @@
 #include "syscalls.h"
 #include "dns.h"
 #include "driver_system.h"
+#include "futex.h"
 #include "idt.h"
 #include "irq.h"
 #include "kernel.h"
@@ -310,12 +311,10 @@ void syscall_handler(struct regs *r) {
       for (bytes_read = 0; bytes_read < count; bytes_read++) {
         int key = keyboard_getkey_nonblock();
         if (key == -1) {
-          task_sleep(1);
-          if (keyboard_available()) {
-            key = keyboard_getkey_nonblock();
-          } else {
+          // Un tick de margen para la siguiente tecla
+          key = keyboard_getkey_wait(1);
+          if (key == -1)
             break;
-          }
         }
 
         if (key == '\n') {
@@ -361,6 +360,10 @@ void syscall_handler(struct regs *r) {
   }
 
   case SYSCALL_GETPID:
+    result = current->tgid;
+    break;
+
+  case SYSCALL_GETTID:
     result = current->task_id;
     break;
 
@@ -381,31 +384,17 @@ void syscall_handler(struct regs *r) {
   // ============================================
   // SYSCALLS DE TECLADO
   // ============================================
-  case SYSCALL_READKEY: {
-    int key = -1;
-    while (key == -1) {
-      key = keyboard_getkey_nonblock();
-      if (key == -1)
-        task_sleep(10);
-    }
-    result = (uint32_t)key;
+  case SYSCALL_READKEY:
+    result = (uint32_t)keyboard_getkey_wait(0);
     break;
-  }
 
   case SYSCALL_KEY_AVAILABLE:
     result = (uint32_t)keyboard_available();
     break;
 
-  case SYSCALL_GETC: {
-    int key = -1;
-    while (key == -1) {
-      key = keyboard_getkey_nonblock();
-      if (key == -1)
-        task_sleep(10);
-    }
-    result = (uint32_t)key;
+  case SYSCALL_GETC:
+    result = (uint32_t)keyboard_getkey_wait(0);
     break;
-  }
 
   case SYSCALL_GETS: {
     uint32_t buf_ptr = r->ebx;
@@ -427,12 +416,7 @@ void syscall_handler(struct regs *r) {
     bool done = false;
 
     while (!done && pos < max_len - 1) {
-      int key = -1;
-      while (key == -1) {
-        key = keyboard_getkey_nonblock();
-        if (key == -1)
-          task_sleep(10);
-      }
+      int key = keyboard_getkey_wait(0);
 
       if (key == '\n') {
         kernel_buffer[pos] = '\0';
@@ -859,6 +843,54 @@ void syscall_handler(struct regs *r) {
     break;
   }
 
+  // ============================================
+  // SYSCALLS DE HILOS
+  // ============================================
+  case SYSCALL_THREAD_CREATE: {
+    uint32_t entry = r->ebx;
+    uint32_t arg = r->ecx;
+    uint32_t stack_size = r->edx;
+
+    uint32_t entry_flags = mmu_get_page_flags(entry & ~0xFFF);
+    if (entry == 0 || entry >= 0xC0000000 || !(entry_flags & PAGE_PRESENT) ||
+        !(entry_flags & PAGE_USER)) {
+      result = (uint32_t)-EFAULT;
+      break;
+    }
+    if (stack_size > THREAD_STACK_MAX) {
+      result = (uint32_t)-EINVAL;
+      break;
+    }
+
+    task_t *thread =
+        task_create_thread(current, (void *)entry, arg, stack_size);
+    result = thread ? thread->task_id : (uint32_t)-EAGAIN;
+    break;
+  }
+
+  case SYSCALL_FUTEX: {
+    uint32_t uaddr = r->ebx;
+    uint32_t op = r->ecx;
+    uint32_t val = r->edx;
+    uint32_t timeout_ms = r->esi;
+
+    if ((uaddr & 0x3) || !validate_user_pointer(uaddr, sizeof(uint32_t))) {
+      result = (uint32_t)-EFAULT;
+      break;
+    }
+
+    if (op == FUTEX_WAIT) {
+      uint32_t timeout_ticks = timeout_ms ? (timeout_ms + 9) / 10 : 0;
+      result = (uint32_t)futex_wait(current, (volatile uint32_t *)uaddr, val,
+                                    timeout_ticks);
+    } else if (op == FUTEX_WAKE) {
+      result = futex_wake(current, (volatile uint32_t *)uaddr, val);
+    } else {
+      result = (uint32_t)-EINVAL;
+    }
+    break;
+  }
+
   case SYSCALL_STAT:
   case SYSCALL_FORK:
   case SYSCALL_EXECVE:
@@ -919,6 +951,7 @@ void syscall_init(void) {
   // Configurar INT 0x80 como puerta de syscall
   idt_set_gate(0x80, (uintptr_t)syscall_entry, 0x08,
                IDT_FLAG_PRESENT | IDT_FLAG_RING3 | IDT_FLAG_INTERRUPT32);
+  futex_init();
 
   terminal_puts(&main_terminal, "Syscalls initialized (INT 0x80)\r\n");
 }
\ No newline at end of file
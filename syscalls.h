@@ -76,6 +76,13 @@
 #define SYSCALL_RECV 0x44          // Recibir de socket
 #define SYSCALL_DNS_RESOLVE 0x45   // Resolver host DNS
 #define SYSCALL_RTC_GET_DATETIME 0x46 // Obtener fecha y hora real
+#define SYSCALL_THREAD_CREATE 0x47    // Crear hilo en el proceso actual
+#define SYSCALL_FUTEX 0x48            // Esperar/despertar sobre un int
+#define SYSCALL_GETTID 0x49           // Obtener ID del hilo
+
+// Operaciones de SYSCALL_FUTEX
+#define FUTEX_WAIT 0 // Dormir si *uaddr == val
+#define FUTEX_WAKE 1 // Despertar hasta val esperas
 
 // ✅ Definir códigos de error (versión simplificada)
 #define EPERM 1
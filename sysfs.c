@@ -1,4 +1,6 @@
+#include "bcache.h"
 #include "kernel.h"
+#include "sched_stats.h"
 #include "string.h"
 #include "vfs.h"
 #include <stdint.h>
@@ -11,6 +13,8 @@ extern uint32_t ticks_since_boot;
 #define SYS_NODE_ROOT 1
 #define SYS_NODE_INFO 2
 #define SYS_NODE_MEM 3
+#define SYS_NODE_SCHED 4
+#define SYS_NODE_BCACHE 5
 
 static int sys_lookup(vfs_node_t *parent, const char *name, vfs_node_t **out);
 static int sys_read(vfs_node_t *node, uint8_t *buf, uint32_t size,
@@ -64,6 +68,13 @@ static int sys_lookup(vfs_node_t *parent, const char *name, vfs_node_t **out) {
   } else if (strcmp(name, "uptime") == 0) {
     *out = create_sys_node("uptime", VFS_NODE_FILE, SYS_NODE_MEM, parent->sb);
     return 0;
+  } else if (strcmp(name, "sched") == 0) {
+    *out = create_sys_node("sched", VFS_NODE_FILE, SYS_NODE_SCHED, parent->sb);
+    return 0;
+  } else if (strcmp(name, "bcache") == 0) {
+    *out =
+        create_sys_node("bcache", VFS_NODE_FILE, SYS_NODE_BCACHE, parent->sb);
+    return 0;
   }
   return -1;
 }
@@ -87,6 +98,14 @@ static int sys_readdir(vfs_node_t *dir, vfs_dirent_t *dirents, uint32_t *count,
   dirents[n].type = VFS_NODE_FILE;
   n++;
 
+  strncpy(dirents[n].name, "sched", VFS_NAME_MAX - 1);
+  dirents[n].type = VFS_NODE_FILE;
+  n++;
+
+  strncpy(dirents[n].name, "bcache", VFS_NAME_MAX - 1);
+  dirents[n].type = VFS_NODE_FILE;
+  n++;
+
   *count = n;
   return 0;
 }
@@ -97,6 +116,25 @@ static int sys_read(vfs_node_t *node, uint8_t *buf, uint32_t size,
   char data[256];
   memset(data, 0, sizeof(data));
 
+  if (id == SYS_NODE_SCHED || id == SYS_NODE_BCACHE) {
+    // Tabla por tarea e histogramas globales: no cabe en 'data'
+    size_t len = 0;
+    char *text = id == SYS_NODE_SCHED ? sched_stats_format(&len)
+                                      : bcache_format_stats(&len);
+    if (!text)
+      return -1;
+    int copied = 0;
+    if (offset < len) {
+      size_t to_copy = len - offset;
+      if (to_copy > size)
+        to_copy = size;
+      memcpy(buf, text + offset, to_copy);
+      copied = (int)to_copy;
+    }
+    kernel_free(text);
+    return copied;
+  }
+
   if (id == SYS_NODE_INFO) {
     snprintf(data, sizeof(data),
              "OS: MicroKernelOS\nVersion: 0.1.0\nAuthor: Alvaro\n");
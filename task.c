@@ -1,14 +1,19 @@
 #include "task.h"
+#include "futex.h"
 #include "gdt.h"
 #include "io.h"
 #include "irq.h"
 #include "kernel.h"
+#include "latency.h"
 #include "memory.h"
 #include "memutils.h"
 #include "mmu.h"
+#include "softirq.h"
+#include "spinlock.h"
 #include "string.h"
 #include "task_utils.h"
 #include "terminal.h"
+#include "workqueue.h"
 
 // ============================================================================
 // DECLARACIONES Y VARIABLES GLOBALES
@@ -16,18 +21,285 @@
 
 task_scheduler_t scheduler = {0};
 
+// Protege la lista de tareas y los campos de estado del planificador. Se
+// suelta justo antes de task_switch_context (con IRQs aún deshabilitadas):
+// la tarea destino puede no volver nunca por este camino (p.ej. una tarea
+// nueva arranca en task_entry_wrapper), así que no puede heredar el lock.
+static spinlock_t scheduler_lock = SPINLOCK_INIT("scheduler");
+
+// Hash PID -> tarea (encadenado por task->pid_hash_next)
+static task_t *pid_hash[TASK_PID_HASH_SIZE];
+
 static void idle_task_func(void *arg);
 static void task_wrapper(void);
 static task_t *allocate_task(void);
 static void deallocate_task(task_t *task);
 static void add_task_to_list(task_t *task);
 static void remove_task_from_list(task_t *task);
+static void wait_queue_remove(wait_queue_t *wq, task_t *task);
+static uint32_t pid_alloc(void);
+static void pid_free(uint32_t pid);
+static void pid_hash_insert(task_t *task);
+static void pid_hash_remove(task_t *task);
 
 extern void task_switch_context(cpu_context_t *old_context,
                                 cpu_context_t *new_context);
 extern void task_start_first(cpu_context_t *context);
 extern void task_switch_to_user(cpu_context_t *user_context);
 
+// ========================================================================
+// CLASES DE PLANIFICACIÓN (requieren scheduler_lock)
+// ========================================================================
+//
+// Clase justa: cada tarea acumula vruntime = tiempo de CPU * 1024 / peso,
+// y se ejecuta siempre la READY con menos vruntime (la más a la izquierda
+// del árbol). Una tarea HIGH avanza su vruntime más despacio y recibe más
+// CPU, pero una LOW nunca se queda sin ella. La tarea en ejecución se saca
+// del árbol y se vuelve a meter al desalojarla.
+//
+// Clase RT: prioridad estricta por encima de la justa, limitada a
+// SCHED_RT_RUNTIME_TICKS de cada SCHED_RT_PERIOD_TICKS para que un bottom
+// half desbocado no congele el sistema.
+
+// Pesos por prioridad (0..7), equivalentes a nice -5, -4, -2, 0, +2, +4,
+// +6 y +8: cada nivel de nice son ~1.25x de CPU
+static const uint32_t sched_prio_to_weight[8] = {3121, 2501, 1586, 1024,
+                                                 655,  423,  272,  172};
+
+static inline uint32_t sched_weight_for(task_priority_t priority) {
+  uint32_t index = (uint32_t)priority;
+  return sched_prio_to_weight[index < 8 ? index : 7];
+}
+
+static inline bool sched_is_fair(task_t *task) {
+  return task != scheduler.idle_task && task->sched_class == SCHED_CLASS_FAIR;
+}
+
+static inline bool sched_input_boosted(task_t *task) {
+  return task->input_boost_until &&
+         (int32_t)(task->input_boost_until - ticks_since_boot) > 0;
+}
+
+static void fair_enqueue(task_t *task) {
+  if (task->on_rq)
+    return;
+
+  // A igual vruntime va a la derecha: FIFO entre empatadas
+  rb_node_t **link = &scheduler.fair_rq.root.node;
+  rb_node_t *parent = NULL;
+  bool leftmost = true;
+  while (*link) {
+    parent = *link;
+    task_t *other = rb_entry(parent, task_t, run_node);
+    if (task->vruntime < other->vruntime) {
+      link = &parent->left;
+    } else {
+      link = &parent->right;
+      leftmost = false;
+    }
+  }
+  rb_link_node(&task->run_node, parent, link);
+  rb_insert_color_cached(&task->run_node, &scheduler.fair_rq, leftmost);
+
+  task->on_rq = true;
+  scheduler.fair_nr_running++;
+  scheduler.fair_load += task->sched_weight;
+}
+
+static void fair_dequeue(task_t *task) {
+  if (!task->on_rq)
+    return;
+  rb_erase_cached(&task->run_node, &scheduler.fair_rq);
+  task->on_rq = false;
+  scheduler.fair_nr_running--;
+  scheduler.fair_load -= task->sched_weight;
+}
+
+static void rt_list_remove(task_t *task) {
+  task_t **link = &scheduler.rt_list;
+  while (*link && *link != task)
+    link = &(*link)->rt_next;
+  if (*link)
+    *link = task->rt_next;
+  task->rt_next = NULL;
+}
+
+static inline task_t *fair_leftmost(void) {
+  rb_node_t *node = rb_first_cached(&scheduler.fair_rq);
+  return node ? rb_entry(node, task_t, run_node) : NULL;
+}
+
+// min_vruntime solo avanza: sigue a la menor entre la actual y el árbol
+static void fair_update_min_vruntime(void) {
+  task_t *current = scheduler.current_task;
+  task_t *left = fair_leftmost();
+  bool have = false;
+  uint64_t vruntime = 0;
+
+  if (current && sched_is_fair(current) && current->state == TASK_RUNNING) {
+    vruntime = current->vruntime;
+    have = true;
+  }
+  if (left && (!have || left->vruntime < vruntime)) {
+    vruntime = left->vruntime;
+    have = true;
+  }
+  if (have && vruntime > scheduler.min_vruntime)
+    scheduler.min_vruntime = vruntime;
+}
+
+// La tarea pasa a READY. 'waking' = vuelve de dormir/esperar: se le
+// limita el crédito acumulado para que no monopolice la CPU al volver.
+static void sched_enqueue(task_t *task, bool waking) {
+  if (task == scheduler.idle_task)
+    return;
+
+  sched_stats_ready(task, waking);
+  if (task->sched_class != SCHED_CLASS_FAIR)
+    return;
+
+  if (waking) {
+    uint64_t floor = scheduler.min_vruntime > SCHED_WAKEUP_CREDIT_US
+                         ? scheduler.min_vruntime - SCHED_WAKEUP_CREDIT_US
+                         : 0;
+    if (task->vruntime < floor)
+      task->vruntime = floor;
+  }
+  fair_enqueue(task);
+}
+
+// Tras desalojar a 'from': si sigue READY vuelve al árbol. Si se bloquea,
+// la ventaja por entrada ya se usó para atender el evento.
+static void sched_put_prev(task_t *from) {
+  from->need_resched = false;
+  sched_stats_stop(from);
+  if (from->state == TASK_READY)
+    sched_enqueue(from, false);
+  else
+    from->input_boost_until = 0;
+}
+
+// Despertar por entrada del usuario: la tarea entra con todo el crédito de
+// despertar (queda a la izquierda del árbol) y, si la actual es de la clase
+// justa sin ventaja propia, se le pide ceder ya (en el tick o al final del
+// top half con scheduler_irq_preempt). Llamar antes de encolarla.
+static void sched_wakeup_boost(task_t *task) {
+  task->input_boost_until = ticks_since_boot + SCHED_INPUT_BOOST_TICKS;
+  if (task->sched_class != SCHED_CLASS_FAIR || task->on_rq)
+    return;
+
+  task->vruntime = scheduler.min_vruntime > SCHED_WAKEUP_CREDIT_US
+                       ? scheduler.min_vruntime - SCHED_WAKEUP_CREDIT_US
+                       : 0;
+
+  task_t *current = scheduler.current_task;
+  if (current && current != task &&
+      (current == scheduler.idle_task ||
+       (sched_is_fair(current) && !sched_input_boosted(current))))
+    current->need_resched = true;
+}
+
+static uint32_t sched_slice(task_t *task) {
+  if (!sched_is_fair(task))
+    return scheduler.quantum_ticks;
+
+  // El periodo se reparte según el peso entre las READY más esta
+  uint32_t nr = scheduler.fair_nr_running + 1;
+  uint32_t period = scheduler.quantum_ticks;
+  if (nr * SCHED_MIN_GRANULARITY_TICKS > period)
+    period = nr * SCHED_MIN_GRANULARITY_TICKS;
+
+  uint32_t load = scheduler.fair_load + task->sched_weight;
+  uint32_t slice = period * task->sched_weight / load;
+  return slice < SCHED_MIN_GRANULARITY_TICKS ? SCHED_MIN_GRANULARITY_TICKS
+                                             : slice;
+}
+
+// 'next' pasa a ejecutarse: sale del árbol y se contabiliza su espera
+static void sched_set_next(task_t *next) {
+  fair_dequeue(next);
+  sched_stats_run(next);
+  next->time_slice = sched_slice(next);
+}
+
+// Cargar un tick de CPU a la tarea actual
+static void sched_update_curr(task_t *current) {
+  // Puesta en CPU fuera del planificador (arranque, fallos): el tramo
+  // empieza a contar aquí
+  if (!current->sched_stats.exec_start)
+    sched_stats_run(current);
+
+  if (ticks_since_boot - scheduler.rt_period_start >= SCHED_RT_PERIOD_TICKS) {
+    scheduler.rt_period_start = ticks_since_boot;
+    scheduler.rt_used_ticks = 0;
+    scheduler.rt_throttled = false;
+  }
+
+  if (current == scheduler.idle_task)
+    return;
+
+  if (current->sched_class == SCHED_CLASS_RT) {
+    if (++scheduler.rt_used_ticks >= SCHED_RT_RUNTIME_TICKS)
+      scheduler.rt_throttled = true;
+    return;
+  }
+
+  // La clave no puede cambiar con el nodo enlazado (p.ej. una tarea
+  // puesta en RUNNING a mano fuera del planificador)
+  fair_dequeue(current);
+  current->vruntime +=
+      SCHED_TICK_US * SCHED_NICE_0_WEIGHT / current->sched_weight;
+  fair_update_min_vruntime();
+}
+
+// Mejor tarea RT lista; round-robin entre iguales empezando tras la actual
+static task_t *sched_pick_rt(void) {
+  if (scheduler.rt_throttled || !scheduler.rt_list)
+    return NULL;
+
+  task_t *current = scheduler.current_task;
+  task_t *start = scheduler.rt_list;
+  if (current && current->sched_class == SCHED_CLASS_RT && current->rt_next)
+    start = current->rt_next;
+
+  task_t *best = NULL;
+  task_t *t = start;
+  do {
+    if (t->state == TASK_READY && (!best || t->priority < best->priority))
+      best = t;
+    t = t->rt_next ? t->rt_next : scheduler.rt_list;
+  } while (t != start);
+  return best;
+}
+
+// Con la tarea actual aún RUNNING y su quantum agotado: ¿se desaloja?
+static bool sched_should_preempt(task_t *from, task_t *next) {
+  if (from == scheduler.idle_task)
+    return true;
+  if (next == scheduler.idle_task)
+    return false;
+
+  if (from->sched_class == SCHED_CLASS_RT) {
+    if (scheduler.rt_throttled)
+      return true;
+    return next->sched_class == SCHED_CLASS_RT &&
+           next->priority <= from->priority;
+  }
+  if (next->sched_class == SCHED_CLASS_RT)
+    return true;
+  // Mientras dura la ventaja por entrada solo la desaloja otra igual
+  if (sched_input_boosted(from) && !sched_input_boosted(next))
+    return false;
+  return next->vruntime < from->vruntime;
+}
+
+static bool sched_has_runnable(void) {
+  if (sched_pick_rt())
+    return true;
+  task_t *left = fair_leftmost();
+  return left && left->state == TASK_READY;
+}
+
 // ========================================================================
 // INICIALIZACIÃ“N DEL SISTEMA DE TAREAS
 // ========================================================================
@@ -152,8 +424,12 @@ void task_init(void) {
   // El scheduler decidirá qué tarea ejecutar primero
   scheduler.current_task = NULL;
 
-  // ✅ FIX: Idle queda en READY, esperando su turno
+  // ✅ FIX: Idle queda en READY, esperando su turno. No pertenece a ninguna
+  // clase: task_create la metió en el árbol antes de saber que era idle
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+  fair_dequeue(scheduler.idle_task);
   scheduler.idle_task->state = TASK_READY;
+  spin_unlock_irqrestore(&scheduler_lock, flags);
 
   terminal_puts(&main_terminal, "Idle task created successfully\r\n");
 }
@@ -168,14 +444,18 @@ void task_yield(void) {
   }
 
   // ✅ Deshabilitar interrupciones durante el cambio
-  uint32_t flags;
-  __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
 
   task_t *next = scheduler_next_task();
 
   // ✅ FIX: Verificar que next sea diferente de current
   if (!next || next == scheduler.current_task) {
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+    // Despertada antes de llegar a ceder: sigue en la CPU
+    if (next && next->state == TASK_READY) {
+      next->state = TASK_RUNNING;
+      sched_set_next(next);
+    }
+    spin_unlock_irqrestore(&scheduler_lock, flags);
     return;
   }
 
@@ -185,46 +465,109 @@ void task_yield(void) {
   if (from->state == TASK_RUNNING && from != scheduler.idle_task) {
     from->state = TASK_READY;
   }
+  sched_put_prev(from);
 
   next->state = TASK_RUNNING;
-  next->time_slice = scheduler.quantum_ticks;
+  sched_set_next(next);
 
   from->switch_count++;
   next->switch_count++;
   scheduler.total_switches++;
 
   scheduler.current_task = next;
+  fpu_prepare_switch(next);
+  spin_unlock(&scheduler_lock);
 
   // ✅ FIX: Switch de contexto con interrupciones deshabilitadas
   task_switch_context(&from->context, &next->context);
 
   // ✅ FIX: Restaurar interrupciones DESPUÉS del switch
-  __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+  local_irq_restore(flags);
+}
+
+// ========================================================================
+// EXPULSIÓN Y PUNTOS DE REPLANIFICACIÓN
+// ========================================================================
+//
+// El contador es por tarea (como en Linux está en thread_info): si una
+// tarea cede voluntariamente con la expulsión deshabilitada, la siguiente
+// no hereda el estado.
+
+void preempt_disable(void) {
+  task_t *self = scheduler.current_task;
+  if (!self)
+    return;
+  if (self->preempt_count++ == 0 && latency_trace_enabled) {
+    self->preempt_off_at = sched_clock();
+    self->preempt_off_where = __builtin_return_address(0);
+  }
+}
+
+void preempt_enable(void) {
+  task_t *self = scheduler.current_task;
+  if (!self || self->preempt_count == 0)
+    return;
+  if (--self->preempt_count)
+    return;
+
+  if (self->preempt_off_at) {
+    latency_preempt_on(self->preempt_off_at, self->preempt_off_where,
+                       __builtin_return_address(0));
+    self->preempt_off_at = 0;
+  }
+  if (self->need_resched)
+    cond_resched();
+}
+
+bool preemptible(void) {
+  task_t *self = scheduler.current_task;
+  return self && self->preempt_count == 0 && local_irq_enabled() &&
+         !softirq_in_progress();
+}
+
+void cond_resched(void) {
+  task_t *self = scheduler.current_task;
+  if (!scheduler.scheduler_enabled || !self || self == scheduler.idle_task ||
+      !preemptible())
+    return;
+
+  // need_resched lo deja el tick cuando no pudo expulsar
+  if (self->need_resched || self->time_slice == 0)
+    task_yield();
 }
 
 // ========================================================================
 // GESTIÃ“N DE TAREAS
 // ========================================================================
 
-task_t *task_create(const char *name, void (*entry_point)(void *), void *arg,
-                    task_priority_t priority) {
+// Requiere scheduler_lock. Empieza en min_vruntime: ni adelanta a las que
+// ya esperan ni arrastra deuda
+static void task_make_ready_locked(task_t *task) {
+  task->vruntime = scheduler.min_vruntime;
+  task->state = TASK_READY;
+  sched_enqueue(task, false);
+}
+
+// Con 'start' a false la tarea queda en TASK_CREATED, fuera de la cola:
+// quien la crea termina de rellenarla y la encola con
+// task_make_ready_locked()
+static task_t *task_create_common(const char *name,
+                                  void (*entry_point)(void *), void *arg,
+                                  task_priority_t priority, bool start) {
   terminal_printf(&main_terminal, "[TASK_CREATE] Creating task: %s\r\n",
                   name ? name : "null");
 
-  if (!entry_point || scheduler.task_count >= MAX_TASKS) {
+  if (!entry_point) {
     terminal_printf(&main_terminal,
                     "[TASK_CREATE] FAILED: entry=%s, count=%u\r\n",
                     entry_point ? "ok" : "NULL", scheduler.task_count);
     return NULL;
   }
 
-  // Deshabilitar interrupciones durante la creaciÃ³n
-  uint32_t flags;
-  __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
-
+  // La tarea aún no es visible para el scheduler: se prepara sin lock y
+  // solo se toma para asignar ID y enlazarla en la lista
   task_t *task = allocate_task();
   if (!task) {
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
     return NULL;
   }
 
@@ -232,27 +575,37 @@ task_t *task_create(const char *name, void (*entry_point)(void *), void *arg,
   memset(task, 0,
          sizeof(task_t)); // Esto asegura que todos los campos estÃ©n en 0
 
-  task->task_id = scheduler.next_task_id++;
   strncpy(task->name, name ? name : "unnamed", TASK_NAME_MAX - 1);
   task->name[TASK_NAME_MAX - 1] = '\0';
   task->state = TASK_CREATED;
   task->priority = priority;
+  task->base_priority = priority;
+  task->sched_class = SCHED_CLASS_FAIR;
+  task->sched_weight = sched_weight_for(priority);
   task->entry_point = entry_point;
   task->arg = arg;
+  task->fd_table = task->own_fds;
 
   // Asignar stack
   task->stack_size = TASK_STACK_SIZE;
   task->stack_base = kernel_malloc(task->stack_size);
   if (!task->stack_base) {
     deallocate_task(task);
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
     return NULL;
   }
 
   task->stack_top = (void *)((uint8_t *)task->stack_base + task->stack_size);
 
+  // Área FXSAVE (solo se usa si la tarea llega a tocar la FPU)
+  if (!fpu_state_alloc(task)) {
+    kernel_free(task->stack_base);
+    deallocate_task(task);
+    return NULL;
+  }
+
   // Configurar el stack y contexto inicial
   task_setup_stack(task, entry_point, arg);
+  task_profiling_attach(task);
 
   // INICIALIZAR TODOS LOS CAMPOS DE TIEMPO Y ESTADÃSTICAS
   task->time_slice = scheduler.quantum_ticks;
@@ -267,29 +620,45 @@ task_t *task_create(const char *name, void (*entry_point)(void *), void *arg,
   task->prev = NULL;
 
   // AÃ±adir a la lista de tareas
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+  task->task_id = pid_alloc();
+  if (task->task_id == 0) {
+    spin_unlock_irqrestore(&scheduler_lock, flags);
+    terminal_printf(&main_terminal,
+                    "[TASK_CREATE] FAILED: no free PIDs (count=%u)\r\n",
+                    scheduler.task_count);
+    fpu_state_release(task);
+    task_profiling_release(task);
+    kernel_free(task->stack_base);
+    deallocate_task(task);
+    return NULL;
+  }
+  task->tgid = task->task_id;
+  pid_hash_insert(task);
   add_task_to_list(task);
   scheduler.task_count++;
+  if (start)
+    task_make_ready_locked(task);
+  spin_unlock_irqrestore(&scheduler_lock, flags);
 
-  // La tarea estÃ¡ lista para ejecutar
-  task->state = TASK_READY;
-
-  __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
-
-  message_queue_create(task->task_id);
+  // La cola de mensajes se crea bajo demanda (primer envío o recepción): con
+  // miles de tareas no todas usan IPC
 
   terminal_printf(&main_terminal, "Task created: %s (ID: %u)\r\n", task->name,
                   task->task_id);
   return task;
 }
 
+task_t *task_create(const char *name, void (*entry_point)(void *), void *arg,
+                    task_priority_t priority) {
+  return task_create_common(name, entry_point, arg, priority, true);
+}
+
 void task_destroy(task_t *task) {
   if (!task || task == scheduler.idle_task) {
     return; // No destruir la tarea idle
   }
 
-  uint32_t flags;
-  __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
-
   // Si es la tarea actual, debemos manejar esto con cuidado
   if (task == scheduler.current_task) {
     // CAMBIO CRITICO: No podemos liberar nuestra propia memoria mientras
@@ -306,9 +675,34 @@ void task_destroy(task_t *task) {
       __asm__("hlt");
   }
 
-  // Marcar como zombie y remover de la lista
+  // Marcar como zombie y remover de la lista. Una vez fuera de la lista
+  // nadie más la ve, así que los recursos se liberan sin el lock (close()
+  // puede entrar en la pila de red, que cede CPU)
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+  if (task->waiting_on)
+    wait_queue_remove(task->waiting_on, task);
+  fair_dequeue(task);
+  rt_list_remove(task);
   task->state = TASK_ZOMBIE;
   remove_task_from_list(task);
+  pid_hash_remove(task);
+  scheduler.task_count--;
+  spin_unlock_irqrestore(&scheduler_lock, flags);
+
+  // Su espera en FUTEX_WAIT vive en el stack que se libera abajo
+  futex_task_exit(task);
+  // Que ningún mutex se quede con un dueño o un waiter ya liberado
+  mutex_task_exit(task);
+
+  // Liberar su cola de mensajes (y los buffers transferidos sin recoger)
+  message_queue_destroy(message_queue_get(task->task_id));
+  task_profiling_release(task);
+  fpu_state_release(task);
+
+  // El PID solo se recicla cuando ya nada lo referencia
+  flags = spin_lock_irqsave(&scheduler_lock);
+  pid_free(task->task_id);
+  spin_unlock_irqrestore(&scheduler_lock, flags);
 
   // Liberar recursos
   if (task->stack_base) {
@@ -321,8 +715,17 @@ void task_destroy(task_t *task) {
     task->user_stack_base = NULL;
   }
 
+  // Tabla compartida con otros hilos: solo la cierra el último que la usa
+  bool close_fds = true;
+  task_files_t *files = task->files;
+  if (files) {
+    flags = spin_lock_irqsave(&scheduler_lock);
+    close_fds = (--files->refcount == 0);
+    spin_unlock_irqrestore(&scheduler_lock, flags);
+  }
+
   // Liberar descriptores de archivo abiertos
-  for (int i = 0; i < VFS_MAX_FDS; i++) {
+  for (int i = 0; close_fds && i < VFS_MAX_FDS; i++) {
     if (task->fd_table[i] != NULL) {
       // vfs_close se encarga de liberar la estructura socket o file
       // Nota: Necesitamos asegurarnos de que vfs_close pueda manejar esto sin
@@ -359,11 +762,10 @@ void task_destroy(task_t *task) {
       }
     }
   }
+  if (files && close_fds)
+    kernel_free(files);
 
-  scheduler.task_count--;
   deallocate_task(task);
-
-  __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
 }
 
 void task_sleep(uint32_t ms) {
@@ -425,6 +827,203 @@ void task_exit(int exit_code) {
     __asm__ __volatile__("cli; hlt");
 }
 
+// ========================================================================
+// WAIT QUEUES
+// ========================================================================
+
+void wait_queue_init(wait_queue_t *wq, const char *name) {
+  if (!wq)
+    return;
+  wq->head = NULL;
+  wq->tail = NULL;
+  wq->name = name ? name : "unnamed_wq";
+}
+
+// Requieren scheduler_lock tomado
+static void wait_queue_append(wait_queue_t *wq, task_t *task) {
+  task->wait_next = NULL;
+  task->waiting_on = wq;
+  if (wq->tail)
+    wq->tail->wait_next = task;
+  else
+    wq->head = task;
+  wq->tail = task;
+}
+
+static void wait_queue_remove(wait_queue_t *wq, task_t *task) {
+  task_t *prev = NULL;
+  task_t *cur = wq->head;
+  while (cur && cur != task) {
+    prev = cur;
+    cur = cur->wait_next;
+  }
+  if (!cur)
+    return;
+
+  if (prev)
+    prev->wait_next = cur->wait_next;
+  else
+    wq->head = cur->wait_next;
+  if (wq->tail == cur)
+    wq->tail = prev;
+
+  cur->wait_next = NULL;
+  cur->waiting_on = NULL;
+}
+
+static void wait_queue_wake_task(task_t *task, bool boost) {
+  wait_queue_remove(task->waiting_on, task);
+  task->wait_deadline = 0;
+  if (task->state == TASK_WAITING) {
+    task->state = TASK_READY;
+    if (boost)
+      sched_wakeup_boost(task);
+    sched_enqueue(task, true);
+  }
+}
+
+// Bloquea la tarea actual en 'wq'. Si se pasa 'lock', debe estar tomado con
+// spin_lock_irqsave: la tarea se encola antes de soltarlo, así que un
+// wake_one hecho bajo el mismo lock no se puede perder. Se devuelve con el
+// lock tomado de nuevo. El llamador debe re-evaluar su condición.
+// Retorna false si expiró timeout_ticks (0 = sin límite).
+bool wait_queue_sleep(wait_queue_t *wq, spinlock_t *lock,
+                      uint32_t timeout_ticks) {
+  task_t *self = scheduler.current_task;
+
+  if (!wq || !self || !scheduler.scheduler_enabled ||
+      self == scheduler.idle_task) {
+    // No se puede bloquear (arranque o idle): devolver para que el
+    // llamador reintente
+    if (lock) {
+      spin_unlock(lock);
+      __asm__ __volatile__("pause");
+      spin_lock(lock);
+    }
+    return true;
+  }
+
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+  self->state = TASK_WAITING;
+  self->wait_timed_out = false;
+  self->wait_deadline = timeout_ticks ? ticks_since_boot + timeout_ticks : 0;
+  wait_queue_append(wq, self);
+  spin_unlock_irqrestore(&scheduler_lock, flags);
+
+  if (lock)
+    spin_unlock(lock);
+
+  task_yield();
+
+  if (lock)
+    spin_lock(lock);
+
+  return !self->wait_timed_out;
+}
+
+// Despierta a la tarea de mayor prioridad (FIFO entre iguales)
+task_t *wait_queue_wake_one(wait_queue_t *wq) {
+  if (!wq)
+    return NULL;
+
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+
+  task_t *best = NULL;
+  for (task_t *t = wq->head; t; t = t->wait_next) {
+    if (!best || t->priority < best->priority)
+      best = t;
+  }
+  if (best)
+    wait_queue_wake_task(best, false);
+
+  spin_unlock_irqrestore(&scheduler_lock, flags);
+  return best;
+}
+
+static uint32_t wait_queue_wake_all_common(wait_queue_t *wq, bool boost) {
+  if (!wq)
+    return 0;
+
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+  uint32_t woken = 0;
+  while (wq->head) {
+    wait_queue_wake_task(wq->head, boost);
+    woken++;
+  }
+  spin_unlock_irqrestore(&scheduler_lock, flags);
+  return woken;
+}
+
+uint32_t wait_queue_wake_all(wait_queue_t *wq) {
+  return wait_queue_wake_all_common(wq, false);
+}
+
+// Para eventos de entrada del usuario: las tareas despertadas reciben la
+// ventaja de sched_wakeup_boost y desalojan a la actual
+uint32_t wait_queue_wake_all_boosted(wait_queue_t *wq) {
+  return wait_queue_wake_all_common(wq, true);
+}
+
+bool wait_queue_has_waiters(wait_queue_t *wq) {
+  return wq && wq->head != NULL;
+}
+
+task_priority_t wait_queue_best_priority(wait_queue_t *wq,
+                                         task_priority_t fallback) {
+  if (!wq)
+    return fallback;
+
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+  task_priority_t best = fallback;
+  for (task_t *t = wq->head; t; t = t->wait_next) {
+    if (t->priority < best)
+      best = t->priority;
+  }
+  spin_unlock_irqrestore(&scheduler_lock, flags);
+  return best;
+}
+
+// Cambia la prioridad efectiva (herencia de prioridad); base_priority no se
+// toca
+void task_set_effective_priority(task_t *task, task_priority_t priority) {
+  if (!task)
+    return;
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+  task->priority = priority;
+  // El peso cambia pero no la clave del árbol: solo hay que ajustar la carga
+  if (task->on_rq)
+    scheduler.fair_load -= task->sched_weight;
+  task->sched_weight = sched_weight_for(priority);
+  if (task->on_rq)
+    scheduler.fair_load += task->sched_weight;
+  spin_unlock_irqrestore(&scheduler_lock, flags);
+}
+
+// Mover una tarea entre la clase justa y la RT
+void task_set_sched_class(task_t *task, sched_class_t sched_class) {
+  if (!task || task == scheduler.idle_task)
+    return;
+
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+  if (task->sched_class != sched_class) {
+    if (task->sched_class == SCHED_CLASS_RT)
+      rt_list_remove(task);
+    else
+      fair_dequeue(task);
+
+    task->sched_class = sched_class;
+    if (sched_class == SCHED_CLASS_RT) {
+      task->rt_next = scheduler.rt_list;
+      scheduler.rt_list = task;
+    } else {
+      task->vruntime = scheduler.min_vruntime;
+      if (task->state == TASK_READY)
+        fair_enqueue(task);
+    }
+  }
+  spin_unlock_irqrestore(&scheduler_lock, flags);
+}
+
 // ========================================================================
 // CONTROL DEL PLANIFICADOR
 // ========================================================================
@@ -470,8 +1069,9 @@ void scheduler_start(void) {
 
   // Configurar primera tarea
   first_task->state = TASK_RUNNING;
-  first_task->time_slice = scheduler.quantum_ticks;
+  sched_set_next(first_task);
   scheduler.current_task = first_task;
+  fpu_prepare_switch(first_task);
   scheduler.scheduler_enabled = true;
 
   terminal_printf(&main_terminal, "First task: %s (ID: %u)\r\n",
@@ -483,17 +1083,42 @@ void scheduler_start(void) {
 
 void scheduler_stop(void) { scheduler.scheduler_enabled = false; }
 
+// Expulsión desde una IRQ: se entra con scheduler_lock tomado y los flags
+// de spin_lock_irqsave; se vuelve (en otro momento) con el lock libre
+static void sched_preempt_switch(task_t *from, task_t *next, uint32_t flags) {
+  if (from->state == TASK_RUNNING) {
+    from->state = TASK_READY;
+  }
+  sched_put_prev(from);
+  next->state = TASK_RUNNING;
+  sched_set_next(next);
+
+  from->switch_count++;
+  next->switch_count++;
+  scheduler.total_switches++;
+
+  scheduler.current_task = next;
+  fpu_prepare_switch(next);
+  spin_unlock(&scheduler_lock);
+
+  task_switch_context(&from->context, &next->context);
+  local_irq_restore(flags);
+}
+
 void scheduler_tick(void) {
   if (!scheduler.scheduler_enabled || !scheduler.current_task) {
     return;
   }
 
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+
   // 1. Actualizar tareas durmientes
   task_update_sleep_states();
 
   // 2. Incrementar runtime de la tarea actual (si está RUNNING)
   if (scheduler.current_task->state == TASK_RUNNING) {
     scheduler.current_task->total_runtime++;
+    sched_update_curr(scheduler.current_task);
   }
 
   // 3. Decidir si hacer switch
@@ -512,87 +1137,88 @@ void scheduler_tick(void) {
     if (scheduler.current_task->time_slice == 0) {
       // Quantum expirado
       should_switch = true;
+    } else if (scheduler.current_task->need_resched) {
+      // Un despertar por entrada pidió desalojarla
+      should_switch = true;
+    } else if (sched_is_fair(scheduler.current_task) && sched_pick_rt()) {
+      // Una tarea RT lista desaloja a la clase justa sin esperar
+      should_switch = true;
     }
   } else {
     // Estamos en idle, verificar si hay otras tareas
-    task_t *t = scheduler.task_list;
-    if (t) {
-      do {
-        if (t != scheduler.idle_task && t->state == TASK_READY) {
-          should_switch = true;
-          break;
-        }
-        t = t->next;
-      } while (t != scheduler.task_list);
-    }
+    should_switch = sched_has_runnable();
   }
 
   if (!should_switch) {
+    spin_unlock_irqrestore(&scheduler_lock, flags);
+    return;
+  }
+
+  // Sección sin expulsión: se cambia en su preempt_enable()/cond_resched()
+  if (scheduler.current_task->preempt_count &&
+      scheduler.current_task->state == TASK_RUNNING) {
+    scheduler.current_task->need_resched = true;
+    spin_unlock_irqrestore(&scheduler_lock, flags);
     return;
   }
 
   // 4. Buscar siguiente tarea
   task_t *next = scheduler_next_task();
-  if (!next || next == scheduler.current_task) {
+  task_t *from = scheduler.current_task;
+  if (!next || next == from ||
+      (from->state == TASK_RUNNING && !sched_should_preempt(from, next))) {
+    // Sigue la misma: nuevo quantum según el reparto actual
+    if (next == from && from->state == TASK_READY) {
+      from->state = TASK_RUNNING;
+      sched_set_next(from);
+    } else if (from->state == TASK_RUNNING && from->time_slice == 0) {
+      from->time_slice = sched_slice(from);
+    }
+    spin_unlock_irqrestore(&scheduler_lock, flags);
     return;
   }
 
   // 5. Realizar switch
+  sched_preempt_switch(from, next, flags);
+}
+
+void scheduler_irq_preempt(void) {
   task_t *from = scheduler.current_task;
+  if (!scheduler.scheduler_enabled || !from || !from->need_resched ||
+      from->preempt_count || softirq_in_progress())
+    return;
 
-  if (from->state == TASK_RUNNING) {
-    from->state = TASK_READY;
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+  task_t *next = scheduler_next_task();
+  // Si no procede, need_resched queda para el próximo tick
+  if (!next || next == from || from->state != TASK_RUNNING ||
+      !sched_should_preempt(from, next)) {
+    spin_unlock_irqrestore(&scheduler_lock, flags);
+    return;
   }
-  next->state = TASK_RUNNING;
-
-  from->switch_count++;
-  next->switch_count++;
-  scheduler.total_switches++;
-
-  next->time_slice = scheduler.quantum_ticks;
-  scheduler.current_task = next;
-
-  task_switch_context(&from->context, &next->context);
+  sched_preempt_switch(from, next, flags);
 }
 
+// Requiere scheduler_lock. Orden: RT (prioridad estricta), justa (menor
+// vruntime) e idle. La tarea actual no es candidata: no está READY.
 task_t *scheduler_next_task(void) {
   if (!scheduler.task_list || scheduler.task_count == 0) {
     return scheduler.idle_task;
   }
 
-  // Empezar desde la SIGUIENTE tarea (round-robin)
-  task_t *start = scheduler.current_task ? scheduler.current_task->next
-                                         : scheduler.task_list;
-  task_t *current = start;
-  task_t *best = NULL;
-  int best_priority = 99;
+  task_t *rt = sched_pick_rt();
+  if (rt)
+    return rt;
 
-  // Una vuelta completa buscando la mejor tarea READY
-  do {
-    // Solo tareas en estado READY
-    if (current->state == TASK_READY) {
-      // Preferir non-idle tasks
-      if (current != scheduler.idle_task) {
-        // Encontramos una tarea real lista
-        if (current->priority < best_priority) {
-          best = current;
-          best_priority = current->priority;
-        }
-      } else if (!best) {
-        // Idle solo si no hay nada mÃ¡s
-        best = current;
-      }
-    }
-
-    current = current->next;
-  } while (current != start);
-
-  // Si no encontramos nada, usar idle
-  if (!best) {
-    return scheduler.idle_task;
+  task_t *left;
+  while ((left = fair_leftmost()) != NULL) {
+    if (left->state == TASK_READY)
+      return left;
+    // Entrada obsoleta (cambiada de estado fuera del planificador)
+    fair_dequeue(left);
   }
 
-  return best;
+  return scheduler.idle_task;
 }
 
 // ========================================================================
@@ -735,6 +1361,37 @@ static void user_mode_entry_wrapper(void *arg) {
 // FUNCIÓN PARA CREAR TAREAS DE USUARIO (COMPLETAMENTE CORREGIDA)
 // ============================================================================
 
+// Reserva un stack de usuario de 'size' bytes más una guard page y mapea sus
+// páginas con PAGE_USER. Devuelve el bloque de kernel_malloc (lo libera
+// task_destroy vía user_stack_base), su tamaño y la dirección final.
+static void *task_alloc_user_stack(size_t size, size_t *alloc_size,
+                                   uint32_t *stack_end) {
+  size_t aligned_stack_size = (size + 0xFFF) & ~0xFFF;
+  size_t total_alloc_size = aligned_stack_size + PAGE_SIZE;
+
+  void *user_stack = kernel_malloc(total_alloc_size);
+  if (!user_stack)
+    return NULL;
+  memset(user_stack, 0, total_alloc_size);
+
+  uint32_t alloc_base = (uint32_t)user_stack;
+  uint32_t guard_page = alloc_base & ~0xFFF;
+  uint32_t stack_real_base = guard_page + PAGE_SIZE;
+  uint32_t end = alloc_base + total_alloc_size;
+
+  for (uint32_t page = stack_real_base; page < end; page += PAGE_SIZE) {
+    if (!mmu_is_mapped(page)) {
+      mmu_map_page(page, page, PAGE_PRESENT | PAGE_RW | PAGE_USER);
+    } else {
+      mmu_set_page_user(page);
+    }
+  }
+
+  *alloc_size = total_alloc_size;
+  *stack_end = end;
+  return user_stack;
+}
+
 task_t *task_create_user(const char *name, void *user_code_addr, int argc,
                          char **argv, uint32_t code_size,
                          task_priority_t priority) {
@@ -768,28 +1425,13 @@ task_t *task_create_user(const char *name, void *user_code_addr, int argc,
     mmu_set_page_user(code_page);
   }
 
-  // 3. Asignar stack con GUARD PAGE
-  size_t aligned_stack_size = (USER_STACK_SIZE + 0xFFF) & ~0xFFF;
-  size_t total_alloc_size = aligned_stack_size + PAGE_SIZE;
-
-  void *user_stack = kernel_malloc(total_alloc_size);
+  // 3-5. Asignar y mapear stack con GUARD PAGE
+  size_t total_alloc_size;
+  uint32_t stack_end;
+  void *user_stack =
+      task_alloc_user_stack(USER_STACK_SIZE, &total_alloc_size, &stack_end);
   if (!user_stack)
     return NULL;
-  memset(user_stack, 0, total_alloc_size);
-
-  uint32_t alloc_base = (uint32_t)user_stack;
-  uint32_t guard_page = alloc_base & ~0xFFF;
-  uint32_t stack_real_base = guard_page + PAGE_SIZE;
-  uint32_t stack_end = alloc_base + total_alloc_size;
-
-  // 5. Mapear stack
-  for (uint32_t page = stack_real_base; page < stack_end; page += PAGE_SIZE) {
-    if (!mmu_is_mapped(page)) {
-      mmu_map_page(page, page, PAGE_PRESENT | PAGE_RW | PAGE_USER);
-    } else {
-      mmu_set_page_user(page);
-    }
-  }
 
   // 6. Preparar stack top y ARGC/ARGV
   uint32_t stack_top = (stack_end - 16) & ~0xF;
@@ -855,6 +1497,92 @@ task_t *task_create_user(const char *name, void *user_code_addr, int argc,
   return task;
 }
 
+// ============================================================================
+// HILOS DE USUARIO
+// ============================================================================
+//
+// Un hilo es una tarea de usuario más (mismo planificador, mismo
+// user_mode_entry_wrapper) que comparte con su proceso el espacio de
+// direcciones y la tabla de descriptores, y tiene su propio stack. El hilo
+// arranca en user_entry con 'arg' como único argumento cdecl y debe
+// terminar con SYSCALL_EXIT (la dirección de retorno apilada es 0).
+
+task_t *task_create_thread(task_t *parent, void *user_entry, uint32_t arg,
+                           uint32_t stack_size) {
+  if (!parent || !(parent->flags & TASK_FLAG_USER_MODE) || !user_entry)
+    return NULL;
+
+  if (stack_size == 0)
+    stack_size = USER_STACK_SIZE;
+  if (stack_size > THREAD_STACK_MAX)
+    return NULL;
+
+  // Primer hilo del proceso: su tabla embebida pasa a ser compartida
+  if (!parent->files) {
+    task_files_t *files = (task_files_t *)kernel_malloc(sizeof(task_files_t));
+    if (!files)
+      return NULL;
+
+    uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+    if (!parent->files) {
+      memcpy(files->fd, parent->own_fds, sizeof(files->fd));
+      files->refcount = 1;
+      parent->files = files;
+      parent->fd_table = files->fd;
+      files = NULL;
+    }
+    spin_unlock_irqrestore(&scheduler_lock, flags);
+    if (files)
+      kernel_free(files);
+  }
+
+  size_t total_alloc_size;
+  uint32_t stack_end;
+  void *user_stack =
+      task_alloc_user_stack(stack_size, &total_alloc_size, &stack_end);
+  if (!user_stack)
+    return NULL;
+
+  // [esp] = retorno (0), [esp+4] = arg
+  uint32_t stack_top = (stack_end - 16) & ~0xF;
+  stack_top -= 4;
+  *(uint32_t *)stack_top = arg;
+  stack_top -= 4;
+  *(uint32_t *)stack_top = 0;
+
+  // Fuera de la cola hasta completar los campos de usuario: el wrapper no
+  // debe verla a medias
+  task_t *task = task_create_common(parent->name, user_mode_entry_wrapper,
+                                    NULL, parent->base_priority, false);
+  if (!task) {
+    kernel_free(user_stack);
+    return NULL;
+  }
+
+  // "proceso:tid": el tid solo se conoce tras task_create
+  snprintf(task->name, sizeof(task->name), "%s:%u", parent->name,
+           task->task_id);
+
+  task->user_stack_base = user_stack;
+  task->user_stack_top = (void *)stack_top;
+  task->user_stack_size = total_alloc_size;
+  task->user_entry_point = user_entry;
+  task->user_code_base = parent->user_code_base;
+  task->user_code_size = parent->user_code_size;
+  task->address_space = parent->address_space;
+  task->flags |= TASK_FLAG_USER_MODE | TASK_FLAG_THREAD;
+
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+  task->tgid = parent->tgid;
+  task->files = parent->files;
+  task->files->refcount++;
+  task->fd_table = task->files->fd;
+  task_make_ready_locked(task);
+  spin_unlock_irqrestore(&scheduler_lock, flags);
+
+  return task;
+}
+
 // ========================================================================
 // FUNCIONES DE INFORMACIÃ“N
 // ========================================================================
@@ -862,18 +1590,12 @@ task_t *task_create_user(const char *name, void *user_code_addr, int argc,
 task_t *task_current(void) { return scheduler.current_task; }
 
 task_t *task_find_by_id(uint32_t task_id) {
-  if (!scheduler.task_list)
-    return NULL;
-
-  task_t *current = scheduler.task_list;
-  do {
-    if (current->task_id == task_id) {
-      return current;
-    }
-    current = current->next;
-  } while (current != scheduler.task_list);
-
-  return NULL;
+  uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+  task_t *found = pid_hash[task_id & (TASK_PID_HASH_SIZE - 1)];
+  while (found && found->task_id != task_id)
+    found = found->pid_hash_next;
+  spin_unlock_irqrestore(&scheduler_lock, flags);
+  return found;
 }
 
 task_t *task_find_by_name(const char *name) {
@@ -992,7 +1714,12 @@ bool task_is_ready(task_t *task) {
   case TASK_SLEEPING:
     // Verificar si ya es hora de despertar
     if (ticks_since_boot >= task->sleep_until) {
-      task->state = TASK_READY;
+      uint32_t flags = spin_lock_irqsave(&scheduler_lock);
+      if (task->state == TASK_SLEEPING) {
+        task->state = TASK_READY;
+        sched_enqueue(task, true);
+      }
+      spin_unlock_irqrestore(&scheduler_lock, flags);
       return true;
     }
     return false;
@@ -1015,8 +1742,22 @@ void task_update_sleep_states(void) {
     if (current->state == TASK_SLEEPING &&
         ticks_since_boot >= current->sleep_until) {
       current->state = TASK_READY;
+      sched_enqueue(current, true);
       // terminal_printf(&main_terminal, "[SLEEP] Task %s woke up\r\n",
       // current->name);
+    } else if (current->state == TASK_WAITING && current->wait_deadline &&
+               ticks_since_boot >= current->wait_deadline) {
+      // Timeout de una espera en wait queue
+      if (current->waiting_on)
+        wait_queue_remove(current->waiting_on, current);
+      current->wait_deadline = 0;
+      current->wait_timed_out = true;
+      current->state = TASK_READY;
+      sched_enqueue(current, true);
+    } else if (current->state == TASK_READY && !current->on_rq &&
+               sched_is_fair(current) && current != scheduler.current_task) {
+      // Puesta en READY a mano fuera del planificador (arranque, fallos)
+      sched_enqueue(current, false);
     }
     current = current->next;
   } while (current != scheduler.task_list);
@@ -1026,6 +1767,102 @@ void task_update_sleep_states(void) {
 // FUNCIONES AUXILIARES INTERNAS
 // ========================================================================
 
+// ------------------------------------------------------------------------
+// Allocator de PIDs (requiere scheduler_lock)
+// ------------------------------------------------------------------------
+
+static uint32_t *pid_bitmap = NULL; // Bit a 1 = PID en uso
+static uint32_t pid_bitmap_bits = 0;
+
+// Duplica el bitmap (hasta TASK_PID_MAX). Se llama con scheduler_lock
+// tomado: kernel_malloc solo usa heap_lock, que nunca toma el del scheduler
+static bool pid_bitmap_grow(void) {
+  uint32_t new_bits =
+      pid_bitmap_bits ? pid_bitmap_bits * 2 : TASK_PID_BITMAP_INITIAL;
+  if (new_bits > TASK_PID_MAX)
+    new_bits = TASK_PID_MAX;
+  if (new_bits <= pid_bitmap_bits)
+    return false;
+
+  uint32_t *bitmap = (uint32_t *)kernel_malloc(new_bits / 8);
+  if (!bitmap)
+    return false;
+
+  memset(bitmap, 0, new_bits / 8);
+  if (pid_bitmap) {
+    memcpy(bitmap, pid_bitmap, pid_bitmap_bits / 8);
+    kernel_free(pid_bitmap);
+  } else {
+    bitmap[0] = 1; // PID 0 reservado
+  }
+
+  pid_bitmap = bitmap;
+  pid_bitmap_bits = new_bits;
+  return true;
+}
+
+// Busca un bit libre desde el cursor (next-fit, evita reusar un PID recién
+// liberado) saltando palabras llenas de 32 en 32
+static uint32_t pid_bitmap_scan(uint32_t from) {
+  uint32_t words = pid_bitmap_bits / 32;
+  uint32_t word = from / 32;
+
+  for (uint32_t n = 0; n <= words; n++, word++) {
+    if (word >= words)
+      word = 0;
+
+    uint32_t free_bits = ~pid_bitmap[word];
+    if (n == 0)
+      free_bits &= ~0u << (from % 32); // Primera palabra: solo desde 'from'
+    if (free_bits)
+      return word * 32 + (uint32_t)__builtin_ctz(free_bits);
+  }
+  return 0;
+}
+
+static uint32_t pid_alloc(void) {
+  if (!pid_bitmap && !pid_bitmap_grow())
+    return 0;
+
+  uint32_t from = scheduler.next_task_id;
+  if (from == 0 || from >= pid_bitmap_bits)
+    from = 1;
+
+  uint32_t pid = pid_bitmap_scan(from);
+  if (pid == 0) {
+    // Bitmap lleno: crecer y tomar el primer PID de la zona nueva
+    uint32_t old_bits = pid_bitmap_bits;
+    if (!pid_bitmap_grow())
+      return 0;
+    pid = old_bits;
+  }
+
+  pid_bitmap[pid / 32] |= 1u << (pid % 32);
+  scheduler.next_task_id = pid + 1;
+  return pid;
+}
+
+static void pid_free(uint32_t pid) {
+  if (pid == 0 || pid >= pid_bitmap_bits)
+    return;
+  pid_bitmap[pid / 32] &= ~(1u << (pid % 32));
+}
+
+static void pid_hash_insert(task_t *task) {
+  task_t **bucket = &pid_hash[task->task_id & (TASK_PID_HASH_SIZE - 1)];
+  task->pid_hash_next = *bucket;
+  *bucket = task;
+}
+
+static void pid_hash_remove(task_t *task) {
+  task_t **link = &pid_hash[task->task_id & (TASK_PID_HASH_SIZE - 1)];
+  while (*link && *link != task)
+    link = &(*link)->pid_hash_next;
+  if (*link)
+    *link = task->pid_hash_next;
+  task->pid_hash_next = NULL;
+}
+
 static task_t *allocate_task(void) {
   task_t *task = (task_t *)kernel_malloc(sizeof(task_t));
   if (task) {
@@ -1141,7 +1978,7 @@ void show_system_stats(void) {
   terminal_printf(&main_terminal, "Scheduler enabled: %s\r\n",
                   scheduler.scheduler_enabled ? "YES" : "NO");
   terminal_printf(&main_terminal, "Total tasks: %u (max: %u)\r\n",
-                  scheduler.task_count, MAX_TASKS);
+                  scheduler.task_count, TASK_PID_MAX - 1);
   terminal_printf(&main_terminal, "Total context switches: %u\r\n",
                   scheduler.total_switches);
   terminal_printf(&main_terminal, "Current task: %s (ID: %u)\r\n",
@@ -1163,25 +2000,31 @@ void show_system_stats(void) {
   terminal_puts(&main_terminal, "\r\n");
 }
 
+#define CLEANUP_INTERVAL_MS 200
+
+static work_t cleanup_work;
+
+// Recolector de zombies: se ejecuta en la workqueue cada 200ms
 void cleanup_task(void *arg) {
   (void)arg;
 
-  while (1) {
-    task_cleanup_zombies();
-
-    // CAMBIO: 200ms en lugar de 1 segundo
-    task_sleep(200);
+  task_cleanup_zombies();
 
-    // Verificar heap periÃ³dicamente
-    static uint32_t cleanup_count = 0;
-    if (++cleanup_count % 50 == 0) { // Cada 10 segundos
-      heap_info_t info = heap_stats();
-      if (info.used > (STATIC_HEAP_SIZE * 0.8)) {
-        terminal_printf(&main_terminal, "[CLEANUP] High memory usage: %u%%\r\n",
-                        (info.used * 100) / STATIC_HEAP_SIZE);
-      }
+  // Verificar heap periÃ³dicamente
+  static uint32_t cleanup_count = 0;
+  if (++cleanup_count % 50 == 0) { // Cada 10 segundos
+    heap_info_t info = heap_stats();
+    if (info.used > (STATIC_HEAP_SIZE * 0.8)) {
+      terminal_printf(&main_terminal, "[CLEANUP] High memory usage: %u%%\r\n",
+                      (info.used * 100) / STATIC_HEAP_SIZE);
     }
-
-    task_yield();
   }
+
+  queue_delayed_work(&cleanup_work, CLEANUP_INTERVAL_MS);
+}
+
+void task_cleanup_start(void) {
+  work_init(&cleanup_work, cleanup_task, NULL);
+  if (!queue_delayed_work(&cleanup_work, CLEANUP_INTERVAL_MS))
+    terminal_puts(&main_terminal, "[CLEANUP] Workqueue not available\r\n");
 }
\ No newline at end of file
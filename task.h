@@ -1,8 +1,12 @@
 #ifndef TASK_H
 #define TASK_H
 
+#include "fpu.h"
 #include "isr.h"
 #include "memory.h"
+#include "rbtree.h"
+#include "sched_stats.h"
+#include "spinlock.h"
 #include "vfs.h"
 #include <stdbool.h>
 #include <stddef.h>
@@ -26,15 +30,39 @@ typedef enum {
   TASK_PRIORITY_LOW = 7
 } task_priority_t;
 
+// Clases de planificación. La clase justa reparte la CPU en proporción al
+// peso derivado de la prioridad; la de tiempo real es prioridad estricta y
+// se reserva para los workers que ejecutan bottom halves.
+typedef enum {
+  SCHED_CLASS_FAIR = 0, // Ordenada por vruntime en un árbol rojo-negro
+  SCHED_CLASS_RT        // Prioridad estricta, round-robin entre iguales
+} sched_class_t;
+
+#define SCHED_NICE_0_WEIGHT 1024      // Peso de TASK_PRIORITY_NORMAL
+#define SCHED_TICK_US 10000           // Duración de un tick (PIT a 100 Hz)
+#define SCHED_MIN_GRANULARITY_TICKS 1 // Quantum mínimo de la clase justa
+#define SCHED_WAKEUP_CREDIT_US 30000  // Ventaja máxima al despertar
+#define SCHED_INPUT_BOOST_TICKS 3     // Ventaja tras un evento de entrada
+#define SCHED_RT_PERIOD_TICKS 100     // Ventana de control de la clase RT
+#define SCHED_RT_RUNTIME_TICKS 95     // Máximo de la ventana para RT
+
 // Tamaño del stack para cada tarea
 #define TASK_STACK_SIZE (32 * 1024)
 #define USER_STACK_SIZE (16 * 1024) // Stack más grande para usuario
-#define MAX_TASKS 32
 #define TASK_NAME_MAX 32
 
+// PIDs: bitmap que crece bajo demanda + hash PID -> tarea. El PID 0 queda
+// reservado (significa "ninguna tarea" en colas de mensajes, etc.)
+#define TASK_PID_MAX 32768          // Límite de PIDs simultáneos
+#define TASK_PID_BITMAP_INITIAL 1024 // PIDs cubiertos por el bitmap inicial
+#define TASK_PID_HASH_SIZE 256       // Buckets (potencia de 2)
+
 // Flags para tareas
 #define TASK_FLAG_USER_MODE 0x00000001  // Ejecuta en modo usuario (Ring 3)
 #define TASK_FLAG_USER_STACK 0x00000002 // Tiene stack de usuario asignado
+#define TASK_FLAG_THREAD 0x00000004     // Hilo de otro proceso (thread_create)
+
+#define THREAD_STACK_MAX (1024 * 1024) // Stack de usuario máximo por hilo
 
 // Contexto de CPU para cambio de tareas
 typedef struct {
@@ -50,6 +78,17 @@ typedef struct {
   uint32_t eflags;
 } cpu_context_t;
 
+struct wait_queue;
+struct mutex;
+struct task_profile;
+
+// Tabla de descriptores compartida por los hilos de un proceso. Se crea al
+// lanzar el primer hilo; las tareas sin hilos usan su tabla embebida.
+typedef struct task_files {
+  uint32_t refcount; // Tareas que la usan (protegido por scheduler_lock)
+  struct vfs_file *fd[VFS_MAX_FDS];
+} task_files_t;
+
 // Estructura de control de tarea (TCB)
 typedef struct task {
   uint32_t task_id;         // ID único de la tarea
@@ -82,6 +121,14 @@ typedef struct task {
   // Información de tiempo
   uint32_t time_slice;  // Quantum de tiempo asignado
   uint32_t sleep_until; // Tick hasta el que duerme
+
+  // Expulsión: con preempt_count > 0 el tick no cambia de tarea, solo
+  // marca need_resched para el próximo preempt_enable()/cond_resched()
+  uint32_t preempt_count;
+  volatile bool need_resched;
+  uint64_t preempt_off_at; // Reloj al deshabilitar (latency tracer)
+  void *preempt_off_where; // Quién la deshabilitó
+  uint32_t input_boost_until; // Tick en que vence la ventaja por entrada
   uint32_t wake_time;   // Tiempo de despertar
 
   // Lista enlazada
@@ -99,22 +146,75 @@ typedef struct task {
   // Valor de retorno
   int exit_code; // Código de salida
 
-  // Tabla de descriptores de archivos por proceso
-  struct vfs_file *fd_table[VFS_MAX_FDS];
+  // Tabla de descriptores de archivos por proceso: apunta a own_fds o, si
+  // el proceso tiene hilos, a files->fd
+  struct vfs_file **fd_table;
+  struct vfs_file *own_fds[VFS_MAX_FDS];
+  task_files_t *files; // Tabla compartida entre hilos (NULL = propia)
+  uint32_t tgid;       // PID del proceso (el del hilo principal)
+
+  // Espera bloqueante (wait queues)
+  struct task *wait_next;        // Siguiente en la wait queue
+  struct wait_queue *waiting_on; // Cola en la que está bloqueada
+  uint32_t wait_deadline;        // Tick límite de la espera (0 = sin timeout)
+  bool wait_timed_out;           // La última espera terminó por timeout
+  struct futex_q *futex_wait_q;  // FUTEX_WAIT en curso (en su stack de kernel)
+
+  // Herencia de prioridad
+  task_priority_t base_priority; // Prioridad asignada (priority puede subir)
+  struct mutex *blocked_on;      // Mutex por el que está bloqueada
+  struct mutex *held_mutexes;    // Mutexes que posee (lista enlazada)
+
+  struct task *pid_hash_next;   // Cadena del bucket en el hash de PIDs
+  struct task_profile *profile; // Profiling (se reserva bajo demanda)
+
+  fpu_state_t fpu; // Estado x87/SSE (se carga perezosamente vía #NM)
+
+  // Planificación (requieren scheduler_lock)
+  sched_class_t sched_class;
+  uint32_t sched_weight; // Peso de la clase justa según priority
+  uint64_t vruntime;     // Tiempo de CPU en us ponderado por el peso
+  rb_node_t run_node;    // Nodo en el árbol de tareas justas READY
+  bool on_rq;            // run_node está enlazado en el árbol
+  struct task *rt_next;  // Lista de tareas de la clase RT
+
+  task_sched_stats_t sched_stats; // CPU, espera y latencias (TSC)
 } task_t;
 
+// Cola de tareas bloqueadas. Las listas se protegen con el lock del
+// planificador; el llamador protege su propia condición con otro lock.
+typedef struct wait_queue {
+  task_t *head;
+  task_t *tail;
+  const char *name;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT(queue_name) {NULL, NULL, queue_name}
+
 // Planificador de tareas
 typedef struct {
   task_t *current_task; // Tarea actualmente en ejecución
   task_t *idle_task;    // Tarea idle del sistema
   task_t *task_list;    // Lista de todas las tareas
 
-  uint32_t next_task_id;   // Próximo ID de tarea a asignar
+  uint32_t next_task_id;   // Cursor next-fit del allocator de PIDs
   uint32_t task_count;     // Número de tareas activas
   uint32_t total_switches; // Total de cambios de contexto
 
   bool scheduler_enabled; // Si el planificador está habilitado
-  uint32_t quantum_ticks; // Duración del quantum en ticks
+  uint32_t quantum_ticks; // Periodo de latencia objetivo en ticks
+
+  // Clase justa: tareas READY ordenadas por vruntime (la actual no está)
+  rb_root_cached_t fair_rq;
+  uint32_t fair_nr_running; // Tareas en el árbol
+  uint32_t fair_load;       // Suma de sus pesos
+  uint64_t min_vruntime;    // Mínimo monótono, base para nuevas/despertadas
+
+  // Clase RT
+  task_t *rt_list;          // Todas las tareas RT (pocas: se recorre)
+  uint32_t rt_period_start; // Tick de inicio de la ventana actual
+  uint32_t rt_used_ticks;   // Ticks consumidos por RT en la ventana
+  bool rt_throttled;        // RT agotó su cuota: cede a la clase justa
 } task_scheduler_t;
 
 // Funciones principales del planificador
@@ -126,10 +226,21 @@ void task_yield(void);         // Ceder voluntariamente el CPU
 void task_sleep(uint32_t ms);  // Dormir por tiempo específico
 void task_exit(int exit_code); // Terminar tarea actual
 
+// Expulsión y puntos de replanificación para operaciones largas del kernel
+void preempt_disable(void);
+void preempt_enable(void);
+bool preemptible(void);
+// Cede la CPU si el tick lo pidió y no hay locks ni IRQs deshabilitadas.
+// Llamar entre iteraciones de bucles largos, sin locks tomados.
+void cond_resched(void);
+
 // Control del planificador
 void scheduler_start(void);
 void scheduler_stop(void);
 void scheduler_tick(void);         // Llamar desde el timer interrupt
+// Punto de expulsión al final de un top half (tras el EOI): cambia de tarea
+// si un despertar pidió desalojar a la actual
+void scheduler_irq_preempt(void);
 task_t *scheduler_next_task(void); // Obtener próxima tarea a ejecutar
 
 // Funciones de información
@@ -138,6 +249,19 @@ task_t *task_find_by_id(uint32_t task_id);
 task_t *task_find_by_name(const char *name);
 void task_list_all(void); // Listar todas las tareas
 
+// Wait queues
+void wait_queue_init(wait_queue_t *wq, const char *name);
+bool wait_queue_sleep(wait_queue_t *wq, spinlock_t *lock,
+                      uint32_t timeout_ticks);
+task_t *wait_queue_wake_one(wait_queue_t *wq);
+uint32_t wait_queue_wake_all(wait_queue_t *wq);
+uint32_t wait_queue_wake_all_boosted(wait_queue_t *wq);
+bool wait_queue_has_waiters(wait_queue_t *wq);
+task_priority_t wait_queue_best_priority(wait_queue_t *wq,
+                                         task_priority_t fallback);
+void task_set_effective_priority(task_t *task, task_priority_t priority);
+void task_set_sched_class(task_t *task, sched_class_t sched_class);
+
 // Funciones auxiliares
 void task_setup_stack(task_t *task, void (*entry_point)(void *), void *arg);
 bool task_is_ready(task_t *task);
@@ -145,12 +269,15 @@ void task_update_sleep_states(void);
 void show_system_stats(void);
 void stress_test_task(void *arg);
 static bool validate_task_context(task_t *task);
-void cleanup_task(void *arg);
+void cleanup_task(void *arg); // Trabajo periódico de la workqueue
+void task_cleanup_start(void);
 
 // USER MODE
 task_t *task_create_user(const char *name, void *user_code_addr, int argc,
                          char **argv, uint32_t code_size,
                          task_priority_t priority);
+task_t *task_create_thread(task_t *parent, void *user_entry, uint32_t arg,
+                           uint32_t stack_size);
 void task_setup_user_mode(task_t *task, void (*entry_point)(void *), void *arg,
                           void *user_stack);
 // Macros útiles
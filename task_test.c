@@ -512,6 +512,42 @@ static void test_scheduler_basic(void) {
     TEST_PASS();
 }
 
+// ========================================================================
+// TESTS DE WAIT QUEUES (SEMÁFOROS)
+// ========================================================================
+
+static semaphore_t test_sem;
+
+static void semaphore_poster_task(void* arg) {
+    (void)arg;
+    task_sleep(50);
+    semaphore_post(&test_sem);
+    task_exit(0);
+}
+
+static void test_semaphore_blocking(void) {
+    TEST_START("Semaphore Blocking Wait/Post");
+
+    semaphore_init(&test_sem, "test_sem", 0);
+
+    // Sin post, la espera debe expirar sin consumir nada
+    TEST_ASSERT(semaphore_try_wait(&test_sem) == false, "try_wait con contador 0");
+    TEST_ASSERT(semaphore_wait_timeout(&test_sem, 30) == false, "wait no expiró");
+
+    task_t* poster = task_create("sem_post", semaphore_poster_task, NULL,
+                                 TASK_PRIORITY_NORMAL);
+    TEST_ASSERT(poster != NULL, "No se pudo crear la tarea poster");
+
+    // Debe bloquearse (TASK_WAITING) hasta el post, no girar
+    uint32_t start = ticks_since_boot;
+    TEST_ASSERT(semaphore_wait_timeout(&test_sem, 2000) == true, "Post no despertó al waiter");
+    TEST_ASSERT_FORMAT(ticks_since_boot - start < 200,
+                       "Wake tardó demasiado (%u ticks)", ticks_since_boot - start);
+    TEST_ASSERT(test_sem.count == 0, "Contador incorrecto tras wait");
+
+    TEST_PASS();
+}
+
 // ========================================================================
 // TEST RUNNER PRINCIPAL (ACTUALIZADO)
 // ========================================================================
@@ -534,6 +570,7 @@ void run_task_utils_test_suite(void) {
     test_mutex_basic();
     test_mutex_reentrancy();
     test_mutex_race_condition();
+    test_semaphore_blocking();
     
     // Tests de mensajes
     terminal_puts(&main_terminal, "\r\n--- MESSAGE TESTS ---\r\n");
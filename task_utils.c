@@ -6,6 +6,8 @@
 #include "task_utils.h"
 #include "irq.h"
 #include "log.h"
+#include "mmu.h"
+#include "pmm.h"
 
 // ========================================================================
 // FUNCIONES DE SINCRONIZACIÓN BÁSICA (CORREGIDAS)
@@ -17,109 +19,313 @@ void mutex_init(mutex_t* mutex, const char* name) {
     mutex->owner = NULL;
     mutex->lock_count = 0;
     mutex->name = name ? name : "unnamed_mutex";
+    spinlock_init(&mutex->wait_lock, mutex->name);
+    wait_queue_init(&mutex->waiters, mutex->name);
+    mutex->next_held = NULL;
+    mutex->contentions = 0;
+}
+
+// Convierte ms a ticks del timer (100Hz), redondeando hacia arriba
+static uint32_t sync_ms_to_ticks(uint32_t ms) {
+    uint32_t ticks = (ms + 9) / 10;
+    return ticks ? ticks : 1;
+}
+
+// Requiere mutex->wait_lock tomado
+static void mutex_take(mutex_t* mutex, task_t* owner) {
+    mutex->locked = true;
+    mutex->owner = owner;
+    mutex->lock_count = 1;
+    if (owner) {
+        mutex->next_held = owner->held_mutexes;
+        owner->held_mutexes = mutex;
+    }
+}
+
+// Requiere mutex->wait_lock tomado
+static void mutex_release(mutex_t* mutex) {
+    task_t* owner = mutex->owner;
+    if (owner) {
+        mutex_t** link = &owner->held_mutexes;
+        while (*link && *link != mutex)
+            link = &(*link)->next_held;
+        if (*link)
+            *link = mutex->next_held;
+    }
+    mutex->next_held = NULL;
+    mutex->locked = false;
+    mutex->owner = NULL;
+    mutex->lock_count = 0;
+}
+
+// Herencia de prioridad: sube al dueño (y a quien bloquee al dueño, en
+// cadena) hasta 'priority'. Se llama con IRQs deshabilitadas; en UP la
+// cadena owner->blocked_on no puede cambiar mientras la recorremos.
+static void mutex_propagate_priority(mutex_t* mutex, task_priority_t priority) {
+    for (int depth = 0; mutex && depth < MUTEX_PI_MAX_DEPTH; depth++) {
+        task_t* owner = mutex->owner;
+        if (!owner || owner->priority <= priority)
+            break;
+        task_set_effective_priority(owner, priority);
+        mutex = owner->blocked_on;
+    }
+}
+
+// Al soltar un mutex, la prioridad vuelve a la base o a la del mejor
+// waiter de los mutexes que la tarea aún posee
+static void mutex_restore_priority(task_t* task) {
+    if (!task) return;
+    task_priority_t priority = task->base_priority;
+    for (mutex_t* held = task->held_mutexes; held; held = held->next_held)
+        priority = wait_queue_best_priority(&held->waiters, priority);
+    if (priority != task->priority)
+        task_set_effective_priority(task, priority);
 }
 
 bool mutex_try_lock(mutex_t* mutex) {
     if (!mutex) return false;
-    
-    // Deshabilitar interrupciones para operación atómica
-    uint32_t flags;
-    __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
-    
+
+    uint32_t flags = spin_lock_irqsave(&mutex->wait_lock);
+
     bool success = false;
     task_t* current = task_current();
-    
+
     // ✅ FIX: NO permitir reentrada en try_lock (comportamiento estándar)
     // Solo permitir si el mutex está completamente libre
     if (!mutex->locked) {
-        mutex->locked = true;
-        mutex->owner = current;
-        mutex->lock_count = 1;
+        mutex_take(mutex, current);
         success = true;
     }
-    
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+
+    spin_unlock_irqrestore(&mutex->wait_lock, flags);
     return success;
 }
 
 void mutex_lock(mutex_t* mutex) {
     if (!mutex) return;
-    
+
     task_t* current = task_current();
-    
+    uint32_t flags = spin_lock_irqsave(&mutex->wait_lock);
+
     // Permitir reentrada
-    if (mutex->owner == current) {
-        uint32_t flags;
-        __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
+    if (mutex->locked && mutex->owner == current) {
         mutex->lock_count++;
-        __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+        spin_unlock_irqrestore(&mutex->wait_lock, flags);
         return;
     }
-    
-    uint32_t start_ticks = ticks_since_boot;
-    uint32_t attempts = 0;
-    uint32_t backoff = 1;  // ✅ NUEVO: Backoff exponencial
-    
-    while (!mutex_try_lock(mutex)) {
-        attempts++;
-        
-        // Timeout de 5 segundos
-        if (ticks_since_boot - start_ticks > 500) {
-            log_message(LOG_INFO, 
-                "[MUTEX] TIMEOUT: %s waiting for %s (owner: %s, attempts: %u)\r\n",
-                current ? current->name : "unknown",
-                mutex->name,
-                mutex->owner ? mutex->owner->name : "none",
-                attempts);
-            return;
-        }
-        
-        // ✅ FIX: Backoff exponencial para reducir contención
-        for (volatile uint32_t i = 0; i < backoff; i++) {
-            __asm__ volatile("pause");
-        }
-        
-        // Aumentar backoff hasta un máximo
-        if (backoff < 1000) {
-            backoff *= 2;
-        }
-        
-        // Yield cada 10 intentos
-        if (attempts % 10 == 0) {
-            task_yield();
+
+    // Ocupado: bloquearse en la cola del mutex hasta que mutex_unlock nos
+    // despierte. Otra tarea puede ganarlo antes, por eso se re-evalúa.
+    while (mutex->locked) {
+        mutex->contentions++;
+        if (current) {
+            current->blocked_on = mutex;
+            mutex_propagate_priority(mutex, current->priority);
         }
+        wait_queue_sleep(&mutex->waiters, &mutex->wait_lock, 0);
+        if (current)
+            current->blocked_on = NULL;
     }
+
+    mutex_take(mutex, current);
+    spin_unlock_irqrestore(&mutex->wait_lock, flags);
 }
 
-void mutex_unlock(mutex_t* mutex) {
-    if (!mutex || !mutex->locked) return;
-    
+// Devuelve la tarea despertada (si hay) para que el llamador decida si ceder
+static task_t* mutex_unlock_internal(mutex_t* mutex) {
+    uint32_t flags = spin_lock_irqsave(&mutex->wait_lock);
+
+    if (!mutex->locked) {
+        spin_unlock_irqrestore(&mutex->wait_lock, flags);
+        return NULL;
+    }
+
     // Verificar que solo el propietario pueda desbloquear
-    if (mutex->owner != task_current()) {
-        log_message(LOG_INFO, 
+    task_t* current = task_current();
+    if (mutex->owner != current) {
+        spin_unlock_irqrestore(&mutex->wait_lock, flags);
+        log_message(LOG_INFO,
             "[MUTEX] WARNING: %s trying to unlock %s owned by %s\r\n",
-            task_current() ? task_current()->name : "unknown",
+            current ? current->name : "unknown",
             mutex->name,
             mutex->owner ? mutex->owner->name : "unknown");
-        return;
+        return NULL;
     }
-    
-    uint32_t flags;
-    __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
-    
+
     // ✅ FIX: Decrementar contador de locks reentrantes
     if (mutex->lock_count > 1) {
         mutex->lock_count--;
-    } else {
-        mutex->locked = false;
-        mutex->owner = NULL;
-        mutex->lock_count = 0;
-        
-        // ✅ FIX: Barrera de memoria después de liberar (x86-32 compatible)
-        __asm__ __volatile__("lock; addl $0, (%%esp)" ::: "memory", "cc");
+        spin_unlock_irqrestore(&mutex->wait_lock, flags);
+        return NULL;
     }
-    
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
+
+    mutex_release(mutex);
+    mutex_restore_priority(current);
+    task_t* woken = wait_queue_wake_one(&mutex->waiters);
+
+    spin_unlock_irqrestore(&mutex->wait_lock, flags);
+    return woken;
+}
+
+void mutex_unlock(mutex_t* mutex) {
+    if (!mutex) return;
+
+    task_t* woken = mutex_unlock_internal(mutex);
+
+    // Si despertamos a alguien más prioritario, dejarle correr ya
+    task_t* current = task_current();
+    if (woken && current && woken->priority < current->priority)
+        task_yield();
+}
+
+void mutex_task_exit(task_t* task) {
+    if (!task) return;
+
+    // Bloqueada: task_destroy ya la sacó de mutex->waiters; el dueño deja de
+    // heredar su prioridad
+    mutex_t* waiting = task->blocked_on;
+    if (waiting) {
+        uint32_t flags = spin_lock_irqsave(&waiting->wait_lock);
+        task->blocked_on = NULL;
+        mutex_restore_priority(waiting->owner);
+        spin_unlock_irqrestore(&waiting->wait_lock, flags);
+    }
+
+    // Dueña: cada mutex queda libre y el primer waiter lo vuelve a pedir
+    while (task->held_mutexes) {
+        mutex_t* mutex = task->held_mutexes;
+        uint32_t flags = spin_lock_irqsave(&mutex->wait_lock);
+        if (mutex->owner == task) {
+            log_message(LOG_WARN,
+                "[MUTEX] WARNING: %s destroyed holding %s\r\n",
+                task->name, mutex->name);
+            mutex_release(mutex);
+            wait_queue_wake_one(&mutex->waiters);
+        } else {
+            // No debería pasar: no dar vueltas sobre la misma entrada
+            task->held_mutexes = mutex->next_held;
+            mutex->next_held = NULL;
+        }
+        spin_unlock_irqrestore(&mutex->wait_lock, flags);
+    }
+}
+
+// ========================================================================
+// VARIABLES DE CONDICIÓN
+// ========================================================================
+
+void condvar_init(condvar_t* cv, const char* name) {
+    if (!cv) return;
+    cv->name = name ? name : "unnamed_condvar";
+    spinlock_init(&cv->lock, cv->name);
+    wait_queue_init(&cv->waiters, cv->name);
+}
+
+// Suelta el mutex y se bloquea de forma atómica respecto a signal: la
+// tarea queda encolada antes de que nadie pueda tomar cv->lock
+static bool condvar_wait_ticks(condvar_t* cv, mutex_t* mutex,
+                               uint32_t timeout_ticks) {
+    if (!cv || !mutex) return false;
+
+    uint32_t saved_count = mutex->lock_count;
+
+    uint32_t flags = spin_lock_irqsave(&cv->lock);
+    mutex->lock_count = 1;
+    mutex_unlock_internal(mutex);
+    bool signaled = wait_queue_sleep(&cv->waiters, &cv->lock, timeout_ticks);
+    spin_unlock_irqrestore(&cv->lock, flags);
+
+    mutex_lock(mutex);
+    mutex->lock_count = saved_count;
+    return signaled;
+}
+
+void condvar_wait(condvar_t* cv, mutex_t* mutex) {
+    condvar_wait_ticks(cv, mutex, 0);
+}
+
+bool condvar_wait_timeout(condvar_t* cv, mutex_t* mutex, uint32_t timeout_ms) {
+    return condvar_wait_ticks(cv, mutex, sync_ms_to_ticks(timeout_ms));
+}
+
+void condvar_signal(condvar_t* cv) {
+    if (!cv) return;
+    uint32_t flags = spin_lock_irqsave(&cv->lock);
+    wait_queue_wake_one(&cv->waiters);
+    spin_unlock_irqrestore(&cv->lock, flags);
+}
+
+void condvar_broadcast(condvar_t* cv) {
+    if (!cv) return;
+    uint32_t flags = spin_lock_irqsave(&cv->lock);
+    wait_queue_wake_all(&cv->waiters);
+    spin_unlock_irqrestore(&cv->lock, flags);
+}
+
+// ========================================================================
+// SEMÁFOROS CONTADORES
+// ========================================================================
+
+void semaphore_init(semaphore_t* sem, const char* name, int32_t initial) {
+    if (!sem) return;
+    sem->name = name ? name : "unnamed_sem";
+    sem->count = initial;
+    spinlock_init(&sem->lock, sem->name);
+    wait_queue_init(&sem->waiters, sem->name);
+}
+
+static bool semaphore_wait_ticks(semaphore_t* sem, uint32_t timeout_ticks) {
+    if (!sem) return false;
+
+    // Si otro waiter se lleva la cuenta, se vuelve a dormir solo lo que
+    // queda hasta el plazo (0 = sin plazo)
+    uint32_t deadline = ticks_since_boot + timeout_ticks;
+    uint32_t flags = spin_lock_irqsave(&sem->lock);
+    while (sem->count <= 0) {
+        uint32_t remaining = 0;
+        if (timeout_ticks) {
+            int32_t left = (int32_t)(deadline - ticks_since_boot);
+            if (left <= 0) {
+                spin_unlock_irqrestore(&sem->lock, flags);
+                return false;
+            }
+            remaining = (uint32_t)left;
+        }
+        if (!wait_queue_sleep(&sem->waiters, &sem->lock, remaining) &&
+            sem->count <= 0) {
+            spin_unlock_irqrestore(&sem->lock, flags);
+            return false;
+        }
+    }
+    sem->count--;
+    spin_unlock_irqrestore(&sem->lock, flags);
+    return true;
+}
+
+void semaphore_wait(semaphore_t* sem) {
+    semaphore_wait_ticks(sem, 0);
+}
+
+bool semaphore_wait_timeout(semaphore_t* sem, uint32_t timeout_ms) {
+    return semaphore_wait_ticks(sem, sync_ms_to_ticks(timeout_ms));
+}
+
+bool semaphore_try_wait(semaphore_t* sem) {
+    if (!sem) return false;
+    uint32_t flags = spin_lock_irqsave(&sem->lock);
+    bool ok = sem->count > 0;
+    if (ok)
+        sem->count--;
+    spin_unlock_irqrestore(&sem->lock, flags);
+    return ok;
+}
+
+void semaphore_post(semaphore_t* sem) {
+    if (!sem) return;
+    uint32_t flags = spin_lock_irqsave(&sem->lock);
+    sem->count++;
+    wait_queue_wake_one(&sem->waiters);
+    spin_unlock_irqrestore(&sem->lock, flags);
 }
 
 // ========================================================================
@@ -129,19 +335,24 @@ void mutex_unlock(mutex_t* mutex) {
 static message_queue_t message_queues[MAX_MESSAGE_QUEUES];
 static bool message_system_initialized = false;
 
+// Protege la asignación de slots de message_queues; cada cola tiene su lock
+static spinlock_t message_table_lock = SPINLOCK_INIT("msg_table");
+
 void message_system_init(void) {
     if (message_system_initialized) return;
     
     for (int i = 0; i < MAX_MESSAGE_QUEUES; i++) {
-        message_queues[i].owner_task_id = 0;
-        message_queues[i].head = NULL;
-        message_queues[i].tail = NULL;
-        message_queues[i].message_count = 0;
-        message_queues[i].has_messages = false;  // ✅ NUEVO
-        
-        char mutex_name[32];
-        snprintf(mutex_name, sizeof(mutex_name), "msgqueue_%d", i);
-        mutex_init(&message_queues[i].queue_mutex, mutex_name);
+        message_queue_t* queue = &message_queues[i];
+        queue->owner_task_id = 0;
+        queue->slots = NULL;
+        queue->capacity = 0;
+        queue->head = 0;
+        queue->tail = 0;
+        queue->message_count = 0;
+        queue->has_messages = false;  // ✅ NUEVO
+        queue->dropped = 0;
+        spinlock_init(&queue->lock, "msgqueue");
+        wait_queue_init(&queue->receivers, "msgqueue");
     }
     
     message_system_initialized = true;
@@ -153,16 +364,25 @@ message_queue_t* message_queue_get(uint32_t task_id) {
     if (!message_system_initialized) {
         message_system_init();
     }
+    if (task_id == 0) return NULL;
     
+    message_queue_t* found = NULL;
+    uint32_t flags = spin_lock_irqsave(&message_table_lock);
     for (int i = 0; i < MAX_MESSAGE_QUEUES; i++) {
         if (message_queues[i].owner_task_id == task_id) {
-            return &message_queues[i];
+            found = &message_queues[i];
+            break;
         }
     }
-    return NULL;
+    spin_unlock_irqrestore(&message_table_lock, flags);
+    return found;
 }
 
 message_queue_t* message_queue_create(uint32_t task_id) {
+    return message_queue_create_sized(task_id, MAX_MESSAGES_PER_QUEUE);
+}
+
+message_queue_t* message_queue_create_sized(uint32_t task_id, uint32_t capacity) {
     if (!message_system_initialized) {
         message_system_init();
     }
@@ -175,90 +395,138 @@ message_queue_t* message_queue_create(uint32_t task_id) {
         return existing;
     }
     
+    if (capacity == 0) capacity = MAX_MESSAGES_PER_QUEUE;
+    
+    // El ring se reserva una sola vez; send/receive ya no usan el heap
+    message_t* slots = (message_t*)kernel_malloc(capacity * sizeof(message_t));
+    if (!slots) {
+        log_message(LOG_ERROR, "[MSG] ERROR: No memory for queue ring (%u slots)\r\n",
+                    capacity);
+        return NULL;
+    }
+    
+    message_queue_t* queue = NULL;
+    uint32_t flags = spin_lock_irqsave(&message_table_lock);
     for (int i = 0; i < MAX_MESSAGE_QUEUES; i++) {
-        if (message_queues[i].owner_task_id == 0) {
-            message_queues[i].owner_task_id = task_id;
-            log_message(LOG_INFO, 
-                "[MSG] Created queue for task %u at slot %d\r\n", task_id, i);
+        if (message_queues[i].owner_task_id == task_id) {
+            // Otra tarea la creó mientras reservábamos
+            spin_unlock_irqrestore(&message_table_lock, flags);
+            kernel_free(slots);
             return &message_queues[i];
         }
+        if (!queue && message_queues[i].owner_task_id == 0) {
+            queue = &message_queues[i];
+        }
     }
-    
-    log_message(LOG_ERROR, "[MSG] ERROR: No free message queues\r\n");
-    return NULL;
-}
-
-bool message_send(uint32_t target_task_id, uint32_t type, const void* data, size_t size) {
-    if (!message_system_initialized || size > MAX_MESSAGE_SIZE) {
-        return false;
+    if (queue) {
+        uint32_t qflags = spin_lock_irqsave(&queue->lock);
+        queue->slots = slots;
+        queue->capacity = capacity;
+        queue->head = 0;
+        queue->tail = 0;
+        queue->message_count = 0;
+        queue->has_messages = false;
+        queue->dropped = 0;
+        queue->owner_task_id = task_id;
+        spin_unlock_irqrestore(&queue->lock, qflags);
     }
+    spin_unlock_irqrestore(&message_table_lock, flags);
     
-    // ✅ Deshabilitar interrupciones para operación atómica completa
-    uint32_t flags;
-    __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
+    if (!queue) {
+        kernel_free(slots);
+        log_message(LOG_ERROR, "[MSG] ERROR: No free message queues\r\n");
+        return NULL;
+    }
     
+    log_message(LOG_INFO, 
+        "[MSG] Created queue for task %u (%u slots)\r\n", task_id, capacity);
+    return queue;
+}
+
+// Copia el mensaje en el siguiente slot del ring y despierta al receptor
+static bool message_enqueue(uint32_t target_task_id, uint32_t type,
+                            const void* data, size_t size, void* buffer,
+                            size_t buffer_size, uint32_t msg_flags) {
     message_queue_t* queue = message_queue_get(target_task_id);
-    
+    if (!queue && task_find_by_id(target_task_id)) {
+        queue = message_queue_create(target_task_id);  // Creación bajo demanda
+    }
     if (!queue) {
-        __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
         log_message(LOG_WARN, "[MSG] No queue for task %u\n", target_task_id);
         return false;
     }
     
-    if (queue->message_count >= MAX_MESSAGES_PER_QUEUE) {
-        __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
-        log_message(LOG_WARN, "[MSG] Queue full for task %u\n", target_task_id);
+    uint32_t flags = spin_lock_irqsave(&queue->lock);
+    
+    // La cola pudo destruirse entre el lookup y el lock
+    if (queue->owner_task_id != target_task_id || !queue->slots) {
+        spin_unlock_irqrestore(&queue->lock, flags);
         return false;
     }
     
-    // Crear mensaje
-    message_t* msg = (message_t*)kernel_malloc(sizeof(message_t));
-    if (!msg) {
-        __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
-        log_message(LOG_ERROR, "[MSG] Failed to allocate message\n");
+    if (queue->message_count >= queue->capacity) {
+        queue->dropped++;
+        spin_unlock_irqrestore(&queue->lock, flags);
+        log_message(LOG_WARN, "[MSG] Queue full for task %u\n", target_task_id);
         return false;
     }
     
-    msg->sender_id = task_current() ? task_current()->task_id : 0;
-    msg->type = type;
-    msg->size = size;
+    message_t* slot = &queue->slots[queue->tail];
+    slot->sender_id = task_current() ? task_current()->task_id : 0;
+    slot->type = type;
+    slot->size = size;
+    slot->flags = msg_flags;
+    slot->buffer = buffer;
+    slot->buffer_size = buffer_size;
     if (data && size > 0) {
-        memcpy(msg->data, data, size);
+        memcpy(slot->data, data, size);
     }
-    msg->next = NULL;
     
-    // Añadir a la cola
-    if (queue->tail) {
-        queue->tail->next = msg;
-        queue->tail = msg;
-    } else {
-        queue->head = queue->tail = msg;
-    }
+    if (++queue->tail == queue->capacity) queue->tail = 0;
     queue->message_count++;
     
     // ✅ FIX: Establecer flag de señalización
     queue->has_messages = true;
     
-    // ✅ FIX: Usar barrera de memoria para asegurar visibilidad
-    __asm__ __volatile__("mfence" ::: "memory");
-    
-    log_message(LOG_INFO, 
-        "[MSG] Sent type=%u to task %u (count=%u)\n",
-        type, target_task_id, queue->message_count);
+    wait_queue_wake_one(&queue->receivers);
     
-    // ✅ FIX: Despertar tarea de manera segura
-    task_t* target_task = task_find_by_id(target_task_id);
-    if (target_task && target_task->state == TASK_SLEEPING) {
-        target_task->state = TASK_READY;
-        target_task->sleep_until = 0;  // Cancelar sleep
-        log_message(LOG_INFO, "[MSG] Woke up task %s\n", target_task->name);
+    spin_unlock_irqrestore(&queue->lock, flags);
+    return true;
+}
+
+bool message_send(uint32_t target_task_id, uint32_t type, const void* data, size_t size) {
+    if (!message_system_initialized || size > MAX_MESSAGE_SIZE) {
+        return false;
+    }
+    return message_enqueue(target_task_id, type, data, size, NULL, 0, 0);
+}
+
+bool message_send_buffer(uint32_t target_task_id, uint32_t type,
+                         const void* data, size_t size,
+                         void* buffer, size_t buffer_size, uint32_t flags) {
+    if (!message_system_initialized || !buffer || size > MAX_MESSAGE_SIZE) {
+        return false;
     }
+    flags = (flags & MSG_FLAG_PAGES) | MSG_FLAG_BUFFER;
+    return message_enqueue(target_task_id, type, data, size, buffer,
+                           buffer_size, flags);
+}
+
+void message_release_buffer(message_t* msg) {
+    if (!msg || !(msg->flags & MSG_FLAG_BUFFER) || !msg->buffer) return;
     
-    __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
-    return true;
+    if (msg->flags & MSG_FLAG_PAGES) {
+        pmm_free_pages(msg->buffer,
+                       (msg->buffer_size + PAGE_SIZE - 1) / PAGE_SIZE);
+    } else {
+        kernel_free(msg->buffer);
+    }
+    msg->buffer = NULL;
+    msg->flags &= ~(MSG_FLAG_BUFFER | MSG_FLAG_PAGES);
 }
 
-bool message_receive(message_t* msg_out, bool blocking) {
+static bool message_dequeue(message_t* msg_out, bool blocking,
+                            uint32_t timeout_ticks) {
     if (!message_system_initialized || !msg_out) {
         log_message(LOG_WARN, "[MSG] receive: system not init or NULL output\r\n");
         return false;
@@ -271,112 +539,132 @@ bool message_receive(message_t* msg_out, bool blocking) {
     }
     
     message_queue_t* queue = message_queue_get(current->task_id);
+    if (!queue && blocking) {
+        queue = message_queue_create(current->task_id);  // Creación bajo demanda
+    }
     if (!queue) {
-        log_message(LOG_INFO, "[MSG] receive: No queue for task %u (%s)\r\n", 
-                   current->task_id, current->name);
         return false;
     }
     
-    uint32_t wait_start = ticks_since_boot;
-    uint32_t check_count = 0;
+    uint32_t flags = spin_lock_irqsave(&queue->lock);
     
-    while (true) {
-        check_count++;
-        
-        // ✅ FIX: Verificar flag primero (optimización)
-        if (!queue->has_messages && !blocking) {
-            return false;
-        }
-        
-        // ✅ FIX: Lock solo cuando necesitamos acceder a la cola
-        uint32_t flags;
-        __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
-        
-        if (queue->head) {
-            // Tomar el primer mensaje
-            message_t* msg = queue->head;
-            queue->head = msg->next;
-            if (!queue->head) {
-                queue->tail = NULL;
-                queue->has_messages = false;  // ✅ Limpiar flag
-            }
-            queue->message_count--;
-            
-            // Copiar al output
-            memcpy(msg_out, msg, sizeof(message_t));
-            
-            log_message(LOG_INFO, 
-                "[MSG] Received type=%u by %s (remaining=%u)\r\n",
-                msg_out->type, current->name, queue->message_count);
-            
-            // Liberar el mensaje
-            kernel_free(msg);
-            
-            __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
-            return true;
-        }
-        
-        __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
-        
-        // ✅ Si no es blocking, salir inmediatamente
-        if (!blocking) {
+    // Sin mensajes: dormir en la cola hasta que message_enqueue nos despierte
+    while (queue->message_count == 0) {
+        if (!blocking || !queue->slots) {
+            spin_unlock_irqrestore(&queue->lock, flags);
             return false;
         }
-        
-        // ✅ FIX: Timeout con yield frecuente
-        if (ticks_since_boot - wait_start > 500) { // 5 segundos
-            log_message(LOG_INFO, 
-                "[MSG] Timeout waiting for message (task %s, checks=%u)\r\n",
-                current->name, check_count);
+        if (!wait_queue_sleep(&queue->receivers, &queue->lock, timeout_ticks) &&
+            queue->message_count == 0) {
+            spin_unlock_irqrestore(&queue->lock, flags);
             return false;
         }
-        
-        // ✅ FIX: Sleep corto en lugar de spin
-        // Esto permite que el sender se ejecute
-        task_sleep(10);  // 10ms
     }
+    
+    // Copiar solo la cabecera y los bytes útiles, no el slot completo
+    message_t* slot = &queue->slots[queue->head];
+    msg_out->sender_id = slot->sender_id;
+    msg_out->type = slot->type;
+    msg_out->size = slot->size;
+    msg_out->flags = slot->flags;
+    msg_out->buffer = slot->buffer;
+    msg_out->buffer_size = slot->buffer_size;
+    if (slot->size > 0) {
+        memcpy(msg_out->data, slot->data, slot->size);
+    }
+    slot->buffer = NULL;
+    
+    if (++queue->head == queue->capacity) queue->head = 0;
+    queue->message_count--;
+    queue->has_messages = queue->message_count > 0;  // ✅ Limpiar flag
+    
+    spin_unlock_irqrestore(&queue->lock, flags);
+    return true;
+}
+
+bool message_receive(message_t* msg_out, bool blocking) {
+    return message_dequeue(msg_out, blocking, 0);
+}
+
+bool message_receive_timeout(message_t* msg_out, uint32_t timeout_ms) {
+    return message_dequeue(msg_out, true, sync_ms_to_ticks(timeout_ms));
 }
 
 void message_queue_destroy(message_queue_t* queue) {
     if (!queue) return;
     
-    mutex_lock(&queue->queue_mutex);
+    uint32_t tflags = spin_lock_irqsave(&message_table_lock);
+    uint32_t flags = spin_lock_irqsave(&queue->lock);
     
-    // Liberar todos los mensajes pendientes
-    message_t* current = queue->head;
-    while (current) {
-        message_t* next = current->next;
-        kernel_free(current);
-        current = next;
-    }
+    message_t* slots = queue->slots;
+    uint32_t head = queue->head;
+    uint32_t pending = queue->message_count;
+    uint32_t capacity = queue->capacity;
     
-    queue->head = NULL;
-    queue->tail = NULL;
+    queue->slots = NULL;
+    queue->capacity = 0;
+    queue->head = 0;
+    queue->tail = 0;
     queue->message_count = 0;
+    queue->has_messages = false;
     queue->owner_task_id = 0;
     
-    mutex_unlock(&queue->queue_mutex);
+    // Quien estuviera esperando verá la cola vacía y sin ring
+    wait_queue_wake_all(&queue->receivers);
+    
+    spin_unlock_irqrestore(&queue->lock, flags);
+    spin_unlock_irqrestore(&message_table_lock, tflags);
+    
+    if (!slots) return;
+    
+    // Los buffers transferidos que nadie recogió siguen siendo nuestros
+    for (uint32_t i = 0; i < pending; i++) {
+        message_release_buffer(&slots[(head + i) % capacity]);
+    }
+    kernel_free(slots);
 }
 
 // ========================================================================
 // PROFILING DE TAREAS
 // ========================================================================
 
-typedef struct {
+// Cada tarea lleva su propio bloque de profiling (task->profile), reservado
+// al crearla (o al activar el profiling) y liberado en task_destroy. El
+// planificador lo actualiza en cada cambio de contexto con el tramo medido
+// por el TSC, así que aquí nunca se reserva memoria.
+typedef struct task_profile {
     uint32_t task_switches;
-    uint32_t total_runtime;
+    uint32_t total_runtime; // us
     uint32_t max_runtime_in_switch;
     uint32_t min_runtime_in_switch;
     uint32_t average_runtime_per_switch;
 } task_profile_t;
 
-static task_profile_t task_profiles[MAX_TASKS] = {0};
 static bool profiling_enabled = false;
 
+void task_profiling_attach(task_t* task) {
+    if (!profiling_enabled || !task || task->profile) return;
+    
+    task_profile_t* profile = (task_profile_t*)kernel_malloc(sizeof(task_profile_t));
+    if (!profile) return;
+    memset(profile, 0, sizeof(task_profile_t));
+    task->profile = profile;
+}
+
 void task_profiling_enable(void) {
     if (profiling_enabled) return;
-    memset(task_profiles, 0, sizeof(task_profiles));
     profiling_enabled = true;
+    
+    // Reiniciar los perfiles existentes y crear los que falten
+    if (scheduler.task_list) {
+        task_t* t = scheduler.task_list;
+        do {
+            if (t->profile) memset(t->profile, 0, sizeof(task_profile_t));
+            else task_profiling_attach(t);
+            t = t->next;
+        } while (t != scheduler.task_list);
+    }
+    
     terminal_puts(&main_terminal, "Task profiling enabled\r\n");
 }
 
@@ -385,23 +673,51 @@ void task_profiling_disable(void) {
     terminal_puts(&main_terminal, "Task profiling disabled\r\n");
 }
 
-void task_profiling_update(task_t* task, uint32_t runtime_ticks) {
-    if (!profiling_enabled || !task || task->task_id >= MAX_TASKS) return;
+void task_profiling_update(task_t* task, uint32_t runtime_us) {
+    if (!profiling_enabled || !task || !task->profile) return;
     
-    task_profile_t* profile = &task_profiles[task->task_id];
+    task_profile_t* profile = task->profile;
     profile->task_switches++;
-    profile->total_runtime += runtime_ticks;
+    profile->total_runtime += runtime_us;
     
-    if (runtime_ticks > profile->max_runtime_in_switch) {
-        profile->max_runtime_in_switch = runtime_ticks;
+    if (runtime_us > profile->max_runtime_in_switch) {
+        profile->max_runtime_in_switch = runtime_us;
     }
-    if (runtime_ticks < profile->min_runtime_in_switch || profile->task_switches == 1) {
-        profile->min_runtime_in_switch = runtime_ticks;
+    if (runtime_us < profile->min_runtime_in_switch || profile->task_switches == 1) {
+        profile->min_runtime_in_switch = runtime_us;
     }
     
     profile->average_runtime_per_switch = profile->total_runtime / profile->task_switches;
 }
 
+void task_profiling_release(task_t* task) {
+    if (!task || !task->profile) return;
+    kernel_free(task->profile);
+    task->profile = NULL;
+}
+
+void task_profiling_report(void) {
+    terminal_puts(&main_terminal, "\r\n=== Task Profiling ===\r\n");
+    terminal_puts(&main_terminal, "PID   NAME             SWITCHES  TOTAL   MIN   MAX   AVG (us)\r\n");
+    
+    if (scheduler.task_list) {
+        task_t* t = scheduler.task_list;
+        do {
+            task_profile_t* p = t->profile;
+            if (p && p->task_switches) {
+                terminal_printf(&main_terminal, "%-5u %-16s %-9u %-7u %-5u %-5u %u\r\n",
+                               t->task_id, t->name, p->task_switches, p->total_runtime,
+                               p->min_runtime_in_switch, p->max_runtime_in_switch,
+                               p->average_runtime_per_switch);
+            }
+            t = t->next;
+        } while (t != scheduler.task_list);
+    }
+    
+    terminal_printf(&main_terminal, "Profiling: %s\r\n\r\n",
+                    profiling_enabled ? "enabled" : "disabled");
+}
+
 // ========================================================================
 // FUNCIONES DE MONITOREO AVANZADO
 // ========================================================================
@@ -455,9 +771,9 @@ void task_monitor_health(void) {
         terminal_printf(&main_terminal, "WARNING: %u zombie tasks detected!\r\n", zombie_tasks);
     }
     
-    if (scheduler.task_count > (MAX_TASKS * 0.8)) {
+    if (scheduler.task_count > (TASK_PID_MAX / 5) * 4) {
         terminal_printf(&main_terminal, "WARNING: Task limit nearly reached (%u/%u)\r\n", 
-                       scheduler.task_count, MAX_TASKS);
+                       scheduler.task_count, TASK_PID_MAX - 1);
     }
     
     // Verificar si hay deadlocks potenciales
@@ -49,59 +49,123 @@
 // ESTRUCTURA MUTEX (MEJORADA)
 // ========================================================================
 
-typedef struct {
+typedef struct mutex {
     volatile bool locked;
     task_t* owner;
     uint32_t lock_count;  // ✅ NUEVO: Para locks reentrantes
     const char* name;
+    spinlock_t wait_lock;      // Protege el estado del mutex
+    wait_queue_t waiters;      // Tareas bloqueadas esperando el mutex
+    struct mutex* next_held;   // Siguiente mutex en owner->held_mutexes
+    uint32_t contentions;      // Veces que alguien tuvo que bloquearse
 } mutex_t;
 
+// Profundidad máxima al propagar herencia de prioridad (A -> B -> C ...)
+#define MUTEX_PI_MAX_DEPTH 8
+
 // Funciones de sincronización
 void mutex_init(mutex_t* mutex, const char* name);
 bool mutex_try_lock(mutex_t* mutex);
 void mutex_lock(mutex_t* mutex);
 void mutex_unlock(mutex_t* mutex);
+// Limpieza de herencia de prioridad al destruir 'task' (ya fuera del
+// planificador y de su wait queue): suelta los mutexes que poseía,
+// despertando a un waiter de cada uno, y devuelve su prioridad al dueño del
+// mutex por el que estaba bloqueada
+void mutex_task_exit(task_t* task);
+
+// ========================================================================
+// VARIABLES DE CONDICIÓN Y SEMÁFOROS
+// ========================================================================
+
+typedef struct {
+    spinlock_t lock;
+    wait_queue_t waiters;
+    const char* name;
+} condvar_t;
+
+void condvar_init(condvar_t* cv, const char* name);
+void condvar_wait(condvar_t* cv, mutex_t* mutex);
+bool condvar_wait_timeout(condvar_t* cv, mutex_t* mutex, uint32_t timeout_ms);
+void condvar_signal(condvar_t* cv);
+void condvar_broadcast(condvar_t* cv);
+
+typedef struct {
+    spinlock_t lock;
+    volatile int32_t count;
+    wait_queue_t waiters;
+    const char* name;
+} semaphore_t;
+
+void semaphore_init(semaphore_t* sem, const char* name, int32_t initial);
+void semaphore_wait(semaphore_t* sem);
+bool semaphore_try_wait(semaphore_t* sem);
+bool semaphore_wait_timeout(semaphore_t* sem, uint32_t timeout_ms);
+void semaphore_post(semaphore_t* sem);
 
 // ========================================================================
 // SISTEMA DE MENSAJES
 // ========================================================================
 
 #define MAX_MESSAGE_QUEUES 16
-#define MAX_MESSAGES_PER_QUEUE 32
+#define MAX_MESSAGES_PER_QUEUE 32   // Profundidad por defecto del ring
 #define MAX_MESSAGE_SIZE 256
 
+// Flags de message_t
+#define MSG_FLAG_BUFFER 0x01  // Transporta un buffer por referencia (sin copia)
+#define MSG_FLAG_PAGES  0x02  // El buffer son páginas de pmm (si no, heap)
+
 typedef struct message {
     uint32_t sender_id;
     uint32_t type;
-    size_t size;
+    size_t size;          // Bytes válidos en data[]
+    uint32_t flags;
+    void* buffer;         // MSG_FLAG_BUFFER: el receptor pasa a ser dueño
+    size_t buffer_size;
     uint8_t data[MAX_MESSAGE_SIZE];
-    struct message* next;
 } message_t;
 
+// Ring preasignado por cola: enviar y recibir no tocan el heap
 typedef struct {
     uint32_t owner_task_id;
-    message_t* head;
-    message_t* tail;
+    message_t* slots;
+    uint32_t capacity;
+    uint32_t head;             // Próximo slot a leer
+    uint32_t tail;             // Próximo slot a escribir
     uint32_t message_count;
-    mutex_t queue_mutex;
+    spinlock_t lock;
+    wait_queue_t receivers;    // Dueño bloqueado en message_receive
     volatile bool has_messages;
+    uint32_t dropped;          // Envíos rechazados por cola llena
 } message_queue_t;
 
 // Funciones de mensajes
 void message_system_init(void);
 message_queue_t* message_queue_create(uint32_t task_id);
+message_queue_t* message_queue_create_sized(uint32_t task_id, uint32_t capacity);
 message_queue_t* message_queue_get(uint32_t task_id);  // ✅ NUEVO
 bool message_send(uint32_t target_task_id, uint32_t type, const void* data, size_t size);
 bool message_receive(message_t* msg_out, bool blocking);
+bool message_receive_timeout(message_t* msg_out, uint32_t timeout_ms);
 void message_queue_destroy(message_queue_t* queue);
 
+// Zero-copy: transfiere la propiedad de 'buffer' (heap o páginas de pmm
+// según MSG_FLAG_PAGES) junto a una cabecera pequeña en data. Si falla, el
+// emisor sigue siendo el dueño del buffer.
+bool message_send_buffer(uint32_t target_task_id, uint32_t type,
+                         const void* data, size_t size,
+                         void* buffer, size_t buffer_size, uint32_t flags);
+void message_release_buffer(message_t* msg);
+
 // ========================================================================
 // PROFILING
 // ========================================================================
 
 void task_profiling_enable(void);
 void task_profiling_disable(void);
-void task_profiling_update(task_t* task, uint32_t runtime_ticks);
+void task_profiling_attach(task_t* task); // Reserva el perfil si está activo
+void task_profiling_update(task_t* task, uint32_t runtime_us);
+void task_profiling_release(task_t* task);
 void task_profiling_report(void);
 
 // ========================================================================
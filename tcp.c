@@ -9,14 +9,24 @@
 #include "task.h"
 #include "terminal.h"
 
+#define TCP_MAX_RETRANSMITS 5
+
 tcp_pcb_t tcp_pcbs[TCP_MAX_CONNECTIONS];
 
+static void tcp_rto_expired(void *arg);
+static void tcp_retransmit_work(void *arg);
+static void tcp_stop_rto(tcp_pcb_t *pcb);
+
 void tcp_init(void) { memset(tcp_pcbs, 0, sizeof(tcp_pcbs)); }
 
 tcp_pcb_t *tcp_new_pcb(void) {
   for (int i = 0; i < TCP_MAX_CONNECTIONS; i++) {
     if (tcp_pcbs[i].state == TCP_CLOSED) {
+      // Un reenvío de la conexión anterior no debe ver el PCB a medias
+      tcp_stop_rto(&tcp_pcbs[i]);
       memset(&tcp_pcbs[i], 0, sizeof(tcp_pcb_t));
+      ktimer_init(&tcp_pcbs[i].rto_timer, tcp_rto_expired, &tcp_pcbs[i]);
+      work_init(&tcp_pcbs[i].rto_work, tcp_retransmit_work, &tcp_pcbs[i]);
       return &tcp_pcbs[i];
     }
   }
@@ -87,11 +97,10 @@ bool tcp_send_packet(tcp_pcb_t *pcb, uint8_t flags, const uint8_t *data,
   tcp->checksum =
       htons(tcp_checksum(buffer, tcp_len, pcb->local_ip, pcb->remote_ip));
 
-  uint32_t f;
-  __asm__ __volatile__("pushf; cli; pop %0" : "=r"(f));
+  network_stack_lock();
   bool success =
       ip_send_packet(pcb->remote_ip, IP_PROTOCOL_TCP, buffer, tcp_len);
-  __asm__ __volatile__("push %0; popf" : : "r"(f));
+  network_stack_unlock();
 
   kernel_free(buffer);
   if (success) {
@@ -103,6 +112,56 @@ bool tcp_send_packet(tcp_pcb_t *pcb, uint8_t flags, const uint8_t *data,
   return success;
 }
 
+// ========================================================================
+// RETRANSMISIÓN
+// ========================================================================
+
+static void tcp_arm_rto(tcp_pcb_t *pcb) {
+  timer_mod(&pcb->rto_timer,
+            (uint64_t)pcb->retransmit_timeout * TIMER_NS_PER_TICK);
+}
+
+// Softirq: no se puede tomar el lock de la pila, se reenvía desde un worker
+static void tcp_rto_expired(void *arg) {
+  tcp_pcb_t *pcb = (tcp_pcb_t *)arg;
+  if (!workqueue_running()) {
+    timer_add(&pcb->rto_timer, TIMER_NS_PER_TICK); // Reintentar en un tick
+    return;
+  }
+  queue_work_item(&pcb->rto_work); // Si ya estaba en cola, basta con esa
+}
+
+// El worker puede estar reenviando y rearmar el timer: se espera a que
+// acabe y se quita otra vez
+static void tcp_stop_rto(tcp_pcb_t *pcb) {
+  timer_del(&pcb->rto_timer);
+  cancel_work_sync(&pcb->rto_work);
+  timer_del(&pcb->rto_timer);
+}
+
+static void tcp_retransmit_work(void *arg) {
+  tcp_pcb_t *pcb = (tcp_pcb_t *)arg;
+  // tcp_input puede haber establecido la conexión mientras esperaba: el
+  // estado solo vale mirado bajo el lock
+  network_stack_lock();
+  if (pcb->state != TCP_SYN_SENT) {
+    network_stack_unlock();
+    return;
+  }
+
+  if (++pcb->retransmit_count >= TCP_MAX_RETRANSMITS) {
+    pcb->state = TCP_CLOSED; // tcp_connect lo ve y falla
+    network_stack_unlock();
+    return;
+  }
+  pcb->retransmit_timeout *= 2;
+  pcb->last_activity = ticks_since_boot;
+  pcb->snd_nxt = pcb->snd_una; // El SYN reenviado lleva el mismo ISN
+  tcp_send_packet(pcb, TCP_FLAG_SYN, NULL, 0);
+  tcp_arm_rto(pcb);
+  network_stack_unlock();
+}
+
 int tcp_connect(ip_addr_t dest_ip, uint16_t dest_port) {
   tcp_pcb_t *pcb = tcp_new_pcb();
   if (!pcb)
@@ -124,31 +183,27 @@ int tcp_connect(ip_addr_t dest_ip, uint16_t dest_port) {
   pcb->retransmit_count = 0;
   pcb->internal_rx_len = 0;
 
-  if (!tcp_send_packet(pcb, TCP_FLAG_SYN, NULL, 0))
+  if (!tcp_send_packet(pcb, TCP_FLAG_SYN, NULL, 0)) {
+    pcb->state = TCP_CLOSED;
     return -1;
+  }
+  // Los reintentos del SYN los lleva el timer de retransmisión
+  tcp_arm_rto(pcb);
 
   uint32_t start_time = ticks_since_boot;
   while (ticks_since_boot - start_time < 500) {
-    uint32_t f;
-    __asm__ __volatile__("pushf; cli; pop %0" : "=r"(f));
     network_stack_tick();
-    __asm__ __volatile__("push %0; popf" : : "r"(f));
 
     if (pcb->state == TCP_ESTABLISHED)
       return (pcb - tcp_pcbs);
+    if (pcb->state == TCP_CLOSED)
+      break; // Reintentos agotados
 
-    if (ticks_since_boot - pcb->last_activity > pcb->retransmit_timeout) {
-      pcb->retransmit_count++;
-      if (pcb->retransmit_count >= 5)
-        break;
-      pcb->retransmit_timeout *= 2;
-      pcb->last_activity = ticks_since_boot;
-      tcp_send_packet(pcb, TCP_FLAG_SYN, NULL, 0);
-    }
     for (volatile int i = 0; i < 5000; i++)
       __asm__ __volatile__("pause");
   }
 
+  timer_del(&pcb->rto_timer);
   pcb->state = TCP_CLOSED;
   return -1;
 }
@@ -168,6 +223,7 @@ void tcp_input(uint8_t *packet, uint32_t length, ip_addr_t src_ip) {
 
   if (pcb->state == TCP_SYN_SENT) {
     if ((tcp->flags & TCP_FLAG_SYN) && (tcp->flags & TCP_FLAG_ACK)) {
+      timer_del(&pcb->rto_timer);
       pcb->rcv_nxt = seq + 1;
       pcb->state = TCP_ESTABLISHED;
       tcp_send_packet(pcb, TCP_FLAG_ACK, NULL, 0);
@@ -232,10 +288,7 @@ int tcp_receive(int socket_id, uint8_t *buffer, uint32_t len) {
     }
 
     // 3. PROCESAR RED
-    uint32_t f;
-    __asm__ __volatile__("pushf; cli; pop %0" : "=r"(f));
     network_stack_tick();
-    __asm__ __volatile__("push %0; popf" : : "r"(f));
 
     for (volatile int i = 0; i < 5000; i++)
       __asm__ __volatile__("pause");
@@ -249,6 +302,7 @@ void tcp_close(int socket_id) {
     if (pcb->state == TCP_ESTABLISHED) {
       tcp_send_packet(pcb, TCP_FLAG_FIN | TCP_FLAG_ACK, NULL, 0);
     }
+    tcp_stop_rto(pcb);
     pcb->state = TCP_CLOSED;
   }
 }
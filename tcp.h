@@ -2,6 +2,8 @@
 #define TCP_H
 
 #include "ipv4.h"
+#include "timer.h"
+#include "workqueue.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -65,8 +67,10 @@ typedef struct {
   uint32_t internal_rx_len;
 
   uint32_t last_activity;        // Ticks de última actividad
-  uint32_t retransmit_timeout;   // Timeout para retransmisión
+  uint32_t retransmit_timeout;   // Timeout para retransmisión (ticks)
   uint32_t retransmit_count;     // Contador de reintentos
+  ktimer_t rto_timer;            // Vence al agotarse retransmit_timeout
+  work_t rto_work;               // Retransmisión en contexto de tarea
   uint8_t retransmit_data[1024]; // Datos a retransmitir
   uint32_t retransmit_len;       // Longitud de datos a retransmitir
 } tcp_pcb_t;
@@ -3,6 +3,7 @@
 #include "ahci.h"
 #include "apic.h"
 #include "arp.h"
+#include "bcache.h"
 #include "cpuid.h"
 #include "disk.h"
 #include "disk_io_daemon.h"
@@ -12,14 +13,20 @@
 #include "e1000.h"
 #include "exec.h"
 #include "fat32.h"
+#include "fpu.h"
+#include "futex.h"
 #include "gdt.h"
 #include "http.h"
 #include "icmp.h"
+#include "ide.h"
 #include "installer.h"
+#include "input.h"
 #include "irq.h"
 #include "kernel.h"
+#include "latency.h"
 #include "log.h"
 #include "memory.h"
+#include "memutils.h"
 #include "mini_parser.h"
 #include "mmu.h"
 #include "module_loader.h"
@@ -30,13 +37,18 @@
 #include "pci.h"
 #include "pmm.h"
 #include "sata_disk.h"
+#include "sched_stats.h"
 #include "serial.h"
+#include "softirq.h"
+#include "spinlock.h"
 #include "string.h"
 #include "syscalls.h"
 #include "task.h"
 #include "task_utils.h"
 #include "text_editor.h"
+#include "timer.h"
 #include "vfs.h"
+#include "workqueue.h"
 
 extern vfs_superblock_t *mount_table[VFS_MAX_MOUNTS];
 extern char mount_points[VFS_MAX_MOUNTS][VFS_PATH_MAX];
@@ -45,6 +57,7 @@ extern ahci_controller_t ahci_controller;
 // Forward declaration for cmd_top
 void cmd_top(Terminal *term);
 void cmd_stack_debug(Terminal *term);
+void cmd_task_info(Terminal *term, uint32_t task_id);
 
 // Decodifica un color ANSI a color RGB
 uint32_t ansi_to_color(uint8_t ansi_code, uint8_t is_bright) {
@@ -1320,6 +1333,9 @@ void terminal_draw(Terminal *term) {
     last_cursor_visible = term->cursor_visible;
     term->cursor_state_changed = 0;
   }
+
+  // Lo tecleado hasta ahora ya está en pantalla
+  input_glyph_drawn();
 }
 
 void terminal_handle_key(Terminal *term, int key) {
@@ -2049,6 +2065,159 @@ static void show_disk_health(Terminal *term) {
   }
 }
 
+// Lee el archivo entero con lecturas de 'bufsize' bytes, como cat.
+// Devuelve los ciclos de sched_clock() y los bytes en *bytes, o 0 si falla.
+static uint64_t readbench_pass(const char *path, uint8_t *buf,
+                               uint32_t bufsize, uint32_t *bytes) {
+  int fd = vfs_open(path, VFS_O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+  uint32_t total = 0;
+  int n;
+  uint64_t start = sched_clock();
+  while ((n = vfs_read(fd, buf, bufsize)) > 0)
+    total += (uint32_t)n;
+  uint64_t cycles = sched_clock() - start;
+  vfs_close(fd);
+
+  *bytes = total;
+  return n < 0 ? 0 : (cycles ? cycles : 1);
+}
+
+// Tiempo de CPU de la tarea idle: lo que no consumió nadie más
+static uint64_t readbench_idle_us(void) {
+  return scheduler.idle_task ? sched_stats_runtime_us(scheduler.idle_task)
+                             : 0;
+}
+
+// Lectura secuencial de un archivo: una pasada en frío (sin bloques limpios
+// en la caché) y otra en caliente. La CPU ocupada (todo lo que no fue idle,
+// incluidas las tareas de disco y las esperas que sondean) se da por MiB
+// leído para comparar esperas por interrupción con sondeo.
+static void cmd_readbench(Terminal *term, int argc, char **argv) {
+  if (argc < 2) {
+    terminal_puts(term, "Usage: readbench <path> [bufsize]\r\n");
+    return;
+  }
+  char full_path[VFS_PATH_MAX];
+  resolve_relative_path(term, argv[1], full_path);
+
+  uint32_t bufsize = argc > 2 ? (uint32_t)atoi(argv[2]) : 4096;
+  if (bufsize < 512 || bufsize > 1024 * 1024)
+    bufsize = 4096;
+  uint8_t *buf = (uint8_t *)kernel_malloc(bufsize);
+  if (!buf) {
+    terminal_puts(term, "readbench: Out of memory\r\n");
+    return;
+  }
+  if (!sched_clock_mhz())
+    terminal_puts(term, "No TSC: times have timer tick resolution\r\n");
+
+  static const char *const pass_names[2] = {"cold", "warm"};
+  for (int pass = 0; pass < 2; pass++) {
+    if (pass == 0)
+      bcache_drop_clean();
+    uint32_t bytes = 0;
+    uint64_t idle_start = readbench_idle_us();
+    uint64_t cycles = readbench_pass(full_path, buf, bufsize, &bytes);
+    uint64_t idle_us = readbench_idle_us() - idle_start;
+    if (!cycles) {
+      terminal_printf(term, "readbench: Failed to read %s\r\n", full_path);
+      break;
+    }
+    uint64_t us = sched_clock_to_us(cycles);
+    if (!us)
+      us = 1;
+    uint64_t busy_us = idle_us < us ? us - idle_us : 0;
+    uint32_t mib_x100 = (uint32_t)((uint64_t)bytes * 100 / (1024 * 1024));
+    terminal_printf(term, "%s: %u KiB in %u ms, %u KiB/s\r\n",
+                    pass_names[pass], bytes / 1024, (uint32_t)(us / 1000),
+                    (uint32_t)((uint64_t)bytes * 1000000 / us / 1024));
+    terminal_printf(term, "  CPU busy %u ms (%u%%), %u us per MiB\r\n",
+                    (uint32_t)(busy_us / 1000),
+                    (uint32_t)(busy_us * 100 / us),
+                    mib_x100 ? (uint32_t)(busy_us * 100 / mib_x100) : 0);
+  }
+  kernel_free(buf);
+  terminal_puts(term, "Read-ahead counters: cat /sys/bcache\r\n");
+  ide_print_irq_stats();
+  terminal_puts(term, "AHCI interrupts: ahci list\r\n");
+}
+
+// Lee 'sectors' del disco principal en comandos de 'io_sectors', sin caché.
+// Devuelve los microsegundos (0 si falla) y la CPU ocupada en *busy_us.
+static uint64_t diskbench_pass(uint64_t sectors, uint32_t io_sectors,
+                               uint8_t *buf, uint64_t *busy_us) {
+  uint64_t idle_start = readbench_idle_us();
+  uint64_t start = sched_clock();
+  for (uint64_t lba = 0; lba < sectors; lba += io_sectors) {
+    uint32_t n = sectors - lba < io_sectors ? (uint32_t)(sectors - lba)
+                                            : io_sectors;
+    if (bcache_device_read(&main_disk, lba, n, buf) != DISK_ERR_NONE)
+      return 0;
+  }
+  uint64_t us = sched_clock_to_us(sched_clock() - start);
+  uint64_t idle_us = readbench_idle_us() - idle_start;
+  if (!us)
+    us = 1;
+  *busy_us = idle_us < us ? us - idle_us : 0;
+  return us;
+}
+
+// Lectura secuencial cruda del disco principal: throughput y CPU ocupada
+// por MiB. En un disco IDE con bus-master se mide por DMA y por PIO.
+static void cmd_diskbench(Terminal *term, int argc, char **argv) {
+  if (!disk_is_initialized(&main_disk)) {
+    terminal_puts(term, "diskbench: No disk\r\n");
+    return;
+  }
+  uint32_t mib = argc > 1 ? (uint32_t)atoi(argv[1]) : 16;
+  if (mib == 0 || mib > 1024)
+    mib = 16;
+  uint32_t io_kib = argc > 2 ? (uint32_t)atoi(argv[2]) : 64;
+  if (io_kib == 0 || io_kib > 1024)
+    io_kib = 64;
+
+  uint64_t sectors = (uint64_t)mib * 2048;
+  if (sectors > main_disk.sector_count)
+    sectors = main_disk.sector_count;
+  uint32_t io_sectors = io_kib * 2;
+  uint8_t *buf = (uint8_t *)kernel_malloc(io_kib * 1024);
+  if (!buf) {
+    terminal_puts(term, "diskbench: Out of memory\r\n");
+    return;
+  }
+  if (!sched_clock_mhz())
+    terminal_puts(term, "No TSC: times have timer tick resolution\r\n");
+
+  bool compare =
+      main_disk.type == DEVICE_TYPE_PATA_DISK && ide_dma_enabled();
+  static const char *const pass_names[2] = {"dma", "pio"};
+  for (int pass = 0; pass < (compare ? 2 : 1); pass++) {
+    if (compare)
+      ide_set_dma_enabled(pass == 0);
+    uint64_t busy_us = 0;
+    uint64_t us = diskbench_pass(sectors, io_sectors, buf, &busy_us);
+    if (!us) {
+      terminal_puts(term, "diskbench: Read failed\r\n");
+      break;
+    }
+    uint32_t kib = (uint32_t)(sectors / 2);
+    terminal_printf(term,
+                    "%s: %u KiB in %u KiB reads, %u ms, %u KiB/s, CPU busy "
+                    "%u%% (%u us per MiB)\r\n",
+                    compare ? pass_names[pass] : "read", kib, io_kib,
+                    (uint32_t)(us / 1000),
+                    (uint32_t)((uint64_t)kib * 1000000 / us),
+                    (uint32_t)(busy_us * 100 / us),
+                    kib >= 1024 ? (uint32_t)(busy_us * 1024 / kib) : 0);
+  }
+  if (compare)
+    ide_set_dma_enabled(true);
+  kernel_free(buf);
+}
+
 static void cmd_disk_info(Terminal *term, const char *args) {
   (void)args; // No se usan argumentos
 
@@ -2894,6 +3063,13 @@ void terminal_execute(Terminal *term, const char *cmd) {
     cmd_top(term);
   } else if (strcmp(command, "stack-debug") == 0) {
     cmd_stack_debug(term);
+  } else if (strcmp(command, "locks") == 0) {
+    if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+      spinlock_reset_stats();
+      terminal_puts(term, "Lock statistics reset\r\n");
+    } else {
+      spinlock_print_stats();
+    }
   } else if (strcmp(command, "modules") == 0) {
     cmd_list_modules(args);
   } else if (strcmp(command, "apic") == 0) {
@@ -3187,6 +3363,8 @@ void terminal_execute(Terminal *term, const char *cmd) {
   } else if (strcmp(command, "heaptest") == 0) {
     heap_test_results_t test_results = heap_run_exhaustive_tests();
     heap_print_test_results(&test_results, &main_terminal);
+  } else if (strcmp(command, "futextest") == 0) {
+    cmd_futextest();
   } else if (strcmp(command, "async_read") == 0) {
     cmd_async_read_test();
   } else if (strcmp(command, "async_write") == 0) {
@@ -3203,6 +3381,12 @@ void terminal_execute(Terminal *term, const char *cmd) {
     }
   } else if (strcmp(command, "lsblk") == 0) {
     cmd_lsblk();
+  } else if (strcmp(command, "iosched") == 0) {
+    disk_io_print_stats();
+  } else if (strcmp(command, "readbench") == 0) {
+    cmd_readbench(term, argc, argv);
+  } else if (strcmp(command, "diskbench") == 0) {
+    cmd_diskbench(term, argc, argv);
   } else if (strcmp(command, "format") == 0) {
     int result = fat32_format(&main_disk, "MYOS_DISK");
     if (result == VFS_OK) {
@@ -3214,9 +3398,33 @@ void terminal_execute(Terminal *term, const char *cmd) {
   } else if (strcmp(command, "cpuinfo") == 0) {
     if (argc > 1 && strcmp(argv[1], "detailed") == 0) {
       cmd_cpuinfo_detailed(term, "");
+    } else if (argc > 1 && strcmp(argv[1], "fpu") == 0) {
+      fpu_print_info();
     } else {
       cmd_cpuinfo(term, "");
     }
+  } else if (strcmp(command, "workqueue") == 0) {
+    workqueue_print_stats();
+  } else if (strcmp(command, "softirqs") == 0) {
+    softirq_print_stats();
+  } else if (strcmp(command, "timers") == 0) {
+    timer_print_stats();
+  } else if (strcmp(command, "latency") == 0) {
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+      latency_reset();
+      terminal_puts(term, "Latency maxima cleared\r\n");
+    } else {
+      latency_print_stats();
+    }
+  } else if (strcmp(command, "inputlat") == 0) {
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+      input_latency_reset();
+      terminal_puts(term, "Input latency samples cleared\r\n");
+    } else {
+      input_print_stats();
+    }
+  } else if (strcmp(command, "membench") == 0) {
+    memutils_benchmark();
   } else if (strcmp(command, "cpufreq") == 0) {
     // Asegurarse de que las interrupciones estén habilitadas
     __asm__ __volatile__("sti");
@@ -3300,6 +3508,12 @@ void terminal_execute(Terminal *term, const char *cmd) {
     } else {
       terminal_printf(term, "Task with ID %u not found\r\n", task_id);
     }
+  } else if (strcmp(command, "taskinfo") == 0) {
+    if (args[0] == '\0') {
+      terminal_puts(term, "Error: Usage: taskinfo <task_id>\r\n");
+      return;
+    }
+    cmd_task_info(term, atoi(args));
   } else if (strcmp(command, "yield") == 0) {
     terminal_puts(term, "Yielding CPU...\r\n");
     task_yield();
@@ -3384,6 +3598,8 @@ void terminal_execute(Terminal *term, const char *cmd) {
     terminal_puts(term, "  tasks              - List all tasks\r\n");
     terminal_puts(term, "  task_state              - List all tasks\r\n");
     terminal_puts(term, "  kill <id>          - Kill task by ID\r\n");
+    terminal_puts(term,
+                  "  taskinfo <id>      - Task details and latency histograms\r\n");
     terminal_puts(term, "  yield              - Yield CPU to other tasks\r\n");
     terminal_puts(
         term,
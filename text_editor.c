@@ -1,4 +1,5 @@
 #include "text_editor.h"
+#include "input.h"
 #include "irq.h"
 #include "kernel.h"
 #include "keyboard.h"
@@ -1533,22 +1534,28 @@ void editor_run(text_editor_t *editor) {
   uint32_t last_render = ticks_since_boot;
   uint32_t frame_time =
       5; // ~50ms entre frames (20 FPS es suficiente para un editor)
+  uint32_t seen_input = input_event_seq();
 
   while (editor->running) {
     uint32_t current_ticks = ticks_since_boot;
+    uint32_t input_seq = input_event_seq();
+    bool input_arrived = input_seq != seen_input;
+    seen_input = input_seq;
 
     // ✅ Solo redibujar si:
     // 1. Hay cambios (needs_redraw)
-    // 2. Ha pasado suficiente tiempo (evitar redibujado excesivo)
-    if (needs_redraw && (current_ticks - last_render >= frame_time)) {
+    // 2. Llegó una tecla (respuesta inmediata) o ha pasado suficiente
+    //    tiempo (evitar redibujado excesivo)
+    if (needs_redraw &&
+        (input_arrived || current_ticks - last_render >= frame_time)) {
       editor_render(editor);
       last_render = current_ticks;
       needs_redraw = false;
     }
 
-    // ✅ Sleep más largo para reducir uso de CPU
-    task_sleep(20); // 20ms entre checks
-    task_yield();
+    // Dormir hasta la próxima tecla, o 20ms para cambios que no vienen
+    // del teclado
+    input_wait(seen_input, 2);
   }
 
   // Limpiar al salir
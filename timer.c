@@ -0,0 +1,225 @@
+#include "timer.h"
+#include "irq.h"
+#include "kernel.h"
+#include "softirq.h"
+#include "spinlock.h"
+#include "terminal.h"
+#include "workqueue.h"
+
+// ========================================================================
+// ESTADO
+// ========================================================================
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+#define TIMER_MAX_TICKS 0x7FFFFFFFu // Comparaciones con int32_t
+
+static spinlock_t timer_lock = SPINLOCK_INIT("timer");
+static ktimer_t *timer_wheel[TIMER_WHEEL_SIZE];
+static uint32_t timer_clk = 0; // Último tick procesado por la rueda
+static uint32_t timer_count = 0;
+
+static uint32_t stat_added = 0;
+static uint32_t stat_fired = 0;
+
+static uint32_t timer_ns_to_ticks(uint64_t ns) {
+  uint64_t max_ns = (uint64_t)TIMER_MAX_TICKS * TIMER_NS_PER_TICK;
+  if (ns >= max_ns)
+    return TIMER_MAX_TICKS;
+  uint32_t ticks = (uint32_t)((ns + TIMER_NS_PER_TICK - 1) / TIMER_NS_PER_TICK);
+  return ticks ? ticks : 1;
+}
+
+// Enlazar en la ranura de 'expires'. Nunca antes del próximo tick que
+// procese la rueda, aunque el llamador vaya con retraso.
+static void timer_enqueue_locked(ktimer_t *timer, uint32_t expires) {
+  if ((int32_t)(expires - timer_clk) <= 0)
+    expires = timer_clk + 1;
+
+  ktimer_t **slot = &timer_wheel[expires & TIMER_WHEEL_MASK];
+  timer->expires = expires;
+  timer->prev = NULL;
+  timer->next = *slot;
+  if (*slot)
+    (*slot)->prev = timer;
+  *slot = timer;
+  timer->flags |= KTIMER_PENDING;
+  timer_count++;
+}
+
+static void timer_dequeue_locked(ktimer_t *timer) {
+  if (timer->prev)
+    timer->prev->next = timer->next;
+  else
+    timer_wheel[timer->expires & TIMER_WHEEL_MASK] = timer->next;
+  if (timer->next)
+    timer->next->prev = timer->prev;
+  timer->next = timer->prev = NULL;
+  timer->flags &= ~KTIMER_PENDING;
+  timer_count--;
+}
+
+// ========================================================================
+// API
+// ========================================================================
+
+void timers_init(void) {
+  uint32_t flags = spin_lock_irqsave(&timer_lock);
+  // Los timers armados antes (en el arranque) conservan su ranura: solo se
+  // fija el reloj si la rueda está vacía
+  if (timer_count == 0)
+    timer_clk = ticks_since_boot;
+  spin_unlock_irqrestore(&timer_lock, flags);
+
+  open_softirq(SOFTIRQ_TIMER, timer_softirq);
+}
+
+void ktimer_init(ktimer_t *timer, ktimer_func_t func, void *arg) {
+  if (!timer)
+    return;
+  timer->next = timer->prev = NULL;
+  timer->expires = 0;
+  timer->period_ticks = 0;
+  timer->func = func;
+  timer->arg = arg;
+  timer->flags = 0;
+}
+
+bool timer_add(ktimer_t *timer, uint64_t expires_ns) {
+  if (!timer || !timer->func)
+    return false;
+
+  uint32_t flags = spin_lock_irqsave(&timer_lock);
+  bool ok = !(timer->flags & KTIMER_PENDING);
+  if (ok) {
+    timer->period_ticks = 0;
+    timer_enqueue_locked(timer,
+                         ticks_since_boot + timer_ns_to_ticks(expires_ns));
+    stat_added++;
+  }
+  spin_unlock_irqrestore(&timer_lock, flags);
+  return ok;
+}
+
+bool timer_add_periodic(ktimer_t *timer, uint64_t period_ns) {
+  if (!timer || !timer->func)
+    return false;
+
+  uint32_t flags = spin_lock_irqsave(&timer_lock);
+  bool ok = !(timer->flags & KTIMER_PENDING);
+  if (ok) {
+    timer->period_ticks = timer_ns_to_ticks(period_ns);
+    timer_enqueue_locked(timer, ticks_since_boot + timer->period_ticks);
+    stat_added++;
+  }
+  spin_unlock_irqrestore(&timer_lock, flags);
+  return ok;
+}
+
+bool timer_mod(ktimer_t *timer, uint64_t expires_ns) {
+  if (!timer || !timer->func)
+    return false;
+
+  uint32_t flags = spin_lock_irqsave(&timer_lock);
+  bool was_pending = (timer->flags & KTIMER_PENDING) != 0;
+  if (was_pending)
+    timer_dequeue_locked(timer);
+  timer_enqueue_locked(timer, ticks_since_boot + timer_ns_to_ticks(expires_ns));
+  stat_added++;
+  spin_unlock_irqrestore(&timer_lock, flags);
+  return was_pending;
+}
+
+bool timer_del(ktimer_t *timer) {
+  if (!timer)
+    return false;
+
+  uint32_t flags = spin_lock_irqsave(&timer_lock);
+  bool was_pending = (timer->flags & KTIMER_PENDING) != 0;
+  if (was_pending)
+    timer_dequeue_locked(timer);
+  spin_unlock_irqrestore(&timer_lock, flags);
+  return was_pending;
+}
+
+bool timer_pending(const ktimer_t *timer) {
+  return timer && (timer->flags & KTIMER_PENDING);
+}
+
+// ========================================================================
+// SOFTIRQ
+// ========================================================================
+
+void timer_softirq(void) {
+  uint32_t flags = spin_lock_irqsave(&timer_lock);
+
+  // Avanzar tick a tick: si el softirq se retrasó, se procesan todas las
+  // ranuras intermedias en orden
+  while ((int32_t)(ticks_since_boot - timer_clk) > 0) {
+    uint32_t tick = timer_clk + 1;
+    if (timer_count == 0) {
+      timer_clk = ticks_since_boot;
+      break;
+    }
+
+    // Una ranura mezcla vueltas de la rueda: solo vencen los de este tick
+    ktimer_t *timer = timer_wheel[tick & TIMER_WHEEL_MASK];
+    while (timer && (int32_t)(timer->expires - tick) > 0)
+      timer = timer->next;
+    if (!timer) {
+      timer_clk = tick;
+      continue;
+    }
+
+    timer_dequeue_locked(timer);
+    if (timer->period_ticks) {
+      // Sin deriva; si se perdieron periodos no se recuperan en ráfaga
+      uint32_t next = timer->expires + timer->period_ticks;
+      if ((int32_t)(next - tick) <= 0)
+        next = tick + timer->period_ticks;
+      timer_enqueue_locked(timer, next);
+    }
+    ktimer_func_t func = timer->func;
+    void *arg = timer->arg;
+    stat_fired++;
+
+    // El callback puede rearmar o borrar timers (incluido el suyo)
+    spin_unlock_irqrestore(&timer_lock, flags);
+    func(arg);
+    flags = spin_lock_irqsave(&timer_lock);
+  }
+
+  spin_unlock_irqrestore(&timer_lock, flags);
+
+  // Los diferidos de la workqueue comparten el softirq
+  workqueue_timer_tick();
+}
+
+// ========================================================================
+// ESTADÍSTICAS
+// ========================================================================
+
+void timer_print_stats(void) {
+  uint32_t flags = spin_lock_irqsave(&timer_lock);
+  uint32_t pending = timer_count;
+  uint32_t used_slots = 0;
+  uint32_t max_depth = 0;
+  for (uint32_t i = 0; i < TIMER_WHEEL_SIZE; i++) {
+    uint32_t depth = 0;
+    for (ktimer_t *t = timer_wheel[i]; t; t = t->next)
+      depth++;
+    if (depth)
+      used_slots++;
+    if (depth > max_depth)
+      max_depth = depth;
+  }
+  uint32_t clk = timer_clk;
+  spin_unlock_irqrestore(&timer_lock, flags);
+
+  terminal_puts(&main_terminal, "\r\n=== Kernel timers ===\r\n");
+  terminal_printf(&main_terminal,
+                  "Pending: %u  Added: %u  Fired: %u  Wheel clock: %u "
+                  "(lag %u ticks)\r\n",
+                  pending, stat_added, stat_fired, clk, ticks_since_boot - clk);
+  terminal_printf(&main_terminal, "Slots in use: %u/%u  Deepest slot: %u\r\n",
+                  used_slots, TIMER_WHEEL_SIZE, max_depth);
+}
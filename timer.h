@@ -0,0 +1,75 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ========================================================================
+// TIMERS DEL KERNEL (ONE-SHOT Y PERIÓDICOS)
+// ========================================================================
+//
+// En lugar de sondear ticks_since_boot en bucle, quien necesita un timeout
+// arma un ktimer_t y recibe la llamada cuando vence. Los timers viven en
+// una rueda de TIMER_WHEEL_SIZE ranuras indexada por el tick de
+// vencimiento (insertar y borrar son O(1)); el softirq TIMER avanza la
+// rueda tick a tick y ejecuta los vencidos.
+//
+// Los callbacks corren en contexto de softirq: IRQs habilitadas pero sin
+// poder dormir ni tomar locks que cedan la CPU (p.ej. el de la pila de
+// red). Para trabajo pesado, el callback encola un work_t.
+
+#define TIMER_WHEEL_SIZE 256 // Potencia de 2
+#define TIMER_NS_PER_TICK 10000000ull // PIT a 100 Hz
+
+#define TIMER_NS_PER_MS 1000000ull
+#define TIMER_MS(ms) ((uint64_t)(ms) * TIMER_NS_PER_MS)
+
+typedef void (*ktimer_func_t)(void *arg);
+
+// Flags de ktimer_t
+#define KTIMER_PENDING 0x01 // En la rueda esperando su tick
+
+// Va embebido en la estructura del subsistema (sin reservas, válido desde
+// IRQ). Inicializar con ktimer_init() o KTIMER_INIT antes de armarlo.
+typedef struct ktimer {
+  struct ktimer *next;
+  struct ktimer *prev;
+  uint32_t expires;      // Tick de vencimiento
+  uint32_t period_ticks; // 0 = one-shot
+  ktimer_func_t func;
+  void *arg;
+  volatile uint32_t flags;
+} ktimer_t;
+
+#define KTIMER_INIT(fn, a) {NULL, NULL, 0, 0, fn, a, 0}
+
+// Registra el softirq TIMER (que además avanza los diferidos de la
+// workqueue). Llamar antes de armar timers.
+void timers_init(void);
+
+void ktimer_init(ktimer_t *timer, ktimer_func_t func, void *arg);
+
+// Arma un timer one-shot que vence dentro de 'expires_ns' (se redondea al
+// tick siguiente). Devuelve false si ya estaba armado.
+bool timer_add(ktimer_t *timer, uint64_t expires_ns);
+
+// Arma un timer periódico: vence cada 'period_ns' hasta timer_del()
+bool timer_add_periodic(ktimer_t *timer, uint64_t period_ns);
+
+// Rearma (o arma) el timer para dentro de 'expires_ns', conservando su
+// periodo. Devuelve true si estaba armado.
+bool timer_mod(ktimer_t *timer, uint64_t expires_ns);
+
+// Desarma el timer. Devuelve true si estaba armado. No espera a un
+// callback que ya esté ejecutándose.
+bool timer_del(ktimer_t *timer);
+
+bool timer_pending(const ktimer_t *timer);
+
+// Softirq TIMER: ejecuta los timers vencidos hasta el tick actual
+void timer_softirq(void);
+
+void timer_print_stats(void);
+
+#endif // TIMER_H
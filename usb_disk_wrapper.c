@@ -100,6 +100,47 @@ uint32_t usb_disk_get_count(void) {
 // DISK OPERATIONS
 // ========================================================================
 
+#define USB_DISK_MAX_BLOCKS_PER_CMD 256
+
+uint32_t usb_disk_block_size(disk_t* disk) {
+    if (!disk_is_usb(disk)) return 0;
+    usb_msc_device_t* msc = usb_msc_get_device(disk->drive_number - USB_DISK_BASE_ID);
+    return (msc && msc->initialized) ? msc->block_size : 0;
+}
+
+// Native blocks straight into/from the caller's buffer ('ctx' is the device)
+static disk_err_t usb_disk_block_read(void* ctx, uint32_t block, uint32_t count, void* buffer) {
+    usb_msc_device_t* msc = (usb_msc_device_t*)ctx;
+    uint8_t* buf = (uint8_t*)buffer;
+    while (count) {
+        uint32_t chunk = count > USB_DISK_MAX_BLOCKS_PER_CMD ? USB_DISK_MAX_BLOCKS_PER_CMD : count;
+        if (!usb_msc_read_blocks(msc, block, chunk, buf)) {
+            terminal_printf(&main_terminal, "USB disk read failed at block %u\r\n", block);
+            return DISK_ERR_ATA;
+        }
+        block += chunk;
+        count -= chunk;
+        buf += chunk * msc->block_size;
+    }
+    return DISK_ERR_NONE;
+}
+
+static disk_err_t usb_disk_block_write(void* ctx, uint32_t block, uint32_t count, const void* buffer) {
+    usb_msc_device_t* msc = (usb_msc_device_t*)ctx;
+    const uint8_t* buf = (const uint8_t*)buffer;
+    while (count) {
+        uint32_t chunk = count > USB_DISK_MAX_BLOCKS_PER_CMD ? USB_DISK_MAX_BLOCKS_PER_CMD : count;
+        if (!usb_msc_write_blocks(msc, block, chunk, buf)) {
+            terminal_printf(&main_terminal, "USB disk write failed at block %u\r\n", block);
+            return DISK_ERR_ATA;
+        }
+        block += chunk;
+        count -= chunk;
+        buf += chunk * msc->block_size;
+    }
+    return DISK_ERR_NONE;
+}
+
 disk_err_t usb_disk_read(disk_t* disk, uint64_t lba, uint32_t count, void* buffer) {
     if (!disk || !disk->initialized || !buffer) {
         return DISK_ERR_INVALID_PARAM;
@@ -124,7 +165,7 @@ disk_err_t usb_disk_read(disk_t* disk, uint64_t lba, uint32_t count, void* buffe
         // Direct 1:1 mapping
         while (sectors_read < count) {
             uint32_t chunk = count - sectors_read;
-            if (chunk > 256) chunk = 256;
+            if (chunk > USB_DISK_MAX_BLOCKS_PER_CMD) chunk = USB_DISK_MAX_BLOCKS_PER_CMD;
             
             if (!usb_msc_read_blocks(msc, lba + sectors_read, chunk, buf)) {
                 terminal_printf(&main_terminal, "USB disk read failed at LBA %llu\r\n", 
@@ -136,27 +177,13 @@ disk_err_t usb_disk_read(disk_t* disk, uint64_t lba, uint32_t count, void* buffe
             buf += chunk * 512;
             for (volatile int i = 0; i < 10000; i++);
         }
-    } else if (msc->block_size == 4096) {
-        // 4K native - 8 sectors per block
-        uint32_t start_block = lba / 8;
-        uint32_t end_block = (lba + count - 1) / 8;
-        uint32_t total_blocks = end_block - start_block + 1;
-        
-        // Allocate temporary buffer for aligned reads
-        uint8_t* temp = (uint8_t*)kernel_malloc(total_blocks * 4096);
-        if (!temp) return DISK_ERR_ATA;
-        
-        if (!usb_msc_read_blocks(msc, start_block, total_blocks, temp)) {
-            kernel_free(temp);
-            return DISK_ERR_ATA;
-        }
-        
-        // Copy relevant data
-        uint32_t offset = (lba % 8) * 512;
-        memcpy(buffer, temp + offset, count * 512);
-        kernel_free(temp);
+    } else if (disk_native_sectors(disk) > 1) {
+        // 2K/4K native: whole blocks go straight into the caller's buffer,
+        // only partial edge blocks are bounced
+        return disk_read_native(disk_native_sectors(disk), lba, count, buffer,
+                                usb_disk_block_read, msc);
     } else {
-        // Generic handling
+        // Generic handling (block sizes larger than the edge buffer)
         uint32_t sectors_per_block = msc->block_size / 512;
         uint32_t start_block = lba / sectors_per_block;
         uint32_t end_block = (lba + count - 1) / sectors_per_block;
@@ -194,13 +221,21 @@ disk_err_t usb_disk_write(disk_t* disk, uint64_t lba, uint32_t count, const void
         return DISK_ERR_NOT_INITIALIZED;
     }
     
+    if (msc->block_size != 512) {
+        // Partial blocks are read-modify-written
+        uint32_t native = disk_native_sectors(disk);
+        if (native <= 1) return DISK_ERR_INVALID_PARAM;
+        return disk_write_native(native, lba, count, buffer,
+                                 usb_disk_block_read, usb_disk_block_write, msc);
+    }
+    
     // Write in chunks
     uint32_t sectors_written = 0;
     const uint8_t* buf = (const uint8_t*)buffer;
     
     while (sectors_written < count) {
         uint32_t chunk = count - sectors_written;
-        if (chunk > 256) chunk = 256;  // Write max 256 sectors at a time
+        if (chunk > USB_DISK_MAX_BLOCKS_PER_CMD) chunk = USB_DISK_MAX_BLOCKS_PER_CMD;
         
         if (!usb_msc_write_blocks(msc, lba + sectors_written, chunk, buf)) {
             terminal_printf(&main_terminal, "USB disk write failed at LBA %llu\r\n",
@@ -230,6 +265,27 @@ disk_err_t usb_disk_flush(disk_t* disk) {
     return DISK_ERR_NONE;
 }
 
+// ========================================================================
+// BLOCK DRIVER
+// ========================================================================
+
+static disk_err_t usb_block_submit(disk_t* disk, disk_op_t op, uint64_t lba, uint32_t count, void* buffer) {
+    return op == DISK_OP_READ ? usb_disk_read(disk, lba, count, buffer)
+                              : usb_disk_write(disk, lba, count, buffer);
+}
+
+// One command at a time, USB_DISK_MAX_BLOCKS_PER_CMD native blocks each
+static void usb_block_limits(disk_t* disk, block_queue_limits_t* limits) {
+    uint32_t block_size = usb_disk_block_size(disk);
+    if (block_size < SECTOR_SIZE) return;
+    limits->physical_block_size = block_size;
+    limits->max_transfer_sectors = USB_DISK_MAX_BLOCKS_PER_CMD * (block_size / SECTOR_SIZE);
+}
+
+const block_device_ops_t usb_block_ops = {
+    "usb", disk_is_usb, usb_block_submit, usb_disk_flush, usb_block_limits
+};
+
 bool disk_is_usb(disk_t* disk) {
     return disk && disk->type == DEVICE_TYPE_USB_DISK && 
            disk->drive_number >= USB_DISK_BASE_ID &&
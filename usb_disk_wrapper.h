@@ -24,6 +24,12 @@ disk_err_t usb_disk_read(disk_t* disk, uint64_t lba, uint32_t count, void* buffe
 disk_err_t usb_disk_write(disk_t* disk, uint64_t lba, uint32_t count, const void* buffer);
 disk_err_t usb_disk_flush(disk_t* disk);
 
+// Native block size in bytes (0 if the disk is not a ready USB disk)
+uint32_t usb_disk_block_size(disk_t* disk);
+
+// Block driver for the disk registry (see disk.h)
+extern const block_device_ops_t usb_block_ops;
+
 // Helper to check if a disk_t is a USB disk
 bool disk_is_usb(disk_t* disk);
 
@@ -6,6 +6,7 @@
 #include "terminal.h"
 #include <stdint.h>
 
+#include "spinlock.h"
 #include "task.h"
 
 /* Usar tus allocators */
@@ -21,6 +22,9 @@ static int fs_count = 0;
 vfs_mount_info_t *mount_list = NULL;
 int mount_count = 0;
 
+/* Protege fs_table, mount_list y mount_count */
+static spinlock_t vfs_mount_lock = SPINLOCK_INIT("vfs_mount");
+
 /* Global FD table REMOVED (now in task_t) */
 
 /* Helpers for allocation */
@@ -120,19 +124,19 @@ int vfs_normalize_path(const char *input, char *output, size_t output_size) {
 int vfs_register_fs(const vfs_fs_type_t *fs) {
   if (!fs)
     return VFS_ERR;
-  unsigned int f = vfs_lock_disable_irq();
+  uint32_t f = spin_lock_irqsave(&vfs_mount_lock);
   if (fs_count >= VFS_MAX_FS_TYPES) {
-    vfs_unlock_restore_irq(f);
+    spin_unlock_irqrestore(&vfs_mount_lock, f);
     return VFS_ERR;
   }
   fs_table[fs_count++] = *fs;
-  vfs_unlock_restore_irq(f);
+  spin_unlock_irqrestore(&vfs_mount_lock, f);
   return VFS_OK;
 }
 
 /* Init */
 void vfs_init(void) {
-  unsigned int f = vfs_lock_disable_irq();
+  uint32_t f = spin_lock_irqsave(&vfs_mount_lock);
   fs_count = 0;
   mount_count = 0;
 
@@ -149,7 +153,7 @@ void vfs_init(void) {
   }
   mount_list = NULL;
 
-  vfs_unlock_restore_irq(f);
+  spin_unlock_irqrestore(&vfs_mount_lock, f);
 }
 
 /* find fs by name */
@@ -205,7 +209,7 @@ vfs_superblock_t *find_mount_for_path(const char *path,
     return NULL;
   }
 
-  unsigned int f = vfs_lock_disable_irq();
+  uint32_t f = spin_lock_irqsave(&vfs_mount_lock);
 
   vfs_superblock_t *best_sb = NULL;
   int best_len = -1;
@@ -253,7 +257,7 @@ vfs_superblock_t *find_mount_for_path(const char *path,
   if (!best_sb) {
     terminal_printf(&main_terminal, "VFS: No mount found for path %s\r\n",
                     normalized);
-    vfs_unlock_restore_irq(f);
+    spin_unlock_irqrestore(&vfs_mount_lock, f);
     return NULL;
   }
 
@@ -261,7 +265,7 @@ vfs_superblock_t *find_mount_for_path(const char *path,
                 best_mountpoint, normalized, best_sb->fs_name); */
 
   *out_relpath = best_relpath;
-  vfs_unlock_restore_irq(f);
+  spin_unlock_irqrestore(&vfs_mount_lock, f);
   return best_sb;
 }
 
@@ -273,19 +277,19 @@ int vfs_mount(const char *mountpoint, const char *fsname, void *device) {
   terminal_printf(&main_terminal, "VFS: Mount attempt %s on %s...\n", fsname,
                   mountpoint);
 
-  unsigned int f = vfs_lock_disable_irq();
+  uint32_t f = spin_lock_irqsave(&vfs_mount_lock);
 
   // Check if mount point is already mounted
   vfs_mount_info_t *current = mount_list;
   while (current) {
     if (strcmp(current->mountpoint, mountpoint) == 0) {
-      vfs_unlock_restore_irq(f);
+      spin_unlock_irqrestore(&vfs_mount_lock, f);
       return VFS_ERR; // Already mounted
     }
     current = current->next;
   }
 
-  vfs_unlock_restore_irq(f);
+  spin_unlock_irqrestore(&vfs_mount_lock, f);
 
   // **NUEVO: Verificar si ya hay un mount para este dispositivo**
   // **PERO SOLO SI device NO ES NULL (tmpfs tiene device = NULL)**
@@ -449,11 +453,11 @@ int vfs_mount(const char *mountpoint, const char *fsname, void *device) {
   }
 
   // Agregar a lista
-  f = vfs_lock_disable_irq();
+  f = spin_lock_irqsave(&vfs_mount_lock);
   mount_info->next = mount_list;
   mount_list = mount_info;
   mount_count++;
-  vfs_unlock_restore_irq(f);
+  spin_unlock_irqrestore(&vfs_mount_lock, f);
 
   terminal_printf(
       &main_terminal, "VFS: Mounted %s at %s (refcount: %u, device: %s)\r\n",
@@ -557,17 +561,42 @@ int vfs_list_mounts(void (*callback)(const char *mountpoint,
   if (!callback)
     return VFS_ERR;
 
-  unsigned int f = vfs_lock_disable_irq();
-  int count = 0;
+  // El callback puede desmontar (p.ej. en shutdown), así que no se le
+  // puede llamar con el lock tomado: copiamos la lista y la recorremos fuera
+  typedef struct {
+    char mountpoint[VFS_PATH_MAX];
+    char fs_name[16];
+  } mount_snapshot_t;
+
+  uint32_t f = spin_lock_irqsave(&vfs_mount_lock);
+  int total = mount_count;
+  spin_unlock_irqrestore(&vfs_mount_lock, f);
+  if (total <= 0)
+    return 0;
+
+  mount_snapshot_t *snap =
+      (mount_snapshot_t *)vfs_alloc(sizeof(mount_snapshot_t) * total);
+  if (!snap)
+    return VFS_ERR;
 
+  int count = 0;
+  f = spin_lock_irqsave(&vfs_mount_lock);
   vfs_mount_info_t *current = mount_list;
-  while (current) {
-    callback(current->mountpoint, current->sb->fs_name, arg);
+  while (current && count < total) {
+    strncpy(snap[count].mountpoint, current->mountpoint, VFS_PATH_MAX - 1);
+    snap[count].mountpoint[VFS_PATH_MAX - 1] = '\0';
+    strncpy(snap[count].fs_name, current->sb->fs_name,
+            sizeof(snap[count].fs_name) - 1);
+    snap[count].fs_name[sizeof(snap[count].fs_name) - 1] = '\0';
     count++;
     current = current->next;
   }
+  spin_unlock_irqrestore(&vfs_mount_lock, f);
+
+  for (int i = 0; i < count; i++)
+    callback(snap[i].mountpoint, snap[i].fs_name, arg);
 
-  vfs_unlock_restore_irq(f);
+  vfs_free(snap);
   return count;
 }
 
@@ -958,7 +987,7 @@ int vfs_unmount(const char *mountpoint) {
   }
 
   // Buscar el mountpoint en la lista
-  unsigned int f = vfs_lock_disable_irq();
+  uint32_t f = spin_lock_irqsave(&vfs_mount_lock);
   vfs_mount_info_t *prev = NULL;
   vfs_mount_info_t *current = mount_list;
   vfs_mount_info_t *found_info = NULL;
@@ -971,7 +1000,7 @@ int vfs_unmount(const char *mountpoint) {
     prev = current;
     current = current->next;
   }
-  vfs_unlock_restore_irq(f);
+  spin_unlock_irqrestore(&vfs_mount_lock, f);
 
   if (!found_info) {
     terminal_printf(&main_terminal,
@@ -1059,14 +1088,14 @@ int vfs_unmount(const char *mountpoint) {
   }
 
   // ✅ Limpiar tabla de mounts
-  f = vfs_lock_disable_irq();
+  f = spin_lock_irqsave(&vfs_mount_lock);
   if (prev) {
     prev->next = found_info->next;
   } else {
     mount_list = found_info->next;
   }
   mount_count--;
-  vfs_unlock_restore_irq(f);
+  spin_unlock_irqrestore(&vfs_mount_lock, f);
 
   // Liberar mount_info
   vfs_free(found_info);
@@ -1357,11 +1386,11 @@ int vfs_bind_mount(const char *source, const char *target, int recursive) {
   mount_info->flags = bind_sb->flags;
 
   // Agregar a lista de montajes
-  unsigned int f = vfs_lock_disable_irq();
+  uint32_t f = spin_lock_irqsave(&vfs_mount_lock);
   mount_info->next = mount_list;
   mount_list = mount_info;
   mount_count++;
-  vfs_unlock_restore_irq(f);
+  spin_unlock_irqrestore(&vfs_mount_lock, f);
 
   terminal_printf(&main_terminal, "✓ Bind mount created: %s -> %s\r\n",
                   norm_source, norm_target);
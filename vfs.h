@@ -65,16 +65,6 @@ typedef struct vfs_node {
 
 typedef enum { VFS_DEV_BLOCK = 1, VFS_DEV_CHAR = 2 } vfs_dev_type_t;
 
-/* Nota: esto protege en kernels uniprocesador con preemptive IRQs. */
-static inline unsigned int vfs_lock_disable_irq(void) {
-  unsigned int flags;
-  __asm__ __volatile__("pushf\n\tcli\n\tpop %0" : "=r"(flags));
-  return flags;
-}
-static inline void vfs_unlock_restore_irq(unsigned int flags) {
-  __asm__ __volatile__("push %0\n\tpopf" : : "r"(flags));
-}
-
 /* Dirent structure - EXTENDIDO */
 typedef struct vfs_dirent {
   char name[VFS_NAME_MAX];
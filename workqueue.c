@@ -0,0 +1,447 @@
+#include "workqueue.h"
+#include "irq.h"
+#include "kernel.h"
+#include "log.h"
+#include "softirq.h"
+#include "spinlock.h"
+#include "task.h"
+#include "terminal.h"
+
+// ========================================================================
+// ESTRUCTURAS INTERNAS
+// ========================================================================
+
+typedef struct worker {
+  task_t *task;
+  spinlock_t lock; // Protege ring/head/tail
+  work_t *ring[WORKQUEUE_DEQUE_SIZE];
+  uint32_t head; // Siguiente a robar (FIFO)
+  uint32_t tail; // Siguiente hueco del dueño (LIFO)
+  work_t *running; // Work propio (no del pool) en ejecución
+  uint32_t executed;
+  uint32_t stolen;
+} worker_t;
+
+static worker_t workers[WORKQUEUE_MAX_WORKERS];
+static uint32_t nr_workers = 0;
+static uint32_t next_target = 0; // Reparto round-robin desde fuera del pool
+static bool wq_running = false;
+
+// Lock del pool: contador de pendientes, workers dormidos, lista de
+// diferidos y pool de items. Orden: pool_lock -> worker.lock -> scheduler
+static spinlock_t pool_lock = SPINLOCK_INIT("workqueue");
+static wait_queue_t pool_idle = WAIT_QUEUE_INIT("wq_idle");
+// cancel_work_sync espera aquí a que un work deje de ejecutarse
+static wait_queue_t work_done = WAIT_QUEUE_INIT("wq_done");
+static uint32_t pool_pending = 0;
+
+static work_t *delayed_head = NULL;
+static uint32_t delayed_next_due = 0;
+
+static work_t pool_items[WORKQUEUE_POOL_ITEMS];
+static work_t *pool_free = NULL;
+
+static uint32_t stat_queued = 0;
+static uint32_t stat_dropped = 0;
+
+// ========================================================================
+// DEQUES
+// ========================================================================
+
+static bool deque_push(worker_t *w, work_t *work) {
+  uint32_t flags = spin_lock_irqsave(&w->lock);
+  if (w->tail - w->head >= WORKQUEUE_DEQUE_SIZE) {
+    spin_unlock_irqrestore(&w->lock, flags);
+    return false;
+  }
+  w->ring[w->tail & (WORKQUEUE_DEQUE_SIZE - 1)] = work;
+  w->tail++;
+  spin_unlock_irqrestore(&w->lock, flags);
+  return true;
+}
+
+// El dueño saca lo último que metió
+static work_t *deque_pop(worker_t *w) {
+  work_t *work = NULL;
+  uint32_t flags = spin_lock_irqsave(&w->lock);
+  if (w->tail != w->head) {
+    w->tail--;
+    work = w->ring[w->tail & (WORKQUEUE_DEQUE_SIZE - 1)];
+  }
+  spin_unlock_irqrestore(&w->lock, flags);
+  return work;
+}
+
+// Los ladrones se llevan lo más antiguo
+static work_t *deque_steal(worker_t *w) {
+  work_t *work = NULL;
+  uint32_t flags = spin_lock_irqsave(&w->lock);
+  if (w->tail != w->head) {
+    work = w->ring[w->head & (WORKQUEUE_DEQUE_SIZE - 1)];
+    w->head++;
+  }
+  spin_unlock_irqrestore(&w->lock, flags);
+  return work;
+}
+
+// Saca 'work' de en medio del deque, corriendo los posteriores un hueco
+static bool deque_remove(worker_t *w, work_t *work) {
+  bool found = false;
+  uint32_t flags = spin_lock_irqsave(&w->lock);
+  for (uint32_t i = w->head; i != w->tail; i++) {
+    if (w->ring[i & (WORKQUEUE_DEQUE_SIZE - 1)] != work)
+      continue;
+    for (; i + 1 != w->tail; i++)
+      w->ring[i & (WORKQUEUE_DEQUE_SIZE - 1)] =
+          w->ring[(i + 1) & (WORKQUEUE_DEQUE_SIZE - 1)];
+    w->tail--;
+    found = true;
+    break;
+  }
+  spin_unlock_irqrestore(&w->lock, flags);
+  return found;
+}
+
+static worker_t *worker_self(void) {
+  task_t *current = task_current();
+  for (uint32_t i = 0; i < nr_workers; i++) {
+    if (workers[i].task == current)
+      return &workers[i];
+  }
+  return NULL;
+}
+
+// Llamar con pool_lock tomado. Prefiere el deque del worker actual (si el
+// trabajo lo genera otro trabajo) y si no reparte en round-robin.
+static bool workqueue_enqueue_locked(work_t *work) {
+  if (nr_workers == 0)
+    return false;
+
+  worker_t *self = worker_self();
+  if (self && deque_push(self, work))
+    goto queued;
+
+  for (uint32_t i = 0; i < nr_workers; i++) {
+    worker_t *w = &workers[next_target++ % nr_workers];
+    if (deque_push(w, work))
+      goto queued;
+  }
+  stat_dropped++;
+  return false;
+
+queued:
+  work->flags |= WORK_PENDING;
+  pool_pending++;
+  stat_queued++;
+  wait_queue_wake_one(&pool_idle);
+  return true;
+}
+
+// ========================================================================
+// WORKERS
+// ========================================================================
+
+static work_t *worker_find_work(worker_t *self) {
+  work_t *work = deque_pop(self);
+  if (work)
+    return work;
+
+  // Nada propio: robar empezando por el siguiente worker
+  uint32_t index = (uint32_t)(self - workers);
+  for (uint32_t i = 1; i < nr_workers; i++) {
+    work = deque_steal(&workers[(index + i) % nr_workers]);
+    if (work) {
+      self->stolen++;
+      return work;
+    }
+  }
+  return NULL;
+}
+
+static void worker_run(worker_t *self, work_t *work) {
+  uint32_t flags = spin_lock_irqsave(&pool_lock);
+  pool_pending--;
+
+  // Se copia antes de ejecutar: el trabajo puede volver a encolarse a sí
+  // mismo, y los items del pool se reciclan ya
+  work_func_t func = work->func;
+  void *arg = work->arg;
+  work->flags &= ~WORK_PENDING;
+  bool pooled = (work->flags & WORK_POOLED) != 0;
+  if (pooled) {
+    work->flags = 0;
+    work->next = pool_free;
+    pool_free = work;
+  } else {
+    // cancel_work_sync espera a que se limpie
+    work->flags |= WORK_RUNNING;
+    self->running = work;
+  }
+  spin_unlock_irqrestore(&pool_lock, flags);
+
+  if (func)
+    func(arg);
+  self->executed++;
+
+  if (!pooled) {
+    flags = spin_lock_irqsave(&pool_lock);
+    work->flags &= ~WORK_RUNNING;
+    self->running = NULL;
+    wait_queue_wake_all(&work_done);
+    spin_unlock_irqrestore(&pool_lock, flags);
+  }
+}
+
+static void worker_main(void *arg) {
+  worker_t *self = (worker_t *)arg;
+
+  while (1) {
+    work_t *work = worker_find_work(self);
+    if (work) {
+      worker_run(self, work);
+      continue;
+    }
+
+    // Dormir hasta que alguien encole (el contador se mira bajo pool_lock,
+    // el mismo que toma quien encola antes de despertar)
+    uint32_t flags = spin_lock_irqsave(&pool_lock);
+    while (pool_pending == 0)
+      wait_queue_sleep(&pool_idle, &pool_lock, 0);
+    spin_unlock_irqrestore(&pool_lock, flags);
+  }
+}
+
+// ========================================================================
+// API
+// ========================================================================
+
+void work_init(work_t *work, work_func_t func, void *arg) {
+  if (!work)
+    return;
+  work->func = func;
+  work->arg = arg;
+  work->flags = 0;
+  work->due_tick = 0;
+  work->next = NULL;
+}
+
+void workqueue_init(void) {
+  if (wq_running)
+    return;
+
+  pool_free = NULL;
+  for (int i = WORKQUEUE_POOL_ITEMS - 1; i >= 0; i--) {
+    pool_items[i].flags = 0;
+    pool_items[i].next = pool_free;
+    pool_free = &pool_items[i];
+  }
+
+  for (uint32_t i = 0; i < WORKQUEUE_DEFAULT_WORKERS; i++) {
+    worker_t *w = &workers[i];
+    spinlock_init(&w->lock, "wq_worker");
+    w->head = w->tail = 0;
+    w->executed = w->stolen = 0;
+
+    char name[16] = "kworker/0";
+    name[8] = (char)('0' + i);
+    w->task = task_create(name, worker_main, w, TASK_PRIORITY_NORMAL);
+    if (!w->task) {
+      log_message(LOG_ERROR, "[WQ] Failed to create %s\r\n", name);
+      break;
+    }
+    // Los workers ejecutan bottom halves: clase RT, por delante de las
+    // tareas normales
+    task_set_sched_class(w->task, SCHED_CLASS_RT);
+    nr_workers++;
+  }
+
+  wq_running = nr_workers > 0;
+  log_message(LOG_INFO, "[WQ] Workqueue initialized with %u workers\r\n",
+              nr_workers);
+}
+
+bool workqueue_running(void) { return wq_running; }
+
+bool workqueue_in_worker(void) { return worker_self() != NULL; }
+
+bool queue_work(work_func_t func, void *arg) {
+  if (!func || !wq_running)
+    return false;
+
+  uint32_t flags = spin_lock_irqsave(&pool_lock);
+  work_t *work = pool_free;
+  if (!work) {
+    stat_dropped++;
+    spin_unlock_irqrestore(&pool_lock, flags);
+    return false;
+  }
+  pool_free = work->next;
+  work->func = func;
+  work->arg = arg;
+  work->flags = WORK_POOLED;
+  work->next = NULL;
+
+  bool ok = workqueue_enqueue_locked(work);
+  if (!ok) {
+    work->flags = 0;
+    work->next = pool_free;
+    pool_free = work;
+  }
+  spin_unlock_irqrestore(&pool_lock, flags);
+  return ok;
+}
+
+bool queue_work_item(work_t *work) {
+  if (!work || !work->func || !wq_running)
+    return false;
+
+  uint32_t flags = spin_lock_irqsave(&pool_lock);
+  bool ok = false;
+  if (!(work->flags & (WORK_PENDING | WORK_DELAYED)))
+    ok = workqueue_enqueue_locked(work);
+  spin_unlock_irqrestore(&pool_lock, flags);
+  return ok;
+}
+
+bool queue_delayed_work(work_t *work, uint32_t delay_ms) {
+  if (!work || !work->func || !wq_running)
+    return false;
+
+  uint32_t ticks = (delay_ms + 9) / 10; // PIT a 100 Hz
+  if (ticks == 0)
+    return queue_work_item(work);
+
+  uint32_t flags = spin_lock_irqsave(&pool_lock);
+  if (work->flags & (WORK_PENDING | WORK_DELAYED)) {
+    spin_unlock_irqrestore(&pool_lock, flags);
+    return false;
+  }
+
+  work->due_tick = ticks_since_boot + ticks;
+  work->flags |= WORK_DELAYED;
+  work->next = delayed_head;
+  if (!delayed_head || (int32_t)(work->due_tick - delayed_next_due) < 0)
+    delayed_next_due = work->due_tick;
+  delayed_head = work;
+  spin_unlock_irqrestore(&pool_lock, flags);
+  return true;
+}
+
+bool cancel_delayed_work(work_t *work) {
+  if (!work)
+    return false;
+
+  uint32_t flags = spin_lock_irqsave(&pool_lock);
+  bool removed = false;
+  if (work->flags & WORK_DELAYED) {
+    work_t **link = &delayed_head;
+    while (*link && *link != work)
+      link = &(*link)->next;
+    if (*link) {
+      *link = work->next;
+      work->next = NULL;
+      work->flags &= ~WORK_DELAYED;
+      removed = true;
+    }
+  }
+  spin_unlock_irqrestore(&pool_lock, flags);
+  return removed;
+}
+
+bool cancel_work_sync(work_t *work) {
+  if (!work)
+    return false;
+
+  bool cancelled = cancel_delayed_work(work);
+
+  uint32_t flags = spin_lock_irqsave(&pool_lock);
+  if (work->flags & WORK_PENDING) {
+    for (uint32_t i = 0; i < nr_workers; i++) {
+      if (deque_remove(&workers[i], work)) {
+        work->flags &= ~WORK_PENDING;
+        pool_pending--;
+        cancelled = true;
+        break;
+      }
+    }
+    // Si no estaba en ningún deque, un worker ya lo sacó y está a punto de
+    // ejecutarlo: se espera abajo como si estuviera en marcha
+  }
+
+  // Desde su propia función no se puede esperar a que acabe. worker_run
+  // despierta al limpiar WORK_RUNNING bajo este mismo lock.
+  worker_t *self = worker_self();
+  if (!self || self->running != work) {
+    while (work->flags & (WORK_PENDING | WORK_RUNNING))
+      wait_queue_sleep(&work_done, &pool_lock, 0);
+  }
+  spin_unlock_irqrestore(&pool_lock, flags);
+  return cancelled;
+}
+
+void workqueue_timer_tick(void) {
+  // Salida rápida sin lock: solo el tick o queue_delayed_work tocan la
+  // lista, y un diferido recién añadido como mucho espera un tick más
+  if (!wq_running || !delayed_head ||
+      (int32_t)(ticks_since_boot - delayed_next_due) < 0)
+    return;
+
+  uint32_t flags = spin_lock_irqsave(&pool_lock);
+  work_t **link = &delayed_head;
+  bool have_next = false;
+  uint32_t next_due = 0;
+
+  while (*link) {
+    work_t *work = *link;
+    if ((int32_t)(ticks_since_boot - work->due_tick) >= 0) {
+      *link = work->next;
+      work->next = NULL;
+      work->flags &= ~WORK_DELAYED;
+      workqueue_enqueue_locked(work);
+      continue;
+    }
+    if (!have_next || (int32_t)(work->due_tick - next_due) < 0) {
+      next_due = work->due_tick;
+      have_next = true;
+    }
+    link = &work->next;
+  }
+  delayed_next_due = next_due;
+  spin_unlock_irqrestore(&pool_lock, flags);
+}
+
+// ========================================================================
+// ESTADÍSTICAS
+// ========================================================================
+
+void workqueue_print_stats(void) {
+  terminal_puts(&main_terminal, "\r\n=== Workqueue ===\r\n");
+  if (!wq_running) {
+    terminal_puts(&main_terminal, "Workqueue not running\r\n");
+    return;
+  }
+
+  uint32_t flags = spin_lock_irqsave(&pool_lock);
+  uint32_t pending = pool_pending;
+  uint32_t delayed = 0;
+  for (work_t *w = delayed_head; w; w = w->next)
+    delayed++;
+  uint32_t free_items = 0;
+  for (work_t *w = pool_free; w; w = w->next)
+    free_items++;
+  spin_unlock_irqrestore(&pool_lock, flags);
+
+  terminal_printf(&main_terminal,
+                  "Queued: %u  Dropped: %u  Pending: %u  Delayed: %u  "
+                  "Free items: %u/%u\r\n",
+                  stat_queued, stat_dropped, pending, delayed, free_items,
+                  WORKQUEUE_POOL_ITEMS);
+  terminal_puts(&main_terminal, "WORKER      PID    DEPTH  EXECUTED  STOLEN\r\n");
+  for (uint32_t i = 0; i < nr_workers; i++) {
+    worker_t *w = &workers[i];
+    terminal_printf(&main_terminal, "%-10s  %-5u  %-5u  %-8u  %u\r\n",
+                    w->task->name, w->task->task_id, w->tail - w->head,
+                    w->executed, w->stolen);
+  }
+  terminal_puts(&main_terminal, "\r\n");
+}
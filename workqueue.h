@@ -0,0 +1,78 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ========================================================================
+// WORKQUEUE DEL KERNEL (POOL DE WORKERS CON ROBO DE TRABAJO)
+// ========================================================================
+//
+// El trabajo diferido se envía con queue_work(fn, arg) en lugar de tener una
+// tarea por subsistema sondeando en bucle. Cada worker tiene su propio deque:
+// el dueño saca por la cola (LIFO, caché caliente) y los demás roban por la
+// cabeza (FIFO). Cuando no hay nada que hacer los workers duermen en una
+// wait queue. Cada deque tiene su spinlock, así que con SMP basta con crear
+// un worker por CPU.
+
+#define WORKQUEUE_MAX_WORKERS 4
+#define WORKQUEUE_DEFAULT_WORKERS 2
+#define WORKQUEUE_DEQUE_SIZE 256   // Potencia de 2
+#define WORKQUEUE_POOL_ITEMS 256   // Items para queue_work(fn, arg)
+
+typedef void (*work_func_t)(void *arg);
+
+// Flags de work_t
+#define WORK_PENDING 0x01 // En un deque esperando worker
+#define WORK_DELAYED 0x02 // En la lista de diferidos (queue_delayed_work)
+#define WORK_POOLED 0x04  // Item del pool interno (se recicla al ejecutar)
+#define WORK_RUNNING 0x08 // Un worker está ejecutando su función
+
+// Un work_t puede ir embebido en la estructura del subsistema (sin reservas,
+// válido desde IRQ) o salir del pool interno vía queue_work()
+typedef struct work {
+  work_func_t func;
+  void *arg;
+  volatile uint32_t flags;
+  uint32_t due_tick;  // Tick de vencimiento si está diferido
+  struct work *next;  // Lista de diferidos / lista libre del pool
+} work_t;
+
+#define WORK_INIT(fn, a) {fn, a, 0, 0, NULL}
+
+void workqueue_init(void);
+bool workqueue_running(void);
+// true si la tarea actual es un worker (no debe bloquearse esperando a
+// otro trabajo de la misma workqueue)
+bool workqueue_in_worker(void);
+
+void work_init(work_t *work, work_func_t func, void *arg);
+
+// Encola fn(arg) usando un item del pool. Se puede llamar desde IRQ.
+// Devuelve false si el pool o los deques están llenos.
+bool queue_work(work_func_t func, void *arg);
+
+// Encola un work_t propio. Devuelve false si ya estaba pendiente.
+bool queue_work_item(work_t *work);
+
+// Encola 'work' cuando pasen 'delay_ms'. Devuelve false si ya estaba
+// pendiente o diferido.
+bool queue_delayed_work(work_t *work, uint32_t delay_ms);
+
+// Quita un work de la lista de diferidos. No espera si ya está ejecutando.
+bool cancel_delayed_work(work_t *work);
+
+// Quita 'work' de donde esté encolado (deque o diferidos) y espera a que
+// termine si un worker lo está ejecutando, salvo que sea el propio llamante.
+// Después se puede reinicializar o liberar su memoria. Contexto de tarea.
+// Devuelve true si estaba pendiente y no llegó a ejecutarse.
+bool cancel_work_sync(work_t *work);
+
+// Llamado desde el softirq TIMER (timer.c): mueve los diferidos vencidos
+// a los deques
+void workqueue_timer_tick(void);
+
+void workqueue_print_stats(void);
+
+#endif // WORKQUEUE_H